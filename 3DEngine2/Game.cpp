@@ -5,6 +5,8 @@
 #include "common/Configuration.h"
 #include "common/ServiceLocator.h"
 #include "common/BaseCache.h"
+#include "common/WorkDispatcher.h"
+#include "common/IoDispatcher.h"
 #include "rendering/PixelShader.h"
 #include "rendering/VertexShader.h"
 #include "rendering/RenderingStateCache.h"
@@ -78,6 +80,25 @@ namespace tde
         //  create rendering state caches
         provideRenderingStateCaches();
 
+        //  create the job dispatcher, worker count of 0 means one worker per hardware thread
+        if (!WorkDispatcherLocator::Get())
+        {
+            const int32_t workerCount = Configuration::GetInstance()->GetIntOrDefault("Jobs.WorkerCount", 0);
+            const bool isProfilingJobs = Configuration::GetInstance()->GetBoolOrDefault("Jobs.Profile", false);
+            WorkDispatcherLocator::Provide(std::make_shared<WorkDispatcher>("Compute", static_cast<uint32_t>(std::max(0, workerCount)), isProfilingJobs));
+            if (JobProfiler* pProfiler = WorkDispatcherLocator::Get()->GetProfiler())
+            {
+                pProfiler->SetThreadName("Main");
+            }
+        }
+
+        //  file reads go to their own threads, so they don't hold up the compute workers
+        if (!IoDispatcherLocator::Get())
+        {
+            const int32_t ioThreadCount = Configuration::GetInstance()->GetIntOrDefault("Io.ThreadCount", IoDispatcher::DEFAULT_THREAD_COUNT);
+            const int32_t ioAffinityMask = Configuration::GetInstance()->GetIntOrDefault("Io.AffinityMask", 0);
+            IoDispatcherLocator::Provide(std::make_shared<IoDispatcher>("Io", static_cast<uint32_t>(std::max(1, ioThreadCount)), static_cast<DWORD_PTR>(ioAffinityMask)));
+        }
 
         //  save the pointer to the Game object so that you can use its members in WndProc
         SetWindowLongPtr(pGame->mpWindow->GetWindowHandle(), GWLP_USERDATA, reinterpret_cast<LONG_PTR>(pGame.get()));
@@ -102,6 +123,9 @@ namespace tde
         mFixUpdatePeriod = 1.0 / mFixUpdateFrequency;
 
         const int maxFixUpdatesPerFrame = Configuration::GetInstance()->GetInt("Game.MaxFixUpdatesPerFrame");
+        //  background jobs may run this many milliseconds into a frame, 0 means until the render phase
+        const float backgroundJobBudget = Configuration::GetInstance()->GetFloatOrDefault("Jobs.BackgroundFrameBudget", 0.0f);
+        WorkDispatcher* pDispatcher = WorkDispatcherLocator::Get().get();
      
         //  setup the all the things
         PrivStart();
@@ -129,6 +153,17 @@ namespace tde
 
             mGameTimer.Tick();
             deltaTime = mGameTimer.GetDeltaTime();
+
+            //  resume whatever has been waiting for this frame
+            if (pDispatcher)
+            {
+                pDispatcher->BeginFrame();
+            }
+            if (pDispatcher && backgroundJobBudget > 0.0f)
+            {
+                pDispatcher->SetFrameDeadline(std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::milli>(backgroundJobBudget)));
+            }
             accumulatedFixUpdateTime += deltaTime;
             fixUpdatesThisFrame = 0;
 
@@ -140,7 +175,17 @@ namespace tde
             }
 
             PrivUpdate(deltaTime);
+
+            //  keep streaming and loading jobs off the cores while the frame is submitted
+            if (pDispatcher)
+            {
+                pDispatcher->SetBackgroundDeferred(true);
+            }
             PrivRender(deltaTime);
+            if (pDispatcher)
+            {
+                pDispatcher->SetBackgroundDeferred(false);
+            }
         }
 
         PrivDestroy();
@@ -156,7 +201,7 @@ namespace tde
 
     void Game::PrivFixUpdate()
     {
-        //  fix update
+        mpScene->FixedUpdate(mFixUpdatePeriod);
     }
 
     void Game::PrivUpdate(
@@ -181,6 +226,23 @@ namespace tde
     void Game::PrivDestroy()
     {
         mpScene->Destroy();
+
+        //  the job timeline of the whole session, if profiling is on
+        PrivWriteJobTrace();
+
+        //  join the worker threads before the statics go away,
+        //  the io threads first as they complete their reads on the workers
+        IoDispatcherLocator::Provide(nullptr);
+        WorkDispatcherLocator::Provide(nullptr);
+    }
+
+    void Game::PrivWriteJobTrace()
+    {
+        std::shared_ptr<WorkDispatcher> pDispatcher = WorkDispatcherLocator::Get();
+        if (pDispatcher && pDispatcher->GetProfiler())
+        {
+            pDispatcher->GetProfiler()->WriteChromeTrace(Configuration::GetInstance()->GetStringOrDefault("Jobs.TraceFile", "job_trace.json"));
+        }
     }
 
     void Game::PrivOnSuspending()
@@ -365,6 +427,11 @@ namespace tde
         case WM_KEYUP:
         case WM_SYSKEYUP:
             DirectX::Keyboard::ProcessMessage(message, wParam, lParam);
+            //  F9 dumps the recent job timeline
+            if (message == WM_KEYDOWN && wParam == VK_F9 && game)
+            {
+                game->PrivWriteJobTrace();
+            }
             break;
 
         //case WM_SYSKEYDOWN:
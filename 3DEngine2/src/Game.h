@@ -34,6 +34,7 @@ namespace tde
 		void								PrivUpdate(const double aDeltaTime);
 		void								PrivRender(const double aDeltaTime);
 		void								PrivDestroy();
+		void								PrivWriteJobTrace();
 
 		void								PrivOnSuspending();
 		void								PrivOnResuming();
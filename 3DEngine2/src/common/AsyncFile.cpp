@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "common/AsyncFile.h"
+
+#include "common/IoDispatcher.h"
+#include "common/WorkDispatcher.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace tde
+{
+	Task<std::vector<char>> readFileAsync(WorkDispatcher* apDispatcher, std::wstring aPath, const JobPriority aPriority)
+	{
+		std::shared_ptr<IoRequest> pRequest;
+		if (std::shared_ptr<IoDispatcher> pIoDispatcher = IoDispatcherLocator::Get())
+		{
+			pRequest = pIoDispatcher->ReadAsync(aPath, apDispatcher);
+		}
+
+		if (pRequest)
+		{
+			if (apDispatcher)
+			{
+				co_await waitFor(apDispatcher, pRequest->GetCounter(), aPriority);
+			}
+			else
+			{
+				pRequest->Wait();
+			}
+			co_return std::move(pRequest->GetData());
+		}
+
+		co_await schedule(apDispatcher, aPriority);
+
+		std::vector<char> data;
+		std::ifstream file(std::filesystem::path(aPath), std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			co_return data;
+		}
+
+		const std::streamoff fileSize = file.tellg();
+		if (fileSize <= 0)
+		{
+			co_return data;
+		}
+		data.resize(static_cast<size_t>(fileSize));
+		file.seekg(0, std::ios::beg);
+		if (!file.read(data.data(), fileSize))
+		{
+			data.clear();
+		}
+		co_return data;
+	}
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "common/Task.h"
+
+namespace tde
+{
+	class WorkDispatcher;
+
+	//	reads the whole file on the io threads of the IoDispatcherLocator and continues on a worker of apDispatcher,
+	//	without an io dispatcher the file is read on a background job, the result is empty if the file can't be read
+	Task<std::vector<char>> readFileAsync(WorkDispatcher* apDispatcher, std::wstring aPath, const JobPriority aPriority = JobPriority::BACKGROUND);
+}
@@ -0,0 +1,38 @@
+#include "pch.h"
+#include "common/CpuFeatures.h"
+
+#include <intrin.h>
+
+namespace tde
+{
+	namespace
+	{
+		bool checkAvx2Support()
+		{
+			int cpuInfo[4] = {};
+			__cpuid(cpuInfo, 0);
+			if (cpuInfo[0] < 7)
+			{
+				return false;
+			}
+
+			//	the os has to save the ymm registers as well
+			__cpuid(cpuInfo, 1);
+			const bool isOsxsaveSupported = (cpuInfo[2] & (1 << 27)) != 0;
+			const bool isAvxSupported = (cpuInfo[2] & (1 << 28)) != 0;
+			if (!isOsxsaveSupported || !isAvxSupported || (_xgetbv(0) & 0x6) != 0x6)
+			{
+				return false;
+			}
+
+			__cpuidex(cpuInfo, 7, 0);
+			return (cpuInfo[1] & (1 << 5)) != 0;
+		}
+	}
+
+	bool isAvx2Supported()
+	{
+		static const bool IS_AVX2_SUPPORTED = checkAvx2Support();
+		return IS_AVX2_SUPPORTED;
+	}
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace tde
+{
+	//	whether the cpu and the os support avx2, checked once
+	bool isAvx2Supported();
+}
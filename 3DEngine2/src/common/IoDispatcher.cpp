@@ -0,0 +1,220 @@
+#include "pch.h"
+#include "common/IoDispatcher.h"
+
+#include "common/WorkDispatcher.h"
+
+namespace tde
+{
+	IoRequest::IoRequest(const std::wstring& aPath, WorkDispatcher* apCompletionDispatcher)
+		: mOverlapped()
+		, mPath(aPath)
+		, mhFile(INVALID_HANDLE_VALUE)
+		, mReadSize(0)
+		, mpCompletionDispatcher(apCompletionDispatcher)
+		, mIsDone(false)
+		, mIsSucceeded(false)
+	{
+	}
+
+	void IoRequest::Wait() const
+	{
+		mIsDone.wait(false, std::memory_order_acquire);
+	}
+
+	IoDispatcher::IoDispatcher(const std::string& aName, const uint32_t aThreadCount, const DWORD_PTR aAffinityMask)
+		: mName(aName)
+		, mhCompletionPort(nullptr)
+		, mAffinityMask(aAffinityMask)
+		, mInFlightCount(0)
+	{
+		const uint32_t threadCount = std::max(1u, aThreadCount);
+		mhCompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, threadCount);
+		if (!mhCompletionPort)
+		{
+			throw std::runtime_error("failed to create the io completion port");
+		}
+
+		mThreads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			mThreads.emplace_back(&IoDispatcher::PrivThreadRoutine, this, i);
+		}
+	}
+
+	IoDispatcher::~IoDispatcher()
+	{
+		//	the completions of reads in flight could arrive after a stop, so wait for them first
+		int32_t inFlightCount = mInFlightCount.load(std::memory_order_acquire);
+		while (inFlightCount > 0)
+		{
+			mInFlightCount.wait(inFlightCount, std::memory_order_acquire);
+			inFlightCount = mInFlightCount.load(std::memory_order_acquire);
+		}
+
+		for (size_t i = 0; i < mThreads.size(); i++)
+		{
+			PostQueuedCompletionStatus(mhCompletionPort, 0, static_cast<ULONG_PTR>(CompletionKey::STOP), nullptr);
+		}
+		for (auto& thread : mThreads)
+		{
+			thread.join();
+		}
+		mThreads.clear();
+
+		CloseHandle(mhCompletionPort);
+	}
+
+	std::shared_ptr<IoRequest> IoDispatcher::ReadAsync(const std::wstring& aPath, WorkDispatcher* apCompletionDispatcher)
+	{
+		std::shared_ptr<IoRequest> pRequest = std::make_shared<IoRequest>(aPath, apCompletionDispatcher);
+		if (apCompletionDispatcher)
+		{
+			apCompletionDispatcher->Retain(pRequest->mCounter);
+		}
+		pRequest->mpSelf = pRequest;
+		mInFlightCount.fetch_add(1, std::memory_order_acq_rel);
+
+		//	even opening a file can take a while, so that's done on an io thread as well
+		if (!PostQueuedCompletionStatus(mhCompletionPort, 0, static_cast<ULONG_PTR>(CompletionKey::OPEN), &pRequest->mOverlapped))
+		{
+			PrivComplete(pRequest.get(), false);
+		}
+		return pRequest;
+	}
+
+	void IoDispatcher::PrivThreadRoutine(const uint32_t aIndex)
+	{
+		std::string threadName = mName + " Io " + std::to_string(aIndex);
+		std::wstring wideThreadName(threadName.begin(), threadName.end());
+		setCurrentThreadDescription(wideThreadName);
+		if (mAffinityMask != 0)
+		{
+			SetThreadAffinityMask(GetCurrentThread(), mAffinityMask);
+		}
+
+		for (;;)
+		{
+			DWORD byteCount = 0;
+			ULONG_PTR key = 0;
+			LPOVERLAPPED pOverlapped = nullptr;
+			const BOOL isSucceeded = GetQueuedCompletionStatus(mhCompletionPort, &byteCount, &key, &pOverlapped, INFINITE);
+			if (!pOverlapped)
+			{
+				//	without an overlapped it's either our stop or the port is gone
+				if (key == static_cast<ULONG_PTR>(CompletionKey::STOP) || !isSucceeded)
+				{
+					return;
+				}
+				continue;
+			}
+
+			IoRequest* pRequest = CONTAINING_RECORD(pOverlapped, IoRequest, mOverlapped);
+			switch (static_cast<CompletionKey>(key))
+			{
+			case CompletionKey::OPEN:
+				PrivOpen(pRequest);
+				break;
+			case CompletionKey::READ:
+				PrivOnChunkRead(pRequest, byteCount, isSucceeded != FALSE);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	void IoDispatcher::PrivOpen(IoRequest* apRequest)
+	{
+		apRequest->mhFile = CreateFileW(apRequest->mPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (apRequest->mhFile == INVALID_HANDLE_VALUE)
+		{
+			PrivComplete(apRequest, false);
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(apRequest->mhFile, &fileSize) || fileSize.QuadPart < 0)
+		{
+			PrivComplete(apRequest, false);
+			return;
+		}
+		if (fileSize.QuadPart == 0)
+		{
+			PrivComplete(apRequest, true);
+			return;
+		}
+
+		//	the reads of this file complete on the port, on whichever io thread is free
+		if (!CreateIoCompletionPort(apRequest->mhFile, mhCompletionPort, static_cast<ULONG_PTR>(CompletionKey::READ), 0))
+		{
+			PrivComplete(apRequest, false);
+			return;
+		}
+		apRequest->mData.resize(static_cast<size_t>(fileSize.QuadPart));
+		PrivReadNextChunk(apRequest);
+	}
+
+	void IoDispatcher::PrivReadNextChunk(IoRequest* apRequest)
+	{
+		const size_t remainingSize = apRequest->mData.size() - apRequest->mReadSize;
+		const DWORD chunkSize = static_cast<DWORD>(std::min(remainingSize, static_cast<size_t>(READ_CHUNK_SIZE)));
+
+		apRequest->mOverlapped = OVERLAPPED();
+		apRequest->mOverlapped.Offset = static_cast<DWORD>(apRequest->mReadSize & 0xFFFFFFFF);
+		apRequest->mOverlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(apRequest->mReadSize) >> 32);
+
+		//	a read which finishes right away still posts its completion to the port
+		if (!ReadFile(apRequest->mhFile, apRequest->mData.data() + apRequest->mReadSize, chunkSize, nullptr, &apRequest->mOverlapped)
+			&& GetLastError() != ERROR_IO_PENDING)
+		{
+			PrivComplete(apRequest, false);
+		}
+	}
+
+	void IoDispatcher::PrivOnChunkRead(IoRequest* apRequest, const DWORD aByteCount, const bool aIsSucceeded)
+	{
+		//	no bytes means the file has shrunk since we've opened it
+		if (!aIsSucceeded || aByteCount == 0)
+		{
+			PrivComplete(apRequest, false);
+			return;
+		}
+
+		apRequest->mReadSize += aByteCount;
+		if (apRequest->mReadSize < apRequest->mData.size())
+		{
+			PrivReadNextChunk(apRequest);
+			return;
+		}
+		PrivComplete(apRequest, true);
+	}
+
+	void IoDispatcher::PrivComplete(IoRequest* apRequest, const bool aIsSucceeded)
+	{
+		if (apRequest->mhFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(apRequest->mhFile);
+			apRequest->mhFile = INVALID_HANDLE_VALUE;
+		}
+		if (!aIsSucceeded)
+		{
+			apRequest->mData.clear();
+		}
+
+		//	the request may be released by its owner as soon as it's done
+		std::shared_ptr<IoRequest> pRequest = std::move(apRequest->mpSelf);
+		pRequest->mIsSucceeded = aIsSucceeded;
+		pRequest->mIsDone.store(true, std::memory_order_release);
+		pRequest->mIsDone.notify_all();
+		if (pRequest->mpCompletionDispatcher)
+		{
+			pRequest->mpCompletionDispatcher->Release(pRequest->mCounter);
+		}
+
+		if (mInFlightCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			mInFlightCount.notify_all();
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "common/ServiceLocator.h"
+#include "common/Job.h"
+
+#include <atomic>
+
+namespace tde
+{
+	class WorkDispatcher;
+
+	//	completion handle of a read issued with IoDispatcher::ReadAsync
+	class IoRequest
+	{
+	public:
+		IoRequest(const std::wstring& aPath, WorkDispatcher* apCompletionDispatcher);
+		IoRequest(const IoRequest& aOther) = delete;
+		IoRequest& operator=(const IoRequest& aOther) = delete;
+
+		inline bool IsDone() const { return mIsDone.load(std::memory_order_acquire); }
+		//	only valid once the request is done
+		inline bool IsSucceeded() const { return mIsSucceeded; }
+		//	blocks the calling thread until the request is done, jobs should wait on the counter instead
+		void Wait() const;
+
+		//	reaches zero once the request is done, only counts if the read was issued with a completion dispatcher,
+		//	so jobs can WorkDispatcher::WaitFor or DispatchAfter it without blocking their worker
+		inline JobCounter& GetCounter() { return mCounter; }
+		//	the whole file, empty if it couldn't be read, only touch it once the request is done
+		inline std::vector<char>& GetData() { return mData; }
+		inline const std::wstring& GetPath() const { return mPath; }
+
+	private:
+		OVERLAPPED mOverlapped;
+		std::wstring mPath;
+		HANDLE mhFile;
+		std::vector<char> mData;
+		size_t mReadSize;
+		WorkDispatcher* mpCompletionDispatcher;
+		//	the dispatcher keeps the request alive while it's in flight
+		std::shared_ptr<IoRequest> mpSelf;
+		JobCounter mCounter;
+		std::atomic<bool> mIsDone;
+		bool mIsSucceeded;
+
+		friend class IoDispatcher;
+	};
+
+	//	a few dedicated threads which do nothing but file io, separate from the compute workers
+	//	so disk latency never stalls a worker or the frame loop
+	//	reads are overlapped and completed through an io completion port, an io thread only opens the file,
+	//	issues the next chunk and finishes the request, it's free for other requests while the disk is busy
+	class IoDispatcher
+	{
+	public:
+		static constexpr uint32_t DEFAULT_THREAD_COUNT = 2;
+		//	large files are read in several overlapped reads of this size
+		static constexpr DWORD READ_CHUNK_SIZE = 16 * 1024 * 1024;
+
+		//	aAffinityMask of 0 lets the threads run on any core
+		IoDispatcher(const std::string& aName, const uint32_t aThreadCount = DEFAULT_THREAD_COUNT, const DWORD_PTR aAffinityMask = 0);
+		IoDispatcher(const IoDispatcher& aOther) = delete;
+		IoDispatcher& operator=(const IoDispatcher& aOther) = delete;
+		//	finishes the requests which are in flight
+		~IoDispatcher();
+
+		//	reads the whole file, the request's counter is released on apCompletionDispatcher once it's done,
+		//	so the completion dispatcher must outlive the request
+		std::shared_ptr<IoRequest> ReadAsync(const std::wstring& aPath, WorkDispatcher* apCompletionDispatcher = nullptr);
+
+		inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(mThreads.size()); }
+
+	private:
+		enum class CompletionKey : ULONG_PTR
+		{
+			OPEN	= 1,	//	posted by ReadAsync
+			READ	= 2,	//	an overlapped read has finished
+			STOP	= 3,
+		};
+
+		void PrivThreadRoutine(const uint32_t aIndex);
+		void PrivOpen(IoRequest* apRequest);
+		void PrivReadNextChunk(IoRequest* apRequest);
+		void PrivOnChunkRead(IoRequest* apRequest, const DWORD aByteCount, const bool aIsSucceeded);
+		void PrivComplete(IoRequest* apRequest, const bool aIsSucceeded);
+
+		std::string mName;
+		HANDLE mhCompletionPort;
+		DWORD_PTR mAffinityMask;
+		std::vector<std::thread> mThreads;
+		std::atomic<int32_t> mInFlightCount;
+	};
+
+	using IoDispatcherLocator = ServiceLocator<IoDispatcher>;
+	std::shared_ptr<IoDispatcher> IoDispatcherLocator::mpService = nullptr;
+}
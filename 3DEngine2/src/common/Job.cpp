@@ -5,6 +5,14 @@ namespace tde
 {
 	void Job::run()
 	{
+		if (mpInvoke)
+		{
+			mpInvoke(mStorage);
+		}
 	}
-}
 
+	JobCounter::JobCounter()
+		: mValue(0)
+	{
+	}
+}
@@ -1,10 +1,94 @@
 #pragma once
 
+#include <atomic>
+#include <type_traits>
+
 namespace tde
 {
+	class JobCounter;
+
+	//	lanes of the work dispatcher, lower values are picked first
+	enum class JobPriority : uint8_t
+	{
+		FRAME_CRITICAL	= 0,	//	work the current frame is waiting for
+		NORMAL			= 1,
+		BACKGROUND		= 2,	//	streaming and loading, deferred during the render phase
+	};
+
+	constexpr static size_t JOB_PRIORITY_COUNT = 3;
+
+	//	type erased job which keeps its callable inline, so dispatching never allocates
+	//	the callable must be small and trivially copyable, capture pointers instead of owning objects
 	class Job
 	{
 	public:
-		virtual void run();
+		//	keeps the whole job in one cache line
+		static constexpr size_t STORAGE_SIZE = 40;
+
+		Job() = default;
+
+		template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Job>::value>>
+		Job(F aFunction, const JobPriority aPriority = JobPriority::NORMAL);
+
+		void run();
+		inline bool IsValid() const { return mpInvoke != nullptr; }
+		inline JobCounter* GetCounter() const { return mpCounter; }
+		inline JobPriority GetPriority() const { return mPriority; }
+		inline void SetPriority(const JobPriority aPriority) { mPriority = aPriority; }
+
+	private:
+		using InvokeFunction = void(*)(void*);
+
+		template<typename F>
+		static void PrivInvoke(void* apStorage);
+
+		alignas(16) unsigned char mStorage[STORAGE_SIZE] = {};
+		InvokeFunction mpInvoke = nullptr;
+		JobCounter* mpCounter = nullptr;	//	decremented when the job is done
+		JobPriority mPriority = JobPriority::NORMAL;
+
+		friend class WorkDispatcher;
 	};
+
+	//	counts the unfinished jobs attached to it
+	//	jobs dispatched with WorkDispatcher::DispatchAfter are held back until it reaches zero
+	//	only destroy a counter after WorkDispatcher::WaitFor on it has returned
+	class JobCounter
+	{
+	public:
+		JobCounter();
+		JobCounter(const JobCounter& aOther) = delete;
+		JobCounter& operator=(const JobCounter& aOther) = delete;
+
+		inline int32_t GetValue() const { return mValue.load(std::memory_order_acquire); }
+		inline bool IsDone() const { return GetValue() == 0; }
+
+	private:
+		std::atomic<int32_t> mValue;
+
+		mutable std::mutex mContinuationMutex;
+		std::vector<Job> mContinuations;
+		//	fibers suspended in WorkDispatcher::WaitFor, waiting doesn't change the value so it's allowed on a const counter
+		mutable std::vector<void*> mWaitingFibers;
+
+		friend class WorkDispatcher;
+	};
+
+	template<typename F, typename>
+	inline Job::Job(F aFunction, const JobPriority aPriority)
+		: mpInvoke(&Job::PrivInvoke<F>)
+		, mPriority(aPriority)
+	{
+		static_assert(sizeof(F) <= STORAGE_SIZE, "job callable is too large, capture a pointer to the data instead");
+		static_assert(alignof(F) <= 16, "job callable is over aligned");
+		static_assert(std::is_trivially_copyable<F>::value && std::is_trivially_destructible<F>::value,
+			"job callable must be trivially copyable, capture pointers instead of owning objects");
+		new (mStorage) F(aFunction);
+	}
+
+	template<typename F>
+	inline void Job::PrivInvoke(void* apStorage)
+	{
+		(*reinterpret_cast<F*>(apStorage))();
+	}
 }
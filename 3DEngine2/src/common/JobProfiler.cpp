@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "common/JobProfiler.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace tde
+{
+	namespace
+	{
+		std::atomic<uint32_t> gNextProfilerId(1);
+
+		//	the ring of the calling thread for the profiler it was last looked up for
+		struct ThreadRingCache
+		{
+			uint32_t mProfilerId = 0;
+			void* mpRing = nullptr;
+		};
+		thread_local ThreadRingCache gThreadRingCache;
+
+		int64_t readPerformanceCounter()
+		{
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+		}
+
+		const char* getEventName(const JobEventType aType)
+		{
+			switch (aType)
+			{
+			case JobEventType::JOB_BEGIN:
+			case JobEventType::JOB_END:
+				return "Job";
+			case JobEventType::STEAL:
+				return "Steal";
+			case JobEventType::PARK_BEGIN:
+			case JobEventType::PARK_END:
+				return "Parked";
+			case JobEventType::WAKE:
+				return "Wake";
+			}
+			return "Unknown";
+		}
+	}
+
+	JobProfiler::EventRing::EventRing(const uint32_t aThreadId)
+		: mThreadName("Thread " + std::to_string(aThreadId))
+		, mThreadId(aThreadId)
+		, mEvents(std::make_unique<JobEvent[]>(EVENT_RING_SIZE))
+		, mHead(0)
+	{
+	}
+
+	void JobProfiler::EventRing::CopyEvents(std::vector<JobEvent>& aOutEvents) const
+	{
+		const uint64_t head = mHead.load(std::memory_order_acquire);
+		const uint64_t first = head > EVENT_RING_SIZE ? head - EVENT_RING_SIZE : 0;
+		const size_t outOffset = aOutEvents.size();
+		for (uint64_t i = first; i < head; i++)
+		{
+			aOutEvents.emplace_back(mEvents[i & (EVENT_RING_SIZE - 1)]);
+		}
+
+		//	the owner may have lapped us while we were copying, those slots could be torn
+		const uint64_t headAfterCopy = mHead.load(std::memory_order_acquire);
+		const uint64_t firstIntact = headAfterCopy > EVENT_RING_SIZE ? headAfterCopy - EVENT_RING_SIZE : 0;
+		if (firstIntact > first)
+		{
+			const size_t overwrittenCount = static_cast<size_t>(std::min(firstIntact, head) - first);
+			aOutEvents.erase(aOutEvents.begin() + outOffset, aOutEvents.begin() + outOffset + overwrittenCount);
+		}
+	}
+
+	JobProfiler::JobProfiler()
+		: mProfilerId(gNextProfilerId.fetch_add(1, std::memory_order_relaxed))
+		, mStartTime(readPerformanceCounter())
+		, mMicrosecondsPerTick(0.0)
+	{
+		LARGE_INTEGER frequency;
+		if (QueryPerformanceFrequency(&frequency))
+		{
+			mMicrosecondsPerTick = 1000000.0 / static_cast<double>(frequency.QuadPart);
+		}
+	}
+
+	JobProfiler::~JobProfiler()
+	{
+	}
+
+	void JobProfiler::SetThreadName(const std::string& aName)
+	{
+		EventRing* pRing = PrivGetThreadRing();
+		std::lock_guard<std::mutex> lock(mRingMutex);
+		pRing->mThreadName = aName;
+	}
+
+	void JobProfiler::Record(const JobEventType aType, const uint32_t aArg)
+	{
+		JobEvent event;
+		event.mTime = readPerformanceCounter();
+		event.mArg = aArg;
+		event.mType = aType;
+		PrivGetThreadRing()->Push(event);
+	}
+
+	bool JobProfiler::WriteChromeTrace(const std::string& aPath) const
+	{
+		std::ofstream traceFile(aPath, std::ios::out | std::ios::trunc);
+		if (!traceFile.is_open())
+		{
+			return false;
+		}
+
+		traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		traceFile << std::fixed << std::setprecision(3);
+
+		bool isFirstEvent = true;
+		auto beginEvent = [&traceFile, &isFirstEvent]() -> std::ofstream& {
+			if (!isFirstEvent)
+			{
+				traceFile << ",\n";
+			}
+			isFirstEvent = false;
+			return traceFile;
+		};
+
+		std::lock_guard<std::mutex> lock(mRingMutex);
+		std::vector<JobEvent> events;
+		for (const auto& pRing : mRings)
+		{
+			beginEvent() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pRing->mThreadId
+				<< ",\"args\":{\"name\":\"" << pRing->mThreadName << "\"}}";
+
+			events.clear();
+			pRing->CopyEvents(events);
+
+			//	the oldest events may have lost their begin to the ring, their ends are skipped to keep the timeline balanced
+			int32_t jobDepth = 0;
+			int32_t parkDepth = 0;
+			for (const auto& event : events)
+			{
+				const double time = static_cast<double>(event.mTime - mStartTime) * mMicrosecondsPerTick;
+				const char* pName = getEventName(event.mType);
+				switch (event.mType)
+				{
+				case JobEventType::JOB_BEGIN:
+					jobDepth++;
+					beginEvent() << "{\"name\":\"" << pName << "\",\"ph\":\"B\",\"pid\":1,\"tid\":" << pRing->mThreadId
+						<< ",\"ts\":" << time << ",\"args\":{\"priority\":" << event.mArg << "}}";
+					break;
+				case JobEventType::PARK_BEGIN:
+					parkDepth++;
+					beginEvent() << "{\"name\":\"" << pName << "\",\"ph\":\"B\",\"pid\":1,\"tid\":" << pRing->mThreadId
+						<< ",\"ts\":" << time << "}";
+					break;
+				case JobEventType::JOB_END:
+				case JobEventType::PARK_END:
+				{
+					int32_t& depth = event.mType == JobEventType::JOB_END ? jobDepth : parkDepth;
+					if (depth == 0)
+					{
+						break;
+					}
+					depth--;
+					beginEvent() << "{\"name\":\"" << pName << "\",\"ph\":\"E\",\"pid\":1,\"tid\":" << pRing->mThreadId
+						<< ",\"ts\":" << time << "}";
+					break;
+				}
+				case JobEventType::STEAL:
+					beginEvent() << "{\"name\":\"" << pName << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << pRing->mThreadId
+						<< ",\"ts\":" << time << ",\"args\":{\"victim\":" << event.mArg << "}}";
+					break;
+				case JobEventType::WAKE:
+					beginEvent() << "{\"name\":\"" << pName << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << pRing->mThreadId
+						<< ",\"ts\":" << time << "}";
+					break;
+				}
+			}
+		}
+
+		traceFile << "\n]}\n";
+		return traceFile.good();
+	}
+
+	JobProfiler::EventRing* JobProfiler::PrivGetThreadRing()
+	{
+		ThreadRingCache& cache = gThreadRingCache;
+		if (cache.mProfilerId == mProfilerId)
+		{
+			return static_cast<EventRing*>(cache.mpRing);
+		}
+
+		//	the thread may have been using another profiler in between
+		const uint32_t threadId = static_cast<uint32_t>(GetCurrentThreadId());
+		std::lock_guard<std::mutex> lock(mRingMutex);
+		EventRing* pRing = nullptr;
+		for (const auto& pExistingRing : mRings)
+		{
+			if (pExistingRing->mThreadId == threadId)
+			{
+				pRing = pExistingRing.get();
+				break;
+			}
+		}
+		if (!pRing)
+		{
+			mRings.emplace_back(std::make_unique<EventRing>(threadId));
+			pRing = mRings.back().get();
+		}
+		cache.mProfilerId = mProfilerId;
+		cache.mpRing = pRing;
+		return pRing;
+	}
+}
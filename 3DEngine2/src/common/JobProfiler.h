@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	enum class JobEventType : uint8_t
+	{
+		JOB_BEGIN		= 0,	//	a job starts or its fiber is resumed
+		JOB_END			= 1,	//	a job is done or its fiber is suspended
+		STEAL			= 2,	//	mArg is the index of the victim
+		PARK_BEGIN		= 3,
+		PARK_END		= 4,
+		WAKE			= 5,	//	a parked worker has been notified
+	};
+
+	struct JobEvent
+	{
+		int64_t mTime;		//	performance counter ticks
+		uint32_t mArg;
+		JobEventType mType;
+	};
+
+	//	records what the threads of a work dispatcher are doing into one ring buffer per thread,
+	//	only the owning thread writes to a ring so recording is a store and an atomic increment,
+	//	the rings keep the latest events and can be written out as chrome trace json (chrome://tracing, ui.perfetto.dev)
+	class JobProfiler
+	{
+	public:
+		static constexpr size_t EVENT_RING_SIZE = 64 * 1024;
+
+		JobProfiler();
+		JobProfiler(const JobProfiler& aOther) = delete;
+		JobProfiler& operator=(const JobProfiler& aOther) = delete;
+		~JobProfiler();
+
+		//	names the calling thread's timeline
+		void SetThreadName(const std::string& aName);
+		void Record(const JobEventType aType, const uint32_t aArg = 0);
+
+		//	can be called while the workers are running, events overwritten during the dump are dropped
+		bool WriteChromeTrace(const std::string& aPath) const;
+
+	private:
+		class EventRing
+		{
+		public:
+			EventRing(const uint32_t aThreadId);
+
+			inline void Push(const JobEvent& aEvent)
+			{
+				const uint64_t head = mHead.load(std::memory_order_relaxed);
+				mEvents[head & (EVENT_RING_SIZE - 1)] = aEvent;
+				mHead.store(head + 1, std::memory_order_release);
+			}
+
+			//	copies the events which are still intact, oldest first
+			void CopyEvents(std::vector<JobEvent>& aOutEvents) const;
+
+			std::string mThreadName;
+			uint32_t mThreadId;
+
+		private:
+			std::unique_ptr<JobEvent[]> mEvents;
+			std::atomic<uint64_t> mHead;
+		};
+
+		EventRing* PrivGetThreadRing();
+
+		mutable std::mutex mRingMutex;
+		std::vector<std::unique_ptr<EventRing>> mRings;
+		uint32_t mProfilerId;
+		int64_t mStartTime;
+		double mMicrosecondsPerTick;
+	};
+}
@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "common/MappedFile.h"
+
+namespace tde
+{
+	MappedFile::MappedFile(const std::wstring& aPath)
+		: mPath(aPath)
+		, mhFile(INVALID_HANDLE_VALUE)
+		, mhMapping(nullptr)
+		, mpData(nullptr)
+		, mSize(0)
+	{
+		mhFile = CreateFileW(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (mhFile == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(mhFile, &fileSize) || fileSize.QuadPart <= 0)
+		{
+			return;
+		}
+
+		mhMapping = CreateFileMappingW(mhFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mhMapping)
+		{
+			return;
+		}
+
+		mpData = static_cast<const uint8_t*>(MapViewOfFile(mhMapping, FILE_MAP_READ, 0, 0, 0));
+		if (mpData)
+		{
+			mSize = static_cast<size_t>(fileSize.QuadPart);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mpData)
+		{
+			UnmapViewOfFile(mpData);
+		}
+		if (mhMapping)
+		{
+			CloseHandle(mhMapping);
+		}
+		if (mhFile != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(mhFile);
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace tde
+{
+	//	read only view of a whole file, pages are read by the os when they are first touched,
+	//	so opening a large file costs nothing until its data is used
+	class MappedFile
+	{
+	public:
+		//	IsOpen is false if the file can't be mapped, empty files can't be mapped either
+		explicit MappedFile(const std::wstring& aPath);
+		MappedFile(const MappedFile& aOther) = delete;
+		MappedFile& operator=(const MappedFile& aOther) = delete;
+		~MappedFile();
+
+		inline bool IsOpen() const { return mpData != nullptr; }
+		inline const uint8_t* GetData() const { return mpData; }
+		inline size_t GetSize() const { return mSize; }
+		inline const std::wstring& GetPath() const { return mPath; }
+
+	private:
+		std::wstring mPath;
+		HANDLE mhFile;
+		HANDLE mhMapping;
+		const uint8_t* mpData;
+		size_t mSize;
+	};
+}
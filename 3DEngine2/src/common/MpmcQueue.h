@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	//	bounded multi producer multi consumer queue by Dmitry Vyukov
+	//	https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+	//	every cell carries a sequence number which tells producers and consumers whose turn it is,
+	//	so a push or pop is one CAS on the shared position and never waits for other threads to finish theirs
+	//	T must be default constructible and copy assignable
+	template<typename T>
+	class MpmcQueue
+	{
+	public:
+		//	the capacity is rounded up to a power of 2
+		explicit MpmcQueue(const size_t aCapacity);
+		MpmcQueue(const MpmcQueue& aOther) = delete;
+		MpmcQueue& operator=(const MpmcQueue& aOther) = delete;
+
+		//	returns false if the queue is full
+		bool TryPush(const T& aItem);
+		//	returns false if the queue is empty
+		bool TryPop(T& aOutItem);
+
+		//	only a snapshot while other threads are pushing or popping
+		size_t GetSize() const;
+		inline size_t GetCapacity() const { return mMask + 1; }
+
+	private:
+		struct Cell
+		{
+			std::atomic<size_t> mSequence;
+			T mItem;
+		};
+
+		static size_t PrivRoundUpCapacity(const size_t aCapacity);
+
+		std::unique_ptr<Cell[]> mpCells;
+		size_t mMask;
+		alignas(64) std::atomic<size_t> mEnqueuePosition;
+		alignas(64) std::atomic<size_t> mDequeuePosition;
+	};
+
+	template<typename T>
+	inline MpmcQueue<T>::MpmcQueue(const size_t aCapacity)
+		: mpCells(std::make_unique<Cell[]>(PrivRoundUpCapacity(aCapacity)))
+		, mMask(PrivRoundUpCapacity(aCapacity) - 1)
+		, mEnqueuePosition(0)
+		, mDequeuePosition(0)
+	{
+		for (size_t i = 0; i <= mMask; i++)
+		{
+			mpCells[i].mSequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	template<typename T>
+	inline bool MpmcQueue<T>::TryPush(const T& aItem)
+	{
+		Cell* pCell = nullptr;
+		size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			pCell = &mpCells[position & mMask];
+			const size_t sequence = pCell->mSequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0)
+			{
+				//	the cell is free for this position, claim it
+				if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				//	the cell still holds the item from one lap ago
+				return false;
+			}
+			else
+			{
+				//	another producer claimed it first
+				position = mEnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		pCell->mItem = aItem;
+		//	publishes the item to the consumer of this position
+		pCell->mSequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T>
+	inline bool MpmcQueue<T>::TryPop(T& aOutItem)
+	{
+		Cell* pCell = nullptr;
+		size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			pCell = &mpCells[position & mMask];
+			const size_t sequence = pCell->mSequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0)
+			{
+				if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (difference < 0)
+			{
+				//	nothing has been published for this position yet
+				return false;
+			}
+			else
+			{
+				position = mDequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+
+		aOutItem = pCell->mItem;
+		//	hands the cell back to the producer of the next lap
+		pCell->mSequence.store(position + mMask + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T>
+	inline size_t MpmcQueue<T>::GetSize() const
+	{
+		const size_t enqueuePosition = mEnqueuePosition.load(std::memory_order_acquire);
+		const size_t dequeuePosition = mDequeuePosition.load(std::memory_order_acquire);
+		return enqueuePosition > dequeuePosition ? enqueuePosition - dequeuePosition : 0;
+	}
+
+	template<typename T>
+	inline size_t MpmcQueue<T>::PrivRoundUpCapacity(const size_t aCapacity)
+	{
+		size_t capacity = 2;
+		while (capacity < aCapacity)
+		{
+			capacity <<= 1;
+		}
+		return capacity;
+	}
+}
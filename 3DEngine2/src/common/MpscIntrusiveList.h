@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	//	embed this in the items of an MpscIntrusiveList, an item can only be in one list at a time
+	struct MpscNode
+	{
+		std::atomic<MpscNode*> mpNext = nullptr;
+	};
+
+	//	unbounded multi producer single consumer queue by Dmitry Vyukov, the links live in the items so it never allocates
+	//	https://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+	//	any thread may Push(), only one thread may Pop()
+	//	a push is a single exchange, a producer preempted in the middle of it briefly hides the items behind its own,
+	//	Pop() returns nullptr meanwhile, so don't treat nullptr as a proof that the list is empty
+	//	T must derive from MpscNode
+	template<typename T>
+	class MpscIntrusiveList
+	{
+	public:
+		MpscIntrusiveList();
+		MpscIntrusiveList(const MpscIntrusiveList& aOther) = delete;
+		MpscIntrusiveList& operator=(const MpscIntrusiveList& aOther) = delete;
+
+		void Push(T* apItem);
+		//	returns nullptr if there is nothing to pop right now
+		T* Pop();
+
+	private:
+		void PrivPushNode(MpscNode* apNode);
+
+		//	producers append here
+		alignas(64) std::atomic<MpscNode*> mpHead;
+		//	the consumer takes from here
+		alignas(64) MpscNode* mpTail;
+		//	keeps the list non empty, so producers and the consumer never touch the same pointer
+		MpscNode mStub;
+	};
+
+	template<typename T>
+	inline MpscIntrusiveList<T>::MpscIntrusiveList()
+		: mpHead(&mStub)
+		, mpTail(&mStub)
+	{
+		static_assert(std::is_base_of<MpscNode, T>::value, "items of an mpsc intrusive list must derive from MpscNode");
+	}
+
+	template<typename T>
+	inline void MpscIntrusiveList<T>::Push(T* apItem)
+	{
+		PrivPushNode(static_cast<MpscNode*>(apItem));
+	}
+
+	template<typename T>
+	inline void MpscIntrusiveList<T>::PrivPushNode(MpscNode* apNode)
+	{
+		apNode->mpNext.store(nullptr, std::memory_order_relaxed);
+		MpscNode* pPrevious = mpHead.exchange(apNode, std::memory_order_acq_rel);
+		//	until this store the node is unreachable for the consumer
+		pPrevious->mpNext.store(apNode, std::memory_order_release);
+	}
+
+	template<typename T>
+	inline T* MpscIntrusiveList<T>::Pop()
+	{
+		MpscNode* pTail = mpTail;
+		MpscNode* pNext = pTail->mpNext.load(std::memory_order_acquire);
+
+		//	skip the stub
+		if (pTail == &mStub)
+		{
+			if (!pNext)
+			{
+				return nullptr;
+			}
+			mpTail = pNext;
+			pTail = pNext;
+			pNext = pNext->mpNext.load(std::memory_order_acquire);
+		}
+
+		if (pNext)
+		{
+			mpTail = pNext;
+			return static_cast<T*>(pTail);
+		}
+
+		//	pTail is the last node we can see, a producer may be in the middle of linking the next one
+		if (pTail != mpHead.load(std::memory_order_acquire))
+		{
+			return nullptr;
+		}
+
+		//	re-insert the stub behind the last node, so it can be handed out without leaving the list empty
+		PrivPushNode(&mStub);
+		pNext = pTail->mpNext.load(std::memory_order_acquire);
+		if (pNext)
+		{
+			mpTail = pNext;
+			return static_cast<T*>(pTail);
+		}
+		return nullptr;
+	}
+}
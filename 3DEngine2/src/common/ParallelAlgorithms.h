@@ -0,0 +1,189 @@
+#pragma once
+#include "common/Job.h"
+#include "common/WorkDispatcher.h"
+
+namespace tde
+{
+	//	all algorithms here block until the whole range is processed, the calling thread helps with the work
+	//	if apDispatcher is nullptr the range is processed serially on the calling thread
+	//	aGrainSize of 0 picks a grain size from the range size and the worker count
+	//	aPriority is the lane the split off jobs go to, use FRAME_CRITICAL for work the frame is blocked on
+
+	//	calls aFunction(i) for every i in [aBegin, aEnd)
+	template<typename F>
+	void parallelFor(WorkDispatcher* apDispatcher, const size_t aBegin, const size_t aEnd, const F& aFunction, const size_t aGrainSize = 0, const JobPriority aPriority = JobPriority::NORMAL);
+
+	//	reduces aMap(i) for every i in [aBegin, aEnd) with aReduce(T, T)
+	//	the range is split into blocks of the grain size which are combined in order, so the result doesn't depend on scheduling,
+	//	the picked grain size depends on the worker count, pass one to get the same float result on every machine
+	template<typename T, typename M, typename R>
+	T parallelReduce(WorkDispatcher* apDispatcher, const size_t aBegin, const size_t aEnd, const T& aIdentity, const M& aMap, const R& aReduce, const size_t aGrainSize = 0, const JobPriority aPriority = JobPriority::NORMAL);
+
+	//	inclusive prefix scan, apOutput[i] = aOp(apInput[0], ..., apInput[i]), apInput and apOutput may be the same
+	template<typename T, typename Op>
+	void parallelScan(WorkDispatcher* apDispatcher, const T* apInput, T* apOutput, const size_t aCount, const T& aIdentity, const Op& aOp, const size_t aGrainSize = 0, const JobPriority aPriority = JobPriority::NORMAL);
+
+	//	splits the range recursively, the upper halves are dispatched so idle workers can steal them,
+	//	the lower half keeps running on the current thread
+	template<typename F>
+	class ParallelForTask
+	{
+	public:
+		ParallelForTask(WorkDispatcher* apDispatcher, const F* apFunction, const size_t aGrainSize, const JobPriority aPriority)
+			: mpDispatcher(apDispatcher)
+			, mpFunction(apFunction)
+			, mGrainSize(aGrainSize)
+			, mPriority(aPriority)
+		{}
+
+		void Run(size_t aBegin, size_t aEnd, JobCounter* apCounter) const
+		{
+			while (aEnd - aBegin > mGrainSize)
+			{
+				const size_t middle = aBegin + (aEnd - aBegin) / 2;
+				const ParallelForTask* pTask = this;
+				const size_t upperBegin = middle;
+				const size_t upperEnd = aEnd;
+				mpDispatcher->Dispatch(Job([pTask, upperBegin, upperEnd, apCounter]() {
+					pTask->Run(upperBegin, upperEnd, apCounter);
+				}, mPriority), apCounter);
+				aEnd = middle;
+			}
+
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				(*mpFunction)(i);
+			}
+		}
+
+	private:
+		WorkDispatcher* mpDispatcher;
+		const F* mpFunction;
+		size_t mGrainSize;
+		JobPriority mPriority;
+	};
+
+	inline size_t computeGrainSize(WorkDispatcher* apDispatcher, const size_t aCount, const size_t aGrainSize)
+	{
+		if (aGrainSize > 0)
+		{
+			return aGrainSize;
+		}
+		//	a few chunks per worker leaves room for stealing to even out uneven work
+		const size_t chunkCount = static_cast<size_t>(apDispatcher->GetWorkerCount()) * 8;
+		return std::max<size_t>(1, aCount / chunkCount);
+	}
+
+	template<typename F>
+	inline void parallelFor(WorkDispatcher* apDispatcher, const size_t aBegin, const size_t aEnd, const F& aFunction, const size_t aGrainSize, const JobPriority aPriority)
+	{
+		if (aEnd <= aBegin)
+		{
+			return;
+		}
+
+		const size_t count = aEnd - aBegin;
+		if (!apDispatcher || count == 1)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				aFunction(i);
+			}
+			return;
+		}
+
+		const size_t grainSize = computeGrainSize(apDispatcher, count, aGrainSize);
+		if (count <= grainSize)
+		{
+			for (size_t i = aBegin; i < aEnd; i++)
+			{
+				aFunction(i);
+			}
+			return;
+		}
+
+		JobCounter counter;
+		ParallelForTask<F> task(apDispatcher, &aFunction, grainSize, aPriority);
+		task.Run(aBegin, aEnd, &counter);
+		apDispatcher->WaitFor(counter);
+	}
+
+	template<typename T, typename M, typename R>
+	inline T parallelReduce(WorkDispatcher* apDispatcher, const size_t aBegin, const size_t aEnd, const T& aIdentity, const M& aMap, const R& aReduce, const size_t aGrainSize, const JobPriority aPriority)
+	{
+		if (aEnd <= aBegin)
+		{
+			return aIdentity;
+		}
+
+		const size_t count = aEnd - aBegin;
+		//	a given grain size splits the same way without a dispatcher, so a serial run gives the same result too
+		const size_t blockSize = apDispatcher || aGrainSize > 0 ? computeGrainSize(apDispatcher, count, aGrainSize) : count;
+		const size_t blockCount = (count + blockSize - 1) / blockSize;
+
+		std::vector<T> partials(blockCount, aIdentity);
+		parallelFor(apDispatcher, 0, blockCount, [&](const size_t aBlock) {
+			const size_t blockBegin = aBegin + aBlock * blockSize;
+			const size_t blockEnd = std::min(aEnd, blockBegin + blockSize);
+			T partial = aIdentity;
+			for (size_t i = blockBegin; i < blockEnd; i++)
+			{
+				partial = aReduce(partial, aMap(i));
+			}
+			partials[aBlock] = partial;
+		}, 1, aPriority);
+
+		T result = aIdentity;
+		for (const auto& partial : partials)
+		{
+			result = aReduce(result, partial);
+		}
+		return result;
+	}
+
+	template<typename T, typename Op>
+	inline void parallelScan(WorkDispatcher* apDispatcher, const T* apInput, T* apOutput, const size_t aCount, const T& aIdentity, const Op& aOp, const size_t aGrainSize, const JobPriority aPriority)
+	{
+		if (aCount == 0)
+		{
+			return;
+		}
+
+		const size_t blockSize = apDispatcher ? computeGrainSize(apDispatcher, aCount, aGrainSize) : aCount;
+		const size_t blockCount = (aCount + blockSize - 1) / blockSize;
+
+		//	1. reduce every block
+		std::vector<T> blockOffsets(blockCount, aIdentity);
+		parallelFor(apDispatcher, 0, blockCount, [&](const size_t aBlock) {
+			const size_t blockBegin = aBlock * blockSize;
+			const size_t blockEnd = std::min(aCount, blockBegin + blockSize);
+			T sum = aIdentity;
+			for (size_t i = blockBegin; i < blockEnd; i++)
+			{
+				sum = aOp(sum, apInput[i]);
+			}
+			blockOffsets[aBlock] = sum;
+		}, 1, aPriority);
+
+		//	2. exclusive scan of the block sums, there are only a few of them
+		T running = aIdentity;
+		for (auto& offset : blockOffsets)
+		{
+			T sum = offset;
+			offset = running;
+			running = aOp(running, sum);
+		}
+
+		//	3. scan every block starting from its offset
+		parallelFor(apDispatcher, 0, blockCount, [&](const size_t aBlock) {
+			const size_t blockBegin = aBlock * blockSize;
+			const size_t blockEnd = std::min(aCount, blockBegin + blockSize);
+			T sum = blockOffsets[aBlock];
+			for (size_t i = blockBegin; i < blockEnd; i++)
+			{
+				sum = aOp(sum, apInput[i]);
+				apOutput[i] = sum;
+			}
+		}, 1, aPriority);
+	}
+}
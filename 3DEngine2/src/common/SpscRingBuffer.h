@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	//	bounded single producer single consumer ring buffer
+	//	only one thread may push and only one thread may pop, each side caches the other side's index
+	//	so it only touches the other side's cache line when the buffer looks full or empty
+	template<typename T, size_t CAPACITY>
+	class SpscRingBuffer
+	{
+	public:
+		static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity of the spsc ring buffer must be power of 2");
+
+		SpscRingBuffer();
+		SpscRingBuffer(const SpscRingBuffer& aOther) = delete;
+		SpscRingBuffer& operator=(const SpscRingBuffer& aOther) = delete;
+
+		//	producer only, returns false if the buffer is full
+		bool TryPush(const T& aItem);
+		//	consumer only, returns false if the buffer is empty
+		bool TryPop(T& aOutItem);
+
+		//	only a snapshot unless called from the producer or consumer with the other side idle
+		size_t GetSize() const;
+
+	private:
+		static constexpr size_t MASK = CAPACITY - 1;
+
+		//	written by the consumer
+		alignas(64) std::atomic<size_t> mHead;
+		size_t mCachedTail;
+		//	written by the producer
+		alignas(64) std::atomic<size_t> mTail;
+		size_t mCachedHead;
+		alignas(64) T mItems[CAPACITY];
+	};
+
+	template<typename T, size_t CAPACITY>
+	inline SpscRingBuffer<T, CAPACITY>::SpscRingBuffer()
+		: mHead(0)
+		, mCachedTail(0)
+		, mTail(0)
+		, mCachedHead(0)
+	{
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline bool SpscRingBuffer<T, CAPACITY>::TryPush(const T& aItem)
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mCachedHead >= CAPACITY)
+		{
+			mCachedHead = mHead.load(std::memory_order_acquire);
+			if (tail - mCachedHead >= CAPACITY)
+			{
+				return false;
+			}
+		}
+
+		mItems[tail & MASK] = aItem;
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline bool SpscRingBuffer<T, CAPACITY>::TryPop(T& aOutItem)
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mCachedTail)
+		{
+			mCachedTail = mTail.load(std::memory_order_acquire);
+			if (head == mCachedTail)
+			{
+				return false;
+			}
+		}
+
+		aOutItem = mItems[head & MASK];
+		//	the producer may overwrite the slot from now on
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline size_t SpscRingBuffer<T, CAPACITY>::GetSize() const
+	{
+		const size_t tail = mTail.load(std::memory_order_acquire);
+		const size_t head = mHead.load(std::memory_order_acquire);
+		return tail > head ? tail - head : 0;
+	}
+}
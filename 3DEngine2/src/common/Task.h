@@ -0,0 +1,457 @@
+#pragma once
+#include "common/Job.h"
+#include "common/WorkDispatcher.h"
+
+#include <coroutine>
+#include <optional>
+#include <tuple>
+#include <utility>
+
+namespace tde
+{
+	//	lazy coroutine, the body starts running when the task is awaited and the awaiting coroutine
+	//	is resumed on whichever thread the task finishes, so co_await schedule() to move the work onto the workers
+	//	exceptions thrown in the body are rethrown from co_await
+	template<typename T = void>
+	class Task;
+
+	//	coroutine handles are resumed from jobs, only their address is kept so the job stays trivially copyable
+	inline Job makeResumeJob(std::coroutine_handle<> aHandle, const JobPriority aPriority)
+	{
+		void* pAddress = aHandle.address();
+		return Job([pAddress]() {
+			std::coroutine_handle<>::from_address(pAddress).resume();
+		}, aPriority);
+	}
+
+	//	co_await schedule(pDispatcher) continues the coroutine on a worker
+	//	without a dispatcher the coroutine just keeps running on the current thread
+	class ScheduleAwaiter
+	{
+	public:
+		ScheduleAwaiter(WorkDispatcher* apDispatcher, const JobPriority aPriority)
+			: mpDispatcher(apDispatcher)
+			, mPriority(aPriority)
+		{}
+
+		bool await_ready() const noexcept { return mpDispatcher == nullptr; }
+		void await_suspend(std::coroutine_handle<> aHandle) const { mpDispatcher->Dispatch(makeResumeJob(aHandle, mPriority)); }
+		void await_resume() const noexcept {}
+
+	private:
+		WorkDispatcher* mpDispatcher;
+		JobPriority mPriority;
+	};
+
+	inline ScheduleAwaiter schedule(WorkDispatcher* apDispatcher, const JobPriority aPriority = JobPriority::NORMAL)
+	{
+		return ScheduleAwaiter(apDispatcher, aPriority);
+	}
+
+	//	co_await nextFrame(pDispatcher) continues the coroutine on a worker once the next frame has begun
+	class NextFrameAwaiter
+	{
+	public:
+		NextFrameAwaiter(WorkDispatcher* apDispatcher, const JobPriority aPriority)
+			: mpDispatcher(apDispatcher)
+			, mPriority(aPriority)
+		{}
+
+		bool await_ready() const noexcept { return mpDispatcher == nullptr; }
+		void await_suspend(std::coroutine_handle<> aHandle) const { mpDispatcher->DispatchNextFrame(makeResumeJob(aHandle, mPriority)); }
+		void await_resume() const noexcept {}
+
+	private:
+		WorkDispatcher* mpDispatcher;
+		JobPriority mPriority;
+	};
+
+	inline NextFrameAwaiter nextFrame(WorkDispatcher* apDispatcher, const JobPriority aPriority = JobPriority::NORMAL)
+	{
+		return NextFrameAwaiter(apDispatcher, aPriority);
+	}
+
+	//	co_await waitFor(pDispatcher, counter) continues the coroutine on a worker once the counter has reached zero,
+	//	unlike WorkDispatcher::WaitFor no fiber is held meanwhile, it needs a dispatcher unless the counter is already done
+	class CounterAwaiter
+	{
+	public:
+		CounterAwaiter(WorkDispatcher* apDispatcher, JobCounter& aCounter, const JobPriority aPriority)
+			: mpDispatcher(apDispatcher)
+			, mCounter(aCounter)
+			, mPriority(aPriority)
+		{}
+
+		bool await_ready() const noexcept { return mCounter.IsDone(); }
+		void await_suspend(std::coroutine_handle<> aHandle) const { mpDispatcher->DispatchAfter(mCounter, makeResumeJob(aHandle, mPriority)); }
+		void await_resume() const noexcept {}
+
+	private:
+		WorkDispatcher* mpDispatcher;
+		JobCounter& mCounter;
+		JobPriority mPriority;
+	};
+
+	inline CounterAwaiter waitFor(WorkDispatcher* apDispatcher, JobCounter& aCounter, const JobPriority aPriority = JobPriority::NORMAL)
+	{
+		return CounterAwaiter(apDispatcher, aCounter, aPriority);
+	}
+
+	class TaskPromiseBase
+	{
+	public:
+		class FinalAwaiter
+		{
+		public:
+			bool await_ready() const noexcept { return false; }
+			template<typename P>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<P> aHandle) const noexcept
+			{
+				//	symmetric transfer, resuming the awaiting coroutine doesn't grow the stack
+				std::coroutine_handle<> continuation = aHandle.promise().mContinuation;
+				return continuation ? continuation : std::noop_coroutine();
+			}
+			void await_resume() const noexcept {}
+		};
+
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() noexcept { mException = std::current_exception(); }
+
+		inline void SetContinuation(std::coroutine_handle<> aContinuation) { mContinuation = aContinuation; }
+
+	protected:
+		inline void PrivRethrowIfFailed() const
+		{
+			if (mException)
+			{
+				std::rethrow_exception(mException);
+			}
+		}
+
+	private:
+		std::coroutine_handle<> mContinuation;
+		std::exception_ptr mException;
+	};
+
+	template<typename T>
+	class TaskPromise : public TaskPromiseBase
+	{
+	public:
+		Task<T> get_return_object() noexcept;
+
+		template<typename U>
+		void return_value(U&& aValue) { mResult.emplace(std::forward<U>(aValue)); }
+
+		T TakeResult()
+		{
+			PrivRethrowIfFailed();
+			return std::move(*mResult);
+		}
+
+	private:
+		std::optional<T> mResult;
+	};
+
+	template<>
+	class TaskPromise<void> : public TaskPromiseBase
+	{
+	public:
+		Task<void> get_return_object() noexcept;
+
+		void return_void() const noexcept {}
+
+		void TakeResult() const
+		{
+			PrivRethrowIfFailed();
+		}
+	};
+
+	template<typename T>
+	class Task
+	{
+	public:
+		using promise_type = TaskPromise<T>;
+		using Handle = std::coroutine_handle<promise_type>;
+
+		class Awaiter
+		{
+		public:
+			explicit Awaiter(Handle aHandle) : mHandle(aHandle) {}
+
+			bool await_ready() const noexcept { return !mHandle || mHandle.done(); }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> aAwaitingHandle) const noexcept
+			{
+				mHandle.promise().SetContinuation(aAwaitingHandle);
+				return mHandle;
+			}
+			T await_resume() const { return mHandle.promise().TakeResult(); }
+
+		private:
+			Handle mHandle;
+		};
+
+		Task() = default;
+		explicit Task(Handle aHandle) : mHandle(aHandle) {}
+		Task(Task&& aOther) noexcept : mHandle(std::exchange(aOther.mHandle, nullptr)) {}
+		Task& operator=(Task&& aOther) noexcept
+		{
+			if (this != &aOther)
+			{
+				PrivDestroy();
+				mHandle = std::exchange(aOther.mHandle, nullptr);
+			}
+			return *this;
+		}
+		Task(const Task& aOther) = delete;
+		Task& operator=(const Task& aOther) = delete;
+		~Task() { PrivDestroy(); }
+
+		inline bool IsValid() const { return static_cast<bool>(mHandle); }
+
+		//	a task can only be awaited once
+		Awaiter operator co_await() && noexcept { return Awaiter(mHandle); }
+
+	private:
+		void PrivDestroy()
+		{
+			if (mHandle)
+			{
+				mHandle.destroy();
+				mHandle = nullptr;
+			}
+		}
+
+		Handle mHandle;
+	};
+
+	template<typename T>
+	inline Task<T> TaskPromise<T>::get_return_object() noexcept
+	{
+		return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+	}
+
+	inline Task<void> TaskPromise<void>::get_return_object() noexcept
+	{
+		return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+	}
+
+	//	eagerly started coroutine which destroys itself when it's done, used to drive tasks from plain code
+	class DetachedTask
+	{
+	public:
+		class promise_type
+		{
+		public:
+			DetachedTask get_return_object() const noexcept { return {}; }
+			std::suspend_never initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			//	the bodies catch everything themselves
+			void unhandled_exception() const noexcept { std::terminate(); }
+		};
+	};
+
+	//	resumes the awaiting coroutine once all of its children are done
+	class WhenAllLatch
+	{
+	public:
+		explicit WhenAllLatch(const size_t aChildCount)
+			//	the awaiting coroutine holds one count until it's suspended
+			: mCount(aChildCount + 1)
+		{}
+		WhenAllLatch(const WhenAllLatch& aOther) = delete;
+		WhenAllLatch& operator=(const WhenAllLatch& aOther) = delete;
+
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> aHandle) noexcept
+		{
+			mAwaitingHandle = aHandle;
+			return mCount.fetch_sub(1, std::memory_order_acq_rel) > 1;
+		}
+		void await_resume() const
+		{
+			if (mException)
+			{
+				std::rethrow_exception(mException);
+			}
+		}
+
+		void NotifyChildDone()
+		{
+			//	the awaiting coroutine may finish and destroy the latch, don't touch it after resuming
+			if (mCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				mAwaitingHandle.resume();
+			}
+		}
+
+		void SetException(std::exception_ptr aException)
+		{
+			std::lock_guard<std::mutex> lock(mExceptionMutex);
+			if (!mException)
+			{
+				mException = aException;
+			}
+		}
+
+	private:
+		std::atomic<size_t> mCount;
+		std::coroutine_handle<> mAwaitingHandle;
+		std::mutex mExceptionMutex;
+		std::exception_ptr mException;
+	};
+
+	template<typename T>
+	inline DetachedTask runWhenAllChild(WorkDispatcher* apDispatcher, Task<T> aTask, std::optional<T>* apResult, WhenAllLatch* apLatch)
+	{
+		try
+		{
+			co_await schedule(apDispatcher);
+			apResult->emplace(co_await std::move(aTask));
+		}
+		catch (...)
+		{
+			apLatch->SetException(std::current_exception());
+		}
+		apLatch->NotifyChildDone();
+	}
+
+	inline DetachedTask runWhenAllChild(WorkDispatcher* apDispatcher, Task<void> aTask, WhenAllLatch* apLatch)
+	{
+		try
+		{
+			co_await schedule(apDispatcher);
+			co_await std::move(aTask);
+		}
+		catch (...)
+		{
+			apLatch->SetException(std::current_exception());
+		}
+		apLatch->NotifyChildDone();
+	}
+
+	//	starts every task on its own job and finishes once all of them are done,
+	//	the results are returned in the order of the tasks, the first exception thrown by any of them is rethrown
+	template<typename... Ts>
+	inline Task<std::tuple<Ts...>> whenAll(WorkDispatcher* apDispatcher, Task<Ts>... aTasks)
+	{
+		std::tuple<std::optional<Ts>...> results;
+		WhenAllLatch latch(sizeof...(Ts));
+		[&]<size_t... I>(std::index_sequence<I...>) {
+			(runWhenAllChild(apDispatcher, std::move(aTasks), &std::get<I>(results), &latch), ...);
+		}(std::index_sequence_for<Ts...>{});
+		co_await latch;
+
+		co_return std::apply([](auto&... aResults) {
+			return std::tuple<Ts...>(std::move(*aResults)...);
+		}, results);
+	}
+
+	template<typename T>
+	inline Task<std::vector<T>> whenAll(WorkDispatcher* apDispatcher, std::vector<Task<T>> aTasks)
+	{
+		std::vector<std::optional<T>> results(aTasks.size());
+		WhenAllLatch latch(aTasks.size());
+		for (size_t i = 0; i < aTasks.size(); i++)
+		{
+			runWhenAllChild(apDispatcher, std::move(aTasks[i]), &results[i], &latch);
+		}
+		co_await latch;
+
+		std::vector<T> values;
+		values.reserve(results.size());
+		for (auto& result : results)
+		{
+			values.emplace_back(std::move(*result));
+		}
+		co_return values;
+	}
+
+	inline Task<void> whenAll(WorkDispatcher* apDispatcher, std::vector<Task<void>> aTasks)
+	{
+		WhenAllLatch latch(aTasks.size());
+		for (auto& task : aTasks)
+		{
+			runWhenAllChild(apDispatcher, std::move(task), &latch);
+		}
+		co_await latch;
+	}
+
+	template<typename T>
+	inline DetachedTask runSyncWaitTask(WorkDispatcher* apDispatcher, Task<T> aTask, std::optional<T>* apResult, std::exception_ptr* apException, JobCounter* apCounter)
+	{
+		try
+		{
+			apResult->emplace(co_await std::move(aTask));
+		}
+		catch (...)
+		{
+			*apException = std::current_exception();
+		}
+		if (apCounter)
+		{
+			apDispatcher->Release(*apCounter);
+		}
+	}
+
+	inline DetachedTask runSyncWaitTask(WorkDispatcher* apDispatcher, Task<void> aTask, std::exception_ptr* apException, JobCounter* apCounter)
+	{
+		try
+		{
+			co_await std::move(aTask);
+		}
+		catch (...)
+		{
+			*apException = std::current_exception();
+		}
+		if (apCounter)
+		{
+			apDispatcher->Release(*apCounter);
+		}
+	}
+
+	//	blocks until the task is done, the calling thread runs jobs meanwhile,
+	//	the task starts on the calling thread and runs there until its first suspension,
+	//	without a dispatcher nothing ever suspends and the task simply runs to completion
+	template<typename T>
+	inline T syncWait(WorkDispatcher* apDispatcher, Task<T> aTask)
+	{
+		JobCounter counter;
+		std::optional<T> result;
+		std::exception_ptr exception;
+		if (apDispatcher)
+		{
+			apDispatcher->Retain(counter);
+		}
+		runSyncWaitTask(apDispatcher, std::move(aTask), &result, &exception, apDispatcher ? &counter : nullptr);
+		if (apDispatcher)
+		{
+			apDispatcher->WaitFor(counter);
+		}
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+		return std::move(*result);
+	}
+
+	inline void syncWait(WorkDispatcher* apDispatcher, Task<void> aTask)
+	{
+		JobCounter counter;
+		std::exception_ptr exception;
+		if (apDispatcher)
+		{
+			apDispatcher->Retain(counter);
+		}
+		runSyncWaitTask(apDispatcher, std::move(aTask), &exception, apDispatcher ? &counter : nullptr);
+		if (apDispatcher)
+		{
+			apDispatcher->WaitFor(counter);
+		}
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+}
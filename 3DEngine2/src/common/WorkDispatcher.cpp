@@ -6,26 +6,628 @@
 
 namespace tde
 {
-	WorkDispatcher::WorkDispatcher(const std::string& aName)
+	namespace
+	{
+		constexpr JobPriority STRICT_LANE_ORDER[JOB_PRIORITY_COUNT] = { JobPriority::FRAME_CRITICAL, JobPriority::NORMAL, JobPriority::BACKGROUND };
+		constexpr JobPriority NORMAL_BOOST_LANE_ORDER[JOB_PRIORITY_COUNT] = { JobPriority::NORMAL, JobPriority::FRAME_CRITICAL, JobPriority::BACKGROUND };
+		constexpr JobPriority BACKGROUND_BOOST_LANE_ORDER[JOB_PRIORITY_COUNT] = { JobPriority::BACKGROUND, JobPriority::FRAME_CRITICAL, JobPriority::NORMAL };
+
+		inline size_t laneIndex(const JobPriority aPriority)
+		{
+			return static_cast<size_t>(aPriority);
+		}
+
+		uint32_t resolveWorkerCount(const uint32_t aWorkerCount)
+		{
+			return aWorkerCount != 0 ? aWorkerCount : std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		//	every worker needs a fiber to start on, the rest is for suspended jobs
+		uint32_t getFiberPoolSize(const uint32_t aWorkerCount)
+		{
+			return std::max(WorkDispatcher::FIBER_POOL_SIZE, aWorkerCount * 4);
+		}
+	}
+
+	WorkDispatcher::WorkDispatcher(const std::string& aName, const uint32_t aWorkerCount, const bool aIsProfiling)
 		: mName(aName)
+		, mpProfiler(aIsProfiling ? std::make_unique<JobProfiler>() : nullptr)
+		, mInjectedJobs{ MpmcQueue<Job>(INJECTED_JOB_QUEUE_CAPACITY), MpmcQueue<Job>(INJECTED_JOB_QUEUE_CAPACITY), MpmcQueue<Job>(INJECTED_JOB_QUEUE_CAPACITY) }
+		, mFreeFibers(getFiberPoolSize(resolveWorkerCount(aWorkerCount)))
+		, mReadyFibers(getFiberPoolSize(resolveWorkerCount(aWorkerCount)))
+		, mReadyFiberCount(0)
+		, mIsBackgroundDeferred(false)
+		, mFrameDeadline(0)
+		, mParkedWorkerCount(0)
+		, mIsRunning(true)
 	{
-		mWorkers.emplace_back(Worker(this));
+		static_assert(JOB_PRIORITY_COUNT == 3, "initialize an injection queue for every priority");
+		for (size_t i = 0; i < JOB_PRIORITY_COUNT; i++)
+		{
+			mPendingJobCounts[i].store(0, std::memory_order_relaxed);
+			mOverflowJobCounts[i].store(0, std::memory_order_relaxed);
+		}
+
+		const uint32_t workerCount = resolveWorkerCount(aWorkerCount);
+		const uint32_t fiberCount = getFiberPoolSize(workerCount);
+		mFibers.reserve(fiberCount);
+		for (uint32_t i = 0; i < fiberCount; i++)
+		{
+			LPVOID pFiber = CreateFiberEx(FIBER_STACK_COMMIT_SIZE, FIBER_STACK_RESERVE_SIZE, 0, &Worker::FiberRoutine, this);
+			if (!pFiber)
+			{
+				break;
+			}
+			mFibers.emplace_back(pFiber);
+		}
+		if (mFibers.size() < workerCount)
+		{
+			for (auto pFiber : mFibers)
+			{
+				DeleteFiber(pFiber);
+			}
+			throw std::runtime_error("failed to create fibers for the work dispatcher");
+		}
+		for (auto pFiber : mFibers)
+		{
+			mFreeFibers.TryPush(pFiber);
+		}
+
+		//	create all workers before starting any of them, they steal from each other
+		mWorkers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			mWorkers.emplace_back(std::make_unique<Worker>(this, i));
+		}
+		for (auto& pWorker : mWorkers)
+		{
+			//	hand out the start fibers up front, suspended jobs can't drain the pool before a worker is up
+			pWorker->mpStartFiber = PrivAcquireFiber();
+			pWorker->Start();
+		}
 	}
-	
+
 	WorkDispatcher::~WorkDispatcher()
 	{
+		{
+			std::lock_guard<std::mutex> lock(mParkMutex);
+			mIsRunning.store(false, std::memory_order_release);
+		}
+		mParkCondition.notify_all();
+
+		for (auto& pWorker : mWorkers)
+		{
+			pWorker->Join();
+		}
 		mWorkers.clear();
+
+		//	the threads are gone, so none of the fibers is running anymore
+		for (auto pFiber : mFibers)
+		{
+			DeleteFiber(pFiber);
+		}
+		mFibers.clear();
 	}
 
-	void WorkDispatcher::Dispatch(Job aJob)
+	void WorkDispatcher::Dispatch(const Job& aJob, JobCounter* apCounter)
 	{
-		std::lock_guard<std::mutex> lock(mJobMutex);
-		mPendingJobs.emplace_back(aJob);
+		Dispatch(&aJob, 1, apCounter);
 	}
 
-	bool WorkDispatcher::HasPendingJobs()
+	void WorkDispatcher::Dispatch(const Job* apJobs, const size_t aJobCount, JobCounter* apCounter)
 	{
-		return !mPendingJobs.empty();
+		if (apCounter)
+		{
+			apCounter->mValue.fetch_add(static_cast<int32_t>(aJobCount), std::memory_order_acq_rel);
+		}
+		for (size_t i = 0; i < aJobCount; i++)
+		{
+			Job job = apJobs[i];
+			job.mpCounter = apCounter;
+			PrivSchedule(job);
+		}
 	}
-}
 
+	void WorkDispatcher::DispatchAfter(JobCounter& aDependency, const Job& aJob, JobCounter* apCounter)
+	{
+		Job job = aJob;
+		job.mpCounter = apCounter;
+		if (apCounter)
+		{
+			apCounter->mValue.fetch_add(1, std::memory_order_acq_rel);
+		}
+
+		{
+			//	the finishing job takes the same lock before it flushes the continuations,
+			//	so the job is either registered in time or the dependency is already done
+			std::lock_guard<std::mutex> lock(aDependency.mContinuationMutex);
+			if (!aDependency.IsDone())
+			{
+				aDependency.mContinuations.emplace_back(job);
+				return;
+			}
+		}
+		PrivSchedule(job);
+	}
+
+	void WorkDispatcher::WaitFor(const JobCounter& aCounter)
+	{
+		Worker* pWorker = Worker::GetCurrentWorker();
+		if (pWorker && pWorker->GetDispatcher() != this)
+		{
+			pWorker = nullptr;
+		}
+
+		if (!aCounter.IsDone() && pWorker)
+		{
+			LPVOID pNextFiber = PrivAcquireFiber();
+			if (pNextFiber)
+			{
+				//	the next fiber parks us on the counter, doing it here could resume us before we've switched away
+				pWorker->mpFiberToSuspend = GetCurrentFiber();
+				pWorker->mpSuspendCounter = &aCounter;
+				const JobPriority priority = pWorker->mRunningJobPriority;
+				if (mpProfiler)
+				{
+					mpProfiler->Record(JobEventType::JOB_END, static_cast<uint32_t>(priority));
+				}
+				SwitchToFiber(pNextFiber);
+
+				//	resumed once the counter is done, maybe on another thread
+				pWorker = Worker::GetCurrentWorker();
+				pWorker->CompleteFiberSwitch();
+				if (mpProfiler)
+				{
+					pWorker->mRunningJobPriority = priority;
+					mpProfiler->Record(JobEventType::JOB_BEGIN, static_cast<uint32_t>(priority));
+				}
+			}
+		}
+
+		PrivHelpUntilDone(pWorker, aCounter);
+
+		//	the job which brought the counter to zero may still be holding its lock
+		std::lock_guard<std::mutex> lock(aCounter.mContinuationMutex);
+	}
+
+	void WorkDispatcher::Retain(JobCounter& aCounter, const int32_t aCount)
+	{
+		aCounter.mValue.fetch_add(aCount, std::memory_order_acq_rel);
+	}
+
+	void WorkDispatcher::Release(JobCounter& aCounter)
+	{
+		PrivDecrementCounter(aCounter);
+	}
+
+	void WorkDispatcher::DispatchNextFrame(const Job& aJob, JobCounter* apCounter)
+	{
+		Job job = aJob;
+		job.mpCounter = apCounter;
+		if (apCounter)
+		{
+			apCounter->mValue.fetch_add(1, std::memory_order_acq_rel);
+		}
+
+		std::lock_guard<std::mutex> lock(mNextFrameJobMutex);
+		mNextFrameJobs.emplace_back(job);
+	}
+
+	void WorkDispatcher::BeginFrame()
+	{
+		std::vector<Job> nextFrameJobs;
+		{
+			std::lock_guard<std::mutex> lock(mNextFrameJobMutex);
+			nextFrameJobs.swap(mNextFrameJobs);
+		}
+		//	the counters have been incremented when the jobs were held back
+		for (const auto& job : nextFrameJobs)
+		{
+			PrivSchedule(job);
+		}
+	}
+
+	bool WorkDispatcher::HasPendingJobs() const
+	{
+		if (mReadyFiberCount.load(std::memory_order_acquire) > 0)
+		{
+			return true;
+		}
+		for (const auto& pendingJobCount : mPendingJobCounts)
+		{
+			if (pendingJobCount.load(std::memory_order_acquire) > 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkDispatcher::SetBackgroundDeferred(const bool aIsDeferred)
+	{
+		mIsBackgroundDeferred.store(aIsDeferred, std::memory_order_seq_cst);
+		if (!aIsDeferred)
+		{
+			//	workers may have parked on background jobs they weren't allowed to run
+			PrivWakeAllWorkers();
+		}
+	}
+
+	void WorkDispatcher::SetFrameDeadline(const std::chrono::steady_clock::time_point& aDeadline)
+	{
+		mFrameDeadline.store(static_cast<int64_t>(aDeadline.time_since_epoch().count()), std::memory_order_seq_cst);
+		PrivWakeAllWorkers();
+	}
+
+	void WorkDispatcher::ClearFrameDeadline()
+	{
+		mFrameDeadline.store(0, std::memory_order_seq_cst);
+		PrivWakeAllWorkers();
+	}
+
+	bool WorkDispatcher::IsBackgroundDeferred() const
+	{
+		if (mIsBackgroundDeferred.load(std::memory_order_seq_cst))
+		{
+			return true;
+		}
+		const int64_t deadline = mFrameDeadline.load(std::memory_order_seq_cst);
+		return deadline != 0 && static_cast<int64_t>(std::chrono::steady_clock::now().time_since_epoch().count()) >= deadline;
+	}
+
+	void WorkDispatcher::PrivSchedule(const Job& aJob)
+	{
+		const JobPriority priority = aJob.GetPriority();
+		mPendingJobCounts[laneIndex(priority)].fetch_add(1, std::memory_order_seq_cst);
+
+		Worker* pWorker = Worker::GetCurrentWorker();
+		if (!pWorker || pWorker->GetDispatcher() != this || !pWorker->PushJob(aJob))
+		{
+			const size_t lane = laneIndex(priority);
+			if (!mInjectedJobs[lane].TryPush(aJob))
+			{
+				std::lock_guard<std::mutex> lock(mOverflowJobMutex);
+				mOverflowJobs[lane].emplace_back(aJob);
+				mOverflowJobCounts[lane].fetch_add(1, std::memory_order_release);
+			}
+		}
+
+		//	nobody could pick up a deferred job, whoever lifts the deferral wakes the workers
+		if (priority != JobPriority::BACKGROUND || !IsBackgroundDeferred())
+		{
+			PrivWakeWorker();
+		}
+	}
+
+	void WorkDispatcher::PrivRunJob(Job& aJob)
+	{
+		if (mpProfiler)
+		{
+			//	WaitFor records the slices of a suspended job with it, a job run while another one waits
+			//	on the same fiber puts the priority of the waiting one back
+			Worker* pWorker = Worker::GetCurrentWorker();
+			const JobPriority waitingPriority = pWorker ? pWorker->mRunningJobPriority : JobPriority::NORMAL;
+			if (pWorker)
+			{
+				pWorker->mRunningJobPriority = aJob.GetPriority();
+			}
+
+			const uint32_t priority = static_cast<uint32_t>(aJob.GetPriority());
+			mpProfiler->Record(JobEventType::JOB_BEGIN, priority);
+			aJob.run();
+			//	a job which waited may end on another thread, the profiler records into the ring of the current one
+			mpProfiler->Record(JobEventType::JOB_END, priority);
+
+			pWorker = Worker::GetCurrentWorker();
+			if (pWorker)
+			{
+				pWorker->mRunningJobPriority = waitingPriority;
+			}
+		}
+		else
+		{
+			aJob.run();
+		}
+		PrivFinishJob(aJob);
+	}
+
+	void WorkDispatcher::PrivFinishJob(const Job& aJob)
+	{
+		if (aJob.mpCounter)
+		{
+			PrivDecrementCounter(*aJob.mpCounter);
+		}
+	}
+
+	void WorkDispatcher::PrivDecrementCounter(JobCounter& aCounter)
+	{
+		JobCounter* pCounter = &aCounter;
+
+		//	fast path, this is not the last job of the counter
+		int32_t value = pCounter->mValue.load(std::memory_order_acquire);
+		while (value > 1)
+		{
+			if (pCounter->mValue.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return;
+			}
+		}
+
+		//	the last decrement happens under the lock so DispatchAfter sees a consistent state,
+		//	WaitFor takes the lock once before returning so the counter outlives this block
+		std::vector<Job> continuations;
+		std::vector<void*> waitingFibers;
+		{
+			std::lock_guard<std::mutex> lock(pCounter->mContinuationMutex);
+			if (pCounter->mValue.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				continuations.swap(pCounter->mContinuations);
+				waitingFibers.swap(pCounter->mWaitingFibers);
+			}
+		}
+		for (const auto& continuation : continuations)
+		{
+			PrivSchedule(continuation);
+		}
+		for (auto pFiber : waitingFibers)
+		{
+			PrivResumeFiber(pFiber);
+		}
+	}
+
+	bool WorkDispatcher::PrivFindJob(Worker* apWorker, Job& aOutJob, const bool aCanRunBackground)
+	{
+		//	other threads only help out while they wait, they always take the most urgent job
+		const JobPriority* pLaneOrder = STRICT_LANE_ORDER;
+		if (apWorker)
+		{
+			if (apWorker->mPickCount % BACKGROUND_BOOST_INTERVAL == BACKGROUND_BOOST_INTERVAL - 1)
+			{
+				pLaneOrder = BACKGROUND_BOOST_LANE_ORDER;
+			}
+			else if (apWorker->mPickCount % NORMAL_BOOST_INTERVAL == NORMAL_BOOST_INTERVAL - 1)
+			{
+				pLaneOrder = NORMAL_BOOST_LANE_ORDER;
+			}
+		}
+
+		for (size_t i = 0; i < JOB_PRIORITY_COUNT; i++)
+		{
+			const JobPriority priority = pLaneOrder[i];
+			if (priority == JobPriority::BACKGROUND && !aCanRunBackground)
+			{
+				continue;
+			}
+			if (PrivFindJobInLane(apWorker, priority, aOutJob))
+			{
+				if (apWorker)
+				{
+					apWorker->mPickCount++;
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool WorkDispatcher::PrivFindJobInLane(Worker* apWorker, const JobPriority aPriority, Job& aOutJob)
+	{
+		std::atomic<int32_t>& pendingJobCount = mPendingJobCounts[laneIndex(aPriority)];
+		//	skip the steal attempts on empty lanes
+		if (pendingJobCount.load(std::memory_order_acquire) <= 0)
+		{
+			return false;
+		}
+
+		if ((apWorker && apWorker->PopJob(aPriority, aOutJob)) ||
+			PrivTakeInjectedJob(aPriority, aOutJob) ||
+			PrivStealJob(apWorker, aPriority, aOutJob))
+		{
+			pendingJobCount.fetch_sub(1, std::memory_order_acq_rel);
+			return true;
+		}
+		return false;
+	}
+
+	bool WorkDispatcher::PrivTakeInjectedJob(const JobPriority aPriority, Job& aOutJob)
+	{
+		const size_t lane = laneIndex(aPriority);
+		if (mInjectedJobs[lane].TryPop(aOutJob))
+		{
+			return true;
+		}
+
+		//	only touch the lock when a burst has spilled over
+		if (mOverflowJobCounts[lane].load(std::memory_order_acquire) <= 0)
+		{
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(mOverflowJobMutex);
+		std::deque<Job>& overflowJobs = mOverflowJobs[lane];
+		if (overflowJobs.empty())
+		{
+			return false;
+		}
+		aOutJob = overflowJobs.front();
+		overflowJobs.pop_front();
+		mOverflowJobCounts[lane].fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	bool WorkDispatcher::PrivStealJob(Worker* apThief, const JobPriority aPriority, Job& aOutJob)
+	{
+		const uint32_t workerCount = GetWorkerCount();
+		if (workerCount == 0 || (apThief && workerCount == 1))
+		{
+			return false;
+		}
+
+		//	start from a random victim so thieves don't all hammer the same worker
+		uint32_t victimIndex = apThief ? apThief->NextRandom() % workerCount : 0;
+		for (uint32_t i = 0; i < workerCount; i++, victimIndex = (victimIndex + 1) % workerCount)
+		{
+			if (apThief && victimIndex == apThief->GetIndex())
+			{
+				continue;
+			}
+			if (mWorkers[victimIndex]->StealJob(aPriority, aOutJob))
+			{
+				if (mpProfiler)
+				{
+					mpProfiler->Record(JobEventType::STEAL, victimIndex);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkDispatcher::PrivPark(Worker* apWorker)
+	{
+		if (mpProfiler)
+		{
+			mpProfiler->Record(JobEventType::PARK_BEGIN);
+		}
+
+		std::unique_lock<std::mutex> lock(mParkMutex);
+		mParkedWorkerCount.fetch_add(1, std::memory_order_seq_cst);
+		//	the pending count is checked after announcing the park,
+		//	so either we see the new job here or the dispatcher sees us parked and notifies
+		mParkCondition.wait(lock, [this]() {
+			return !IsRunning() || PrivHasRunnableWork();
+		});
+		mParkedWorkerCount.fetch_sub(1, std::memory_order_seq_cst);
+		lock.unlock();
+
+		if (mpProfiler)
+		{
+			mpProfiler->Record(JobEventType::PARK_END);
+		}
+	}
+
+	bool WorkDispatcher::PrivHasRunnableWork() const
+	{
+		return mReadyFiberCount.load(std::memory_order_seq_cst) > 0 ||
+			mPendingJobCounts[laneIndex(JobPriority::FRAME_CRITICAL)].load(std::memory_order_seq_cst) > 0 ||
+			mPendingJobCounts[laneIndex(JobPriority::NORMAL)].load(std::memory_order_seq_cst) > 0 ||
+			(mPendingJobCounts[laneIndex(JobPriority::BACKGROUND)].load(std::memory_order_seq_cst) > 0 && !IsBackgroundDeferred());
+	}
+
+	void WorkDispatcher::PrivWakeWorker()
+	{
+		if (mParkedWorkerCount.load(std::memory_order_seq_cst) == 0)
+		{
+			return;
+		}
+		{
+			//	take the lock so the notification can't slip in between the predicate check and the wait
+			std::lock_guard<std::mutex> lock(mParkMutex);
+		}
+		mParkCondition.notify_one();
+		if (mpProfiler)
+		{
+			mpProfiler->Record(JobEventType::WAKE);
+		}
+	}
+
+	void WorkDispatcher::PrivWakeAllWorkers()
+	{
+		if (mParkedWorkerCount.load(std::memory_order_seq_cst) == 0)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mParkMutex);
+		}
+		mParkCondition.notify_all();
+		if (mpProfiler)
+		{
+			mpProfiler->Record(JobEventType::WAKE);
+		}
+	}
+
+	LPVOID WorkDispatcher::PrivAcquireFiber()
+	{
+		LPVOID pFiber = nullptr;
+		if (!mFreeFibers.TryPop(pFiber))
+		{
+			return nullptr;
+		}
+		return pFiber;
+	}
+
+	void WorkDispatcher::PrivReleaseFiber(LPVOID apFiber)
+	{
+		mFreeFibers.TryPush(apFiber);
+	}
+
+	void WorkDispatcher::PrivSuspendFiber(LPVOID apFiber, const JobCounter& aCounter)
+	{
+		{
+			std::lock_guard<std::mutex> lock(aCounter.mContinuationMutex);
+			if (!aCounter.IsDone())
+			{
+				aCounter.mWaitingFibers.emplace_back(apFiber);
+				return;
+			}
+		}
+		//	the counter reached zero while we were switching
+		PrivResumeFiber(apFiber);
+	}
+
+	void WorkDispatcher::PrivResumeFiber(LPVOID apFiber)
+	{
+		mReadyFiberCount.fetch_add(1, std::memory_order_seq_cst);
+		mReadyFibers.TryPush(apFiber);
+		PrivWakeWorker();
+	}
+
+	bool WorkDispatcher::PrivTakeReadyFiber(LPVOID& aOutFiber)
+	{
+		if (!mReadyFibers.TryPop(aOutFiber))
+		{
+			return false;
+		}
+		mReadyFiberCount.fetch_sub(1, std::memory_order_acq_rel);
+		return true;
+	}
+
+	void WorkDispatcher::PrivHelpUntilDone(Worker* apWorker, const JobCounter& aCounter)
+	{
+		//	the awaited jobs may be background jobs, so the deferral doesn't apply to a thread that's waiting
+		Job job;
+		while (!aCounter.IsDone())
+		{
+			if (PrivFindJob(apWorker, job, true))
+			{
+				PrivRunJob(job);
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void WorkDispatcher::PrivNameWorkerThread(Worker* apWorker)
+	{
+		std::string threadName = mName + " Worker " + std::to_string(apWorker->GetIndex());
+		std::wstring wideThreadName(threadName.begin(), threadName.end());
+		setCurrentThreadDescription(wideThreadName);
+		if (mpProfiler)
+		{
+			mpProfiler->SetThreadName(threadName);
+		}
+	}
+
+	void setCurrentThreadDescription(const std::wstring& aDescription)
+	{
+		using SetThreadDescriptionFunction = HRESULT(WINAPI*)(HANDLE, PCWSTR);
+		static const SetThreadDescriptionFunction pSetThreadDescription = reinterpret_cast<SetThreadDescriptionFunction>(
+			GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+		if (pSetThreadDescription)
+		{
+			pSetThreadDescription(GetCurrentThread(), aDescription.c_str());
+		}
+	}
+}
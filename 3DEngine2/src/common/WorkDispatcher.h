@@ -1,26 +1,132 @@
 #pragma once
+#include "common/ServiceLocator.h"
+#include "common/Job.h"
+#include "common/JobProfiler.h"
+#include "common/MpmcQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 
 namespace tde
 {
-	class Job;
 	class Worker;
 
+	//	work stealing job scheduler
+	//	every worker owns a lock free deque, jobs dispatched from a worker thread go to its own deque,
+	//	jobs dispatched from other threads go to a shared lock free injection queue,
+	//	idle workers steal from the others and park when there is nothing left to do
+	//	workers run jobs on pooled fibers, a job waiting for a counter suspends its fiber
+	//	and the worker moves on to other jobs, the fiber is resumed by any worker once the counter reaches zero
+	//	so don't hold locks or rely on thread local state across WaitFor in a job
+	//	every priority has its own lanes, frame critical jobs are picked first and background jobs last,
+	//	background jobs are held back while deferred or once the frame deadline has passed
 	class WorkDispatcher
 	{
 	public:
-		WorkDispatcher(const std::string& aName);
+		static constexpr uint32_t FIBER_POOL_SIZE = 128;
+		static constexpr SIZE_T FIBER_STACK_COMMIT_SIZE = 64 * 1024;
+		static constexpr SIZE_T FIBER_STACK_RESERVE_SIZE = 512 * 1024;
+		//	per priority, jobs injected beyond that go to a locked overflow queue
+		static constexpr size_t INJECTED_JOB_QUEUE_CAPACITY = 4096;
+		//	every n-th pick of a worker tries the lower lanes first, so they are not starved by a flood of urgent jobs
+		static constexpr uint32_t NORMAL_BOOST_INTERVAL = 8;
+		static constexpr uint32_t BACKGROUND_BOOST_INTERVAL = 32;
+
+		//	aWorkerCount of 0 means one worker per hardware thread
+		//	with aIsProfiling every job, steal and park is recorded, see GetProfiler
+		WorkDispatcher(const std::string& aName, const uint32_t aWorkerCount = 0, const bool aIsProfiling = false);
+		WorkDispatcher(const WorkDispatcher& aOther) = delete;
+		WorkDispatcher& operator=(const WorkDispatcher& aOther) = delete;
 		~WorkDispatcher();
 
-		void Dispatch(Job aJob);
-		bool HasPendingJobs();
+		//	the counter, if given, is incremented now and decremented once the job has run
+		void Dispatch(const Job& aJob, JobCounter* apCounter = nullptr);
+		void Dispatch(const Job* apJobs, const size_t aJobCount, JobCounter* apCounter = nullptr);
+		//	holds the job back until aDependency reaches zero
+		void DispatchAfter(JobCounter& aDependency, const Job& aJob, JobCounter* apCounter = nullptr);
+		//	on a worker the calling fiber is suspended until the counter reaches zero,
+		//	on other threads, or when the fiber pool runs dry, other jobs are run on the calling thread meanwhile
+		void WaitFor(const JobCounter& aCounter);
+		bool HasPendingJobs() const;
+		//	for work that doesn't finish with a job, e.g. a coroutine which resumes on other jobs,
+		//	Release acts like a finished job, it runs the continuations and wakes the waiters once the counter reaches zero
+		void Retain(JobCounter& aCounter, const int32_t aCount = 1);
+		void Release(JobCounter& aCounter);
+
+		//	holds the job back until the next BeginFrame
+		void DispatchNextFrame(const Job& aJob, JobCounter* apCounter = nullptr);
+		//	called by the game loop at the start of every frame
+		void BeginFrame();
 
-		std::mutex mJobMutex;
+		//	the game defers background jobs while it's rendering, so they don't compete with the render thread
+		void SetBackgroundDeferred(const bool aIsDeferred);
+		//	background jobs are held back once the deadline has passed, until a new deadline is set or it's cleared
+		void SetFrameDeadline(const std::chrono::steady_clock::time_point& aDeadline);
+		void ClearFrameDeadline();
+		bool IsBackgroundDeferred() const;
+
+		inline bool IsRunning() const { return mIsRunning.load(std::memory_order_acquire); }
+		inline uint32_t GetWorkerCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+		//	nullptr unless the dispatcher was created with profiling
+		inline JobProfiler* GetProfiler() const { return mpProfiler.get(); }
 
 	private:
+		void PrivSchedule(const Job& aJob);
+		void PrivRunJob(Job& aJob);
+		void PrivFinishJob(const Job& aJob);
+		void PrivDecrementCounter(JobCounter& aCounter);
+		//	apWorker is nullptr when called from a thread that's not one of our workers
+		bool PrivFindJob(Worker* apWorker, Job& aOutJob, const bool aCanRunBackground);
+		bool PrivFindJobInLane(Worker* apWorker, const JobPriority aPriority, Job& aOutJob);
+		bool PrivTakeInjectedJob(const JobPriority aPriority, Job& aOutJob);
+		bool PrivStealJob(Worker* apThief, const JobPriority aPriority, Job& aOutJob);
+		bool PrivHasRunnableWork() const;
+		void PrivPark(Worker* apWorker);
+		void PrivWakeWorker();
+		void PrivWakeAllWorkers();
+		void PrivNameWorkerThread(Worker* apWorker);
+
+		LPVOID PrivAcquireFiber();
+		void PrivReleaseFiber(LPVOID apFiber);
+		void PrivSuspendFiber(LPVOID apFiber, const JobCounter& aCounter);
+		void PrivResumeFiber(LPVOID apFiber);
+		bool PrivTakeReadyFiber(LPVOID& aOutFiber);
+		void PrivHelpUntilDone(Worker* apWorker, const JobCounter& aCounter);
+
 		std::string mName;
-		std::vector<Job> mPendingJobs;
-		std::vector<Worker> mWorkers;
+		std::unique_ptr<JobProfiler> mpProfiler;
+		std::vector<std::unique_ptr<Worker>> mWorkers;
+
+		MpmcQueue<Job> mInjectedJobs[JOB_PRIORITY_COUNT];
+		std::mutex mOverflowJobMutex;
+		std::deque<Job> mOverflowJobs[JOB_PRIORITY_COUNT];
+		std::atomic<int32_t> mOverflowJobCounts[JOB_PRIORITY_COUNT];
+
+		std::mutex mNextFrameJobMutex;
+		std::vector<Job> mNextFrameJobs;
+
+		std::vector<LPVOID> mFibers;
+		//	sized for the whole pool, a fiber is in at most one of them so they never run full
+		MpmcQueue<LPVOID> mFreeFibers;
+		MpmcQueue<LPVOID> mReadyFibers;
+
+		std::atomic<int32_t> mPendingJobCounts[JOB_PRIORITY_COUNT];
+		std::atomic<int32_t> mReadyFiberCount;
+		std::atomic<bool> mIsBackgroundDeferred;
+		std::atomic<int64_t> mFrameDeadline;	//	steady clock ticks, 0 when there is none
+		std::atomic<uint32_t> mParkedWorkerCount;
+		std::mutex mParkMutex;
+		std::condition_variable mParkCondition;
+		std::atomic<bool> mIsRunning;
 
 		friend Worker;
 	};
+
+	//	names the calling thread for debuggers, SetThreadDescription only exists from windows 10 1607 on
+	//	so it's looked up at runtime and older systems just keep unnamed threads
+	void setCurrentThreadDescription(const std::wstring& aDescription);
+
+	using WorkDispatcherLocator = ServiceLocator<WorkDispatcher>;
+	std::shared_ptr<WorkDispatcher> WorkDispatcherLocator::mpService = nullptr;
 }
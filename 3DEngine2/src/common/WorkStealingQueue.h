@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	//	bounded Chase-Lev work stealing deque
+	//	https://www.di.ens.fr/~zappa/readings/ppopp13.pdf
+	//	only the owner thread may Push() and Pop(), any thread may Steal()
+	//	T is expected to be a pointer type
+	template<typename T, size_t CAPACITY>
+	class WorkStealingQueue
+	{
+	public:
+		static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity of the work stealing queue must be power of 2");
+
+		WorkStealingQueue();
+		WorkStealingQueue(const WorkStealingQueue& aOther) = delete;
+		WorkStealingQueue& operator=(const WorkStealingQueue& aOther) = delete;
+
+		//	returns false if the queue is full
+		bool Push(T aItem);
+		//	returns nullptr if the queue is empty
+		T Pop();
+		//	returns nullptr if the queue is empty or the steal lost the race
+		T Steal();
+
+		size_t GetSize() const;
+
+	private:
+		static constexpr int64_t MASK = static_cast<int64_t>(CAPACITY) - 1;
+
+		alignas(64) std::atomic<int64_t> mTop;
+		alignas(64) std::atomic<int64_t> mBottom;
+		alignas(64) std::atomic<T> mItems[CAPACITY];
+	};
+
+	template<typename T, size_t CAPACITY>
+	inline WorkStealingQueue<T, CAPACITY>::WorkStealingQueue()
+		: mTop(0)
+		, mBottom(0)
+	{
+		for (auto& item : mItems)
+		{
+			item.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline bool WorkStealingQueue<T, CAPACITY>::Push(T aItem)
+	{
+		int64_t bottom = mBottom.load(std::memory_order_relaxed);
+		int64_t top = mTop.load(std::memory_order_acquire);
+		if (bottom - top >= static_cast<int64_t>(CAPACITY))
+		{
+			return false;
+		}
+
+		mItems[bottom & MASK].store(aItem, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline T WorkStealingQueue<T, CAPACITY>::Pop()
+	{
+		int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+		mBottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = mTop.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			//	the queue is empty
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		T item = mItems[bottom & MASK].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			//	last item, race against the thieves
+			if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				item = nullptr;
+			}
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return item;
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline T WorkStealingQueue<T, CAPACITY>::Steal()
+	{
+		int64_t top = mTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = mBottom.load(std::memory_order_acquire);
+
+		if (top >= bottom)
+		{
+			return nullptr;
+		}
+
+		T item = mItems[top & MASK].load(std::memory_order_relaxed);
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		return item;
+	}
+
+	template<typename T, size_t CAPACITY>
+	inline size_t WorkStealingQueue<T, CAPACITY>::GetSize() const
+	{
+		int64_t bottom = mBottom.load(std::memory_order_relaxed);
+		int64_t top = mTop.load(std::memory_order_relaxed);
+		return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+	}
+}
@@ -6,59 +6,185 @@
 
 namespace tde
 {
-	Worker::Worker(WorkDispatcher* apDispatcher)
-		: mpDispatcher(apDispatcher)
+	namespace
 	{
-		mIsWorking = true;
-		mThread = std::thread(std::bind(&Worker::WorkingRoutine, this));
+		thread_local Worker* gpCurrentWorker = nullptr;
 	}
 
-	// note: probably need much more refinement to handle movement when not empty
-	Worker::Worker(Worker&& aOther) noexcept
-		: mThread(std::move(aOther.mThread)), mpDispatcher(aOther.mpDispatcher), 
-		mIsWorking(aOther.mIsWorking), mPendingJobs(std::move(aOther.mPendingJobs))
+	Worker::Worker(WorkDispatcher* apDispatcher, const uint32_t aIndex)
+		: mpJobRing(std::make_unique<Job[]>(JOB_RING_SIZE))
+		, mpJobSlotUsage(std::make_unique<std::atomic<bool>[]>(JOB_RING_SIZE))
+		, mpDispatcher(apDispatcher)
+		, mIndex(aIndex)
+		, mRandomState(0x9E3779B9u * (aIndex + 1))
 	{
+		for (size_t i = 0; i < JOB_RING_SIZE; i++)
+		{
+			mpJobSlotUsage[i].store(false, std::memory_order_relaxed);
+		}
 	}
 
 	Worker::~Worker()
 	{
-		mIsWorking = false;
+		Join();
+	}
+
+	Worker* Worker::GetCurrentWorker()
+	{
+		return gpCurrentWorker;
+	}
+
+	bool Worker::HasPendingJobs() const
+	{
+		for (const auto& queue : mJobQueues)
+		{
+			if (queue.GetSize() > 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool Worker::PushJob(const Job& aJob)
+	{
+		//	the next slot is almost always free, only jobs which have been sitting in a queue for a while are skipped
+		size_t slotIndex = mJobRingIndex & (JOB_RING_SIZE - 1);
+		for (size_t i = 0; i < JOB_RING_SIZE && mpJobSlotUsage[slotIndex].load(std::memory_order_acquire); i++)
+		{
+			slotIndex = ++mJobRingIndex & (JOB_RING_SIZE - 1);
+		}
+		if (mpJobSlotUsage[slotIndex].load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		Job* pSlot = &mpJobRing[slotIndex];
+		*pSlot = aJob;
+		mpJobSlotUsage[slotIndex].store(true, std::memory_order_relaxed);
+		if (!mJobQueues[static_cast<size_t>(aJob.GetPriority())].Push(pSlot))
+		{
+			mpJobSlotUsage[slotIndex].store(false, std::memory_order_relaxed);
+			return false;
+		}
+		mJobRingIndex++;
+		return true;
+	}
+
+	bool Worker::PopJob(const JobPriority aPriority, Job& aOutJob)
+	{
+		return PrivTakeJob(mJobQueues[static_cast<size_t>(aPriority)].Pop(), aOutJob);
+	}
+
+	bool Worker::StealJob(const JobPriority aPriority, Job& aOutJob)
+	{
+		return PrivTakeJob(mJobQueues[static_cast<size_t>(aPriority)].Steal(), aOutJob);
+	}
+
+	bool Worker::PrivTakeJob(Job* apSlot, Job& aOutJob)
+	{
+		if (!apSlot)
+		{
+			return false;
+		}
+		aOutJob = *apSlot;
+		//	the owner may reuse the slot from now on
+		mpJobSlotUsage[apSlot - mpJobRing.get()].store(false, std::memory_order_release);
+		return true;
+	}
+
+	uint32_t Worker::NextRandom()
+	{
+		mRandomState ^= mRandomState << 13;
+		mRandomState ^= mRandomState >> 17;
+		mRandomState ^= mRandomState << 5;
+		return mRandomState;
+	}
+
+	void Worker::Start()
+	{
+		mThread = std::thread(std::bind(&Worker::WorkingRoutine, this));
+	}
+
+	void Worker::Join()
+	{
 		if (mThread.joinable())
 		{
 			mThread.join();
 		}
 	}
 
-	bool Worker::HasPendingJobs()
+	void Worker::CompleteFiberSwitch()
 	{
-		return !mPendingJobs.empty();
+		if (mpFiberToRelease)
+		{
+			mpDispatcher->PrivReleaseFiber(mpFiberToRelease);
+			mpFiberToRelease = nullptr;
+		}
+		if (mpFiberToSuspend)
+		{
+			mpDispatcher->PrivSuspendFiber(mpFiberToSuspend, *mpSuspendCounter);
+			mpFiberToSuspend = nullptr;
+			mpSuspendCounter = nullptr;
+		}
 	}
 
 	void Worker::WorkingRoutine()
 	{
-		while (mIsWorking)
+		gpCurrentWorker = this;
+		mpDispatcher->PrivNameWorkerThread(this);
+
+		//	jobs run on pooled fibers so they can be suspended while they wait,
+		//	the thread's own fiber is only used to start up and to shut down
+		mpThreadFiber = ConvertThreadToFiber(nullptr);
+		SwitchToFiber(mpStartFiber);
+
+		ConvertFiberToThread();
+		mpThreadFiber = nullptr;
+		gpCurrentWorker = nullptr;
+	}
+
+	void WINAPI Worker::FiberRoutine(LPVOID apDispatcher)
+	{
+		WorkDispatcher* pDispatcher = static_cast<WorkDispatcher*>(apDispatcher);
+		GetCurrentWorker()->CompleteFiberSwitch();
+
+		Job job;
+		uint32_t idleRounds = 0;
+		while (pDispatcher->IsRunning())
 		{
-			if (HasPendingJobs())
-			{
-				for (auto& job : mPendingJobs)
-				{
-					job.run();
-				}
+			//	don't cache the worker, a suspended fiber may be resumed on another thread
+			Worker* pWorker = GetCurrentWorker();
 
-				mPendingJobs.clear();
+			//	resumed fibers go first, their jobs are already half done
+			LPVOID pReadyFiber = nullptr;
+			if (pDispatcher->PrivTakeReadyFiber(pReadyFiber))
+			{
+				pWorker->mpFiberToRelease = GetCurrentFiber();
+				SwitchToFiber(pReadyFiber);
+				GetCurrentWorker()->CompleteFiberSwitch();
+				idleRounds = 0;
+				continue;
 			}
 
-			if (!mIsWorking)
+			if (pDispatcher->PrivFindJob(pWorker, job, !pDispatcher->IsBackgroundDeferred()))
 			{
-				break;
+				pDispatcher->PrivRunJob(job);
+				idleRounds = 0;
+				continue;
 			}
 
-			if (mpDispatcher->HasPendingJobs())
+			//	spin a little before parking, jobs usually come in bursts
+			if (++idleRounds < IDLE_SPIN_ROUNDS)
 			{
-				std::lock_guard<std::mutex> lock(mpDispatcher->mJobMutex);
-				mPendingJobs = std::move(mpDispatcher->mPendingJobs);
-				mpDispatcher->mPendingJobs.clear();
+				std::this_thread::yield();
+				continue;
 			}
+
+			idleRounds = 0;
+			pDispatcher->PrivPark(pWorker);
 		}
+
+		SwitchToFiber(GetCurrentWorker()->mpThreadFiber);
 	}
 }
@@ -1,29 +1,80 @@
 #pragma once
+#include "common/Job.h"
+#include "common/WorkStealingQueue.h"
+
+#include <bit>
 
 namespace tde
 {
-	class Job;
 	class WorkDispatcher;
 
 	class Worker
 	{
 	public:
-		Worker(WorkDispatcher* apDispatcher);
-		Worker(Worker&& aOther) noexcept;
+		//	per priority lane
+		static constexpr size_t JOB_QUEUE_CAPACITY = 2048;
+
+		Worker(WorkDispatcher* apDispatcher, const uint32_t aIndex);
+		Worker(const Worker& aOther) = delete;
+		Worker& operator=(const Worker& aOther) = delete;
 		~Worker();
 
-		bool HasPendingJobs();
+		//	the worker running on the calling thread, nullptr if it's not a worker thread
+		static Worker* GetCurrentWorker();
+
+		bool HasPendingJobs() const;
+		inline uint32_t GetIndex() const { return mIndex; }
+		inline WorkDispatcher* GetDispatcher() const { return mpDispatcher; }
+
+		//	can only be called from the worker's own thread
+		bool PushJob(const Job& aJob);
+		bool PopJob(const JobPriority aPriority, Job& aOutJob);
+		//	can be called from any thread
+		bool StealJob(const JobPriority aPriority, Job& aOutJob);
+
+		//	xorshift, used to pick the victim to steal from
+		uint32_t NextRandom();
+
+		//	must be called by a fiber right after it has been switched to,
+		//	finishes what the fiber which switched away asked for
+		void CompleteFiberSwitch();
+
+		void Start();
+		void Join();
 
 	private:
+		//	jobs are copied into the ring and the queues only carry pointers to them,
+		//	a slot stays taken until the job has been copied out again, the ring is twice as large as all queues together
+		//	so a free slot is always close by even though old jobs can sit in a queue for a long time,
+		//	rounded up to a power of two so every slot can be reached by masking the ring index
+		static constexpr size_t JOB_RING_SIZE = std::bit_ceil(JOB_QUEUE_CAPACITY * JOB_PRIORITY_COUNT * 2);
+		static_assert(std::has_single_bit(JOB_RING_SIZE), "the ring index is masked with JOB_RING_SIZE - 1");
+		static constexpr uint32_t IDLE_SPIN_ROUNDS = 64;
+
 		void WorkingRoutine();
-		
-		std::thread mThread;
-		std::vector<Job> mPendingJobs;
-		WorkDispatcher* mpDispatcher;
-		bool mIsWorking = false;
-	};
+		static void WINAPI FiberRoutine(LPVOID apDispatcher);
+		bool PrivTakeJob(Job* apSlot, Job& aOutJob);
 
+		WorkStealingQueue<Job*, JOB_QUEUE_CAPACITY> mJobQueues[JOB_PRIORITY_COUNT];
+		std::unique_ptr<Job[]> mpJobRing;
+		std::unique_ptr<std::atomic<bool>[]> mpJobSlotUsage;
+		size_t mJobRingIndex = 0;
 
-}
+		std::thread mThread;
+		LPVOID mpThreadFiber = nullptr;
+		LPVOID mpStartFiber = nullptr;
+		//	set by a fiber right before it switches away, handled by the fiber it switched to
+		LPVOID mpFiberToRelease = nullptr;
+		LPVOID mpFiberToSuspend = nullptr;
+		const JobCounter* mpSuspendCounter = nullptr;
+		//	of the job running on the worker, only tracked while profiling, so the slices of a suspended job keep their lane
+		JobPriority mRunningJobPriority = JobPriority::NORMAL;
 
+		WorkDispatcher* mpDispatcher;
+		uint32_t mIndex;
+		uint32_t mRandomState;
+		uint32_t mPickCount = 0;	//	jobs taken so far, drives the starvation protection
 
+		friend WorkDispatcher;
+	};
+}
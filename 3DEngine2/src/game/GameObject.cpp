@@ -15,7 +15,18 @@ namespace tde
 		std::shared_ptr<PixelShader> apPixelShader, 
 		ID3D11Buffer** appLightBuffer)
 	{
-		mpModel = Model::CreateModelFromFile(aModelFilename);
+		Init(Model::CreateModelFromFile(aModelFilename), apDevice, apCamera, apVertexShader, apPixelShader, appLightBuffer);
+	}
+
+	void SimpleModelGameObject::Init(
+		std::shared_ptr<Model> apModel,
+		ID3D11Device1* apDevice,
+		std::shared_ptr<ICamera> apCamera,
+		std::shared_ptr<VertexShader> apVertexShader,
+		std::shared_ptr<PixelShader> apPixelShader,
+		ID3D11Buffer** appLightBuffer)
+	{
+		mpModel = apModel;
 		mpModel->CreateBuffers(apDevice);
 		mWorldMatrix = XMMatrixScaling(0.01f, 0.01f, 0.01f) * XMMatrixRotationAxis({ 0, 1.0f, 0, 0 }, XMConvertToRadians(-90.0f)) * XMMatrixTranslation(-5.0f, 0.0f, 0.0f);
 		mpCamera = apCamera;
@@ -20,6 +20,9 @@ namespace tde
 	public:
 		void Init(const char* aModelFilename, ID3D11Device1* apDevice, std::shared_ptr<ICamera> apCamera,
 			std::shared_ptr<VertexShader> apVertexShader, std::shared_ptr<PixelShader> apPixelShader, ID3D11Buffer** appLightBuffer);
+		//	for a model which has already been loaded, e.g. on a background job
+		void Init(std::shared_ptr<Model> apModel, ID3D11Device1* apDevice, std::shared_ptr<ICamera> apCamera,
+			std::shared_ptr<VertexShader> apVertexShader, std::shared_ptr<PixelShader> apPixelShader, ID3D11Buffer** appLightBuffer);
 		virtual void Update(const float aDeltaTime) override;
 		virtual void Render(ID3D11DeviceContext1* apContext, const float aDeltaTime) override;
 		virtual void Destroy() override;
@@ -5,65 +5,136 @@
 #include "rendering/Camera.h"
 #include "common/ServiceLocator.h"
 #include "common/BaseCache.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+#include "common/Task.h"
+#include "common/AsyncFile.h"
 #include "rendering/VertexShader.h"
 #include "rendering/PixelShader.h"
+#include "rendering/Model.h"
 #include "rendering/RenderingStateCache.h"
 #include "rendering/SkyRenderer.h"
 #include "rendering/CubeWorldRenderer.h"
+#include "voxel/CubeWorldFile.h"
+#include "voxel/CubeWorldStreamer.h"
+#include "voxel/CubeWorldGenerator.h"
+#include "voxel/CubeWorldOctree.h"
+#include "voxel/CubeWorldLighting.h"
+#include "voxel/CubeRaycaster.h"
+#include "common/Configuration.h"
 
 namespace tde
 {
 	using namespace DirectX;
 
-	void Scene::Init(ID3D11Device1* apDevice, HWND aWindowHandle)
+	namespace
 	{
-		//	load shaders
-		const D3D11_INPUT_ELEMENT_DESC meshVertexLayout[] =
+		const D3D11_INPUT_ELEMENT_DESC MESH_VERTEX_LAYOUT[] =
 		{
 			{ "POSITION",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 			{ "NORMAL",			0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 			{ "TEXCOORD",		0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
 		};
-		UINT numElements = sizeof(meshVertexLayout) / sizeof(meshVertexLayout[0]);
-		std::shared_ptr<VertexShader> pBasicVS = std::make_shared<VertexShader>(L"shaders/BasicVS.cso", &meshVertexLayout[0], numElements, apDevice);
-		if (pBasicVS)
-		{
-			VertexShaderCacheLocator::Get()->InsertIfNotExists("BasicVS", pBasicVS);
-		}
-		const D3D11_INPUT_ELEMENT_DESC skyVertexLayout[] =
+		const D3D11_INPUT_ELEMENT_DESC SKY_VERTEX_LAYOUT[] =
 		{
 			{"POSITION",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
 			{"TEXCOORD",		0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
 		};
-		numElements = sizeof(skyVertexLayout) / sizeof(skyVertexLayout[0]);
-		std::shared_ptr<VertexShader> pSkyVS = std::make_shared<VertexShader>(L"shaders/SkyVS.cso", &skyVertexLayout[0], numElements, apDevice);
+		const D3D11_INPUT_ELEMENT_DESC BOX_VERTEX_LAYOUT[] =
+		{
+			{"POSITION",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TEXCOORD",		0, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TEXCOORD",		1, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+		const D3D11_INPUT_ELEMENT_DESC BOX_COMPACT_VERTEX_LAYOUT[] =
+		{
+			{"TEXCOORD",		0, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TEXCOORD",		1, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+
+		std::shared_ptr<VertexShader> createVertexShader(const std::vector<char>& aByteCode,
+			const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice)
+		{
+			if (aByteCode.empty())
+			{
+				return nullptr;
+			}
+			return std::make_shared<VertexShader>(aByteCode.data(), aByteCode.size(), apLayout, aLayoutElementCount, apDevice);
+		}
+
+		std::shared_ptr<PixelShader> createPixelShader(const std::vector<char>& aByteCode, ID3D11Device* apDevice)
+		{
+			if (aByteCode.empty())
+			{
+				return nullptr;
+			}
+			return std::make_shared<PixelShader>(aByteCode.data(), aByteCode.size(), apDevice);
+		}
+
+		Task<std::shared_ptr<Model>> loadModelAsync(WorkDispatcher* apDispatcher, std::string aPath)
+		{
+			co_await schedule(apDispatcher, JobPriority::BACKGROUND);
+			co_return Model::CreateModelFromFile(aPath.c_str());
+		}
+	}
+
+	void Scene::Init(ID3D11Device1* apDevice, HWND aWindowHandle)
+	{
+		WorkDispatcher* pDispatcher = WorkDispatcherLocator::Get().get();
+
+		//	read shaders, the model and the cube world at the same time on the workers, this thread helps out until everything is ready,
+		//	the rest of the setup stays on this thread, the camera hooks into the input of the window
+		auto [basicVSData, skyVSData, boxVSData, boxCompactVSData, boxFacesVSData, phongPSData, skyPSData, boxPSData, pModel, cubeWorldData] =
+			syncWait(pDispatcher, whenAll(pDispatcher,
+				readFileAsync(pDispatcher, L"shaders/BasicVS.cso"),
+				readFileAsync(pDispatcher, L"shaders/SkyVS.cso"),
+				readFileAsync(pDispatcher, L"shaders/BoxVS.cso"),
+				readFileAsync(pDispatcher, L"shaders/BoxCompactVS.cso"),
+				readFileAsync(pDispatcher, L"shaders/BoxFacesVS.cso"),
+				readFileAsync(pDispatcher, L"shaders/PhongPS.cso"),
+				readFileAsync(pDispatcher, L"shaders/SkyPS.cso"),
+				readFileAsync(pDispatcher, L"shaders/BoxPS.cso"),
+				loadModelAsync(pDispatcher, "Fortnite-Plane.fbx"),
+				readFileAsync(pDispatcher, L"test_cube_world")));
+
+		//	create shaders
+		std::shared_ptr<VertexShader> pBasicVS = createVertexShader(basicVSData, MESH_VERTEX_LAYOUT, ARRAYSIZE(MESH_VERTEX_LAYOUT), apDevice);
+		if (pBasicVS)
+		{
+			VertexShaderCacheLocator::Get()->InsertIfNotExists("BasicVS", pBasicVS);
+		}
+		std::shared_ptr<VertexShader> pSkyVS = createVertexShader(skyVSData, SKY_VERTEX_LAYOUT, ARRAYSIZE(SKY_VERTEX_LAYOUT), apDevice);
 		if (pSkyVS)
 		{
 			VertexShaderCacheLocator::Get()->InsertIfNotExists("SkyVS", pSkyVS);
 		}
-		const D3D11_INPUT_ELEMENT_DESC boxVertexLayout[] =
-		{
-			{"POSITION",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TEXCOORD",		0, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0}
-		};
-		numElements = sizeof(boxVertexLayout) / sizeof(boxVertexLayout[0]);
-		std::shared_ptr<VertexShader> pBoxVS = std::make_shared<VertexShader>(L"shaders/BoxVS.cso", &boxVertexLayout[0], numElements, apDevice);
+		std::shared_ptr<VertexShader> pBoxVS = createVertexShader(boxVSData, BOX_VERTEX_LAYOUT, ARRAYSIZE(BOX_VERTEX_LAYOUT), apDevice);
 		if (pBoxVS)
 		{
 			VertexShaderCacheLocator::Get()->InsertIfNotExists("BoxVS", pBoxVS);
 		}
+		std::shared_ptr<VertexShader> pBoxCompactVS = createVertexShader(boxCompactVSData, BOX_COMPACT_VERTEX_LAYOUT, ARRAYSIZE(BOX_COMPACT_VERTEX_LAYOUT), apDevice);
+		if (pBoxCompactVS)
+		{
+			VertexShaderCacheLocator::Get()->InsertIfNotExists("BoxCompactVS", pBoxCompactVS);
+		}
+		std::shared_ptr<VertexShader> pBoxFacesVS = createVertexShader(boxFacesVSData, nullptr, 0, apDevice);
+		if (pBoxFacesVS)
+		{
+			VertexShaderCacheLocator::Get()->InsertIfNotExists("BoxFacesVS", pBoxFacesVS);
+		}
 
-		std::shared_ptr<PixelShader> pPhongPS = std::make_shared<PixelShader>(L"shaders/PhongPS.cso", apDevice);
+		std::shared_ptr<PixelShader> pPhongPS = createPixelShader(phongPSData, apDevice);
 		if (pPhongPS)
 		{
 			PixelShaderCacheLocator::Get()->InsertIfNotExists("PhongPS", pPhongPS);
 		}
-		std::shared_ptr<PixelShader> pSkyPS = std::make_shared<PixelShader>(L"shaders/SkyPS.cso", apDevice);
+		std::shared_ptr<PixelShader> pSkyPS = createPixelShader(skyPSData, apDevice);
 		if (pSkyPS)
 		{
 			PixelShaderCacheLocator::Get()->InsertIfNotExists("SkyPS", pSkyPS);
 		}
-		std::shared_ptr<PixelShader> pBoxPS = std::make_shared<PixelShader>(L"shaders/BoxPS.cso", apDevice);
+		std::shared_ptr<PixelShader> pBoxPS = createPixelShader(boxPSData, apDevice);
 		if (pBoxPS)
 		{
 			PixelShaderCacheLocator::Get()->InsertIfNotExists("BoxPS", pBoxPS);
@@ -189,7 +260,7 @@ namespace tde
 
 		//	spawn game objects
 		std::shared_ptr<SimpleModelGameObject> go = std::make_shared<SimpleModelGameObject>();
-		go->Init("Fortnite-Plane.fbx", 
+		go->Init(pModel, 
 			apDevice, 
 			mpCamera, 
 			VertexShaderCacheLocator::Get()->Get("BasicVS"), 
@@ -202,22 +273,100 @@ namespace tde
 		DirectX::XMVECTOR hellColor = XMVectorSet(0.7980f, 0.7980f, 0.7980f, 1.0f);
 		mpSkyRenderer = std::make_shared<SkyRenderer>(apDevice, mpCamera, mpLightBuffer.GetAddressOf(), heavenColor, hellColor);
 
-		//	create cube world renderer
-		std::shared_ptr<CubeWorld> cubeWorld = createCubeWorldFromBinaryFile("test_cube_world", 8, 8, 8);
+		//	create cube world renderer, the world is streamed around the camera if a cube world file is configured,
+		//	otherwise it's generated if a generator radius is configured
+		std::shared_ptr<CubeWorld> cubeWorld;
+		const std::string streamingFile = Configuration::GetInstance()->GetStringOrDefault("CubeWorld.StreamingFile");
+		if (!streamingFile.empty())
+		{
+			std::shared_ptr<CubeWorldFileReader> pReader = std::make_shared<CubeWorldFileReader>(std::wstring(streamingFile.begin(), streamingFile.end()));
+			if (pReader->IsOpen())
+			{
+				const float loadRadius = Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.LoadRadius", 6.0f);
+				const float unloadRadius = Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.UnloadRadius", 8.0f);
+				const int32_t memoryBudgetMB = Configuration::GetInstance()->GetIntOrDefault("CubeWorld.MemoryBudgetMB", 256);
+				mpCubeWorldStreamer = std::make_shared<CubeWorldStreamer>(pReader, loadRadius, unloadRadius, static_cast<size_t>(std::max(memoryBudgetMB, 0)) * 1024 * 1024);
+				cubeWorld = mpCubeWorldStreamer->GetCubeWorld();
+			}
+		}
+		const int32_t generatorRadius = Configuration::GetInstance()->GetIntOrDefault("CubeWorld.GeneratorRadius", 0);
+		if (!cubeWorld && generatorRadius > 0)
+		{
+			CubeWorldGeneratorSettings generatorSettings;
+			generatorSettings.mSeed = static_cast<uint32_t>(Configuration::GetInstance()->GetIntOrDefault("CubeWorld.GeneratorSeed", 1));
+			const int32_t generatorHeight = Configuration::GetInstance()->GetIntOrDefault("CubeWorld.GeneratorHeight", 3);
+			cubeWorld = generateCubeWorld(generatorSettings, { -generatorRadius, 0, -generatorRadius }, { generatorRadius, std::max(generatorHeight, 1) - 1, generatorRadius });
+		}
+		if (!cubeWorld)
+		{
+			cubeWorld = createCubeWorldFromMemory(cubeWorldData.data(), cubeWorldData.size(), 8, 8, 8);
+		}
 		mpCubeWorldRenderer = std::make_shared<CubeWorldRenderer>(apDevice, cubeWorld, mpCamera, mpLightBuffer.GetAddressOf());
 		mpCubeWorldRenderer->SetPosition({ 0.0f, 0.0, 10.0f, 1.0f });
 		mpCubeWorldRenderer->SetScale(1.0f);
+		mpCubeWorldRenderer->SetLodDistances(
+			Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.Lod1Distance", 4.0f),
+			Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.Lod2Distance", 8.0f),
+			Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.Lod3Distance", 16.0f));
+		//	0 full vertices, 1 compact vertices, 2 faces pulled by the vertex shader
+		const int32_t vertexFormat = Configuration::GetInstance()->GetIntOrDefault("CubeWorld.VertexFormat", 0);
+		if (vertexFormat >= 0 && vertexFormat <= static_cast<int32_t>(CubeVertexFormat::FACES))
+		{
+			mpCubeWorldRenderer->SetVertexFormat(static_cast<CubeVertexFormat>(vertexFormat));
+		}
+		mpCubeWorldLighting = std::make_shared<CubeWorldLighting>(*cubeWorld);
+		mpCubeWorldRenderer->SetLighting(mpCubeWorldLighting);
 		mpCubeWorldRenderer->UpdateBuffer(apDevice);
+		mpCubeWorld = cubeWorld;
+		mpCubeWorldOctree = std::make_shared<CubeWorldOctree>(*mpCubeWorld);
+		mCameraCollisionRadius = Configuration::GetInstance()->GetFloatOrDefault("CubeWorld.CameraCollisionRadius", 0.4f);
+		XMStoreFloat3(&mCameraCollisionPosition, mpCamera->GetPosition());
+	}
+
+	void Scene::FixedUpdate(const float aDeltaTime)
+	{
+		//	the camera goes last, so the indices AddCubeMover handed out stay valid
+		const size_t moverCount = mCubeMovers.size();
+		if (mCameraCollisionRadius > 0.0f)
+		{
+			mCubeMovers.push_back(PrivGetCameraMover());
+		}
+		mCubeStepResults.resize(mCubeMovers.size());
+		moveCubeBoxesParallel(*mpCubeWorldOctree, mCubeMovers.data(), mCubeMovers.size(), mCubeStepResults.data());
+		if (mCubeMovers.size() > moverCount)
+		{
+			PrivMoveCamera(mCubeMovers.back(), mCubeStepResults.back());
+		}
+		//	a frame can run several fixed steps and the movers added in it are all moved by the first,
+		//	so a step without movers keeps the results of the last one which had some
+		if (moverCount > 0)
+		{
+			mCubeStepResults.resize(moverCount);
+			mCubeMoveResults.swap(mCubeStepResults);
+		}
+		mCubeMovers.clear();
 	}
 
 	void Scene::Update(ID3D11Device* apDevice, const float aDeltaTime)
 	{
 		mpCamera->Update(aDeltaTime);
-		for (auto pGameObjects : mGameObjects)
+		//	game objects only touch their own state during update
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, mGameObjects.size(), [&](const size_t aIndex)
 		{
-			pGameObjects->Update(aDeltaTime);
-		}
+			mGameObjects[aIndex]->Update(aDeltaTime);
+		}, 1, JobPriority::FRAME_CRITICAL);
 		mpSkyRenderer->Update(aDeltaTime);
+		const XMFLOAT3 cameraCell = mpCubeWorldRenderer->GetCellPosition(mpCamera->GetPosition());
+		if (mpCubeWorldStreamer)
+		{
+			mpCubeWorldStreamer->Update(cameraCell);
+		}
+		//	the octree and the lighting follow the same edits, the lighting marks the chunks to remesh
+		const std::vector<CubeCoord> editedChunks = mpCubeWorld->TakeEditedChunks();
+		mpCubeWorldOctree->Update(*mpCubeWorld, editedChunks);
+		mpCubeWorldLighting->Update(*mpCubeWorld, editedChunks);
+		mpCubeWorldRenderer->UpdateLods(cameraCell);
+		mpCubeWorldRenderer->UpdateDirtyChunks(apDevice);
 	}
 
 	void Scene::Render(ID3D11Device* apDevice, ID3D11DeviceContext1* apContext, const float aDeltaTime)
@@ -249,6 +398,11 @@ namespace tde
 		}
 		mGameObjects.clear();
 		mpSkyRenderer.reset();
+		//	before the work dispatcher goes away, it waits for the chunks being loaded
+		mpCubeWorldStreamer.reset();
+		mpCubeWorldOctree.reset();
+		mpCubeWorldLighting.reset();
+		mpCubeWorld.reset();
 		mpCamera.reset();
 		SAFE_RELEASE(mpLightBuffer);
 	}
@@ -258,6 +412,53 @@ namespace tde
 		mpCamera->SetAspectRatio(static_cast<float>(aWidth) / static_cast<float>(aHeight));
 	}
 
+	bool Scene::PickCubeCell(const float aMaxDistance, CubeRayHit& aOutHit)
+	{
+		const XMVECTOR position = mpCamera->GetPosition();
+		const XMFLOAT3 startCell = mpCubeWorldRenderer->GetCellPosition(position);
+		const XMFLOAT3 endCell = mpCubeWorldRenderer->GetCellPosition(XMVectorAdd(position, XMVectorScale(mpCamera->GetForwardVector(), aMaxDistance)));
+		const XMVECTOR delta = XMVectorSubtract(XMLoadFloat3(&endCell), XMLoadFloat3(&startCell));
+		//	the ray is traced in cells, the world may be scaled
+		CubeRay ray;
+		ray.mOrigin = startCell;
+		XMStoreFloat3(&ray.mDirection, XMVector3Normalize(delta));
+		ray.mMaxDistance = XMVectorGetX(XMVector3Length(delta));
+		bool isHit = false;
+		raycastCubes(*mpCubeWorldOctree, &ray, 1, &aOutHit, &isHit);
+		return isHit;
+	}
+
+	size_t Scene::AddCubeMover(const CubeMover& aMover)
+	{
+		mCubeMovers.push_back(aMover);
+		return mCubeMovers.size() - 1;
+	}
+
+	CubeMover Scene::PrivGetCameraMover() const
+	{
+		//	the collision happens in cells, the world may be scaled
+		const XMFLOAT3 previousCell = mpCubeWorldRenderer->GetCellPosition(XMVectorSetW(XMLoadFloat3(&mCameraCollisionPosition), 1.0f));
+		const XMFLOAT3 targetCell = mpCubeWorldRenderer->GetCellPosition(mpCamera->GetPosition());
+		CubeMover mover;
+		mover.mBox.mMin = { previousCell.x - mCameraCollisionRadius, previousCell.y - mCameraCollisionRadius, previousCell.z - mCameraCollisionRadius };
+		mover.mBox.mMax = { previousCell.x + mCameraCollisionRadius, previousCell.y + mCameraCollisionRadius, previousCell.z + mCameraCollisionRadius };
+		mover.mDisplacement = { targetCell.x - previousCell.x, targetCell.y - previousCell.y, targetCell.z - previousCell.z };
+		return mover;
+	}
+
+	void Scene::PrivMoveCamera(const CubeMover& aMover, const CubeMoveResult& aResult)
+	{
+		if (aResult.mContactFaces != 0)
+		{
+			const XMFLOAT3 movedCell{
+				(aMover.mBox.mMin.x + aMover.mBox.mMax.x) * 0.5f + aResult.mDisplacement.x,
+				(aMover.mBox.mMin.y + aMover.mBox.mMax.y) * 0.5f + aResult.mDisplacement.y,
+				(aMover.mBox.mMin.z + aMover.mBox.mMax.z) * 0.5f + aResult.mDisplacement.z };
+			mpCamera->SetPosition(mpCubeWorldRenderer->GetWorldPosition(movedCell));
+		}
+		XMStoreFloat3(&mCameraCollisionPosition, mpCamera->GetPosition());
+	}
+
 	HRESULT Scene::PrivCreateLightBuffer(ID3D11Device* apDevice)
 	{
 		D3D11_BUFFER_DESC bufDesc;
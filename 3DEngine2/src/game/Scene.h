@@ -1,5 +1,6 @@
 #pragma once
 #include "rendering/Light.h"
+#include "voxel/CubeCollision.h"
 
 namespace tde
 {
@@ -10,12 +11,18 @@ namespace tde
 	class PixelShader;
 	class SkyRenderer;
 	class CubeWorldRenderer;
+	class CubeWorldStreamer;
+	class CubeWorld;
+	class CubeWorldOctree;
+	class CubeWorldLighting;
 
 	class Scene
 	{
 	public:
 
 		void Init(ID3D11Device1* apDevice, HWND aWindowHandle);
+		//	runs at the fix update frequency of the game, before Update
+		void FixedUpdate(const float aDeltaTime);
 		void Update(ID3D11Device* apDevice, const float aDeltaTime);
 		void Render(ID3D11Device* apDevice, ID3D11DeviceContext1* apContext, const float aDeltaTime);
 		void PostProcess(ID3D11DeviceContext1* apContext, 
@@ -27,6 +34,14 @@ namespace tde
 
 		void OnScreenSizeChange(int aWidth, int aHeight);
 
+		//	the cube the camera looks at, aMaxDistance is in world units
+		bool PickCubeCell(const float aMaxDistance, CubeRayHit& aOutHit);
+		//	a box in cells to move through the cubes in the next FixedUpdate, all movers of it are moved at once spread over the workers,
+		//	returns the index of its result in GetCubeMoveResults after that FixedUpdate
+		size_t AddCubeMover(const CubeMover& aMover);
+		//	the results of the movers of the last FixedUpdate which had any, in the order they were added
+		inline const std::vector<CubeMoveResult>& GetCubeMoveResults() const { return mCubeMoveResults; }
+
 	private:
 
 		Lights mLights;
@@ -34,10 +49,28 @@ namespace tde
 		std::vector<std::shared_ptr<IGameObject>> mGameObjects;
 		std::shared_ptr<SkyRenderer> mpSkyRenderer;
 		std::shared_ptr<CubeWorldRenderer> mpCubeWorldRenderer;
+		//	nullptr unless the cube world is streamed from a file
+		std::shared_ptr<CubeWorldStreamer> mpCubeWorldStreamer;
+		std::shared_ptr<CubeWorld> mpCubeWorld;
+		//	for picking, line of sight and collision, kept in sync with the edits of the cube world in Update
+		std::shared_ptr<CubeWorldOctree> mpCubeWorldOctree;
+		//	baked into the cube vertices, relit for the edits of the cube world in Update
+		std::shared_ptr<CubeWorldLighting> mpCubeWorldLighting;
 		std::shared_ptr<BaseCamera> mpCamera;
+		//	half the size of the box in cells the camera is moved through the cubes with, 0 lets it fly through them
+		float mCameraCollisionRadius = 0.0f;
+		//	where the last FixedUpdate left the camera, it's moved from there to where it flew since
+		DirectX::XMFLOAT3 mCameraCollisionPosition;
+		std::vector<CubeMover> mCubeMovers;
+		std::vector<CubeMoveResult> mCubeMoveResults;
+		std::vector<CubeMoveResult> mCubeStepResults;	//	the results of the running fixed step, the camera one is the last
 		Microsoft::WRL::ComPtr<ID3D11Buffer> mpLightBuffer;
 
 		HRESULT PrivCreateLightBuffer(ID3D11Device* apDevice);
 		void PrivUpdateLights(ID3D11DeviceContext1* apContext, const float aDeltaTime);
+		//	the box around the camera from where the last FixedUpdate left it to where it flew since
+		CubeMover PrivGetCameraMover() const;
+		//	moves the camera as far as the cubes let it, sliding along them
+		void PrivMoveCamera(const CubeMover& aMover, const CubeMoveResult& aResult);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <map>
+
+namespace tde
+{
+	//	first fit allocator for ranges of elements in a gpu buffer, it only does the bookkeeping,
+	//	freed ranges are merged with their free neighbours
+	//	NOT thread safe
+	class BufferRangeAllocator
+	{
+	public:
+		explicit BufferRangeAllocator(const size_t aCapacity = 0);
+
+		//	returns false if there is no free range which is large enough, Grow and try again
+		bool Allocate(const size_t aSize, size_t& aOutOffset);
+		void Free(const size_t aOffset, const size_t aSize);
+		//	the new elements are appended as a free range
+		void Grow(const size_t aNewCapacity);
+		void Reset(const size_t aCapacity);
+
+		inline size_t GetCapacity() const { return mCapacity; }
+
+	private:
+		//	offset to size
+		std::map<size_t, size_t> mFreeRanges;
+		size_t mCapacity;
+	};
+
+	inline BufferRangeAllocator::BufferRangeAllocator(const size_t aCapacity)
+		: mCapacity(0)
+	{
+		Reset(aCapacity);
+	}
+
+	inline bool BufferRangeAllocator::Allocate(const size_t aSize, size_t& aOutOffset)
+	{
+		for (auto rangeIt = mFreeRanges.begin(); rangeIt != mFreeRanges.end(); ++rangeIt)
+		{
+			if (rangeIt->second < aSize)
+			{
+				continue;
+			}
+
+			aOutOffset = rangeIt->first;
+			const size_t remainingSize = rangeIt->second - aSize;
+			mFreeRanges.erase(rangeIt);
+			if (remainingSize > 0)
+			{
+				mFreeRanges.emplace(aOutOffset + aSize, remainingSize);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	inline void BufferRangeAllocator::Free(const size_t aOffset, const size_t aSize)
+	{
+		if (aSize == 0)
+		{
+			return;
+		}
+
+		size_t offset = aOffset;
+		size_t size = aSize;
+
+		auto nextIt = mFreeRanges.lower_bound(offset);
+		if (nextIt != mFreeRanges.end() && offset + size == nextIt->first)
+		{
+			size += nextIt->second;
+			nextIt = mFreeRanges.erase(nextIt);
+		}
+		if (nextIt != mFreeRanges.begin())
+		{
+			auto previousIt = std::prev(nextIt);
+			if (previousIt->first + previousIt->second == offset)
+			{
+				offset = previousIt->first;
+				size += previousIt->second;
+				mFreeRanges.erase(previousIt);
+			}
+		}
+		mFreeRanges.emplace(offset, size);
+	}
+
+	inline void BufferRangeAllocator::Grow(const size_t aNewCapacity)
+	{
+		if (aNewCapacity <= mCapacity)
+		{
+			return;
+		}
+		const size_t oldCapacity = mCapacity;
+		mCapacity = aNewCapacity;
+		Free(oldCapacity, aNewCapacity - oldCapacity);
+	}
+
+	inline void BufferRangeAllocator::Reset(const size_t aCapacity)
+	{
+		mFreeRanges.clear();
+		mCapacity = aCapacity;
+		if (aCapacity > 0)
+		{
+			mFreeRanges.emplace(0, aCapacity);
+		}
+	}
+}
@@ -5,51 +5,148 @@
 #include "rendering/VertexShader.h"
 #include "rendering/PixelShader.h"
 #include "rendering/RenderingStateCache.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+#include "voxel/CubeFaceCulling.h"
+#include "voxel/CubeWorldLighting.h"
 
+#include <bit>
+#include <span>
 #include <iostream>
-#include <fstream>
 #include <sstream>
 
 namespace tde
 {
 	using namespace DirectX;
 
-	std::shared_ptr<CubeWorld> createCubeWorldFromBinaryFile(LPCSTR aFilename, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ)
+	namespace
 	{
-		if (aSizeX > MAX_CUBE_WORLD_SIZE ||
-			aSizeY > MAX_CUBE_WORLD_SIZE ||
-			aSizeZ > MAX_CUBE_WORLD_SIZE)
+		//	the cells of a chunk with a shell of one cell from its neighbours, for the occlusion and the light around the faces
+		struct ChunkShading
 		{
-			return nullptr;
-		}
+			constexpr static int32_t SIZE = CUBE_CHUNK_SIZE + 2;
 
-		std::ifstream cubeFile(aFilename);
-		if (!cubeFile.is_open())
-		{
-			return nullptr;
-		}
+			//	the coordinates are local to the chunk, from -1 to CUBE_CHUNK_SIZE
+			static inline size_t Index(const int32_t aX, const int32_t aY, const int32_t aZ)
+			{
+				return (static_cast<size_t>(aY + 1) * SIZE + static_cast<size_t>(aZ + 1)) * SIZE + static_cast<size_t>(aX + 1);
+			}
 
-		std::shared_ptr<CubeWorld> pCubeWorld = std::make_shared<CubeWorld>();
-		pCubeWorld->mSizeX = aSizeX;
-		pCubeWorld->mSizeY = aSizeY;
-		pCubeWorld->mSizeZ = aSizeZ;
-		pCubeWorld->mWorld.resize(aSizeX * aSizeY * aSizeZ);
+			bool mIsSolid[SIZE * SIZE * SIZE];
+			uint8_t mLight[SIZE * SIZE * SIZE];
+		};
 
-		//	the cube world is stored left to right (x++), back to front (z++), bottom to top (y++)
-		cubeFile.read(&(pCubeWorld->mWorld[0]), aSizeX * aSizeY * aSizeZ);
+		void buildChunkShading(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk,
+			ChunkShading& aOutShading)
+		{
+			//	the chunk itself and the 26 chunks around it, each of them is looked up once
+			for (int32_t offsetY = -1; offsetY <= 1; offsetY++)
+			{
+				for (int32_t offsetZ = -1; offsetZ <= 1; offsetZ++)
+				{
+					for (int32_t offsetX = -1; offsetX <= 1; offsetX++)
+					{
+						const CubeCoord chunkCoord{ aChunkCoord.mX + offsetX, aChunkCoord.mY + offsetY, aChunkCoord.mZ + offsetZ };
+						const bool isCenter = offsetX == 0 && offsetY == 0 && offsetZ == 0;
+						const CubeChunk* pChunk = isCenter ? &aChunk : aCubeWorld.FindChunk(chunkCoord);
+						const CubeWorldLighting::ChunkLight* pLight = apLighting ? apLighting->FindChunkLight(chunkCoord) : nullptr;
+
+						//	the cells of the shell are on the far side of the neighbour
+						const int32_t offsets[3] = { offsetX, offsetY, offsetZ };
+						int32_t minCell[3];
+						int32_t maxCell[3];
+						for (int32_t axis = 0; axis < 3; axis++)
+						{
+							minCell[axis] = offsets[axis] < 0 ? -1 : (offsets[axis] > 0 ? CUBE_CHUNK_SIZE : 0);
+							maxCell[axis] = offsets[axis] < 0 ? -1 : (offsets[axis] > 0 ? CUBE_CHUNK_SIZE : CUBE_CHUNK_MASK);
+						}
+						CubeCell row[CUBE_CHUNK_SIZE];
+						for (int32_t y = minCell[1]; y <= maxCell[1]; y++)
+						{
+							for (int32_t z = minCell[2]; z <= maxCell[2]; z++)
+							{
+								if (isCenter)
+								{
+									aChunk.CopyRow(y, z, row);
+								}
+								for (int32_t x = minCell[0]; x <= maxCell[0]; x++)
+								{
+									const int32_t localX = x & CUBE_CHUNK_MASK;
+									const int32_t localY = y & CUBE_CHUNK_MASK;
+									const int32_t localZ = z & CUBE_CHUNK_MASK;
+									const CubeCell cell = isCenter ? row[x] : (pChunk ? pChunk->Get(localX, localY, localZ) : CubeCell(0));
+									const size_t index = ChunkShading::Index(x, y, z);
+									aOutShading.mIsSolid[index] = (cell & HAS_CUBE) != 0;
+									aOutShading.mLight[index] = pLight ? pLight->Get(CubeChunk::CellIndex(localX, localY, localZ)) : CUBE_MAX_LIGHT_LEVEL;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
 
-		return pCubeWorld;
-	}
+		//	the shading of the 4 corners of a face, see packCubeVertexShading, corner (u, v) is in the bits from 6 * (u + 2 * v) on,
+		//	u and v are 1 on the positive side of their axis
+		UINT32 computeFaceShading(const ChunkShading& aShading, const int32_t aCell[3], const int32_t aFace)
+		{
+			const int32_t normalAxis = aFace % 3;
+			const int32_t uAxis = (normalAxis + 1) % 3;
+			const int32_t vAxis = (normalAxis + 2) % 3;
+			int32_t front[3] = { aCell[0], aCell[1], aCell[2] };
+			front[normalAxis] += aFace < 3 ? -1 : 1;
+			const size_t frontIndex = ChunkShading::Index(front[0], front[1], front[2]);
+
+			UINT32 faceShading = 0;
+			for (int32_t corner = 0; corner < 4; corner++)
+			{
+				//	the cells next to the corner in front of the face
+				int32_t uSide[3] = { front[0], front[1], front[2] };
+				int32_t vSide[3] = { front[0], front[1], front[2] };
+				uSide[uAxis] += (corner & 1) ? 1 : -1;
+				vSide[vAxis] += (corner & 2) ? 1 : -1;
+				const int32_t diagonal[3] = { uSide[0] + vSide[0] - front[0], uSide[1] + vSide[1] - front[1], uSide[2] + vSide[2] - front[2] };
+				const size_t uSideIndex = ChunkShading::Index(uSide[0], uSide[1], uSide[2]);
+				const size_t vSideIndex = ChunkShading::Index(vSide[0], vSide[1], vSide[2]);
+				const size_t diagonalIndex = ChunkShading::Index(diagonal[0], diagonal[1], diagonal[2]);
+				const bool isUSideSolid = aShading.mIsSolid[uSideIndex];
+				const bool isVSideSolid = aShading.mIsSolid[vSideIndex];
+				//	the diagonal can't be seen past two solid sides
+				const bool isDiagonalSolid = aShading.mIsSolid[diagonalIndex] || (isUSideSolid && isVSideSolid);
+				const UINT32 occlusion = (isUSideSolid && isVSideSolid) ? 0 :
+					CUBE_VERTEX_MAX_OCCLUSION - static_cast<UINT32>(isUSideSolid) - static_cast<UINT32>(isVSideSolid) - static_cast<UINT32>(isDiagonalSolid);
+
+				//	smooth lighting, the average of the open cells around the corner
+				UINT32 lightSum = 0;
+				UINT32 lightCount = 0;
+				const std::pair<size_t, bool> samples[4] = {
+					{ frontIndex, aShading.mIsSolid[frontIndex] },
+					{ uSideIndex, isUSideSolid },
+					{ vSideIndex, isVSideSolid },
+					{ diagonalIndex, isDiagonalSolid } };
+				for (const auto& [index, isSolid] : samples)
+				{
+					if (!isSolid)
+					{
+						lightSum += aShading.mLight[index];
+						lightCount++;
+					}
+				}
+				const UINT32 light = lightCount > 0 ? (lightSum + lightCount / 2) / lightCount : 0;
+				faceShading |= (occlusion | (light << 2)) << (corner * 6);
+			}
+			return faceShading;
+		}
 
-	inline CubeCell& CubeWorld::At(const size_t aX, const size_t aY, const size_t aZ)
-	{
-		if (aX >= mSizeX || aY >= mSizeY || aZ >= mSizeZ ||
-			aX < 0 || aY < 0 || aZ < 0)
+		inline bool isUniformShading(const UINT32 aFaceShading)
 		{
-			throw std::runtime_error("failed to access out of bound cube cell of the cube world");
+			return aFaceShading == (aFaceShading & 0x3F) * 0x41041;
 		}
 
-		return mWorld.at((mSizeX * mSizeZ) * aY + mSizeX * aZ + aX);
+		inline UINT32 getUniformShading(const UINT32 aOcclusion, const UINT32 aLight)
+		{
+			return (aOcclusion | (aLight << 2)) * 0x41041;
+		}
 	}
 
 	CubeWorldRenderer::CubeWorldRenderer(ID3D11Device* apDevice, 
@@ -61,6 +158,8 @@ namespace tde
 		, mppLightBuffer(appLightBuffer)
 	{
 		mpVertexShader = VertexShaderCacheLocator::Get()->Get("BoxVS");
+		mpCompactVertexShader = VertexShaderCacheLocator::Get()->Get("BoxCompactVS");
+		mpFacesVertexShader = VertexShaderCacheLocator::Get()->Get("BoxFacesVS");
 		mpPixelShader = PixelShaderCacheLocator::Get()->Get("BoxPS");
 
 		//	create vertex param constant buffer
@@ -74,166 +173,610 @@ namespace tde
 			apDevice->CreateBuffer(&bufDesc, nullptr, mpVertexParamBuffer.ReleaseAndGetAddressOf());
 		}
 
-		//	create material constant buffer
+		//	create chunk param constant buffer, it's updated for every chunk drawn with compact vertices
 		{
-			Material material;
-			material.mAmbientColor = DirectX::XMVectorSet(0.75f, 0.9f, 0.9f, 1.0f);
-			material.mAmbientCoef = 0.2f;
-			material.mDiffuseColor = DirectX::XMVectorSet(0.75f, 0.75f, 0.75f, 1.0f);
-			material.mDiffuseCoef = 0.6f;
-			material.mSpecularColor = DirectX::XMVectorSet(0.8f, 0.8f, 0.8f, 1.0f);
-			material.mSpecularCoef = 0.2f;
-			material.mEmissiveColor = DirectX::XMVectorZero();
-			material.mEmissiveCoef = 0.0f;
-			material.mSpecularPower = 4;
-			material.mUseTexture = false;
-
 			D3D11_BUFFER_DESC bufDesc = { 0 };
-			bufDesc.ByteWidth = sizeof(Material);
+			bufDesc.ByteWidth = sizeof(CubeChunkParams);
 			bufDesc.Usage = D3D11_USAGE_DEFAULT;
 			bufDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 			bufDesc.CPUAccessFlags = 0;
 			bufDesc.MiscFlags = 0;
-			D3D11_SUBRESOURCE_DATA initData = { 0 };
-			initData.pSysMem = &material;
-			initData.SysMemPitch = 0;
-			initData.SysMemSlicePitch = 0;
-			apDevice->CreateBuffer(&bufDesc, &initData, mpMaterialBuffer.ReleaseAndGetAddressOf());
+			apDevice->CreateBuffer(&bufDesc, nullptr, mpChunkParamBuffer.ReleaseAndGetAddressOf());
+		}
+
+		//	stone, soil, grass and sand, the materials CubeWorldGenerator uses by default come first
+		{
+			auto makeMaterial = [](const XMFLOAT4& aDiffuseColor, const float aSpecularCoef)
+			{
+				Material material = {};
+				material.mAmbientColor = XMFLOAT4(0.75f, 0.9f, 0.9f, 1.0f);
+				material.mAmbientCoef = 0.2f;
+				material.mDiffuseColor = aDiffuseColor;
+				material.mDiffuseCoef = 0.6f;
+				material.mSpecularColor = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+				material.mSpecularCoef = aSpecularCoef;
+				material.mEmissiveColor = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				material.mEmissiveCoef = 0.0f;
+				material.mSpecularPower = 4;
+				return material;
+			};
+			SetMaterials(apDevice, {
+				makeMaterial(XMFLOAT4(0.75f, 0.75f, 0.75f, 1.0f), 0.2f),
+				makeMaterial(XMFLOAT4(0.45f, 0.32f, 0.2f, 1.0f), 0.05f),
+				makeMaterial(XMFLOAT4(0.35f, 0.6f, 0.25f, 1.0f), 0.1f),
+				makeMaterial(XMFLOAT4(0.85f, 0.78f, 0.55f, 1.0f), 0.1f) });
 		}
 	}
 
 	void CubeWorldRenderer::UpdateBuffer(ID3D11Device* apDevice)
 	{
 		mpVertexBuffer.Reset();
+		mpFaceView.Reset();
+		mChunkMeshes.clear();
+		mVertexRanges.Reset(0);
+		mBufferVertexFormat = mVertexFormat;
 		
 		if (!mpCubeWorld ||
-			mpCubeWorld->mSizeX <= 0 || 
-			mpCubeWorld->mSizeY <= 0 ||
-			mpCubeWorld->mSizeZ <= 0) 
+			mpCubeWorld->GetSizeX() <= 0 || 
+			mpCubeWorld->GetSizeY() <= 0 ||
+			mpCubeWorld->GetSizeZ() <= 0) 
 		{
 			return;
 		}
 
-		std::vector<CubeVertex> vertices;
+		//	everything is remeshed, so the pending edits are covered
+		mpCubeWorld->TakeDirtyChunks();
+
+		//	the world is centered on its bounds
+		const CubeCoord& minCell = mpCubeWorld->GetMinCell();
+		const CubeCoord& maxCell = mpCubeWorld->GetMaxCell();
+		mOrigin = XMFLOAT3{
+			static_cast<float>(minCell.mX + maxCell.mX) / 2.0f,
+			static_cast<float>(minCell.mY + maxCell.mY) / 2.0f,
+			static_cast<float>(minCell.mZ + maxCell.mZ) / 2.0f };
+
+		//	sort the chunks bottom to top, back to front, left to right, so the result doesn't depend on the hash map
+		std::vector<CubeCoord> chunkCoords;
+		chunkCoords.reserve(mpCubeWorld->GetChunkCount());
+		for (const auto& chunk : mpCubeWorld->GetChunks())
+		{
+			chunkCoords.emplace_back(chunk.first);
+		}
+		std::sort(chunkCoords.begin(), chunkCoords.end(), [](const CubeCoord& aLeft, const CubeCoord& aRight)
+		{
+			return std::tie(aLeft.mY, aLeft.mZ, aLeft.mX) < std::tie(aRight.mY, aRight.mZ, aRight.mX);
+		});
+
+		const UINT stride = PrivGetVertexStride();
+		std::vector<std::vector<uint8_t>> chunkVertexData;
+		PrivMeshChunks(chunkCoords, chunkVertexData);
+
+		//	gather the chunks in order, so the result is the same as meshing serially
+		std::vector<size_t> chunkOffsets(chunkVertexData.size());
+		for (size_t i = 0; i < chunkVertexData.size(); i++)
+		{
+			chunkOffsets[i] = chunkVertexData[i].size() / stride;
+		}
+		parallelScan(WorkDispatcherLocator::Get().get(), chunkOffsets.data(), chunkOffsets.data(), chunkOffsets.size(), size_t(0), std::plus<size_t>(), 1);
+		const size_t vertexCount = chunkOffsets.empty() ? 0 : chunkOffsets.back();
+		if (vertexCount == 0)
+		{
+			return;
+		}
+
+		//	the chunks are packed tightly, the rest of the buffer is left for chunks which outgrow their range
+		const size_t capacity = std::max(vertexCount + vertexCount / 4, MIN_VERTEX_BUFFER_CAPACITY);
+		std::vector<uint8_t> vertexData(capacity * stride);
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, chunkVertexData.size(), [&](const size_t aChunk)
+		{
+			std::copy(chunkVertexData[aChunk].begin(), chunkVertexData[aChunk].end(), vertexData.begin() + (chunkOffsets[aChunk] * stride - chunkVertexData[aChunk].size()));
+		}, 1);
+
+		mVertexRanges.Reset(capacity);
+		size_t firstVertex = 0;
+		mVertexRanges.Allocate(vertexCount, firstVertex);
+		for (size_t i = 0; i < chunkCoords.size(); i++)
+		{
+			const UINT chunkVertexCount = static_cast<UINT>(chunkVertexData[i].size() / stride);
+			if (chunkVertexCount > 0)
+			{
+				mChunkMeshes[chunkCoords[i]] = { static_cast<UINT>(chunkOffsets[i]) - chunkVertexCount, chunkVertexCount, chunkVertexCount };
+			}
+		}
+
+		PrivCreateVertexBuffer(apDevice, capacity, vertexData.data(), mpVertexBuffer, mpFaceView);
+	}
+
+	void CubeWorldRenderer::UpdateDirtyChunks(ID3D11Device* apDevice)
+	{
+		if (!mpCubeWorld || !mpCubeWorld->HasDirtyChunks())
+		{
+			return;
+		}
+
+		const std::vector<CubeCoord> dirtyChunks = mpCubeWorld->TakeDirtyChunks();
+		const UINT stride = PrivGetVertexStride();
+		std::vector<std::vector<uint8_t>> chunkVertexData;
+		PrivMeshChunks(dirtyChunks, chunkVertexData);
+
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> pContext;
+		apDevice->GetImmediateContext(pContext.GetAddressOf());
+
+		for (size_t i = 0; i < dirtyChunks.size(); i++)
+		{
+			const std::vector<uint8_t>& vertexData = chunkVertexData[i];
+			const UINT vertexCount = static_cast<UINT>(vertexData.size() / stride);
+
+			//	keep the old range if the new mesh still fits into it
+			auto meshIt = mChunkMeshes.find(dirtyChunks[i]);
+			if (meshIt != mChunkMeshes.end() && (vertexCount == 0 || vertexCount > meshIt->second.mCapacity))
+			{
+				mVertexRanges.Free(meshIt->second.mFirstVertex, meshIt->second.mCapacity);
+				mChunkMeshes.erase(meshIt);
+				meshIt = mChunkMeshes.end();
+			}
+			if (vertexCount == 0)
+			{
+				continue;
+			}
+
+			if (meshIt == mChunkMeshes.end())
+			{
+				//	an edited chunk is likely to be edited again
+				const UINT capacity = vertexCount + vertexCount / 4;
+				size_t firstVertex = 0;
+				if (!mVertexRanges.Allocate(capacity, firstVertex))
+				{
+					PrivGrowVertexBuffer(apDevice, pContext.Get(), mVertexRanges.GetCapacity() + capacity);
+					mVertexRanges.Allocate(capacity, firstVertex);
+				}
+				meshIt = mChunkMeshes.emplace(dirtyChunks[i], ChunkMesh{ static_cast<UINT>(firstVertex), 0, capacity }).first;
+			}
 
-		float originX = static_cast<float>(mpCubeWorld->mSizeX) / 2.0f;
-		float originY = static_cast<float>(mpCubeWorld->mSizeY) / 2.0f;
-		float originZ = static_cast<float>(mpCubeWorld->mSizeZ) / 2.0f;
+			ChunkMesh& mesh = meshIt->second;
+			mesh.mVertexCount = vertexCount;
+			D3D11_BOX destinationBox = { 0 };
+			destinationBox.left = mesh.mFirstVertex * stride;
+			destinationBox.right = (mesh.mFirstVertex + vertexCount) * stride;
+			destinationBox.top = 0;
+			destinationBox.bottom = 1;
+			destinationBox.front = 0;
+			destinationBox.back = 1;
+			pContext->UpdateSubresource(mpVertexBuffer.Get(), 0, &destinationBox, vertexData.data(), 0, 0);
+		}
+	}
 
-		//	construct the vertices
-		for (int y = 0; y < mpCubeWorld->mSizeY; y++)
+	void CubeWorldRenderer::PrivMeshChunks(const std::vector<CubeCoord>& aChunkCoords, std::vector<std::vector<uint8_t>>& aOutVertexData) const
+	{
+		//	the chunks are independent so each of them is meshed by its own job
+		aOutVertexData.clear();
+		aOutVertexData.resize(aChunkCoords.size());
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, aChunkCoords.size(), [&](const size_t aChunk)
 		{
-			for (int z = 0; z < mpCubeWorld->mSizeZ; z++)
+			const CubeChunk* pChunk = mpCubeWorld->FindChunk(aChunkCoords[aChunk]);
+			if (!pChunk)
+			{
+				return;
+			}
+			const int32_t lod = PrivGetChunkLod(aChunkCoords[aChunk]);
+			const uint32_t openBorders = PrivGetOpenBorders(aChunkCoords[aChunk], lod);
+			std::vector<CubeFace> faces;
+			if (lod > 0)
+			{
+				PrivMeshChunkLod(*mpCubeWorld, mpLighting.get(), aChunkCoords[aChunk], *pChunk, lod, openBorders, faces);
+			}
+			else if (mMeshingMode == CubeMeshingMode::GREEDY)
+			{
+				PrivMeshChunkGreedy(*mpCubeWorld, mpLighting.get(), aChunkCoords[aChunk], *pChunk, openBorders, faces);
+			}
+			else
 			{
-				for (int x = 0; x < mpCubeWorld->mSizeX; x++)
+				PrivMeshChunk(*mpCubeWorld, mpLighting.get(), aChunkCoords[aChunk], *pChunk, openBorders, faces);
+			}
+
+			//	the faces go into the buffer as they are, the vertex formats expand them into their two triangles
+			std::vector<uint8_t>& vertexData = aOutVertexData[aChunk];
+			vertexData.resize(faces.size() * PrivGetVertexStride() * (mBufferVertexFormat == CubeVertexFormat::FACES ? 1 : 6));
+			if (mBufferVertexFormat == CubeVertexFormat::FACES)
+			{
+				std::memcpy(vertexData.data(), faces.data(), vertexData.size());
+			}
+			else if (mBufferVertexFormat == CubeVertexFormat::COMPACT)
+			{
+				CubeCompactVertex* pCompactVertices = reinterpret_cast<CubeCompactVertex*>(vertexData.data());
+				CubeVertexCorner corners[6];
+				for (const CubeFace& face : faces)
 				{
-					if (mpCubeWorld->At(x, y, z) & HAS_CUBE)
+					expandCubeFace(face, corners);
+					for (const CubeVertexCorner& corner : corners)
 					{
-						XMFLOAT3 cubeCenter{
-							static_cast<float>(x) - originX + 0.5f,
-							static_cast<float>(y) - originY + 0.5f,
-							static_cast<float>(z) - originZ + 0.5f };
+						*pCompactVertices++ = packCubeCompactVertex(corner);
+					}
+				}
+			}
+			else
+			{
+				CubeVertex* pVertices = reinterpret_cast<CubeVertex*>(vertexData.data());
+				for (const CubeFace& face : faces)
+				{
+					expandCubeFaceVertices(face, aChunkCoords[aChunk], mOrigin, pVertices);
+					pVertices += 6;
+				}
+			}
+		}, 1);
+	}
 
-						//	-x
-						if (x == 0 || !(mpCubeWorld->At(x - 1, y, z) & HAS_CUBE))
-						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NX | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::NX | CubeTexCoord::TOP_LEFT});
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_LEFT});
+	int32_t CubeWorldRenderer::PrivGetChunkLod(const CubeCoord& aChunkCoord) const
+	{
+		const auto lodIt = mChunkLods.find(aChunkCoord);
+		return lodIt != mChunkLods.end() ? lodIt->second : 0;
+	}
 
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_LEFT});
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_RIGHT});
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NX | CubeTexCoord::TOP_RIGHT});
-						}
-						
-						//	-y
-						if (y == 0 || !(mpCubeWorld->At(x, y - 1, z) & HAS_CUBE))
-						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_LEFT });
+	uint32_t CubeWorldRenderer::PrivGetOpenBorders(const CubeCoord& aChunkCoord, const int32_t aLod) const
+	{
+		uint32_t openBorders = 0;
+		for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+		{
+			const CubeCoord neighbourCoord = getCubeFaceNeighbour(aChunkCoord, face);
+			if (mpCubeWorld->FindChunk(neighbourCoord) && PrivGetChunkLod(neighbourCoord) != aLod)
+			{
+				openBorders |= 1u << face;
+			}
+		}
+		return openBorders;
+	}
 
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_RIGHT });
-						}
-						
-						//	-z
-						if (z == 0 || !(mpCubeWorld->At(x, y, z - 1) & HAS_CUBE))
+	void CubeWorldRenderer::PrivGrowVertexBuffer(ID3D11Device* apDevice, ID3D11DeviceContext* apContext, const size_t aMinCapacity)
+	{
+		const size_t oldCapacity = mVertexRanges.GetCapacity();
+		size_t newCapacity = std::max(oldCapacity * 2, MIN_VERTEX_BUFFER_CAPACITY);
+		while (newCapacity < aMinCapacity)
+		{
+			newCapacity *= 2;
+		}
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> pNewVertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> pNewFaceView;
+		PrivCreateVertexBuffer(apDevice, newCapacity, nullptr, pNewVertexBuffer, pNewFaceView);
+
+		//	the copy stays on the gpu
+		if (mpVertexBuffer && oldCapacity > 0)
+		{
+			D3D11_BOX sourceBox = { 0 };
+			sourceBox.left = 0;
+			sourceBox.right = static_cast<UINT>(oldCapacity * PrivGetVertexStride());
+			sourceBox.top = 0;
+			sourceBox.bottom = 1;
+			sourceBox.front = 0;
+			sourceBox.back = 1;
+			apContext->CopySubresourceRegion(pNewVertexBuffer.Get(), 0, 0, 0, 0, mpVertexBuffer.Get(), 0, &sourceBox);
+		}
+
+		mpVertexBuffer = pNewVertexBuffer;
+		mpFaceView = pNewFaceView;
+		mVertexRanges.Grow(newCapacity);
+	}
+
+	void CubeWorldRenderer::PrivCreateVertexBuffer(ID3D11Device* apDevice, const size_t aCapacity, const void* apInitialData,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& aOutBuffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& aOutView) const
+	{
+		const bool isFaces = mBufferVertexFormat == CubeVertexFormat::FACES;
+
+		D3D11_SUBRESOURCE_DATA initialData = { 0 };
+		initialData.pSysMem = apInitialData;
+		initialData.SysMemPitch = 0;
+		initialData.SysMemSlicePitch = 0;
+
+		D3D11_BUFFER_DESC bufferDescription = { 0 };
+		bufferDescription.BindFlags = isFaces ? D3D11_BIND_SHADER_RESOURCE : D3D11_BIND_VERTEX_BUFFER;
+		bufferDescription.ByteWidth = static_cast<UINT>(aCapacity * PrivGetVertexStride());
+		bufferDescription.CPUAccessFlags = 0;
+		bufferDescription.MiscFlags = isFaces ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : 0;
+		bufferDescription.StructureByteStride = isFaces ? PrivGetVertexStride() : 0;
+		bufferDescription.Usage = D3D11_USAGE_DEFAULT;
+		apDevice->CreateBuffer(&bufferDescription, apInitialData ? &initialData : nullptr, aOutBuffer.ReleaseAndGetAddressOf());
+
+		aOutView.Reset();
+		if (isFaces)
+		{
+			D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+			viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+			viewDesc.Buffer.FirstElement = 0;
+			viewDesc.Buffer.NumElements = static_cast<UINT>(aCapacity);
+			apDevice->CreateShaderResourceView(aOutBuffer.Get(), &viewDesc, aOutView.ReleaseAndGetAddressOf());
+		}
+	}
+
+	void CubeWorldRenderer::PrivMeshChunk(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk,
+		const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces)
+	{
+		CubeChunkFaces faces;
+		computeCubeChunkFaces(aCubeWorld, aChunkCoord, aChunk, faces, aOpenBorders);
+
+		//	the masks tell exactly how many faces there are
+		size_t faceCount = 0;
+		for (const uint32_t mask : std::span<const uint32_t>(&faces.mMasks[0][0][0], CUBE_FACE_COUNT * CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE))
+		{
+			faceCount += std::popcount(mask);
+		}
+		aOutFaces.reserve(aOutFaces.size() + faceCount);
+
+		const std::unique_ptr<ChunkShading> pShading = std::make_unique<ChunkShading>();
+		buildChunkShading(aCubeWorld, apLighting, aChunkCoord, aChunk, *pShading);
+
+		for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+		{
+			for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+			{
+				//	only visit the cells with at least one visible face, in x order like a plain loop would
+				uint32_t visibleCells = 0;
+				for (size_t face = 0; face < CUBE_FACE_COUNT; face++)
+				{
+					visibleCells |= faces.mMasks[face][y][z];
+				}
+
+				while (visibleCells != 0)
+				{
+					const int32_t x = std::countr_zero(visibleCells);
+					visibleCells &= visibleCells - 1;
+
+					const UINT32 material = getCubeMaterial(aChunk.Get(x, y, z));
+
+					for (size_t face = 0; face < CUBE_FACE_COUNT; face++)
+					{
+						if (faces.mMasks[face][y][z] & (1u << x))
 						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT });
-							
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT });
+							const int32_t cell[3] = { x, y, z };
+							const UINT32 faceShading = computeFaceShading(*pShading, cell, static_cast<int32_t>(face));
+							//	faces on the positive side lie on the far side of the cell
+							int32_t corner[3] = { x, y, z };
+							corner[face % 3] += face < 3 ? 0 : 1;
+							aOutFaces.push_back(packCubeFace(corner, static_cast<UINT32>(face), 1, 1, faceShading, material));
 						}
-						
-						//	+x
-						if (x == mpCubeWorld->mSizeX - 1 || !(mpCubeWorld->At(x + 1, y, z) & HAS_CUBE))
+					}
+				}
+			}
+		}
+	}
+
+	void CubeWorldRenderer::PrivMeshChunkGreedy(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk,
+		const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces)
+	{
+		CubeChunkFaces faces;
+		computeCubeChunkFaces(aCubeWorld, aChunkCoord, aChunk, faces, aOpenBorders);
+
+		const std::unique_ptr<ChunkShading> pShading = std::make_unique<ChunkShading>();
+		buildChunkShading(aCubeWorld, apLighting, aChunkCoord, aChunk, *pShading);
+
+		//	the exposed faces of one slice of the chunk, the cell type with the shading of the corners above it or 0 where there is no face,
+		//	so faces only merge if they are shaded the same
+		uint32_t faceMask[CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE];
+
+		for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+		{
+			//	the slices are perpendicular to the normal, u and v run along the slice
+			const int32_t normalAxis = face % 3;
+			const int32_t uAxis = (normalAxis + 1) % 3;
+			const int32_t vAxis = (normalAxis + 2) % 3;
+
+			for (int32_t slice = 0; slice < CUBE_CHUNK_SIZE; slice++)
+			{
+				bool hasFaces = false;
+				int32_t cell[3];
+				cell[normalAxis] = slice;
+				for (int32_t v = 0; v < CUBE_CHUNK_SIZE; v++)
+				{
+					cell[vAxis] = v;
+					for (int32_t u = 0; u < CUBE_CHUNK_SIZE; u++)
+					{
+						cell[uAxis] = u;
+						const bool isExposed = (faces.mMasks[face][cell[1]][cell[2]] >> cell[0]) & 1;
+						faceMask[v * CUBE_CHUNK_SIZE + u] = isExposed ?
+							static_cast<uint32_t>(static_cast<uint8_t>(aChunk.Get(cell[0], cell[1], cell[2]))) | (computeFaceShading(*pShading, cell, face) << 8) : 0;
+						hasFaces |= isExposed;
+					}
+				}
+				if (!hasFaces)
+				{
+					continue;
+				}
+
+				//	grow every face along u as far as it goes, then along v as long as the whole row matches
+				for (int32_t v = 0; v < CUBE_CHUNK_SIZE; v++)
+				{
+					for (int32_t u = 0; u < CUBE_CHUNK_SIZE;)
+					{
+						const uint32_t faceKey = faceMask[v * CUBE_CHUNK_SIZE + u];
+						if (faceKey == 0)
 						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PX | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::PX | CubeTexCoord::TOP_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_LEFT });
+							u++;
+							continue;
+						}
 
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PX | CubeTexCoord::TOP_RIGHT });
+						//	faces with a gradient across them stay single, stretching it over a larger quad would look wrong
+						const UINT32 faceShading = faceKey >> 8;
+						const UINT32 material = getCubeMaterial(static_cast<CubeCell>(faceKey & 0xFF));
+						const bool canMerge = isUniformShading(faceShading);
+						int32_t width = 1;
+						while (canMerge && u + width < CUBE_CHUNK_SIZE && faceMask[v * CUBE_CHUNK_SIZE + u + width] == faceKey)
+						{
+							width++;
 						}
-						
-						//	+y
-						if (y == mpCubeWorld->mSizeY - 1 || !(mpCubeWorld->At(x, y + 1, z) & HAS_CUBE))
+						int32_t height = 1;
+						for (; canMerge && v + height < CUBE_CHUNK_SIZE; height++)
 						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_LEFT });
-
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_RIGHT });
+							const uint32_t* pRow = &faceMask[(v + height) * CUBE_CHUNK_SIZE + u];
+							if (std::any_of(pRow, pRow + width, [faceKey](const uint32_t aKey) { return aKey != faceKey; }))
+							{
+								break;
+							}
 						}
-						
-						//	+z
-						if (z == mpCubeWorld->mSizeZ - 1 || !(mpCubeWorld->At(x, y, z + 1) & HAS_CUBE))
+						for (int32_t row = 0; row < height; row++)
 						{
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_LEFT });
-							
-							vertices.push_back({ cubeCenter, CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_LEFT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_RIGHT });
-							vertices.push_back({ cubeCenter, CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_RIGHT });
+							std::fill_n(&faceMask[(v + row) * CUBE_CHUNK_SIZE + u], width, 0u);
 						}
+
+						int32_t corner[3];
+						corner[normalAxis] = face < 3 ? slice : slice + 1;
+						corner[uAxis] = u;
+						corner[vAxis] = v;
+						aOutFaces.push_back(packCubeFace(corner, static_cast<UINT32>(face), static_cast<UINT32>(width), static_cast<UINT32>(height), faceShading, material));
+
+						u += width;
 					}
 				}
 			}
 		}
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT });
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_LEFT });
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT });
+	}
 
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT });
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_RIGHT });
-		//vertices.push_back({ {0.0f, 0.0f, 0.0f}, CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT });
-		//mCubeWorldVerticesCount = 6;
-		mCubeWorldVerticesCount = vertices.size();
+	void CubeWorldRenderer::PrivMeshChunkLod(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, const int32_t aLod,
+		const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces)
+	{
+		const int32_t scale = 1 << aLod;
+		const int32_t chunkCell[3] = {
+			aChunkCoord.mX << CUBE_CHUNK_SIZE_LOG2,
+			aChunkCoord.mY << CUBE_CHUNK_SIZE_LOG2,
+			aChunkCoord.mZ << CUBE_CHUNK_SIZE_LOG2 };
+
+		CubeChunkMip mip;
+		buildCubeChunkMip(aChunk, aLod, mip);
+		const int32_t size = mip.mSize;
+
+		//	the merged cells with a border of one merged cell from each neighbour at the same level, open borders stay empty
+		const int32_t paddedSize = size + 2;
+		std::vector<CubeCell> cells(static_cast<size_t>(paddedSize) * paddedSize * paddedSize, CubeCell(0));
+		auto cellAt = [&cells, paddedSize](const int32_t aX, const int32_t aY, const int32_t aZ) -> CubeCell&
+		{
+			return cells[(static_cast<size_t>(aY + 1) * paddedSize + (aZ + 1)) * paddedSize + (aX + 1)];
+		};
+		for (int32_t y = 0; y < size; y++)
+		{
+			for (int32_t z = 0; z < size; z++)
+			{
+				for (int32_t x = 0; x < size; x++)
+				{
+					cellAt(x, y, z) = mip.Get(x, y, z);
+				}
+			}
+		}
+		for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+		{
+			const CubeChunk* pNeighbour = (aOpenBorders & (1u << face)) ? nullptr : aCubeWorld.FindChunk(getCubeFaceNeighbour(aChunkCoord, face));
+			if (!pNeighbour)
+			{
+				continue;
+			}
+			const int32_t normalAxis = face % 3;
+			const int32_t uAxis = (normalAxis + 1) % 3;
+			const int32_t vAxis = (normalAxis + 2) % 3;
+			int32_t neighbourCell[3];
+			int32_t borderCell[3];
+			neighbourCell[normalAxis] = face < 3 ? size - 1 : 0;
+			borderCell[normalAxis] = face < 3 ? -1 : size;
+			for (int32_t v = 0; v < size; v++)
+			{
+				neighbourCell[vAxis] = borderCell[vAxis] = v;
+				for (int32_t u = 0; u < size; u++)
+				{
+					neighbourCell[uAxis] = borderCell[uAxis] = u;
+					cellAt(borderCell[0], borderCell[1], borderCell[2]) =
+						computeCubeMipCell(*pNeighbour, aLod, neighbourCell[0], neighbourCell[1], neighbourCell[2]);
+				}
+			}
+		}
 
-		//	create the vertex buffer
-		D3D11_SUBRESOURCE_DATA initialData = { 0 };
-		D3D11_BUFFER_DESC bufferDescription = { 0 };
+		//	the exposed faces of one slice, the cell type with the light in front of it or 0 where there is no face
+		std::vector<uint32_t> faceMask(static_cast<size_t>(size) * size);
 
-		initialData.pSysMem = &vertices[0];
-		initialData.SysMemPitch = 0;
-		initialData.SysMemSlicePitch = 0;
+		for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+		{
+			const int32_t normalAxis = face % 3;
+			const int32_t uAxis = (normalAxis + 1) % 3;
+			const int32_t vAxis = (normalAxis + 2) % 3;
+			const int32_t normalStep = face < 3 ? -1 : 1;
 
-		bufferDescription.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		bufferDescription.ByteWidth = mCubeWorldVerticesCount * sizeof(CubeVertex);
-		bufferDescription.CPUAccessFlags = 0;
-		bufferDescription.MiscFlags = 0;
-		bufferDescription.Usage = D3D11_USAGE_DEFAULT;
+			for (int32_t slice = 0; slice < size; slice++)
+			{
+				bool hasFaces = false;
+				int32_t cell[3];
+				int32_t coveringCell[3];
+				cell[normalAxis] = slice;
+				coveringCell[normalAxis] = slice + normalStep;
+				for (int32_t v = 0; v < size; v++)
+				{
+					cell[vAxis] = coveringCell[vAxis] = v;
+					for (int32_t u = 0; u < size; u++)
+					{
+						cell[uAxis] = coveringCell[uAxis] = u;
+						const CubeCell cubeCell = cellAt(cell[0], cell[1], cell[2]);
+						const bool isExposed = (cubeCell & HAS_CUBE) && !(cellAt(coveringCell[0], coveringCell[1], coveringCell[2]) & HAS_CUBE);
+						if (!isExposed)
+						{
+							faceMask[v * size + u] = 0;
+							continue;
+						}
+						//	the light of the finest cell in the middle of the merged cell in front of the face
+						const uint32_t light = apLighting ? apLighting->GetLight(
+							chunkCell[0] + coveringCell[0] * scale + scale / 2,
+							chunkCell[1] + coveringCell[1] * scale + scale / 2,
+							chunkCell[2] + coveringCell[2] * scale + scale / 2) : CUBE_MAX_LIGHT_LEVEL;
+						faceMask[v * size + u] = static_cast<uint32_t>(static_cast<uint8_t>(cubeCell)) | (light << 8);
+						hasFaces |= isExposed;
+					}
+				}
+				if (!hasFaces)
+				{
+					continue;
+				}
 
-		HRESULT hr = apDevice->CreateBuffer(&bufferDescription, &initialData, mpVertexBuffer.ReleaseAndGetAddressOf());
+				//	the same merging as PrivMeshChunkGreedy, on merged cells
+				for (int32_t v = 0; v < size; v++)
+				{
+					for (int32_t u = 0; u < size;)
+					{
+						const uint32_t faceKey = faceMask[v * size + u];
+						if (faceKey == 0)
+						{
+							u++;
+							continue;
+						}
+
+						int32_t width = 1;
+						while (u + width < size && faceMask[v * size + u + width] == faceKey)
+						{
+							width++;
+						}
+						int32_t height = 1;
+						for (; v + height < size; height++)
+						{
+							const uint32_t* pRow = &faceMask[(v + height) * size + u];
+							if (std::any_of(pRow, pRow + width, [faceKey](const uint32_t aKey) { return aKey != faceKey; }))
+							{
+								break;
+							}
+						}
+						for (int32_t row = 0; row < height; row++)
+						{
+							std::fill_n(&faceMask[(v + row) * size + u], width, 0u);
+						}
+
+						//	a whole chunk is still at most CUBE_FACE_MAX_SIZE cells wide
+						int32_t corner[3];
+						corner[normalAxis] = (face < 3 ? slice : slice + 1) * scale;
+						corner[uAxis] = u * scale;
+						corner[vAxis] = v * scale;
+						//	far away occlusion is too small to see, the faces are only lit
+						const UINT32 shading = getUniformShading(CUBE_VERTEX_MAX_OCCLUSION, faceKey >> 8);
+						const UINT32 material = getCubeMaterial(static_cast<CubeCell>(faceKey & 0xFF));
+						aOutFaces.push_back(packCubeFace(corner, static_cast<UINT32>(face),
+							static_cast<UINT32>(width * scale), static_cast<UINT32>(height * scale), shading, material));
+
+						u += width;
+					}
+				}
+			}
+		}
 	}
 
 	void CubeWorldRenderer::SetPosition(DirectX::SimpleMath::Vector4 aCenterPosition)
@@ -248,6 +791,134 @@ namespace tde
 		mTransformDirty = true;
 	}
 
+	void CubeWorldRenderer::SetLighting(std::shared_ptr<const CubeWorldLighting> apLighting)
+	{
+		mpLighting = std::move(apLighting);
+	}
+
+	void CubeWorldRenderer::SetMaterials(ID3D11Device* apDevice, const std::vector<Material>& aMaterials)
+	{
+		if (aMaterials.empty())
+		{
+			return;
+		}
+
+		//	every material a cell can have gets an entry, so the shader never reads past the end
+		std::vector<Material> materials(CUBE_MATERIAL_COUNT, aMaterials.front());
+		std::copy_n(aMaterials.begin(), std::min<size_t>(aMaterials.size(), CUBE_MATERIAL_COUNT), materials.begin());
+
+		D3D11_BUFFER_DESC bufDesc = { 0 };
+		bufDesc.ByteWidth = static_cast<UINT>(materials.size() * sizeof(Material));
+		bufDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		bufDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufDesc.CPUAccessFlags = 0;
+		bufDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufDesc.StructureByteStride = sizeof(Material);
+		D3D11_SUBRESOURCE_DATA initData = { 0 };
+		initData.pSysMem = materials.data();
+		initData.SysMemPitch = 0;
+		initData.SysMemSlicePitch = 0;
+		apDevice->CreateBuffer(&bufDesc, &initData, mpMaterialBuffer.ReleaseAndGetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.FirstElement = 0;
+		viewDesc.Buffer.NumElements = static_cast<UINT>(materials.size());
+		apDevice->CreateShaderResourceView(mpMaterialBuffer.Get(), &viewDesc, mpMaterialView.ReleaseAndGetAddressOf());
+	}
+
+	void CubeWorldRenderer::SetMeshingMode(const CubeMeshingMode aMeshingMode)
+	{
+		mMeshingMode = aMeshingMode;
+	}
+
+	void CubeWorldRenderer::SetVertexFormat(const CubeVertexFormat aVertexFormat)
+	{
+		mVertexFormat = aVertexFormat;
+	}
+
+	void CubeWorldRenderer::SetLodDistances(const float aLod1Distance, const float aLod2Distance, const float aLod3Distance)
+	{
+		mLodDistances[0] = aLod1Distance;
+		mLodDistances[1] = aLod2Distance;
+		mLodDistances[2] = aLod3Distance;
+	}
+
+	void CubeWorldRenderer::UpdateLods(const XMFLOAT3& aFocusCell)
+	{
+		if (!mpCubeWorld)
+		{
+			return;
+		}
+
+		//	chunks which were removed from the world come back at full detail
+		for (auto lodIt = mChunkLods.begin(); lodIt != mChunkLods.end();)
+		{
+			lodIt = mpCubeWorld->FindChunk(lodIt->first) ? std::next(lodIt) : mChunkLods.erase(lodIt);
+		}
+
+		const float focusChunk[3] = {
+			aFocusCell.x / static_cast<float>(CUBE_CHUNK_SIZE),
+			aFocusCell.y / static_cast<float>(CUBE_CHUNK_SIZE),
+			aFocusCell.z / static_cast<float>(CUBE_CHUNK_SIZE) };
+		for (const auto& chunk : mpCubeWorld->GetChunks())
+		{
+			const CubeCoord& chunkCoord = chunk.first;
+			const float offsetX = static_cast<float>(chunkCoord.mX) + 0.5f - focusChunk[0];
+			const float offsetY = static_cast<float>(chunkCoord.mY) + 0.5f - focusChunk[1];
+			const float offsetZ = static_cast<float>(chunkCoord.mZ) + 0.5f - focusChunk[2];
+			const float distance = std::sqrt(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ);
+
+			const int32_t currentLod = PrivGetChunkLod(chunkCoord);
+			int32_t lod = currentLod;
+			while (lod < CUBE_CHUNK_LOD_COUNT - 1 && distance > mLodDistances[lod] + LOD_HYSTERESIS)
+			{
+				lod++;
+			}
+			while (lod > 0 && distance < mLodDistances[lod - 1] - LOD_HYSTERESIS)
+			{
+				lod--;
+			}
+			if (lod == currentLod)
+			{
+				continue;
+			}
+
+			if (lod == 0)
+			{
+				mChunkLods.erase(chunkCoord);
+			}
+			else
+			{
+				mChunkLods[chunkCoord] = lod;
+			}
+			mpCubeWorld->MarkChunkDirty(chunkCoord);
+			for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+			{
+				const CubeCoord neighbourCoord = getCubeFaceNeighbour(chunkCoord, face);
+				if (mpCubeWorld->FindChunk(neighbourCoord))
+				{
+					mpCubeWorld->MarkChunkDirty(neighbourCoord);
+				}
+			}
+		}
+	}
+
+	XMFLOAT3 XM_CALLCONV CubeWorldRenderer::GetCellPosition(FXMVECTOR aWorldPosition)
+	{
+		const XMVECTOR localPosition = XMVector3Transform(aWorldPosition, XMMatrixInverse(nullptr, GetWorldMatrix()));
+		XMFLOAT3 cellPosition;
+		XMStoreFloat3(&cellPosition, XMVectorAdd(localPosition, XMLoadFloat3(&mOrigin)));
+		return cellPosition;
+	}
+
+	XMVECTOR CubeWorldRenderer::GetWorldPosition(const XMFLOAT3& aCellPosition)
+	{
+		const XMVECTOR localPosition = XMVectorSetW(XMVectorSubtract(XMLoadFloat3(&aCellPosition), XMLoadFloat3(&mOrigin)), 1.0f);
+		return XMVector3Transform(localPosition, GetWorldMatrix());
+	}
+
 	XMMATRIX CubeWorldRenderer::GetWorldMatrix()
 	{
 		if (mTransformDirty)
@@ -268,20 +939,53 @@ namespace tde
 		apContext->UpdateSubresource(mpVertexParamBuffer.Get(), 0, nullptr, &vParams, 0, 0);
 
 		//	render
-		UINT strides[] = { sizeof(CubeVertex) };
+		const bool isFaces = mBufferVertexFormat == CubeVertexFormat::FACES;
+		//	compact vertices and faces are relative to their chunk
+		const bool isChunkRelative = mBufferVertexFormat != CubeVertexFormat::FULL;
+		VertexShader* pVertexShader = isFaces ? mpFacesVertexShader.get() :
+			(mBufferVertexFormat == CubeVertexFormat::COMPACT ? mpCompactVertexShader.get() : mpVertexShader.get());
+		//	every face is two triangles
+		const UINT verticesPerElement = isFaces ? 6 : 1;
+		UINT strides[] = { PrivGetVertexStride() };
 		UINT offsets[] = { 0 };
-		//	IA
-		mpVertexShader->SetInputLayout(apContext);
+		//	IA, faces are pulled from the structured buffer so there are no vertex buffers
+		pVertexShader->SetInputLayout(apContext);
 		apContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		apContext->IASetVertexBuffers(0, 1, mpVertexBuffer.GetAddressOf(), strides, offsets);
+		if (isFaces)
+		{
+			ID3D11Buffer* pNoBuffer = nullptr;
+			apContext->IASetVertexBuffers(0, 1, &pNoBuffer, strides, offsets);
+		}
+		else
+		{
+			apContext->IASetVertexBuffers(0, 1, mpVertexBuffer.GetAddressOf(), strides, offsets);
+		}
 		//	VS
-		apContext->VSSetShader(mpVertexShader->GetVertexShader(), nullptr, 0);
-		apContext->VSSetConstantBuffers(0, 1, mpVertexParamBuffer.GetAddressOf());
-		//	PS
-		ID3D11Buffer* pPsConstBufs[2] = { *mppLightBuffer, mpMaterialBuffer.Get() };
+		ID3D11Buffer* pVsConstBufs[2] = { mpVertexParamBuffer.Get(), mpChunkParamBuffer.Get() };
+		apContext->VSSetShader(pVertexShader->GetVertexShader(), nullptr, 0);
+		apContext->VSSetConstantBuffers(0, isChunkRelative ? 2 : 1, pVsConstBufs);
+		if (isFaces)
+		{
+			apContext->VSSetShaderResources(0, 1, mpFaceView.GetAddressOf());
+		}
+		//	PS, the material table covers every material so all chunks go out with the same state
 		apContext->PSSetShader(mpPixelShader->GetPixelShader(), nullptr, 0);
-		apContext->PSSetConstantBuffers(0, 2, pPsConstBufs);
-		//	draw
-		apContext->Draw(mCubeWorldVerticesCount, 0);
+		apContext->PSSetConstantBuffers(0, 1, mppLightBuffer);
+		apContext->PSSetShaderResources(0, 1, mpMaterialView.GetAddressOf());
+		//	draw, every chunk owns a range of the shared vertex buffer
+		for (const auto& chunkMesh : mChunkMeshes)
+		{
+			if (isChunkRelative)
+			{
+				const CubeChunkParams chunkParams{ XMFLOAT4(
+					static_cast<float>(chunkMesh.first.mX << CUBE_CHUNK_SIZE_LOG2) - mOrigin.x,
+					static_cast<float>(chunkMesh.first.mY << CUBE_CHUNK_SIZE_LOG2) - mOrigin.y,
+					static_cast<float>(chunkMesh.first.mZ << CUBE_CHUNK_SIZE_LOG2) - mOrigin.z,
+					0.0f) };
+				apContext->UpdateSubresource(mpChunkParamBuffer.Get(), 0, nullptr, &chunkParams, 0, 0);
+			}
+			//	SV_VertexID starts at the first vertex, so the shader finds the faces of the chunk without an offset
+			apContext->Draw(chunkMesh.second.mVertexCount * verticesPerElement, chunkMesh.second.mFirstVertex * verticesPerElement);
+		}
 	}
 }
@@ -1,16 +1,15 @@
 #pragma once
+#include "voxel/CubeWorld.h"
+#include "voxel/CubeChunkLod.h"
+#include "rendering/BufferRangeAllocator.h"
 
 namespace tde
 {
 	class ICamera;
+	class CubeWorldLighting;
 	class VertexShader;
 	class PixelShader;
 
-	using CubeCell = char;
-
-	constexpr static size_t MAX_CUBE_WORLD_SIZE = 100;
-	constexpr static CubeCell HAS_CUBE = 0X01;
-
 	enum CubeVertexIndex
 	{
 		NX_NY_NZ = 0x0,
@@ -41,43 +40,256 @@ namespace tde
 		BOTTOM_RIGHT	= 0x3 << 6,
 	};
 
-	struct CubeWorld {
-		inline CubeCell& At(const size_t aX, const size_t aY, const size_t aZ);
+	//	the size of the box a vertex belongs to, stored as size - 1 so unit cubes are all zero
+	constexpr static UINT32 CUBE_VERTEX_EXTENT_SHIFT = 8;
+	constexpr static UINT32 CUBE_VERTEX_EXTENT_BITS = 5;
+	constexpr static UINT32 CUBE_VERTEX_MAX_EXTENT = 1 << CUBE_VERTEX_EXTENT_BITS;
+
+	inline UINT32 packCubeVertexExtent(const UINT32 aSizeX, const UINT32 aSizeY, const UINT32 aSizeZ)
+	{
+		return ((aSizeX - 1) << CUBE_VERTEX_EXTENT_SHIFT) |
+			((aSizeY - 1) << (CUBE_VERTEX_EXTENT_SHIFT + CUBE_VERTEX_EXTENT_BITS)) |
+			((aSizeZ - 1) << (CUBE_VERTEX_EXTENT_SHIFT + CUBE_VERTEX_EXTENT_BITS * 2));
+	}
+
+	//	the shading baked into a vertex, 2 bits of ambient occlusion, 3 where nothing occludes the corner,
+	//	and the 4 bit light level of the cells in front of it, see CubeWorldLighting
+	constexpr static UINT32 CUBE_VERTEX_SHADING_SHIFT = 23;
+	constexpr static UINT32 CUBE_VERTEX_MAX_OCCLUSION = 3;
 
-		std::vector<CubeCell> mWorld;
+	inline UINT32 packCubeVertexShading(const UINT32 aOcclusion, const UINT32 aLight)
+	{
+		return (aOcclusion | (aLight << 2)) << CUBE_VERTEX_SHADING_SHIFT;
+	}
 
-		//	left - right +
-		size_t mSizeX = 8;
-		//	bottom - top +
-		size_t mSizeY = 8;
-		//	back - front +
-		size_t mSizeZ = 8;
+	enum class CubeMeshingMode
+	{
+		PER_FACE,	//	two triangles for every exposed face
+		GREEDY,		//	coplanar neighbouring faces of the same cell type are merged into larger quads
 	};
 
-	std::shared_ptr<CubeWorld> createCubeWorldFromBinaryFile(LPCSTR aFilename, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ);
+	enum class CubeVertexFormat
+	{
+		FULL,		//	CubeWorldRenderer::CubeVertex, the box center in floats and the packed corner, 20 bytes
+		COMPACT,	//	CubeCompactVertex, the corner in cells relative to its chunk, 8 bytes
+		FACES,		//	CubeFace, no vertices at all, the vertex shader expands every face from SV_VertexID, 8 bytes per face
+	};
+
+	//	everything a compact vertex holds, unpacked, the coordinates are relative to the first cell of the chunk
+	struct CubeVertexCorner
+	{
+		int32_t mX = 0;
+		int32_t mY = 0;
+		int32_t mZ = 0;
+		UINT32 mFacing = 0;		//	CubeVertexFacing >> 3
+		UINT32 mTexCoord = 0;	//	CubeTexCoord >> 6
+		UINT32 mMaterial = 0;
+		UINT32 mOcclusion = 0;
+		UINT32 mLight = 0;
+	};
+
+	//	the chunk is drawn with its first cell in a constant buffer, so the corners fit into a few bits
+	constexpr static UINT32 CUBE_COMPACT_VERTEX_COORD_BITS = 6;
+	static_assert(CUBE_CHUNK_SIZE < (1 << CUBE_COMPACT_VERTEX_COORD_BITS), "the far corners of a chunk must fit into a compact vertex");
+
+	struct CubeCompactVertex
+	{
+		//	from LSB
+		//	3 x 6 bits		x, y and z of the corner, 0 to CUBE_CHUNK_SIZE
+		//	3 bits			facing
+		//	2 bits			tex coord
+		//	7 bits			material
+		UINT32 mCorner;
+		//	2 + 4 bits		ambient occlusion and light level, in the same order as packCubeVertexShading
+		UINT32 mShading;
+	};
+
+	//	inline like the other packing helpers, so the tests don't need a device
+	inline CubeCompactVertex packCubeCompactVertex(const CubeVertexCorner& aCorner)
+	{
+		CubeCompactVertex vertex;
+		vertex.mCorner = static_cast<UINT32>(aCorner.mX) |
+			(static_cast<UINT32>(aCorner.mY) << CUBE_COMPACT_VERTEX_COORD_BITS) |
+			(static_cast<UINT32>(aCorner.mZ) << (CUBE_COMPACT_VERTEX_COORD_BITS * 2)) |
+			(aCorner.mFacing << 18) |
+			(aCorner.mTexCoord << 21) |
+			(aCorner.mMaterial << 23);
+		vertex.mShading = aCorner.mOcclusion | (aCorner.mLight << 2);
+		return vertex;
+	}
+
+	inline CubeVertexCorner unpackCubeCompactVertex(const CubeCompactVertex& aVertex)
+	{
+		constexpr UINT32 coordMask = (1 << CUBE_COMPACT_VERTEX_COORD_BITS) - 1;
+		CubeVertexCorner corner;
+		corner.mX = static_cast<int32_t>(aVertex.mCorner & coordMask);
+		corner.mY = static_cast<int32_t>((aVertex.mCorner >> CUBE_COMPACT_VERTEX_COORD_BITS) & coordMask);
+		corner.mZ = static_cast<int32_t>((aVertex.mCorner >> (CUBE_COMPACT_VERTEX_COORD_BITS * 2)) & coordMask);
+		corner.mFacing = (aVertex.mCorner >> 18) & 0x7;
+		corner.mTexCoord = (aVertex.mCorner >> 21) & 0x3;
+		corner.mMaterial = (aVertex.mCorner >> 23) & (CUBE_MATERIAL_COUNT - 1);
+		corner.mOcclusion = aVertex.mShading & 0x3;
+		corner.mLight = (aVertex.mShading >> 2) & 0xF;
+		return corner;
+	}
+
+	//	the meshers put out faces, a merged quad is one face
+	constexpr static UINT32 CUBE_FACE_MAX_SIZE = 32;
+	static_assert(CUBE_CHUNK_SIZE <= CUBE_FACE_MAX_SIZE, "a face must be able to span a whole chunk");
+
+	struct CubeFace
+	{
+		//	from LSB
+		//	3 x 6 bits		x, y and z of the corner with the smallest coordinates, relative to the chunk
+		//	3 bits			facing
+		//	2 x 5 bits		size - 1 along u and v, u is the axis after the normal and v the one after u
+		UINT32 mFace;
+		//	4 x 6 bits		the shading of the corners, corner (u, v) in the 6 bits from 6 * (u + 2 * v) on,
+		//					each like packCubeVertexShading
+		//	7 bits			material
+		UINT32 mShading;
+	};
+
+	//	the two triangles of every face, in CubeVertexFacing order, BoxFacesVS has a copy as numbers
+	constexpr static UINT32 CUBE_FACE_VERTICES[6][6] =
+	{
+		//	-x
+		{
+			CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NX | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::NX | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NX | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NX | CubeTexCoord::TOP_RIGHT,
+		},
+		//	-y
+		{
+			CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::NY | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NY | CubeTexCoord::TOP_RIGHT,
+		},
+		//	-z
+		{
+			CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::NZ | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::NZ | CubeTexCoord::TOP_RIGHT,
+		},
+		//	+x
+		{
+			CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PX | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::PX | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_NY_NZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PX | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PX | CubeTexCoord::TOP_RIGHT,
+		},
+		//	+y
+		{
+			CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_PY_NZ | CubeVertexFacing::PY | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PY | CubeTexCoord::TOP_RIGHT,
+		},
+		//	+z
+		{
+			CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_RIGHT,
+			CubeVertexIndex::PX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_LEFT,
+			CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::PX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_LEFT,
+			CubeVertexIndex::NX_NY_PZ | CubeVertexFacing::PZ | CubeTexCoord::BOTTOM_RIGHT,
+			CubeVertexIndex::NX_PY_PZ | CubeVertexFacing::PZ | CubeTexCoord::TOP_RIGHT,
+		},
+	};
+
+	//	the corner of the face a vertex is on, corner (u, v) is u + 2 * v like in CubeFace::mShading
+	inline int32_t getCubeFaceCorner(const UINT32 aVertex, const int32_t aUAxis, const int32_t aVAxis)
+	{
+		//	CubeVertexIndex has +x in bit 2, +y in bit 1 and +z in bit 0
+		return static_cast<int32_t>(((aVertex >> (2 - aUAxis)) & 1) | (((aVertex >> (2 - aVAxis)) & 1) << 1));
+	}
+
+	//	aCorner is relative to the chunk, the sizes are in cells
+	inline CubeFace packCubeFace(const int32_t aCorner[3], const UINT32 aFacing, const UINT32 aUSize, const UINT32 aVSize,
+		const UINT32 aFaceShading, const UINT32 aMaterial)
+	{
+		CubeFace face;
+		face.mFace = static_cast<UINT32>(aCorner[0]) |
+			(static_cast<UINT32>(aCorner[1]) << 6) |
+			(static_cast<UINT32>(aCorner[2]) << 12) |
+			(aFacing << 18) |
+			((aUSize - 1) << 21) |
+			((aVSize - 1) << 26);
+		face.mShading = aFaceShading | (aMaterial << 24);
+		return face;
+	}
+
+	//	the reference for the expansion in BoxFacesVS, the corners of the two triangles of the face in SV_VertexID order
+	inline void expandCubeFace(const CubeFace& aFace, CubeVertexCorner* apOutCorners)
+	{
+		const UINT32 facing = (aFace.mFace >> 18) & 0x7;
+		const int32_t normalAxis = static_cast<int32_t>(facing % 3);
+		const int32_t uAxis = (normalAxis + 1) % 3;
+		const int32_t vAxis = (normalAxis + 2) % 3;
+		const int32_t corner[3] = {
+			static_cast<int32_t>(aFace.mFace & 0x3F),
+			static_cast<int32_t>((aFace.mFace >> 6) & 0x3F),
+			static_cast<int32_t>((aFace.mFace >> 12) & 0x3F) };
+		const int32_t uSize = static_cast<int32_t>((aFace.mFace >> 21) & 0x1F) + 1;
+		const int32_t vSize = static_cast<int32_t>((aFace.mFace >> 26) & 0x1F) + 1;
+
+		//	the same triangles as the full vertices
+		for (size_t i = 0; i < 6; i++)
+		{
+			const UINT32 vertex = CUBE_FACE_VERTICES[facing][i];
+			const int32_t faceCorner = getCubeFaceCorner(vertex, uAxis, vAxis);
+			int32_t position[3] = { corner[0], corner[1], corner[2] };
+			position[uAxis] += (faceCorner & 1) ? uSize : 0;
+			position[vAxis] += (faceCorner & 2) ? vSize : 0;
+			const UINT32 cornerShading = (aFace.mShading >> (faceCorner * 6)) & 0x3F;
+
+			CubeVertexCorner& outCorner = apOutCorners[i];
+			outCorner.mX = position[0];
+			outCorner.mY = position[1];
+			outCorner.mZ = position[2];
+			outCorner.mFacing = facing;
+			outCorner.mTexCoord = (vertex >> 6) & 0x3;
+			outCorner.mMaterial = aFace.mShading >> 24;
+			outCorner.mOcclusion = cornerShading & 0x3;
+			outCorner.mLight = cornerShading >> 2;
+		}
+	}
 
 	class CubeWorldRenderer
 	{
 	public:
 
-		struct alignas(16) Material
+		//	an entry of the material table, which is a structured buffer indexed by the material of the cells,
+		//	the layout has to match CubeMaterial in BoxPS
+		struct Material
 		{
-			DirectX::XMVECTOR mAmbientColor;
-			DirectX::XMVECTOR mDiffuseColor;
-			DirectX::XMVECTOR mSpecularColor;
-			DirectX::XMVECTOR mEmissiveColor;
+			DirectX::XMFLOAT4 mAmbientColor;
+			DirectX::XMFLOAT4 mDiffuseColor;
+			DirectX::XMFLOAT4 mSpecularColor;
+			DirectX::XMFLOAT4 mEmissiveColor;
 			float mAmbientCoef;
 			float mDiffuseCoef;
 			float mSpecularCoef;
 			float mEmissiveCoef;
 			int mSpecularPower;
-			int mUseTexture;
-			int mPadding[2];
+			int mPadding[3];
 		};
 
 		struct CubeVertex 
 		{
-			//	the center position of the cube
+			//	the center position of the cube, or of the merged box in greedy meshing
 			DirectX::XMFLOAT3 mCenterPosition;
 			
 			//	from LSB
@@ -108,7 +320,17 @@ namespace tde
 			//	1: top right	(0,1)
 			//	2: bottom left	(1,0)
 			//	3: bottom right (1,1)
+			//	-----------
+			//	3 x 5 bits
+			//	0b000.*****|*****|*****00000000
+			//	size - 1 of the box on x, y and z, see packCubeVertexExtent
+			//	-----------
+			//	2 + 4 bits
+			//	0b000****|**00000000000000000000000
+			//	ambient occlusion and light level, see packCubeVertexShading
 			UINT32 mVertex;
+			//	the material of the cell the face belongs to, see getCubeMaterial, the same for all vertices of a face
+			UINT32 mMaterial;
 		};
 		
 		struct alignas(16) CubeParams {
@@ -118,34 +340,160 @@ namespace tde
 			//DirectX::XMVECTOR mWorldCenterAndScale;
 		};
 
+		//	for compact vertices and faces, the first cell of the chunk being drawn relative to the center of the world
+		struct alignas(16) CubeChunkParams {
+			DirectX::XMFLOAT4 mChunkOrigin;
+		};
+
 		CubeWorldRenderer(ID3D11Device* apDevice, 
 			std::shared_ptr<CubeWorld> apCubeWorld, 
 			std::shared_ptr<ICamera> apCamera,
 			ID3D11Buffer** appLightBuffer);
 
+		//	remeshes the whole world and recenters it on its bounds
 		void UpdateBuffer(ID3D11Device* apDevice);
+		//	remeshes only the chunks the world marked dirty and patches their ranges of the vertex buffer,
+		//	the world keeps the center it got in the last UpdateBuffer so unchanged chunks stay valid
+		void UpdateDirtyChunks(ID3D11Device* apDevice);
 		void SetPosition(DirectX::SimpleMath::Vector4 centerPosition);
 		void SetScale(const float aScale);
+		//	the light the vertices are shaded with, without it every cell is fully lit,
+		//	takes effect for the chunks meshed from then on
+		void SetLighting(std::shared_ptr<const CubeWorldLighting> apLighting);
+		//	uploads the material table, materials past the end of aMaterials look like the first one,
+		//	the whole world is still drawn with one shader and one table no matter how many materials it uses
+		void SetMaterials(ID3D11Device* apDevice, const std::vector<Material>& aMaterials);
+		//	takes effect with the next UpdateBuffer
+		void SetMeshingMode(const CubeMeshingMode aMeshingMode);
+		//	takes effect with the next UpdateBuffer, compact vertices take 2 / 5 of the memory and upload bandwidth
+		//	and faces a sixth of that, but with both every chunk is drawn with its own constant buffer update
+		void SetVertexFormat(const CubeVertexFormat aVertexFormat);
+		//	distant chunks are drawn from downsampled cells, levels change once the distance in chunks from the focus
+		//	passes these thresholds, for level 1, 2 and 3
+		void SetLodDistances(const float aLod1Distance, const float aLod2Distance, const float aLod3Distance);
+		//	picks the level of detail of every chunk around aFocusCell and marks the chunks which change level dirty,
+		//	together with their neighbours whose borders depend on it
+		void UpdateLods(const DirectX::XMFLOAT3& aFocusCell);
+		//	the cell coordinates which are rendered at aWorldPosition, e.g. to stream the world around the camera
+		DirectX::XMFLOAT3 XM_CALLCONV GetCellPosition(DirectX::FXMVECTOR aWorldPosition);
+		//	the other way around, e.g. to put back what was moved through the cubes
+		DirectX::XMVECTOR GetWorldPosition(const DirectX::XMFLOAT3& aCellPosition);
 
 		void Render(ID3D11DeviceContext* apContext, const float aDeltaTime);
 	private:
 
+		//	the range of the vertex buffer a chunk owns, the capacity leaves room for the chunk to grow a little
+		struct ChunkMesh
+		{
+			UINT mFirstVertex;
+			UINT mVertexCount;
+			UINT mCapacity;
+		};
+
+		constexpr static size_t MIN_VERTEX_BUFFER_CAPACITY = 64 * 1024;
+		//	chunks near a threshold keep their level until they are this many chunks past it, so they don't flicker
+		constexpr static float LOD_HYSTERESIS = 0.5f;
+
 		DirectX::XMMATRIX GetWorldMatrix();
+		//	meshes the chunks on the workers with the current meshing mode into the format of the vertex buffer,
+		//	chunks which don't exist produce no vertices, with CubeVertexFormat::FACES an element of the buffer is a face
+		void PrivMeshChunks(const std::vector<CubeCoord>& aChunkCoords, std::vector<std::vector<uint8_t>>& aOutVertexData) const;
+		inline UINT PrivGetVertexStride() const
+		{
+			switch (mBufferVertexFormat)
+			{
+			case CubeVertexFormat::COMPACT:
+				return sizeof(CubeCompactVertex);
+			case CubeVertexFormat::FACES:
+				return sizeof(CubeFace);
+			default:
+				return sizeof(CubeVertex);
+			}
+		}
+		int32_t PrivGetChunkLod(const CubeCoord& aChunkCoord) const;
+		//	a bit for every face whose neighbour is drawn at another level, faces along those borders are kept
+		//	so both sides close the gap between the two surfaces
+		uint32_t PrivGetOpenBorders(const CubeCoord& aChunkCoord, const int32_t aLod) const;
+		//	the buffer which holds the vertices or faces, a structured buffer with a view for faces
+		void PrivCreateVertexBuffer(ID3D11Device* apDevice, const size_t aCapacity, const void* apInitialData,
+			Microsoft::WRL::ComPtr<ID3D11Buffer>& aOutBuffer, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& aOutView) const;
+		//	recreates the vertex buffer with room for at least aMinCapacity vertices and copies the old contents over
+		void PrivGrowVertexBuffer(ID3D11Device* apDevice, ID3D11DeviceContext* apContext, const size_t aMinCapacity);
+		//	appends the faces of the chunk which aren't covered by a neighbouring cube
+		static void PrivMeshChunk(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk,
+			const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces);
+		//	same faces, merged into as few quads as possible, quads don't cross chunk borders,
+		//	faces are only merged if they are shaded the same at every corner
+		static void PrivMeshChunkGreedy(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk,
+			const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces);
+		//	greedy meshing of the downsampled chunk, every merged cell becomes a cube 2^aLod cells wide,
+		//	the faces aren't occluded and take the light of the cell in front of their middle
+		static void PrivMeshChunkLod(const CubeWorld& aCubeWorld, const CubeWorldLighting* apLighting, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, const int32_t aLod,
+			const uint32_t aOpenBorders, std::vector<CubeFace>& aOutFaces);
 
 		std::shared_ptr<ICamera> mpCamera;
 		std::shared_ptr<CubeWorld> mpCubeWorld;
-		size_t mCubeWorldVerticesCount = 0;
+		std::shared_ptr<const CubeWorldLighting> mpLighting;
+		std::unordered_map<CubeCoord, ChunkMesh, CubeCoordHash> mChunkMeshes;
+		std::unordered_map<CubeCoord, int32_t, CubeCoordHash> mChunkLods;	//	chunks which aren't in here are drawn at full detail
+		float mLodDistances[CUBE_CHUNK_LOD_COUNT - 1] = { 4.0f, 8.0f, 16.0f };
+		BufferRangeAllocator mVertexRanges;
+		DirectX::XMFLOAT3 mOrigin{ 0.0f, 0.0f, 0.0f };	//	the cell position which is placed at the center of the cube world
 		
 		std::shared_ptr<VertexShader> mpVertexShader;
+		std::shared_ptr<VertexShader> mpCompactVertexShader;
+		std::shared_ptr<VertexShader> mpFacesVertexShader;
 		std::shared_ptr<PixelShader> mpPixelShader;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> mpVertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mpFaceView;	//	only with CubeVertexFormat::FACES
 		Microsoft::WRL::ComPtr<ID3D11Buffer> mpVertexParamBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> mpChunkParamBuffer;
 		Microsoft::WRL::ComPtr<ID3D11Buffer> mpMaterialBuffer;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mpMaterialView;
 		ID3D11Buffer** mppLightBuffer;
 		
 		DirectX::SimpleMath::Matrix mWorldMatrix;
 		DirectX::SimpleMath::Vector4 mPosition{ 0.0f, 0.0f, 0.0f, 1.0f };	//	the center point of the cube world
 		float mScale = 1.0f;	//	the size of one cube
+		CubeMeshingMode mMeshingMode = CubeMeshingMode::GREEDY;
+		CubeVertexFormat mVertexFormat = CubeVertexFormat::FULL;
+		CubeVertexFormat mBufferVertexFormat = CubeVertexFormat::FULL;	//	the format of the vertices in the buffer right now
 		bool mTransformDirty = true;
 	};
+
+	//	the full vertices of a face, which becomes the face of a box one cell thick behind it
+	inline void expandCubeFaceVertices(const CubeFace& aFace, const CubeCoord& aChunkCoord, const DirectX::XMFLOAT3& aOrigin,
+		CubeWorldRenderer::CubeVertex* apOutVertices)
+	{
+		static_assert(CUBE_FACE_MAX_SIZE <= CUBE_VERTEX_MAX_EXTENT, "the vertex extent must be able to span a whole face");
+
+		const UINT32 facing = (aFace.mFace >> 18) & 0x7;
+		const int32_t normalAxis = static_cast<int32_t>(facing % 3);
+		const int32_t uAxis = (normalAxis + 1) % 3;
+		const int32_t vAxis = (normalAxis + 2) % 3;
+		const UINT32 material = aFace.mShading >> 24;
+		const float origin[3] = { aOrigin.x, aOrigin.y, aOrigin.z };
+		const int32_t corner[3] = {
+			(aChunkCoord.mX << CUBE_CHUNK_SIZE_LOG2) + static_cast<int32_t>(aFace.mFace & 0x3F),
+			(aChunkCoord.mY << CUBE_CHUNK_SIZE_LOG2) + static_cast<int32_t>((aFace.mFace >> 6) & 0x3F),
+			(aChunkCoord.mZ << CUBE_CHUNK_SIZE_LOG2) + static_cast<int32_t>((aFace.mFace >> 12) & 0x3F) };
+
+		float boxCenter[3];
+		UINT32 boxSize[3];
+		boxCenter[normalAxis] = static_cast<float>(corner[normalAxis]) + (facing < 3 ? 0.5f : -0.5f) - origin[normalAxis];
+		boxSize[normalAxis] = 1;
+		boxSize[uAxis] = ((aFace.mFace >> 21) & 0x1F) + 1;
+		boxCenter[uAxis] = static_cast<float>(corner[uAxis]) + static_cast<float>(boxSize[uAxis]) * 0.5f - origin[uAxis];
+		boxSize[vAxis] = ((aFace.mFace >> 26) & 0x1F) + 1;
+		boxCenter[vAxis] = static_cast<float>(corner[vAxis]) + static_cast<float>(boxSize[vAxis]) * 0.5f - origin[vAxis];
+
+		const DirectX::XMFLOAT3 center{ boxCenter[0], boxCenter[1], boxCenter[2] };
+		const UINT32 extent = packCubeVertexExtent(boxSize[0], boxSize[1], boxSize[2]);
+		for (size_t i = 0; i < 6; i++)
+		{
+			const UINT32 vertex = CUBE_FACE_VERTICES[facing][i];
+			const UINT32 shading = ((aFace.mShading >> (getCubeFaceCorner(vertex, uAxis, vAxis) * 6)) & 0x3F) << CUBE_VERTEX_SHADING_SHIFT;
+			apOutVertices[i] = { center, vertex | extent | shading, material };
+		}
+	}
 }
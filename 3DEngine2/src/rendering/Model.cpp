@@ -2,9 +2,14 @@
 #include "rendering/Model.h"
 #include "rendering/VertexShader.h"
 #include "rendering/PixelShader.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
 
 namespace tde
 {
+	//	transforming a single vertex is cheap, don't split the meshes too finely
+	constexpr static size_t VERTEX_TRANSFORM_GRAIN_SIZE = 4096;
+
 	Model::Model(ConstructorTag tag)
 	{
 	}
@@ -140,7 +145,8 @@ namespace tde
 			Mesh mesh;
 			aiMesh* importedMesh = apScene->mMeshes[apNode->mMeshes[i]];
 			mesh.mVertices = std::vector<Mesh::MeshVertex>(importedMesh->mNumVertices);
-			for (int j = 0; j < importedMesh->mNumVertices; j++)
+			//	the vertices are transformed independently, spread them over the workers
+			parallelFor(WorkDispatcherLocator::Get().get(), 0, importedMesh->mNumVertices, [&](const size_t j)
 			{
 				auto transformedVertex = importedMesh->mVertices[j];
 				auto transformedNormal = importedMesh->mNormals[j];
@@ -157,7 +163,7 @@ namespace tde
 					mesh.mVertices[j].mTexCoord.x = importedMesh->mTextureCoords[0][j].x;
 					mesh.mVertices[j].mTexCoord.y = importedMesh->mTextureCoords[0][j].y;
 				}
-			}
+			}, VERTEX_TRANSFORM_GRAIN_SIZE);
 			for (int j = 0; j < importedMesh->mNumFaces; j++)
 			{
 				aiFace& face = importedMesh->mFaces[j];
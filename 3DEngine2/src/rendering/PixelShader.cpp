@@ -15,6 +15,15 @@ namespace tde
 		pPixelShaderBlob.Reset();
 	}
 
+	PixelShader::PixelShader(const void* apByteCode, SIZE_T aByteCodeSize, ID3D11Device* apDevice)
+	{
+		apDevice->CreatePixelShader(
+			apByteCode,
+			aByteCodeSize,
+			nullptr,
+			mpPixelShader.ReleaseAndGetAddressOf());
+	}
+
 	PixelShader::PixelShader(PixelShader&& aOther) noexcept
 	{
 		mpPixelShader = std::move(aOther.mpPixelShader);
@@ -8,6 +8,8 @@ namespace tde
 	{
 	public:
 		PixelShader(LPCWSTR aPsPath, ID3D11Device* apDevice);
+		//	for byte code which has already been read, e.g. by readFileAsync
+		PixelShader(const void* apByteCode, SIZE_T aByteCodeSize, ID3D11Device* apDevice);
 		PixelShader(PixelShader&& aOther) noexcept;
 		PixelShader& operator=(PixelShader&& aOther) noexcept;
 		PixelShader(const PixelShader& aOther) = delete;
@@ -7,17 +7,33 @@ namespace tde
 	{
 		Microsoft::WRL::ComPtr<ID3DBlob> pVertexShaderBlob;
 		D3DReadFileToBlob(aVsPath, pVertexShaderBlob.ReleaseAndGetAddressOf());
+		PrivCreate(pVertexShaderBlob->GetBufferPointer(), pVertexShaderBlob->GetBufferSize(), apLayout, aLayoutElementCount, apDevice);
+
+		SAFE_RELEASE(pVertexShaderBlob);
+	}
+
+	VertexShader::VertexShader(const void* apByteCode, SIZE_T aByteCodeSize, const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice)
+	{
+		PrivCreate(apByteCode, aByteCodeSize, apLayout, aLayoutElementCount, apDevice);
+	}
+
+	void VertexShader::PrivCreate(const void* apByteCode, SIZE_T aByteCodeSize, const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice)
+	{
 		apDevice->CreateVertexShader(
-			pVertexShaderBlob->GetBufferPointer(), 
-			pVertexShaderBlob->GetBufferSize(), 
-			nullptr, 
+			apByteCode,
+			aByteCodeSize,
+			nullptr,
 			mpVertexShader.ReleaseAndGetAddressOf());
 
+		//	shaders which pull their vertices from buffers don't have an input layout
+		if (aLayoutElementCount == 0)
+		{
+			mpInputLayout.Reset();
+			return;
+		}
 		apDevice->CreateInputLayout(apLayout, aLayoutElementCount,
-			pVertexShaderBlob->GetBufferPointer(), pVertexShaderBlob->GetBufferSize(),
+			apByteCode, aByteCodeSize,
 			mpInputLayout.ReleaseAndGetAddressOf());
-
-		SAFE_RELEASE(pVertexShaderBlob);
 	}
 
 	VertexShader::VertexShader(VertexShader&& aOther) noexcept
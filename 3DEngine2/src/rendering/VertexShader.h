@@ -8,6 +8,8 @@ namespace tde
 	{
 	public:
 		VertexShader(LPCWSTR aVsPath, const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice);
+		//	for byte code which has already been read, e.g. by readFileAsync
+		VertexShader(const void* apByteCode, SIZE_T aByteCodeSize, const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice);
 		VertexShader(VertexShader&& aOther) noexcept;
 		VertexShader& operator=(VertexShader&& aOther) noexcept;
 		VertexShader(const VertexShader& aOther) = delete;
@@ -18,6 +20,8 @@ namespace tde
 		void SetInputLayout(ID3D11DeviceContext* apContext) const;
 
 	private:
+		void PrivCreate(const void* apByteCode, SIZE_T aByteCodeSize, const D3D11_INPUT_ELEMENT_DESC* apLayout, UINT aLayoutElementCount, ID3D11Device* apDevice);
+
 		Microsoft::WRL::ComPtr<ID3D11VertexShader> mpVertexShader;
 		Microsoft::WRL::ComPtr<ID3D11InputLayout> mpInputLayout;
 	};
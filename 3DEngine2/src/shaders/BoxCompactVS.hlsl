@@ -0,0 +1,70 @@
+cbuffer BoxData: register(b0)
+{
+	matrix worldMatrix;
+	matrix viewProjectionMatrix;
+	matrix inversedTransposedWorldMatrix;
+};
+
+cbuffer ChunkData: register(b1)
+{
+	float4 chunkOrigin;	//	the first cell of the chunk relative to the center of the world
+};
+
+struct VertexData
+{
+	uint corner					: TEXCOORD0;	//	position, facing, tex coord and material
+	uint shading				: TEXCOORD1;	//	ambient occlusion and light level
+};
+
+struct PixelData
+{
+	float4 position				: SV_POSITION;
+	float3 worldPosition		: POSWORLD;
+	float3 normal				: NORMAL;
+	float2 texCoord				: TEXCOORD;
+	float2 shading				: SHADING;	//	ambient occlusion and sky light
+	nointerpolation uint material	: MATERIAL;
+};
+
+const static float3 normals[6] = {
+	{ -1.0f,  0.0f,  0.0f },
+	{  0.0f, -1.0f,  0.0f },
+	{  0.0f,  0.0f, -1.0f },
+	{  1.0f,  0.0f,  0.0f },
+	{  0.0f,  1.0f,  0.0f },
+	{  0.0f,  0.0f,  1.0f },
+};
+
+const static float2 texCoords[4] = {
+	{ 0.0f, 0.0f },
+	{ 0.0f, 1.0f },
+	{ 1.0f, 0.0f },
+	{ 1.0f, 1.0f },
+};
+
+PixelData main(VertexData input)
+{
+	PixelData output;
+
+	matrix worldViewProjection = mul(viewProjectionMatrix, worldMatrix);
+
+	//	the same vertex as BoxVS, with the corner in cells relative to the chunk instead of a box around a center
+	float3 cornerPosition = float3(input.corner & 0x3F, (input.corner >> 6) & 0x3F, (input.corner >> 12) & 0x3F);
+	uint vertexNormalIdx = (input.corner >> 18) & 0x7;
+	uint vertexTexIdx = (input.corner >> 21) & 0x3;
+	uint occlusion = input.shading & 0x3;
+	uint light = (input.shading >> 2) & 0xF;
+
+	float4 vertexPos = float4(chunkOrigin.xyz + cornerPosition, 1.0f);
+	float3 normal = normals[vertexNormalIdx];
+	float2 texCoord = texCoords[vertexTexIdx];
+
+	output.position = mul(worldViewProjection, vertexPos);
+	output.worldPosition = mul(worldMatrix, vertexPos).xyz;
+	output.normal = normalize(mul(inversedTransposedWorldMatrix, float4(normal, 0.0f)).xyz);
+	output.texCoord = texCoord;
+	output.shading = float2(0.4f + 0.2f * occlusion, pow(0.8f, 15.0f - light));
+	output.material = (input.corner >> 23) & 0x7F;
+
+	return output;
+}
@@ -0,0 +1,90 @@
+cbuffer BoxData: register(b0)
+{
+	matrix worldMatrix;
+	matrix viewProjectionMatrix;
+	matrix inversedTransposedWorldMatrix;
+};
+
+cbuffer ChunkData: register(b1)
+{
+	float4 chunkOrigin;	//	the first cell of the chunk relative to the center of the world
+};
+
+//	one CubeFace per face, x: corner, facing and size, y: shading of the 4 corners and material
+StructuredBuffer<uint2> faces : register(t0);
+
+struct PixelData
+{
+	float4 position				: SV_POSITION;
+	float3 worldPosition		: POSWORLD;
+	float3 normal				: NORMAL;
+	float2 texCoord				: TEXCOORD;
+	float2 shading				: SHADING;	//	ambient occlusion and sky light
+	nointerpolation uint material	: MATERIAL;
+};
+
+//	a copy of CUBE_FACE_VERTICES in CubeWorldRenderer.h, vertex index | facing << 3 | tex coord << 6, CubeFaceVerticesMatchBoxFacesVS checks it
+const static uint faceVertices[6][6] = {
+	{ 66, 3, 129, 129, 192, 66 },
+	{ 76, 8, 137, 137, 205, 76 },
+	{ 86, 18, 144, 144, 212, 86 },
+	{ 95, 30, 156, 156, 221, 95 },
+	{ 103, 35, 162, 162, 230, 103 },
+	{ 107, 47, 173, 173, 233, 107 },
+};
+
+const static float3 normals[6] = {
+	{ -1.0f,  0.0f,  0.0f },
+	{  0.0f, -1.0f,  0.0f },
+	{  0.0f,  0.0f, -1.0f },
+	{  1.0f,  0.0f,  0.0f },
+	{  0.0f,  1.0f,  0.0f },
+	{  0.0f,  0.0f,  1.0f },
+};
+
+const static float2 texCoords[4] = {
+	{ 0.0f, 0.0f },
+	{ 0.0f, 1.0f },
+	{ 1.0f, 0.0f },
+	{ 1.0f, 1.0f },
+};
+
+//	drawn without a vertex buffer, every 6 vertices are the two triangles of a face
+PixelData main(uint vertexId : SV_VertexID)
+{
+	PixelData output;
+
+	matrix worldViewProjection = mul(viewProjectionMatrix, worldMatrix);
+
+	uint2 face = faces[vertexId / 6];
+	uint facing = (face.x >> 18) & 0x7;
+	uint vertex = faceVertices[facing][vertexId % 6];
+	uint normalAxis = facing % 3;
+	uint uAxis = (normalAxis + 1) % 3;
+	uint vAxis = (normalAxis + 2) % 3;
+
+	//	the same corner as expandCubeFace, the vertex index has +x in bit 2, +y in bit 1 and +z in bit 0
+	uint faceCorner = ((vertex >> (2 - uAxis)) & 1) | (((vertex >> (2 - vAxis)) & 1) << 1);
+	float3 cornerPosition = float3(face.x & 0x3F, (face.x >> 6) & 0x3F, (face.x >> 12) & 0x3F);
+	float3 uDirection = float3(uAxis == 0, uAxis == 1, uAxis == 2);
+	float3 vDirection = float3(vAxis == 0, vAxis == 1, vAxis == 2);
+	cornerPosition += uDirection * ((faceCorner & 1) * (((face.x >> 21) & 0x1F) + 1));
+	cornerPosition += vDirection * ((faceCorner >> 1) * (((face.x >> 26) & 0x1F) + 1));
+
+	uint cornerShading = (face.y >> (faceCorner * 6)) & 0x3F;
+	uint occlusion = cornerShading & 0x3;
+	uint light = cornerShading >> 2;
+
+	float4 vertexPos = float4(chunkOrigin.xyz + cornerPosition, 1.0f);
+	float3 normal = normals[facing];
+	float2 texCoord = texCoords[(vertex >> 6) & 0x3];
+
+	output.position = mul(worldViewProjection, vertexPos);
+	output.worldPosition = mul(worldMatrix, vertexPos).xyz;
+	output.normal = normalize(mul(inversedTransposedWorldMatrix, float4(normal, 0.0f)).xyz);
+	output.texCoord = texCoord;
+	output.shading = float2(0.4f + 0.2f * occlusion, pow(0.8f, 15.0f - light));
+	output.material = face.y >> 24;
+
+	return output;
+}
@@ -23,7 +23,8 @@ cbuffer Lights : register (b0)
     LightSource lights[MAX_LIGHTS];
 }
 
-cbuffer Material : register (b1)
+//  has to match CubeWorldRenderer::Material
+struct CubeMaterial
 {
     float4 ambientColor;
     float4 diffuseColor;
@@ -34,9 +35,11 @@ cbuffer Material : register (b1)
     float specularCoef;
     float emissiveCoef;
     int specularPower;
-    bool useTexture;
-    int2 padding;
-}
+    int3 padding;
+};
+
+//  one entry for every material a cell can have
+StructuredBuffer<CubeMaterial> materials : register (t0);
 
 struct PixelData
 {
@@ -44,6 +47,8 @@ struct PixelData
     float3 worldPosition    : POSWORLD;
     float3 normal           : NORMAL;
     float2 texCoord         : TEXCOORD;
+    float2 shading          : SHADING;
+    nointerpolation uint material : MATERIAL;
 };
 
 struct LightResult
@@ -64,7 +69,7 @@ float4 computeLightSpecular(float4 lightCol, float3 lightDir, float3 viewDir, fl
     return lightCol * max(pow(dot(normal, halfWayVector), specPow), 0);
 }
 
-LightResult computeDirectionalLighting(LightSource light, float3 viewDir, float3 normal)
+LightResult computeDirectionalLighting(LightSource light, float3 viewDir, float3 normal, int specularPower)
 {
     LightResult result;
     float3 lightDir = -normalize(light.direction.xyz);
@@ -75,7 +80,7 @@ LightResult computeDirectionalLighting(LightSource light, float3 viewDir, float3
     return result;
 }
 
-LightResult computePointLighting(LightSource light, float3 viewDir, float3 normal, float3 position)
+LightResult computePointLighting(LightSource light, float3 viewDir, float3 normal, float3 position, int specularPower)
 {
     LightResult result;
     float3 lightDir = light.position.xyz - position;
@@ -92,6 +97,7 @@ LightResult computePointLighting(LightSource light, float3 viewDir, float3 norma
 
 float4 main(PixelData input) : SV_TARGET
 {
+    CubeMaterial material = materials[input.material];
     LightResult totalResult = {{0, 0, 0, 0}, {0, 0, 0, 0}};
     LightResult partResult;
 
@@ -108,12 +114,12 @@ float4 main(PixelData input) : SV_TARGET
             {
             case DIRECTIONAL_LIGHT:
                 {
-                    partResult = computeDirectionalLighting(lights[idx], viewDir, normalize(input.normal));
+                    partResult = computeDirectionalLighting(lights[idx], viewDir, normalize(input.normal), material.specularPower);
                 }
                 break;
             case POINT_LIGHT:
                 {
-                    partResult = computePointLighting(lights[idx], viewDir, normalize(input.normal), input.worldPosition);
+                    partResult = computePointLighting(lights[idx], viewDir, normalize(input.normal), input.worldPosition, material.specularPower);
                 }
                 break;
             case SPOT_LIGHT:
@@ -129,10 +135,13 @@ float4 main(PixelData input) : SV_TARGET
     totalResult.diffuse = saturate(totalResult.diffuse);
     totalResult.specular = saturate(totalResult.specular);
 
-    float4 emission = emissiveColor * emissiveCoef;
-    float4 ambient = ambientColor * ambientCoef;
-    float4 diffuse = diffuseColor * diffuseCoef * totalResult.diffuse;
-    float4 specular = specularColor * specularCoef * totalResult.specular;
+    float4 emission = material.emissiveColor * material.emissiveCoef;
+    //  occlusion only darkens the light which is scattered around, cells without sky light get neither
+    float occlusion = input.shading.x;
+    float skyLight = input.shading.y;
+    float4 ambient = material.ambientColor * material.ambientCoef * occlusion * skyLight;
+    float4 diffuse = material.diffuseColor * material.diffuseCoef * totalResult.diffuse * occlusion * skyLight;
+    float4 specular = material.specularColor * material.specularCoef * totalResult.specular * skyLight;
 
     return float4(saturate(emission + ambient + diffuse + specular).xyz, 1.0f);
 }
\ No newline at end of file
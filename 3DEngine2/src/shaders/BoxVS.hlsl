@@ -9,7 +9,8 @@ cbuffer BoxData: register(b0)
 struct VertexData
 {
 	float3 centerPosition		: POSITION;
-	uint vertex					: TEXCOORD;	//	it's not real tex coord though
+	uint vertex					: TEXCOORD0;	//	it's not real tex coord though
+	uint material				: TEXCOORD1;	//	the index into the material table
 };
 
 struct PixelData
@@ -18,6 +19,8 @@ struct PixelData
 	float3 worldPosition		: POSWORLD;
 	float3 normal				: NORMAL;
 	float2 texCoord				: TEXCOORD;
+	float2 shading				: SHADING;	//	ambient occlusion and sky light
+	nointerpolation uint material	: MATERIAL;
 };
 
 const static float3 vertexPositions[8] = {
@@ -56,12 +59,17 @@ PixelData main(VertexData input)
 	uint vertexPosIdx = input.vertex & 0x7;
 	uint vertexNormalIdx = (input.vertex & 0x38) >> 3;
 	uint vertexTexIdx = (input.vertex & 0xC0) >> 6;
+	//	greedy meshing merges faces into larger boxes, unit cubes have all zero
+	float3 boxSize = float3((input.vertex >> 8) & 0x1F, (input.vertex >> 13) & 0x1F, (input.vertex >> 18) & 0x1F) + 1.0f;
+	//	baked when meshing, occlusion 3 is a free corner and light 15 the open sky
+	uint occlusion = (input.vertex >> 23) & 0x3;
+	uint light = (input.vertex >> 25) & 0xF;
 
 	//float3 boxWorldCenter = boxWorldCenterAndScale.xyz;
 	//float boxScale = boxWorldCenterAndScale.w;
 
 	//float4 vertexPos = float4(boxWorldCenter + input.centerPosition + boxScale * vertexPositions[vertexPosIdx], 1.0f);
-	float4 vertexPos = float4(input.centerPosition + vertexPositions[vertexPosIdx], 1.0f);
+	float4 vertexPos = float4(input.centerPosition + vertexPositions[vertexPosIdx] * boxSize, 1.0f);
 	float3 normal = normals[vertexNormalIdx];
 	float2 texCoord = texCoords[vertexTexIdx];
 
@@ -69,6 +77,9 @@ PixelData main(VertexData input)
 	output.worldPosition = mul(worldMatrix, vertexPos).xyz;
 	output.normal = normalize(mul(inversedTransposedWorldMatrix, float4(normal, 0.0f)).xyz);
 	output.texCoord = texCoord;
+	//	every light level lost darkens by a fifth like in minecraft
+	output.shading = float2(0.4f + 0.2f * occlusion, pow(0.8f, 15.0f - light));
+	output.material = input.material;
 
 	return output;
 }
@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "voxel/CubeChunkLod.h"
+
+namespace tde
+{
+	namespace
+	{
+		//	counts the cells of a block and picks the merged cell
+		class CubeCellReduction
+		{
+		public:
+			inline void Add(const CubeCell aCell)
+			{
+				mCellCount++;
+				if (!(aCell & HAS_CUBE))
+				{
+					return;
+				}
+				mCubeCount++;
+				const uint8_t cellType = static_cast<uint8_t>(aCell);
+				if (mTypeCounts[cellType]++ == 0)
+				{
+					mTypes[mTypeCount++] = cellType;
+				}
+			}
+
+			//	resets the counts for the next block
+			inline CubeCell Reduce()
+			{
+				CubeCell result = 0;
+				if (mCubeCount * 2 >= mCellCount)
+				{
+					uint32_t bestCount = 0;
+					for (uint32_t i = 0; i < mTypeCount; i++)
+					{
+						if (mTypeCounts[mTypes[i]] > bestCount)
+						{
+							bestCount = mTypeCounts[mTypes[i]];
+							result = static_cast<CubeCell>(mTypes[i]);
+						}
+					}
+				}
+				for (uint32_t i = 0; i < mTypeCount; i++)
+				{
+					mTypeCounts[mTypes[i]] = 0;
+				}
+				mTypeCount = 0;
+				mCellCount = 0;
+				mCubeCount = 0;
+				return result;
+			}
+
+		private:
+			uint32_t mTypeCounts[256] = {};
+			uint8_t mTypes[256] = {};
+			uint32_t mTypeCount = 0;
+			uint32_t mCellCount = 0;
+			uint32_t mCubeCount = 0;
+		};
+	}
+
+	void buildCubeChunkMip(const CubeChunk& aChunk, const int32_t aLevel, CubeChunkMip& aOutMip)
+	{
+		const int32_t scale = 1 << aLevel;
+		aOutMip.mLevel = aLevel;
+		aOutMip.mSize = CUBE_CHUNK_SIZE >> aLevel;
+
+		//	merging equal cells gives the same cell
+		if (aChunk.GetStorage() == CubeChunkStorage::UNIFORM)
+		{
+			const CubeCell cell = aChunk.Get(0, 0, 0);
+			aOutMip.mCells.assign(static_cast<size_t>(aOutMip.mSize) * aOutMip.mSize * aOutMip.mSize, (cell & HAS_CUBE) ? cell : CubeCell(0));
+			return;
+		}
+
+		//	compressed chunks are decompressed once instead of cell by cell
+		std::unique_ptr<CubeCell[]> pDecompressedCells;
+		const CubeCell* pCells = aChunk.GetRawCells();
+		if (!pCells)
+		{
+			pDecompressedCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+			aChunk.CopyCells(pDecompressedCells.get());
+			pCells = pDecompressedCells.get();
+		}
+
+		aOutMip.mCells.resize(static_cast<size_t>(aOutMip.mSize) * aOutMip.mSize * aOutMip.mSize);
+		CubeCellReduction reduction;
+		CubeCell* pMipCell = aOutMip.mCells.data();
+		for (int32_t mipY = 0; mipY < aOutMip.mSize; mipY++)
+		{
+			for (int32_t mipZ = 0; mipZ < aOutMip.mSize; mipZ++)
+			{
+				for (int32_t mipX = 0; mipX < aOutMip.mSize; mipX++, pMipCell++)
+				{
+					for (int32_t y = mipY * scale; y < (mipY + 1) * scale; y++)
+					{
+						for (int32_t z = mipZ * scale; z < (mipZ + 1) * scale; z++)
+						{
+							const CubeCell* pRow = pCells + CubeChunk::CellIndex(mipX * scale, y, z);
+							for (int32_t x = 0; x < scale; x++)
+							{
+								reduction.Add(pRow[x]);
+							}
+						}
+					}
+					*pMipCell = reduction.Reduce();
+				}
+			}
+		}
+	}
+
+	CubeCell computeCubeMipCell(const CubeChunk& aChunk, const int32_t aLevel, const int32_t aMipX, const int32_t aMipY, const int32_t aMipZ)
+	{
+		const int32_t scale = 1 << aLevel;
+		CubeCellReduction reduction;
+		for (int32_t y = aMipY * scale; y < (aMipY + 1) * scale; y++)
+		{
+			for (int32_t z = aMipZ * scale; z < (aMipZ + 1) * scale; z++)
+			{
+				for (int32_t x = aMipX * scale; x < (aMipX + 1) * scale; x++)
+				{
+					reduction.Add(aChunk.Get(x, y, z));
+				}
+			}
+		}
+		return reduction.Reduce();
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	//	level 0 is the chunk itself, every further level merges twice as many cells along each axis into one,
+	//	so the last level has 4 x 4 x 4 cells of 8 x 8 x 8
+	constexpr static int32_t CUBE_CHUNK_LOD_COUNT = 4;
+
+	//	a downsampled chunk
+	struct CubeChunkMip
+	{
+		int32_t mLevel = 0;
+		int32_t mSize = 0;	//	cells along every axis
+		std::vector<CubeCell> mCells;	//	laid out like the chunk, x++ first, then z++, then y++
+
+		inline CubeCell Get(const int32_t aMipX, const int32_t aMipY, const int32_t aMipZ) const
+		{
+			return mCells[(static_cast<size_t>(aMipY) * mSize + aMipZ) * mSize + aMipX];
+		}
+	};
+
+	//	a merged cell has a cube if at least half of its cells have one, and takes the most common of their cell types,
+	//	so surfaces stay where they are while thin details fade out with the distance
+	void buildCubeChunkMip(const CubeChunk& aChunk, const int32_t aLevel, CubeChunkMip& aOutMip);
+	//	a single merged cell, e.g. from the border of a neighbouring chunk
+	CubeCell computeCubeMipCell(const CubeChunk& aChunk, const int32_t aLevel, const int32_t aMipX, const int32_t aMipY, const int32_t aMipZ);
+}
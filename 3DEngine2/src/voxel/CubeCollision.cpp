@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "voxel/CubeCollision.h"
+
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+
+#include <bit>
+
+namespace tde
+{
+	using namespace DirectX;
+
+	namespace
+	{
+		//	the cells of a brick inside [aMin, aMax] along one axis, both relative to the brick
+		inline uint32_t getBrickAxisBits(const int32_t aMin, const int32_t aMax)
+		{
+			const int32_t first = std::max(aMin, 0);
+			const int32_t last = std::min(aMax, 3);
+			return first > last ? 0 : ((2u << last) - 1) & ~((1u << first) - 1);
+		}
+
+		//	the bits of the cells of a brick inside [aMinCell, aMaxCell], see getCubeBrickBit
+		uint64_t getBrickRangeMask(const CubeCoord& aBrickCoord, const int32_t aMinCell[3], const int32_t aMaxCell[3])
+		{
+			const int32_t brickCell[3] = {
+				aBrickCoord.mX << CUBE_BRICK_SIZE_LOG2,
+				aBrickCoord.mY << CUBE_BRICK_SIZE_LOG2,
+				aBrickCoord.mZ << CUBE_BRICK_SIZE_LOG2 };
+			const uint32_t xBits = getBrickAxisBits(aMinCell[0] - brickCell[0], aMaxCell[0] - brickCell[0]);
+			const uint32_t yBits = getBrickAxisBits(aMinCell[1] - brickCell[1], aMaxCell[1] - brickCell[1]);
+			const uint32_t zBits = getBrickAxisBits(aMinCell[2] - brickCell[2], aMaxCell[2] - brickCell[2]);
+
+			uint64_t rowMask = 0;
+			for (int32_t z = 0; z < 4; z++)
+			{
+				rowMask |= ((zBits >> z) & 1) ? static_cast<uint64_t>(xBits) << (z * 4) : 0;
+			}
+			uint64_t mask = 0;
+			for (int32_t y = 0; y < 4; y++)
+			{
+				mask |= ((yBits >> y) & 1) ? rowMask << (y * 16) : 0;
+			}
+			return mask;
+		}
+
+		//	slab test of the moving box against one cell, false if it doesn't run into it
+		bool sweepCell(const float aBoxMin[3], const float aBoxMax[3], const float aDisplacement[3], const int32_t aCell[3],
+			float& aOutTime, int32_t& aOutFace)
+		{
+			float entry = -std::numeric_limits<float>::infinity();
+			float exit = std::numeric_limits<float>::infinity();
+			int32_t entryAxis = -1;
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				const float cellMin = static_cast<float>(aCell[axis]);
+				const float cellMax = cellMin + 1.0f;
+				float enterTime;
+				float exitTime;
+				if (aDisplacement[axis] > 0.0f)
+				{
+					enterTime = (cellMin - aBoxMax[axis]) / aDisplacement[axis];
+					exitTime = (cellMax - aBoxMin[axis]) / aDisplacement[axis];
+				}
+				else if (aDisplacement[axis] < 0.0f)
+				{
+					enterTime = (cellMax - aBoxMin[axis]) / aDisplacement[axis];
+					exitTime = (cellMin - aBoxMax[axis]) / aDisplacement[axis];
+				}
+				else
+				{
+					//	boxes which only touch the cell slide past it
+					if (aBoxMax[axis] <= cellMin || aBoxMin[axis] >= cellMax)
+					{
+						return false;
+					}
+					continue;
+				}
+				if (enterTime > entry)
+				{
+					entry = enterTime;
+					entryAxis = axis;
+				}
+				exit = std::min(exit, exitTime);
+			}
+
+			if (entryAxis < 0 || entry >= exit || exit <= 0.0f || entry > 1.0f)
+			{
+				return false;
+			}
+			//	the box already overlapped the cell, unless it's only float error of a box which stopped in front of it
+			if (entry * std::abs(aDisplacement[entryAxis]) < -CUBE_COLLISION_SKIN)
+			{
+				return false;
+			}
+			aOutTime = std::max(entry, 0.0f);
+			aOutFace = aDisplacement[entryAxis] > 0.0f ? entryAxis : entryAxis + 3;
+			return true;
+		}
+
+		void moveCubeBox(const CubeWorldOctree& aOctree, const CubeMover& aMover, CubeMoveResult& aOutResult)
+		{
+			CubeBox box = aMover.mBox;
+			float remaining[3] = { aMover.mDisplacement.x, aMover.mDisplacement.y, aMover.mDisplacement.z };
+			float moved[3] = { 0.0f, 0.0f, 0.0f };
+			aOutResult.mContactFaces = 0;
+			for (int32_t slide = 0; slide < CUBE_MOVE_MAX_SLIDES; slide++)
+			{
+				if (remaining[0] == 0.0f && remaining[1] == 0.0f && remaining[2] == 0.0f)
+				{
+					break;
+				}
+
+				CubeSweepHit hit;
+				const XMFLOAT3 displacement{ remaining[0], remaining[1], remaining[2] };
+				if (!sweepCubeBox(aOctree, box, displacement, hit))
+				{
+					for (int32_t axis = 0; axis < 3; axis++)
+					{
+						moved[axis] += remaining[axis];
+					}
+					break;
+				}
+
+				//	stop the skin in front of the face and slide along it with what's left
+				const int32_t normalAxis = hit.mFace % 3;
+				const float time = std::max(hit.mTime - CUBE_COLLISION_SKIN / std::abs(remaining[normalAxis]), 0.0f);
+				float* pBoxMin[3] = { &box.mMin.x, &box.mMin.y, &box.mMin.z };
+				float* pBoxMax[3] = { &box.mMax.x, &box.mMax.y, &box.mMax.z };
+				for (int32_t axis = 0; axis < 3; axis++)
+				{
+					const float step = remaining[axis] * time;
+					*pBoxMin[axis] += step;
+					*pBoxMax[axis] += step;
+					moved[axis] += step;
+					remaining[axis] -= step;
+				}
+				remaining[normalAxis] = 0.0f;
+
+				if (aOutResult.mContactFaces == 0)
+				{
+					aOutResult.mFirstHit = hit;
+				}
+				aOutResult.mContactFaces |= 1u << hit.mFace;
+			}
+			aOutResult.mDisplacement = { moved[0], moved[1], moved[2] };
+		}
+	}
+
+	bool sweepCubeBox(const CubeWorldOctree& aOctree, const CubeBox& aBox, const XMFLOAT3& aDisplacement, CubeSweepHit& aOutHit)
+	{
+		const float boxMin[3] = { aBox.mMin.x, aBox.mMin.y, aBox.mMin.z };
+		const float boxMax[3] = { aBox.mMax.x, aBox.mMax.y, aBox.mMax.z };
+		const float displacement[3] = { aDisplacement.x, aDisplacement.y, aDisplacement.z };
+
+		//	the cells the box overlaps somewhere along the way
+		int32_t minCell[3];
+		int32_t maxCell[3];
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			minCell[axis] = static_cast<int32_t>(std::floor(std::min(boxMin[axis], boxMin[axis] + displacement[axis])));
+			maxCell[axis] = static_cast<int32_t>(std::ceil(std::max(boxMax[axis], boxMax[axis] + displacement[axis]))) - 1;
+		}
+		const CubeCoord minCellCoord{ minCell[0], minCell[1], minCell[2] };
+		const CubeCoord maxCellCoord{ maxCell[0], maxCell[1], maxCell[2] };
+		if (aOctree.IsBoxEmpty(minCellCoord, maxCellCoord))
+		{
+			return false;
+		}
+
+		CubeSweepHit firstHit;
+		firstHit.mTime = std::numeric_limits<float>::infinity();
+		for (int32_t brickZ = minCell[2] >> CUBE_BRICK_SIZE_LOG2; brickZ <= maxCell[2] >> CUBE_BRICK_SIZE_LOG2; brickZ++)
+		{
+			for (int32_t brickY = minCell[1] >> CUBE_BRICK_SIZE_LOG2; brickY <= maxCell[1] >> CUBE_BRICK_SIZE_LOG2; brickY++)
+			{
+				for (int32_t brickX = minCell[0] >> CUBE_BRICK_SIZE_LOG2; brickX <= maxCell[0] >> CUBE_BRICK_SIZE_LOG2; brickX++)
+				{
+					const CubeCoord brickCoord{ brickX, brickY, brickZ };
+					uint64_t mask = aOctree.GetBrickMask(brickCoord);
+					if (mask == 0)
+					{
+						continue;
+					}
+					mask &= getBrickRangeMask(brickCoord, minCell, maxCell);
+					while (mask != 0)
+					{
+						const int32_t bit = std::countr_zero(mask);
+						mask &= mask - 1;
+						const int32_t cell[3] = {
+							(brickX << CUBE_BRICK_SIZE_LOG2) + (bit & 3),
+							(brickY << CUBE_BRICK_SIZE_LOG2) + (bit >> 4),
+							(brickZ << CUBE_BRICK_SIZE_LOG2) + ((bit >> 2) & 3) };
+
+						float time;
+						int32_t face;
+						if (sweepCell(boxMin, boxMax, displacement, cell, time, face) && time < firstHit.mTime)
+						{
+							firstHit.mCell = { cell[0], cell[1], cell[2] };
+							firstHit.mFace = face;
+							firstHit.mTime = time;
+						}
+					}
+				}
+			}
+		}
+		if (firstHit.mFace < 0)
+		{
+			return false;
+		}
+		aOutHit = firstHit;
+		return true;
+	}
+
+	void moveCubeBoxes(const CubeWorldOctree& aOctree, const CubeMover* apMovers, const size_t aMoverCount, CubeMoveResult* apOutResults)
+	{
+		for (size_t i = 0; i < aMoverCount; i++)
+		{
+			moveCubeBox(aOctree, apMovers[i], apOutResults[i]);
+		}
+	}
+
+	void moveCubeBoxesParallel(const CubeWorldOctree& aOctree, const CubeMover* apMovers, const size_t aMoverCount, CubeMoveResult* apOutResults)
+	{
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, aMoverCount, [&](const size_t aMover)
+		{
+			moveCubeBox(aOctree, apMovers[aMover], apOutResults[aMover]);
+		});
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "voxel/CubeRaycaster.h"
+
+namespace tde
+{
+	//	moving boxes stop this far in front of the cubes they run into, so float error never lets them end up inside
+	constexpr static float CUBE_COLLISION_SKIN = 1.0f / 1024.0f;
+	//	how often a move slides along a face and carries on, enough to get into a corner
+	constexpr static int32_t CUBE_MOVE_MAX_SLIDES = 3;
+
+	//	an axis aligned box in cells, cell (x, y, z) spans [x, x + 1] on every axis
+	struct CubeBox
+	{
+		DirectX::XMFLOAT3 mMin;
+		DirectX::XMFLOAT3 mMax;
+	};
+
+	//	the first cube a moving box runs into
+	struct CubeSweepHit
+	{
+		CubeCoord mCell;
+		int32_t mFace = -1;		//	the face of the cube the box touches, in CubeVertexFacing order, see getCubeFaceNormal
+		float mTime = 0.0f;		//	the fraction of the displacement until the box touches it
+	};
+
+	struct CubeMover
+	{
+		CubeBox mBox;
+		DirectX::XMFLOAT3 mDisplacement;	//	in cells, meant for a few cells per update
+	};
+
+	struct CubeMoveResult
+	{
+		//	what the box really moves, it stops in front of the cubes it runs into and slides along their faces
+		DirectX::XMFLOAT3 mDisplacement;
+		//	bit f is set if the box ended up against face f of a cube, e.g. bit 4, +y, means it's standing on one,
+		//	the velocity of the mover should lose its part along those normals
+		uint32_t mContactFaces = 0;
+		//	only if mContactFaces isn't 0, the time is a fraction of the whole displacement
+		CubeSweepHit mFirstHit;
+	};
+
+	//	the first cube the box runs into when it's moved by aDisplacement, cubes the box already overlaps are ignored,
+	//	so boxes which start inside cubes can get out, the box is tested against every cube in the box it sweeps through
+	bool sweepCubeBox(const CubeWorldOctree& aOctree, const CubeBox& aBox, const DirectX::XMFLOAT3& aDisplacement, CubeSweepHit& aOutHit);
+	//	moves every box as far as it gets and slides it along the faces it runs into, up to CUBE_MOVE_MAX_SLIDES times
+	void moveCubeBoxes(const CubeWorldOctree& aOctree, const CubeMover* apMovers, const size_t aMoverCount, CubeMoveResult* apOutResults);
+	//	the movers are spread over the workers
+	void moveCubeBoxesParallel(const CubeWorldOctree& aOctree, const CubeMover* apMovers, const size_t aMoverCount, CubeMoveResult* apOutResults);
+}
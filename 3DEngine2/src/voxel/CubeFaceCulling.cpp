@@ -0,0 +1,219 @@
+#include "pch.h"
+#include "voxel/CubeFaceCulling.h"
+
+#include "common/CpuFeatures.h"
+
+#include <immintrin.h>
+
+namespace tde
+{
+	namespace
+	{
+		static_assert(CUBE_CHUNK_SIZE == 32, "the face culling packs a row of cells into 32 bits");
+
+		//	the chunk plus one cell of the neighbouring chunks on every side
+		constexpr int32_t PADDED_SIZE = CUBE_CHUNK_SIZE + 2;
+		//	bit x + 1 of [y + 1][z + 1] is set if the cell (x, y, z) has a cube, bits 0 and 33 are the cells left and right of the row
+		using PaddedOccupancy = uint64_t[PADDED_SIZE][PADDED_SIZE];
+
+		inline uint32_t packRowScalar(const CubeCell* apCells)
+		{
+			uint32_t row = 0;
+			for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+			{
+				row |= static_cast<uint32_t>(apCells[x] & HAS_CUBE) << x;
+			}
+			return row;
+		}
+
+		inline uint32_t packRowAvx2(const CubeCell* apCells)
+		{
+			//	moves HAS_CUBE to the top bit of every byte, which is what movemask collects
+			static_assert(HAS_CUBE == 0x01, "the avx2 row packing expects HAS_CUBE in the lowest bit");
+			const __m256i cells = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(apCells));
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(cells, 7)));
+		}
+
+		template<bool IS_AVX2>
+		inline uint64_t packRow(const CubeCell* apCells)
+		{
+			return static_cast<uint64_t>(IS_AVX2 ? packRowAvx2(apCells) : packRowScalar(apCells)) << 1;
+		}
+
+		//	compressed chunks decompress just the row
+		template<bool IS_AVX2>
+		inline uint64_t packChunkRow(const CubeChunk& aChunk, const int32_t aLocalY, const int32_t aLocalZ)
+		{
+			if (const CubeCell* pCells = aChunk.GetRawCells())
+			{
+				return packRow<IS_AVX2>(pCells + CubeChunk::CellIndex(0, aLocalY, aLocalZ));
+			}
+			CubeCell row[CUBE_CHUNK_SIZE];
+			aChunk.CopyRow(aLocalY, aLocalZ, row);
+			return packRow<IS_AVX2>(row);
+		}
+
+		//	the chunk across the face, null if there is none or the border is open
+		const CubeChunk* findNeighbourChunk(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const int32_t aFace, const uint32_t aOpenBorders)
+		{
+			if (aOpenBorders & (1u << aFace))
+			{
+				return nullptr;
+			}
+			return aCubeWorld.FindChunk(getCubeFaceNeighbour(aChunkCoord, aFace));
+		}
+
+		template<bool IS_AVX2>
+		void fillOccupancy(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, const uint32_t aOpenBorders, PaddedOccupancy& aOutOccupancy)
+		{
+			std::memset(aOutOccupancy, 0, sizeof(PaddedOccupancy));
+
+			if (aChunk.GetStorage() == CubeChunkStorage::UNIFORM)
+			{
+				//	nothing to pack, every row is the same
+				const uint64_t row = (aChunk.Get(0, 0, 0) & HAS_CUBE) ? (static_cast<uint64_t>(0xFFFFFFFF) << 1) : 0;
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+					{
+						aOutOccupancy[y + 1][z + 1] = row;
+					}
+				}
+			}
+			else
+			{
+				//	compressed chunks are decompressed once, instead of row by row
+				std::unique_ptr<CubeCell[]> pDecompressedCells;
+				const CubeCell* pCells = aChunk.GetRawCells();
+				if (!pCells)
+				{
+					pDecompressedCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+					aChunk.CopyCells(pDecompressedCells.get());
+					pCells = pDecompressedCells.get();
+				}
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+					{
+						aOutOccupancy[y + 1][z + 1] = packRow<IS_AVX2>(pCells + CubeChunk::CellIndex(0, y, z));
+					}
+				}
+			}
+
+			//	only the plane touching this chunk is read from every neighbour
+			constexpr int32_t LAST = CUBE_CHUNK_SIZE - 1;
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 0, aOpenBorders))
+			{
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+					{
+						aOutOccupancy[y + 1][z + 1] |= static_cast<uint64_t>(pNeighbour->Get(LAST, y, z) & HAS_CUBE);
+					}
+				}
+			}
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 3, aOpenBorders))
+			{
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+					{
+						aOutOccupancy[y + 1][z + 1] |= static_cast<uint64_t>(pNeighbour->Get(0, y, z) & HAS_CUBE) << (CUBE_CHUNK_SIZE + 1);
+					}
+				}
+			}
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 1, aOpenBorders))
+			{
+				for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+				{
+					aOutOccupancy[0][z + 1] = packChunkRow<IS_AVX2>(*pNeighbour, LAST, z);
+				}
+			}
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 4, aOpenBorders))
+			{
+				for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+				{
+					aOutOccupancy[PADDED_SIZE - 1][z + 1] = packChunkRow<IS_AVX2>(*pNeighbour, 0, z);
+				}
+			}
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 2, aOpenBorders))
+			{
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					aOutOccupancy[y + 1][0] = packChunkRow<IS_AVX2>(*pNeighbour, y, LAST);
+				}
+			}
+			if (const CubeChunk* pNeighbour = findNeighbourChunk(aCubeWorld, aChunkCoord, 5, aOpenBorders))
+			{
+				for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+				{
+					aOutOccupancy[y + 1][PADDED_SIZE - 1] = packChunkRow<IS_AVX2>(*pNeighbour, y, 0);
+				}
+			}
+		}
+
+		void computeFacesScalar(const PaddedOccupancy& aOccupancy, CubeChunkFaces& aOutFaces)
+		{
+			for (int32_t y = 1; y <= CUBE_CHUNK_SIZE; y++)
+			{
+				for (int32_t z = 1; z <= CUBE_CHUNK_SIZE; z++)
+				{
+					const uint64_t row = aOccupancy[y][z];
+					//	the padding bits of the result are dropped by the shift and the cast
+					aOutFaces.mMasks[0][y - 1][z - 1] = static_cast<uint32_t>((row & ~(row << 1)) >> 1);
+					aOutFaces.mMasks[1][y - 1][z - 1] = static_cast<uint32_t>((row & ~aOccupancy[y - 1][z]) >> 1);
+					aOutFaces.mMasks[2][y - 1][z - 1] = static_cast<uint32_t>((row & ~aOccupancy[y][z - 1]) >> 1);
+					aOutFaces.mMasks[3][y - 1][z - 1] = static_cast<uint32_t>((row & ~(row >> 1)) >> 1);
+					aOutFaces.mMasks[4][y - 1][z - 1] = static_cast<uint32_t>((row & ~aOccupancy[y + 1][z]) >> 1);
+					aOutFaces.mMasks[5][y - 1][z - 1] = static_cast<uint32_t>((row & ~aOccupancy[y][z + 1]) >> 1);
+				}
+			}
+		}
+
+		//	drops the padding bit and narrows four rows to 32 bits
+		inline void storeFaceMasks(uint32_t* apOut, const __m256i aFaces)
+		{
+			const __m256i lowHalves = _mm256_permutevar8x32_epi32(_mm256_srli_epi64(aFaces, 1), _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(apOut), _mm256_castsi256_si128(lowHalves));
+		}
+
+		void computeFacesAvx2(const PaddedOccupancy& aOccupancy, CubeChunkFaces& aOutFaces)
+		{
+			//	four rows next to each other along z at a time
+			for (int32_t y = 1; y <= CUBE_CHUNK_SIZE; y++)
+			{
+				for (int32_t z = 1; z <= CUBE_CHUNK_SIZE; z += 4)
+				{
+					const __m256i row = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&aOccupancy[y][z]));
+					const __m256i below = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&aOccupancy[y - 1][z]));
+					const __m256i above = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&aOccupancy[y + 1][z]));
+					const __m256i back = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&aOccupancy[y][z - 1]));
+					const __m256i front = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&aOccupancy[y][z + 1]));
+
+					storeFaceMasks(&aOutFaces.mMasks[0][y - 1][z - 1], _mm256_andnot_si256(_mm256_slli_epi64(row, 1), row));
+					storeFaceMasks(&aOutFaces.mMasks[1][y - 1][z - 1], _mm256_andnot_si256(below, row));
+					storeFaceMasks(&aOutFaces.mMasks[2][y - 1][z - 1], _mm256_andnot_si256(back, row));
+					storeFaceMasks(&aOutFaces.mMasks[3][y - 1][z - 1], _mm256_andnot_si256(_mm256_srli_epi64(row, 1), row));
+					storeFaceMasks(&aOutFaces.mMasks[4][y - 1][z - 1], _mm256_andnot_si256(above, row));
+					storeFaceMasks(&aOutFaces.mMasks[5][y - 1][z - 1], _mm256_andnot_si256(front, row));
+				}
+			}
+		}
+	}
+
+	void computeCubeChunkFaces(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, CubeChunkFaces& aOutFaces,
+		const uint32_t aOpenBorders)
+	{
+		alignas(32) PaddedOccupancy occupancy;
+		if (isAvx2Supported())
+		{
+			fillOccupancy<true>(aCubeWorld, aChunkCoord, aChunk, aOpenBorders, occupancy);
+			computeFacesAvx2(occupancy, aOutFaces);
+		}
+		else
+		{
+			fillOccupancy<false>(aCubeWorld, aChunkCoord, aChunk, aOpenBorders, occupancy);
+			computeFacesScalar(occupancy, aOutFaces);
+		}
+	}
+}
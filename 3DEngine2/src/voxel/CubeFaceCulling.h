@@ -0,0 +1,30 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	constexpr static size_t CUBE_FACE_COUNT = 6;
+
+	//	the chunk or cell next to aCoord across the face
+	inline CubeCoord getCubeFaceNeighbour(const CubeCoord& aCoord, const int32_t aFace)
+	{
+		CubeCoord neighbour = aCoord;
+		int32_t* pAxes[3] = { &neighbour.mX, &neighbour.mY, &neighbour.mZ };
+		*pAxes[aFace % 3] += aFace < 3 ? -1 : 1;
+		return neighbour;
+	}
+
+	//	bit x of mMasks[face][y][z] is set if that face of the cell (x, y, z) has a cube and isn't covered by a neighbouring cube,
+	//	the faces are in the order -x, -y, -z, +x, +y, +z like CubeVertexFacing
+	struct CubeChunkFaces
+	{
+		uint32_t mMasks[CUBE_FACE_COUNT][CUBE_CHUNK_SIZE][CUBE_CHUNK_SIZE];
+	};
+
+	//	packs every row of cells along x into a bit mask and finds the visible faces of a whole row with shifts and ands,
+	//	the cells across the chunk border are read from the neighbouring chunks, cells in chunks which don't exist are empty
+	//	bit f of aOpenBorders treats the neighbour across face f as empty, e.g. where it is drawn at another level of detail
+	//	uses avx2 if the cpu has it, the result is the same either way
+	void computeCubeChunkFaces(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, CubeChunkFaces& aOutFaces,
+		const uint32_t aOpenBorders = 0);
+}
@@ -0,0 +1,297 @@
+#include "pch.h"
+#include "voxel/CubeRaycaster.h"
+
+#include "common/CpuFeatures.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+
+#include <bit>
+#include <immintrin.h>
+
+namespace tde
+{
+	namespace
+	{
+		static_assert(CUBE_RAY_BATCH_SIZE == 8, "a batch fills the lanes of an avx2 register");
+
+		//	the state of the dda, along every axis the step, the distance to the next cell border and between two borders
+		struct RayTraversal
+		{
+			int32_t mCell[3];
+			int32_t mStep[3];
+			float mNextDistance[3];
+			float mDeltaDistance[3];
+		};
+
+		void setupRayTraversal(const CubeRay& aRay, RayTraversal& aOutTraversal)
+		{
+			const float origin[3] = { aRay.mOrigin.x, aRay.mOrigin.y, aRay.mOrigin.z };
+			const float direction[3] = { aRay.mDirection.x, aRay.mDirection.y, aRay.mDirection.z };
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				aOutTraversal.mCell[axis] = static_cast<int32_t>(std::floor(origin[axis]));
+				if (direction[axis] > 0.0f)
+				{
+					aOutTraversal.mStep[axis] = 1;
+					aOutTraversal.mNextDistance[axis] = (static_cast<float>(aOutTraversal.mCell[axis] + 1) - origin[axis]) / direction[axis];
+					aOutTraversal.mDeltaDistance[axis] = 1.0f / direction[axis];
+				}
+				else if (direction[axis] < 0.0f)
+				{
+					aOutTraversal.mStep[axis] = -1;
+					aOutTraversal.mNextDistance[axis] = (static_cast<float>(aOutTraversal.mCell[axis]) - origin[axis]) / direction[axis];
+					aOutTraversal.mDeltaDistance[axis] = -1.0f / direction[axis];
+				}
+				else
+				{
+					aOutTraversal.mStep[axis] = 0;
+					aOutTraversal.mNextDistance[axis] = std::numeric_limits<float>::infinity();
+					aOutTraversal.mDeltaDistance[axis] = std::numeric_limits<float>::infinity();
+				}
+			}
+		}
+
+		//	the chunk tree a ray is in, it's only looked up again once the ray leaves the chunk
+		struct ChunkTreeCache
+		{
+			CubeCoord mChunkCoord{ INT32_MIN, INT32_MIN, INT32_MIN };
+			const CubeWorldOctree::ChunkTree* mpTree = nullptr;
+
+			inline uint64_t GetBrickMask(const CubeWorldOctree& aOctree, const CubeCoord& aBrickCoord)
+			{
+				constexpr int32_t CHUNK_SHIFT = CUBE_CHUNK_SIZE_LOG2 - CUBE_BRICK_SIZE_LOG2;
+				const CubeCoord chunkCoord{ aBrickCoord.mX >> CHUNK_SHIFT, aBrickCoord.mY >> CHUNK_SHIFT, aBrickCoord.mZ >> CHUNK_SHIFT };
+				if (chunkCoord != mChunkCoord)
+				{
+					mChunkCoord = chunkCoord;
+					mpTree = aOctree.FindChunkTree(chunkCoord);
+				}
+				return mpTree ? CubeWorldOctree::GetBrickMask(*mpTree, aBrickCoord) : 0;
+			}
+		};
+
+		inline int32_t getHitFace(const CubeRay& aRay, const int32_t aAxis)
+		{
+			if (aAxis < 0)
+			{
+				return -1;
+			}
+			const float direction[3] = { aRay.mDirection.x, aRay.mDirection.y, aRay.mDirection.z };
+			return direction[aAxis] > 0.0f ? aAxis : aAxis + 3;
+		}
+
+		bool raycastScalar(const CubeWorldOctree& aOctree, const CubeRay& aRay, CubeRayHit& aOutHit)
+		{
+			RayTraversal traversal;
+			setupRayTraversal(aRay, traversal);
+
+			ChunkTreeCache chunkTreeCache;
+			CubeCoord brickCoord{ INT32_MIN, INT32_MIN, INT32_MIN };
+			uint64_t brickMask = 0;
+			float distance = 0.0f;
+			int32_t axis = -1;
+			while (true)
+			{
+				//	the brick is only looked up again once the ray leaves it
+				const CubeCoord cellBrickCoord{
+					traversal.mCell[0] >> CUBE_BRICK_SIZE_LOG2,
+					traversal.mCell[1] >> CUBE_BRICK_SIZE_LOG2,
+					traversal.mCell[2] >> CUBE_BRICK_SIZE_LOG2 };
+				if (cellBrickCoord != brickCoord)
+				{
+					brickCoord = cellBrickCoord;
+					brickMask = chunkTreeCache.GetBrickMask(aOctree, brickCoord);
+				}
+				if ((brickMask >> getCubeBrickBit(traversal.mCell[0], traversal.mCell[1], traversal.mCell[2])) & 1)
+				{
+					aOutHit.mCell = { traversal.mCell[0], traversal.mCell[1], traversal.mCell[2] };
+					aOutHit.mFace = getHitFace(aRay, axis);
+					aOutHit.mDistance = distance;
+					return true;
+				}
+
+				const float* pNext = traversal.mNextDistance;
+				axis = pNext[0] < pNext[1] ? (pNext[0] < pNext[2] ? 0 : 2) : (pNext[1] < pNext[2] ? 1 : 2);
+				distance = pNext[axis];
+				if (distance > aRay.mMaxDistance)
+				{
+					return false;
+				}
+				traversal.mCell[axis] += traversal.mStep[axis];
+				traversal.mNextDistance[axis] += traversal.mDeltaDistance[axis];
+			}
+		}
+
+		//	the same steps as raycastScalar in the lanes of avx2 registers, lanes drop out as their rays hit or run out of distance
+		void raycastBatchAvx2(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit)
+		{
+			alignas(32) int32_t cells[3][CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) int32_t steps[3][CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) float nextDistances[3][CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) float deltaDistances[3][CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) float maxDistances[CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) int32_t activeLanes[CUBE_RAY_BATCH_SIZE] = {};
+			for (size_t lane = 0; lane < aRayCount; lane++)
+			{
+				RayTraversal traversal;
+				setupRayTraversal(apRays[lane], traversal);
+				for (int32_t axis = 0; axis < 3; axis++)
+				{
+					cells[axis][lane] = traversal.mCell[axis];
+					steps[axis][lane] = traversal.mStep[axis];
+					nextDistances[axis][lane] = traversal.mNextDistance[axis];
+					deltaDistances[axis][lane] = traversal.mDeltaDistance[axis];
+				}
+				maxDistances[lane] = apRays[lane].mMaxDistance;
+				activeLanes[lane] = -1;
+				apOutIsHit[lane] = false;
+			}
+
+			__m256i cellX = _mm256_load_si256(reinterpret_cast<const __m256i*>(cells[0]));
+			__m256i cellY = _mm256_load_si256(reinterpret_cast<const __m256i*>(cells[1]));
+			__m256i cellZ = _mm256_load_si256(reinterpret_cast<const __m256i*>(cells[2]));
+			const __m256i stepX = _mm256_load_si256(reinterpret_cast<const __m256i*>(steps[0]));
+			const __m256i stepY = _mm256_load_si256(reinterpret_cast<const __m256i*>(steps[1]));
+			const __m256i stepZ = _mm256_load_si256(reinterpret_cast<const __m256i*>(steps[2]));
+			__m256 nextX = _mm256_load_ps(nextDistances[0]);
+			__m256 nextY = _mm256_load_ps(nextDistances[1]);
+			__m256 nextZ = _mm256_load_ps(nextDistances[2]);
+			const __m256 deltaX = _mm256_load_ps(deltaDistances[0]);
+			const __m256 deltaY = _mm256_load_ps(deltaDistances[1]);
+			const __m256 deltaZ = _mm256_load_ps(deltaDistances[2]);
+			const __m256 maxDistance = _mm256_load_ps(maxDistances);
+			__m256i active = _mm256_load_si256(reinterpret_cast<const __m256i*>(activeLanes));
+			__m256 distance = _mm256_setzero_ps();
+			__m256i axis = _mm256_set1_epi32(-1);
+
+			//	the 64 bits of the brick every lane is in, split into the lower and upper 32 cells
+			ChunkTreeCache chunkTreeCaches[CUBE_RAY_BATCH_SIZE];
+			alignas(32) int32_t brickCoords[3][CUBE_RAY_BATCH_SIZE];
+			alignas(32) uint32_t brickLow[CUBE_RAY_BATCH_SIZE] = {};
+			alignas(32) uint32_t brickHigh[CUBE_RAY_BATCH_SIZE] = {};
+			__m256i brickX = _mm256_set1_epi32(INT32_MIN);
+			__m256i brickY = _mm256_set1_epi32(INT32_MIN);
+			__m256i brickZ = _mm256_set1_epi32(INT32_MIN);
+			__m256i low = _mm256_setzero_si256();
+			__m256i high = _mm256_setzero_si256();
+
+			const __m256i three = _mm256_set1_epi32(3);
+			const __m256i one = _mm256_set1_epi32(1);
+			const __m256i thirtyOne = _mm256_set1_epi32(31);
+			while (!_mm256_testz_si256(active, active))
+			{
+				//	the lanes which left their brick look up the new one
+				const __m256i cellBrickX = _mm256_srai_epi32(cellX, CUBE_BRICK_SIZE_LOG2);
+				const __m256i cellBrickY = _mm256_srai_epi32(cellY, CUBE_BRICK_SIZE_LOG2);
+				const __m256i cellBrickZ = _mm256_srai_epi32(cellZ, CUBE_BRICK_SIZE_LOG2);
+				const __m256i sameBrick = _mm256_and_si256(_mm256_cmpeq_epi32(cellBrickX, brickX),
+					_mm256_and_si256(_mm256_cmpeq_epi32(cellBrickY, brickY), _mm256_cmpeq_epi32(cellBrickZ, brickZ)));
+				uint32_t changedLanes = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(sameBrick, active))));
+				if (changedLanes != 0)
+				{
+					_mm256_store_si256(reinterpret_cast<__m256i*>(brickCoords[0]), cellBrickX);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(brickCoords[1]), cellBrickY);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(brickCoords[2]), cellBrickZ);
+					while (changedLanes != 0)
+					{
+						const int32_t lane = std::countr_zero(changedLanes);
+						changedLanes &= changedLanes - 1;
+						const uint64_t brickMask = chunkTreeCaches[lane].GetBrickMask(aOctree, { brickCoords[0][lane], brickCoords[1][lane], brickCoords[2][lane] });
+						brickLow[lane] = static_cast<uint32_t>(brickMask);
+						brickHigh[lane] = static_cast<uint32_t>(brickMask >> 32);
+					}
+					brickX = cellBrickX;
+					brickY = cellBrickY;
+					brickZ = cellBrickZ;
+					low = _mm256_load_si256(reinterpret_cast<const __m256i*>(brickLow));
+					high = _mm256_load_si256(reinterpret_cast<const __m256i*>(brickHigh));
+				}
+
+				//	see getCubeBrickBit
+				const __m256i bit = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(cellY, three), 4),
+					_mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(cellZ, three), 2), _mm256_and_si256(cellX, three)));
+				const __m256i word = _mm256_blendv_epi8(low, high, _mm256_cmpgt_epi32(bit, thirtyOne));
+				const __m256i isOccupied = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_srlv_epi32(word, _mm256_and_si256(bit, thirtyOne)), one), one);
+				const __m256i hit = _mm256_and_si256(isOccupied, active);
+				uint32_t hitLanes = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+				if (hitLanes != 0)
+				{
+					alignas(32) float hitDistances[CUBE_RAY_BATCH_SIZE];
+					alignas(32) int32_t hitAxes[CUBE_RAY_BATCH_SIZE];
+					_mm256_store_si256(reinterpret_cast<__m256i*>(cells[0]), cellX);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(cells[1]), cellY);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(cells[2]), cellZ);
+					_mm256_store_ps(hitDistances, distance);
+					_mm256_store_si256(reinterpret_cast<__m256i*>(hitAxes), axis);
+					while (hitLanes != 0)
+					{
+						const int32_t lane = std::countr_zero(hitLanes);
+						hitLanes &= hitLanes - 1;
+						apOutHits[lane].mCell = { cells[0][lane], cells[1][lane], cells[2][lane] };
+						apOutHits[lane].mFace = getHitFace(apRays[lane], hitAxes[lane]);
+						apOutHits[lane].mDistance = hitDistances[lane];
+						apOutIsHit[lane] = true;
+					}
+					active = _mm256_andnot_si256(hit, active);
+				}
+
+				//	step along the axis with the nearest cell border, ties go to the later axis like in raycastScalar
+				const __m256 isXBeforeY = _mm256_cmp_ps(nextX, nextY, _CMP_LT_OQ);
+				const __m256 isX = _mm256_and_ps(isXBeforeY, _mm256_cmp_ps(nextX, nextZ, _CMP_LT_OQ));
+				const __m256 isY = _mm256_andnot_ps(isXBeforeY, _mm256_cmp_ps(nextY, nextZ, _CMP_LT_OQ));
+				const __m256 isZ = _mm256_andnot_ps(_mm256_or_ps(isX, isY), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+				const __m256 nextDistance = _mm256_blendv_ps(_mm256_blendv_ps(nextZ, nextY, isY), nextX, isX);
+				const __m256i isOutOfRange = _mm256_castps_si256(_mm256_cmp_ps(nextDistance, maxDistance, _CMP_GT_OQ));
+				active = _mm256_andnot_si256(isOutOfRange, active);
+
+				const __m256 activeMask = _mm256_castsi256_ps(active);
+				const __m256i stepsX = _mm256_castps_si256(_mm256_and_ps(isX, activeMask));
+				const __m256i stepsY = _mm256_castps_si256(_mm256_and_ps(isY, activeMask));
+				const __m256i stepsZ = _mm256_castps_si256(_mm256_and_ps(isZ, activeMask));
+				distance = _mm256_blendv_ps(distance, nextDistance, activeMask);
+				axis = _mm256_blendv_epi8(axis,
+					_mm256_add_epi32(_mm256_and_si256(stepsY, one), _mm256_and_si256(stepsZ, _mm256_set1_epi32(2))),
+					active);
+				cellX = _mm256_add_epi32(cellX, _mm256_and_si256(stepX, stepsX));
+				cellY = _mm256_add_epi32(cellY, _mm256_and_si256(stepY, stepsY));
+				cellZ = _mm256_add_epi32(cellZ, _mm256_and_si256(stepZ, stepsZ));
+				nextX = _mm256_blendv_ps(nextX, _mm256_add_ps(nextX, deltaX), _mm256_castsi256_ps(stepsX));
+				nextY = _mm256_blendv_ps(nextY, _mm256_add_ps(nextY, deltaY), _mm256_castsi256_ps(stepsY));
+				nextZ = _mm256_blendv_ps(nextZ, _mm256_add_ps(nextZ, deltaZ), _mm256_castsi256_ps(stepsZ));
+			}
+		}
+	}
+
+	void raycastCubes(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit)
+	{
+		if (isAvx2Supported())
+		{
+			for (size_t first = 0; first < aRayCount; first += CUBE_RAY_BATCH_SIZE)
+			{
+				raycastBatchAvx2(aOctree, apRays + first, std::min(CUBE_RAY_BATCH_SIZE, aRayCount - first), apOutHits + first, apOutIsHit + first);
+			}
+		}
+		else
+		{
+			raycastCubesScalar(aOctree, apRays, aRayCount, apOutHits, apOutIsHit);
+		}
+	}
+
+	void raycastCubesScalar(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit)
+	{
+		for (size_t i = 0; i < aRayCount; i++)
+		{
+			apOutIsHit[i] = raycastScalar(aOctree, apRays[i], apOutHits[i]);
+		}
+	}
+
+	void raycastCubesParallel(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit)
+	{
+		const size_t batchCount = (aRayCount + CUBE_RAY_BATCH_SIZE - 1) / CUBE_RAY_BATCH_SIZE;
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, batchCount, [&](const size_t aBatch)
+		{
+			const size_t first = aBatch * CUBE_RAY_BATCH_SIZE;
+			raycastCubes(aOctree, apRays + first, std::min(CUBE_RAY_BATCH_SIZE, aRayCount - first), apOutHits + first, apOutIsHit + first);
+		});
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "voxel/CubeWorldOctree.h"
+
+namespace tde
+{
+	//	the rays of a batch are traced together in the lanes of simd registers
+	constexpr static size_t CUBE_RAY_BATCH_SIZE = 8;
+
+	struct CubeRay
+	{
+		DirectX::XMFLOAT3 mOrigin;
+		DirectX::XMFLOAT3 mDirection;	//	the distances are measured in lengths of it
+		float mMaxDistance = 0.0f;		//	has to be finite
+	};
+
+	//	the outward normal of a face in CubeVertexFacing order, not of the -1 a ray which starts in a cube reports
+	inline DirectX::XMFLOAT3 getCubeFaceNormal(const int32_t aFace)
+	{
+		DirectX::XMFLOAT3 normal{ 0.0f, 0.0f, 0.0f };
+		float* pAxes[3] = { &normal.x, &normal.y, &normal.z };
+		*pAxes[aFace % 3] = aFace < 3 ? -1.0f : 1.0f;
+		return normal;
+	}
+
+	//	traces the rays cell by cell with amanatides and woo's dda, the cells are read from the bricks of the octree,
+	//	CUBE_RAY_BATCH_SIZE rays at a time with avx2 if the cpu has it, the result is the same either way
+	//	apOutIsHit[i] tells whether ray i hit a cube within its max distance, apOutHits[i] is only written if it did
+	//	for line of sight checks, trace a ray to the target with the distance to it as the max distance
+	void raycastCubes(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit);
+	//	the scalar path of raycastCubes on any cpu, to measure the avx2 path against
+	void raycastCubesScalar(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit);
+	//	the batches are spread over the workers
+	void raycastCubesParallel(const CubeWorldOctree& aOctree, const CubeRay* apRays, const size_t aRayCount, CubeRayHit* apOutHits, bool* apOutIsHit);
+}
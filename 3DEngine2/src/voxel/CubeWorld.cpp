@@ -0,0 +1,823 @@
+#include "pch.h"
+#include "voxel/CubeWorld.h"
+#include "common/MappedFile.h"
+
+#include <fstream>
+
+namespace tde
+{
+	namespace
+	{
+		constexpr size_t CUBE_CHUNK_COLUMN_COUNT = CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE;
+
+		inline size_t columnIndex(const int32_t aLocalX, const int32_t aLocalZ)
+		{
+			return (static_cast<size_t>(aLocalZ) << CUBE_CHUNK_SIZE_LOG2) | static_cast<size_t>(aLocalX);
+		}
+
+		//	indices are never split across bytes
+		inline uint8_t getPaletteIndexBits(const size_t aPaletteSize)
+		{
+			return aPaletteSize <= 2 ? 1 : (aPaletteSize <= 4 ? 2 : 4);
+		}
+
+		inline size_t getPaletteDataSize(const uint8_t aPaletteIndexBits)
+		{
+			return CUBE_CHUNK_CELL_COUNT * aPaletteIndexBits / 8;
+		}
+
+		//	every index has to point into the palette, unless the palette fills all of them
+		bool arePaletteIndicesValid(const uint8_t* apData, const uint8_t aPaletteIndexBits, const size_t aPaletteSize)
+		{
+			const uint8_t indexMask = static_cast<uint8_t>((1 << aPaletteIndexBits) - 1);
+			if (aPaletteSize > indexMask)
+			{
+				return true;
+			}
+			const size_t dataSize = getPaletteDataSize(aPaletteIndexBits);
+			for (size_t byte = 0; byte < dataSize; byte++)
+			{
+				for (uint8_t bit = 0; bit < 8; bit += aPaletteIndexBits)
+				{
+					if (((apData[byte] >> bit) & indexMask) >= aPaletteSize)
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		//	the runs of every column have to follow the ones of the column before and fill exactly CUBE_CHUNK_SIZE cells,
+		//	otherwise reading a column runs past its runs or the data
+		bool areColumnRunsValid(const uint16_t* apColumnRuns, const uint8_t* apRunData)
+		{
+			for (size_t column = 0; column < CUBE_CHUNK_COLUMN_COUNT; column++)
+			{
+				if (apColumnRuns[column] > apColumnRuns[column + 1])
+				{
+					return false;
+				}
+				size_t cellCount = 0;
+				for (size_t run = apColumnRuns[column]; run < apColumnRuns[column + 1] && cellCount <= static_cast<size_t>(CUBE_CHUNK_SIZE); run++)
+				{
+					cellCount += apRunData[run * 2 + 1];
+				}
+				if (cellCount != static_cast<size_t>(CUBE_CHUNK_SIZE))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	CubeChunk::CubeChunk()
+	{
+	}
+
+	bool CubeChunk::IsEmpty() const
+	{
+		CubeCell cell = 0;
+		return IsUniform(cell) && cell == 0;
+	}
+
+	bool CubeChunk::IsUniform(CubeCell& aOutCell) const
+	{
+		switch (mStorage)
+		{
+		case CubeChunkStorage::UNIFORM:
+			aOutCell = mUniformCell;
+			return true;
+		case CubeChunkStorage::PALETTE:
+		{
+			//	the palette has no duplicates, so every index has to be the first one
+			const uint8_t firstIndex = PrivGetPaletteIndex(0);
+			uint8_t pattern = firstIndex;
+			for (uint8_t shift = mPaletteIndexBits; shift < 8; shift *= 2)
+			{
+				pattern |= pattern << shift;
+			}
+			aOutCell = mpPalette[firstIndex];
+			return std::all_of(mpData, mpData + getPaletteDataSize(mPaletteIndexBits), [pattern](const uint8_t aByte) { return aByte == pattern; });
+		}
+		case CubeChunkStorage::RUN_LENGTH:
+			aOutCell = static_cast<CubeCell>(mpData[0]);
+			for (size_t column = 0; column < CUBE_CHUNK_COLUMN_COUNT; column++)
+			{
+				if (mpColumnRuns[column + 1] - mpColumnRuns[column] != 1 || static_cast<CubeCell>(mpData[mpColumnRuns[column] * 2]) != aOutCell)
+				{
+					return false;
+				}
+			}
+			return true;
+		default:
+		{
+			aOutCell = mpRawCells[0];
+			const CubeCell firstCell = aOutCell;
+			return std::all_of(mpRawCells, mpRawCells + CUBE_CHUNK_CELL_COUNT, [firstCell](const CubeCell aCell) { return aCell == firstCell; });
+		}
+		}
+	}
+
+	CubeCell* CubeChunk::GetMutableCells()
+	{
+		if (mStorage != CubeChunkStorage::RAW || mIsMapped)
+		{
+			PrivExpand();
+		}
+		mIsCompressionPending = true;
+		return mpCells.get();
+	}
+
+	void CubeChunk::CopyRow(const int32_t aLocalY, const int32_t aLocalZ, CubeCell* apOutCells) const
+	{
+		switch (mStorage)
+		{
+		case CubeChunkStorage::UNIFORM:
+			std::fill(apOutCells, apOutCells + CUBE_CHUNK_SIZE, mUniformCell);
+			break;
+		case CubeChunkStorage::RAW:
+			std::memcpy(apOutCells, mpRawCells + CellIndex(0, aLocalY, aLocalZ), CUBE_CHUNK_SIZE);
+			break;
+		case CubeChunkStorage::PALETTE:
+		{
+			const size_t firstCell = CellIndex(0, aLocalY, aLocalZ);
+			for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+			{
+				apOutCells[x] = mpPalette[PrivGetPaletteIndex(firstCell + x)];
+			}
+			break;
+		}
+		default:
+			for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+			{
+				apOutCells[x] = PrivGetCompressed(x, aLocalY, aLocalZ);
+			}
+			break;
+		}
+	}
+
+	void CubeChunk::CopyCells(CubeCell* apOutCells) const
+	{
+		switch (mStorage)
+		{
+		case CubeChunkStorage::UNIFORM:
+			std::fill(apOutCells, apOutCells + CUBE_CHUNK_CELL_COUNT, mUniformCell);
+			break;
+		case CubeChunkStorage::RAW:
+			std::memcpy(apOutCells, mpRawCells, CUBE_CHUNK_CELL_COUNT);
+			break;
+		case CubeChunkStorage::PALETTE:
+			for (size_t cell = 0; cell < CUBE_CHUNK_CELL_COUNT; cell++)
+			{
+				apOutCells[cell] = mpPalette[PrivGetPaletteIndex(cell)];
+			}
+			break;
+		default:
+			//	every run fills a part of a column
+			for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+			{
+				for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+				{
+					const size_t column = columnIndex(x, z);
+					int32_t y = 0;
+					for (size_t run = mpColumnRuns[column]; run < mpColumnRuns[column + 1]; run++)
+					{
+						const CubeCell cell = static_cast<CubeCell>(mpData[run * 2]);
+						const int32_t runEnd = y + mpData[run * 2 + 1];
+						for (; y < runEnd; y++)
+						{
+							apOutCells[CellIndex(x, y, z)] = cell;
+						}
+					}
+				}
+			}
+			break;
+		}
+	}
+
+	void CubeChunk::Compress()
+	{
+		mIsCompressionPending = false;
+		if (mStorage == CubeChunkStorage::UNIFORM)
+		{
+			return;
+		}
+
+		std::unique_ptr<CubeCell[]> pCells = std::move(mpCells);
+		if (!pCells)
+		{
+			pCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+			CopyCells(pCells.get());
+		}
+
+		//	the palette in the order the cells first appear, and the number of runs along y
+		std::vector<CubeCell> palette;
+		bool isInPalette[256] = {};
+		for (size_t cell = 0; cell < CUBE_CHUNK_CELL_COUNT; cell++)
+		{
+			const uint8_t value = static_cast<uint8_t>(pCells[cell]);
+			if (!isInPalette[value])
+			{
+				isInPalette[value] = true;
+				palette.push_back(pCells[cell]);
+			}
+		}
+		size_t runCount = CUBE_CHUNK_COLUMN_COUNT;
+		for (int32_t y = 1; y < CUBE_CHUNK_SIZE; y++)
+		{
+			const CubeCell* pRow = pCells.get() + CellIndex(0, y, 0);
+			const CubeCell* pRowBelow = pCells.get() + CellIndex(0, y - 1, 0);
+			for (size_t column = 0; column < CUBE_CHUNK_COLUMN_COUNT; column++)
+			{
+				runCount += pRow[column] != pRowBelow[column];
+			}
+		}
+
+		mPalette.clear();
+		mData.clear();
+		mColumnRuns.clear();
+		if (palette.size() == 1)
+		{
+			mStorage = CubeChunkStorage::UNIFORM;
+			mUniformCell = palette[0];
+			mPalette.shrink_to_fit();
+			mData.shrink_to_fit();
+			mColumnRuns.shrink_to_fit();
+			PrivUpdateViews();
+			return;
+		}
+
+		const size_t rawSize = CUBE_CHUNK_CELL_COUNT;
+		const size_t paletteSize = palette.size() <= MAX_PALETTE_SIZE ?
+			palette.size() + getPaletteDataSize(getPaletteIndexBits(palette.size())) : rawSize;
+		const size_t runLengthSize = runCount * 2 + (CUBE_CHUNK_COLUMN_COUNT + 1) * sizeof(uint16_t);
+		if (paletteSize <= runLengthSize && paletteSize < rawSize)
+		{
+			PrivEncodePalette(pCells.get(), palette);
+		}
+		else if (runLengthSize < rawSize)
+		{
+			PrivEncodeRunLength(pCells.get());
+		}
+		else
+		{
+			mStorage = CubeChunkStorage::RAW;
+			mpCells = std::move(pCells);
+		}
+		mPalette.shrink_to_fit();
+		mData.shrink_to_fit();
+		mColumnRuns.shrink_to_fit();
+		PrivUpdateViews();
+	}
+
+	size_t CubeChunk::GetMemoryUsage() const
+	{
+		return sizeof(CubeChunk) +
+			mPalette.capacity() * sizeof(CubeCell) +
+			mData.capacity() * sizeof(uint8_t) +
+			mColumnRuns.capacity() * sizeof(uint16_t) +
+			(mpCells ? CUBE_CHUNK_CELL_COUNT * sizeof(CubeCell) : 0);
+	}
+
+	CubeChunkEncoding CubeChunk::GetEncoding() const
+	{
+		return { mStorage, mUniformCell, mPaletteIndexBits, mPaletteSize };
+	}
+
+	void CubeChunk::AppendEncodedData(std::vector<uint8_t>& aOutData) const
+	{
+		switch (mStorage)
+		{
+		case CubeChunkStorage::PALETTE:
+			aOutData.insert(aOutData.end(), reinterpret_cast<const uint8_t*>(mpPalette), reinterpret_cast<const uint8_t*>(mpPalette) + mPaletteSize);
+			aOutData.insert(aOutData.end(), mpData, mpData + getPaletteDataSize(mPaletteIndexBits));
+			break;
+		case CubeChunkStorage::RUN_LENGTH:
+		{
+			//	the column runs first, so they stay aligned when the data is mapped
+			const uint8_t* pColumnRuns = reinterpret_cast<const uint8_t*>(mpColumnRuns);
+			aOutData.insert(aOutData.end(), pColumnRuns, pColumnRuns + (CUBE_CHUNK_COLUMN_COUNT + 1) * sizeof(uint16_t));
+			aOutData.insert(aOutData.end(), mpData, mpData + mpColumnRuns[CUBE_CHUNK_COLUMN_COUNT] * 2);
+			break;
+		}
+		case CubeChunkStorage::RAW:
+			aOutData.insert(aOutData.end(), reinterpret_cast<const uint8_t*>(mpRawCells), reinterpret_cast<const uint8_t*>(mpRawCells) + CUBE_CHUNK_CELL_COUNT);
+			break;
+		default:
+			break;
+		}
+	}
+
+	bool CubeChunk::MapEncodedData(const CubeChunkEncoding& aEncoding, const uint8_t* apData, const size_t aDataSize)
+	{
+		switch (aEncoding.mStorage)
+		{
+		case CubeChunkStorage::UNIFORM:
+			if (aDataSize != 0)
+			{
+				return false;
+			}
+			break;
+		case CubeChunkStorage::PALETTE:
+			if (aEncoding.mPaletteSize == 0 ||
+				aEncoding.mPaletteSize > MAX_PALETTE_SIZE ||
+				aEncoding.mPaletteIndexBits != getPaletteIndexBits(aEncoding.mPaletteSize) ||
+				aDataSize != aEncoding.mPaletteSize + getPaletteDataSize(aEncoding.mPaletteIndexBits) ||
+				!arePaletteIndicesValid(apData + aEncoding.mPaletteSize, aEncoding.mPaletteIndexBits, aEncoding.mPaletteSize))
+			{
+				return false;
+			}
+			break;
+		case CubeChunkStorage::RUN_LENGTH:
+		{
+			constexpr size_t COLUMN_RUNS_SIZE = (CUBE_CHUNK_COLUMN_COUNT + 1) * sizeof(uint16_t);
+			if (aDataSize < COLUMN_RUNS_SIZE ||
+				reinterpret_cast<uintptr_t>(apData) % alignof(uint16_t) != 0 ||
+				aDataSize - COLUMN_RUNS_SIZE != reinterpret_cast<const uint16_t*>(apData)[CUBE_CHUNK_COLUMN_COUNT] * size_t(2) ||
+				!areColumnRunsValid(reinterpret_cast<const uint16_t*>(apData), apData + COLUMN_RUNS_SIZE))
+			{
+				return false;
+			}
+			break;
+		}
+		case CubeChunkStorage::RAW:
+			if (aDataSize != CUBE_CHUNK_CELL_COUNT)
+			{
+				return false;
+			}
+			break;
+		default:
+			return false;
+		}
+
+		mPalette.clear();
+		mData.clear();
+		mColumnRuns.clear();
+		mpCells.reset();
+		PrivUpdateViews();
+
+		mStorage = aEncoding.mStorage;
+		mUniformCell = aEncoding.mUniformCell;
+		mPaletteIndexBits = aEncoding.mPaletteIndexBits;
+		mIsCompressionPending = false;
+		switch (mStorage)
+		{
+		case CubeChunkStorage::PALETTE:
+			mPaletteSize = aEncoding.mPaletteSize;
+			mpPalette = reinterpret_cast<const CubeCell*>(apData);
+			mpData = apData + mPaletteSize;
+			break;
+		case CubeChunkStorage::RUN_LENGTH:
+			mpColumnRuns = reinterpret_cast<const uint16_t*>(apData);
+			mpData = apData + (CUBE_CHUNK_COLUMN_COUNT + 1) * sizeof(uint16_t);
+			break;
+		case CubeChunkStorage::RAW:
+			mpRawCells = reinterpret_cast<const CubeCell*>(apData);
+			break;
+		default:
+			break;
+		}
+		mIsMapped = mStorage != CubeChunkStorage::UNIFORM;
+		return true;
+	}
+
+	CubeCell CubeChunk::PrivGetCompressed(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ) const
+	{
+		if (mStorage == CubeChunkStorage::PALETTE)
+		{
+			return mpPalette[PrivGetPaletteIndex(CellIndex(aLocalX, aLocalY, aLocalZ))];
+		}
+
+		const size_t column = columnIndex(aLocalX, aLocalZ);
+		int32_t y = aLocalY;
+		for (size_t run = mpColumnRuns[column]; ; run++)
+		{
+			const int32_t length = mpData[run * 2 + 1];
+			if (y < length)
+			{
+				return static_cast<CubeCell>(mpData[run * 2]);
+			}
+			y -= length;
+		}
+	}
+
+	void CubeChunk::PrivSetCompressed(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ, const CubeCell aCell)
+	{
+		if (Get(aLocalX, aLocalY, aLocalZ) == aCell)
+		{
+			return;
+		}
+		mIsCompressionPending = true;
+		if (mIsMapped)
+		{
+			PrivCopyMappedData();
+		}
+
+		if (mStorage == CubeChunkStorage::UNIFORM)
+		{
+			//	every cell points to the only palette entry
+			mStorage = CubeChunkStorage::PALETTE;
+			mPalette.assign(1, mUniformCell);
+			mPaletteIndexBits = 1;
+			mData.assign(getPaletteDataSize(mPaletteIndexBits), 0);
+		}
+
+		if (mStorage == CubeChunkStorage::PALETTE)
+		{
+			auto paletteIt = std::find(mPalette.begin(), mPalette.end(), aCell);
+			if (paletteIt == mPalette.end() && mPalette.size() < MAX_PALETTE_SIZE)
+			{
+				mPalette.push_back(aCell);
+				paletteIt = mPalette.end() - 1;
+				if (getPaletteIndexBits(mPalette.size()) > mPaletteIndexBits)
+				{
+					PrivWidenPalette(getPaletteIndexBits(mPalette.size()));
+				}
+			}
+			if (paletteIt != mPalette.end())
+			{
+				PrivSetPaletteIndex(CellIndex(aLocalX, aLocalY, aLocalZ), static_cast<uint8_t>(paletteIt - mPalette.begin()));
+				PrivUpdateViews();
+				return;
+			}
+		}
+
+		//	run length chunks and full palettes are edited as raw cells
+		PrivExpand();
+		mpCells[CellIndex(aLocalX, aLocalY, aLocalZ)] = aCell;
+	}
+
+	void CubeChunk::PrivSetPaletteIndex(const size_t aCellIndex, const uint8_t aPaletteIndex)
+	{
+		const size_t bit = aCellIndex * mPaletteIndexBits;
+		const uint8_t mask = static_cast<uint8_t>(((1 << mPaletteIndexBits) - 1) << (bit & 7));
+		mData[bit >> 3] = static_cast<uint8_t>((mData[bit >> 3] & ~mask) | (aPaletteIndex << (bit & 7)));
+	}
+
+	void CubeChunk::PrivWidenPalette(const uint8_t aPaletteIndexBits)
+	{
+		std::vector<uint8_t> oldData = std::move(mData);
+		const uint8_t oldPaletteIndexBits = mPaletteIndexBits;
+		mData.assign(getPaletteDataSize(aPaletteIndexBits), 0);
+		mPaletteIndexBits = aPaletteIndexBits;
+		for (size_t cell = 0; cell < CUBE_CHUNK_CELL_COUNT; cell++)
+		{
+			const size_t bit = cell * oldPaletteIndexBits;
+			PrivSetPaletteIndex(cell, (oldData[bit >> 3] >> (bit & 7)) & ((1 << oldPaletteIndexBits) - 1));
+		}
+	}
+
+	void CubeChunk::PrivExpand()
+	{
+		std::unique_ptr<CubeCell[]> pCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+		CopyCells(pCells.get());
+		mpCells = std::move(pCells);
+		mStorage = CubeChunkStorage::RAW;
+		mPalette.clear();
+		mPalette.shrink_to_fit();
+		mData.clear();
+		mData.shrink_to_fit();
+		mColumnRuns.clear();
+		mColumnRuns.shrink_to_fit();
+		PrivUpdateViews();
+	}
+
+	void CubeChunk::PrivCopyMappedData()
+	{
+		switch (mStorage)
+		{
+		case CubeChunkStorage::PALETTE:
+			mPalette.assign(mpPalette, mpPalette + mPaletteSize);
+			mData.assign(mpData, mpData + getPaletteDataSize(mPaletteIndexBits));
+			break;
+		case CubeChunkStorage::RUN_LENGTH:
+			mColumnRuns.assign(mpColumnRuns, mpColumnRuns + CUBE_CHUNK_COLUMN_COUNT + 1);
+			mData.assign(mpData, mpData + mpColumnRuns[CUBE_CHUNK_COLUMN_COUNT] * 2);
+			break;
+		case CubeChunkStorage::RAW:
+			mpCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+			std::memcpy(mpCells.get(), mpRawCells, CUBE_CHUNK_CELL_COUNT);
+			break;
+		default:
+			break;
+		}
+		PrivUpdateViews();
+	}
+
+	void CubeChunk::PrivUpdateViews()
+	{
+		mpPalette = mPalette.data();
+		mPaletteSize = static_cast<uint8_t>(mPalette.size());
+		mpData = mData.data();
+		mpColumnRuns = mColumnRuns.data();
+		mpRawCells = mpCells.get();
+		mIsMapped = false;
+	}
+
+	void CubeChunk::PrivEncodePalette(const CubeCell* apCells, const std::vector<CubeCell>& aPalette)
+	{
+		uint8_t paletteIndices[256] = {};
+		for (size_t i = 0; i < aPalette.size(); i++)
+		{
+			paletteIndices[static_cast<uint8_t>(aPalette[i])] = static_cast<uint8_t>(i);
+		}
+
+		mStorage = CubeChunkStorage::PALETTE;
+		mPalette = aPalette;
+		mPaletteIndexBits = getPaletteIndexBits(aPalette.size());
+		mData.assign(getPaletteDataSize(mPaletteIndexBits), 0);
+		for (size_t cell = 0; cell < CUBE_CHUNK_CELL_COUNT; cell++)
+		{
+			PrivSetPaletteIndex(cell, paletteIndices[static_cast<uint8_t>(apCells[cell])]);
+		}
+	}
+
+	void CubeChunk::PrivEncodeRunLength(const CubeCell* apCells)
+	{
+		static_assert(CUBE_CHUNK_COLUMN_COUNT * CUBE_CHUNK_SIZE <= std::numeric_limits<uint16_t>::max(), "run indices must fit 16 bits");
+
+		mStorage = CubeChunkStorage::RUN_LENGTH;
+		mColumnRuns.resize(CUBE_CHUNK_COLUMN_COUNT + 1);
+		for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+		{
+			for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+			{
+				mColumnRuns[columnIndex(x, z)] = static_cast<uint16_t>(mData.size() / 2);
+				int32_t runStart = 0;
+				for (int32_t y = 1; y <= CUBE_CHUNK_SIZE; y++)
+				{
+					const CubeCell cell = apCells[CellIndex(x, runStart, z)];
+					if (y == CUBE_CHUNK_SIZE || apCells[CellIndex(x, y, z)] != cell)
+					{
+						mData.push_back(static_cast<uint8_t>(cell));
+						mData.push_back(static_cast<uint8_t>(y - runStart));
+						runStart = y;
+					}
+				}
+			}
+		}
+		mColumnRuns[CUBE_CHUNK_COLUMN_COUNT] = static_cast<uint16_t>(mData.size() / 2);
+	}
+
+	CubeWorld::CubeWorld(const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ)
+		: mMaxCell{ static_cast<int32_t>(aSizeX), static_cast<int32_t>(aSizeY), static_cast<int32_t>(aSizeZ) }
+	{
+	}
+
+	CubeWorld::CubeWorld(const CubeCoord& aMinCell, const CubeCoord& aMaxCell)
+		: mMinCell(aMinCell)
+		, mMaxCell(aMaxCell)
+	{
+	}
+
+	CubeCell& CubeWorld::At(const int32_t aX, const int32_t aY, const int32_t aZ)
+	{
+		if (!IsInBounds(aX, aY, aZ))
+		{
+			throw std::runtime_error("failed to access out of bound cube cell of the cube world");
+		}
+
+		CubeChunk& chunk = GetOrCreateChunk(toChunkCoord(aX, aY, aZ));
+		PrivMarkCellDirty(aX, aY, aZ);
+		return chunk.GetMutableCells()[CubeChunk::CellIndex(aX & CUBE_CHUNK_MASK, aY & CUBE_CHUNK_MASK, aZ & CUBE_CHUNK_MASK)];
+	}
+
+	void CubeWorld::Set(const int32_t aX, const int32_t aY, const int32_t aZ, const CubeCell aCell)
+	{
+		const CubeCoord chunkCoord = toChunkCoord(aX, aY, aZ);
+		CubeChunk* pChunk = FindChunk(chunkCoord);
+		if (!pChunk)
+		{
+			if (aCell == 0)
+			{
+				return;
+			}
+			pChunk = &GetOrCreateChunk(chunkCoord);
+		}
+		const int32_t localX = aX & CUBE_CHUNK_MASK;
+		const int32_t localY = aY & CUBE_CHUNK_MASK;
+		const int32_t localZ = aZ & CUBE_CHUNK_MASK;
+		if (pChunk->Get(localX, localY, localZ) == aCell)
+		{
+			return;
+		}
+		pChunk->Set(localX, localY, localZ, aCell);
+		PrivGrowBounds(aX, aY, aZ);
+		PrivMarkCellDirty(aX, aY, aZ);
+	}
+
+	const CubeChunk* CubeWorld::FindChunk(const CubeCoord& aChunkCoord) const
+	{
+		auto chunkIt = mChunks.find(aChunkCoord);
+		return chunkIt != mChunks.end() ? chunkIt->second.get() : nullptr;
+	}
+
+	CubeChunk* CubeWorld::FindChunk(const CubeCoord& aChunkCoord)
+	{
+		auto chunkIt = mChunks.find(aChunkCoord);
+		return chunkIt != mChunks.end() ? chunkIt->second.get() : nullptr;
+	}
+
+	CubeChunk& CubeWorld::GetOrCreateChunk(const CubeCoord& aChunkCoord)
+	{
+		std::unique_ptr<CubeChunk>& pChunk = mChunks[aChunkCoord];
+		if (!pChunk)
+		{
+			pChunk = std::make_unique<CubeChunk>();
+		}
+		return *pChunk;
+	}
+
+	void CubeWorld::AddChunk(const CubeCoord& aChunkCoord, std::unique_ptr<CubeChunk> apChunk)
+	{
+		mChunks[aChunkCoord] = std::move(apChunk);
+		PrivMarkChunkAndNeighboursDirty(aChunkCoord);
+	}
+
+	void CubeWorld::RemoveChunk(const CubeCoord& aChunkCoord)
+	{
+		if (mChunks.erase(aChunkCoord) > 0)
+		{
+			PrivMarkChunkAndNeighboursDirty(aChunkCoord);
+		}
+	}
+
+	void CubeWorld::RemoveEmptyChunks()
+	{
+		for (auto chunkIt = mChunks.begin(); chunkIt != mChunks.end();)
+		{
+			if (chunkIt->second->IsEmpty())
+			{
+				mDirtyChunks.insert(chunkIt->first);
+				mEditedChunks.insert(chunkIt->first);
+				chunkIt = mChunks.erase(chunkIt);
+			}
+			else
+			{
+				++chunkIt;
+			}
+		}
+	}
+
+	void CubeWorld::CompressChunks()
+	{
+		for (const auto& chunk : mChunks)
+		{
+			if (chunk.second->IsCompressionPending())
+			{
+				chunk.second->Compress();
+			}
+		}
+	}
+
+	size_t CubeWorld::GetChunkMemoryUsage() const
+	{
+		size_t memoryUsage = 0;
+		for (const auto& chunk : mChunks)
+		{
+			memoryUsage += chunk.second->GetMemoryUsage();
+		}
+		return memoryUsage;
+	}
+
+	void CubeWorld::UnmapChunks()
+	{
+		for (auto& chunk : mChunks)
+		{
+			chunk.second->Unmap();
+		}
+		mpMappedFile.reset();
+	}
+
+	std::vector<CubeCoord> CubeWorld::TakeDirtyChunks()
+	{
+		std::vector<CubeCoord> dirtyChunks(mDirtyChunks.begin(), mDirtyChunks.end());
+		mDirtyChunks.clear();
+		return dirtyChunks;
+	}
+
+	std::vector<CubeCoord> CubeWorld::TakeEditedChunks()
+	{
+		std::vector<CubeCoord> editedChunks(mEditedChunks.begin(), mEditedChunks.end());
+		mEditedChunks.clear();
+		return editedChunks;
+	}
+
+	void CubeWorld::MarkChunkDirty(const CubeCoord& aChunkCoord)
+	{
+		mDirtyChunks.insert(aChunkCoord);
+	}
+
+	void CubeWorld::MarkAllChunksDirty()
+	{
+		for (const auto& chunk : mChunks)
+		{
+			mDirtyChunks.insert(chunk.first);
+		}
+	}
+
+	void CubeWorld::PrivMarkCellDirty(const int32_t aX, const int32_t aY, const int32_t aZ)
+	{
+		const CubeCoord chunkCoord = toChunkCoord(aX, aY, aZ);
+		mDirtyChunks.insert(chunkCoord);
+		mEditedChunks.insert(chunkCoord);
+
+		//	the chunks around an edge or a corner sample the cell for their ambient occlusion
+		const int32_t localCell[3] = { aX & CUBE_CHUNK_MASK, aY & CUBE_CHUNK_MASK, aZ & CUBE_CHUNK_MASK };
+		int32_t minOffset[3];
+		int32_t maxOffset[3];
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			minOffset[axis] = localCell[axis] == 0 ? -1 : 0;
+			maxOffset[axis] = localCell[axis] == CUBE_CHUNK_MASK ? 1 : 0;
+		}
+		for (int32_t y = minOffset[1]; y <= maxOffset[1]; y++)
+		{
+			for (int32_t z = minOffset[2]; z <= maxOffset[2]; z++)
+			{
+				for (int32_t x = minOffset[0]; x <= maxOffset[0]; x++)
+				{
+					mDirtyChunks.insert({ chunkCoord.mX + x, chunkCoord.mY + y, chunkCoord.mZ + z });
+				}
+			}
+		}
+	}
+
+	void CubeWorld::PrivMarkChunkAndNeighboursDirty(const CubeCoord& aChunkCoord)
+	{
+		mEditedChunks.insert(aChunkCoord);
+		for (int32_t y = -1; y <= 1; y++)
+		{
+			for (int32_t z = -1; z <= 1; z++)
+			{
+				for (int32_t x = -1; x <= 1; x++)
+				{
+					mDirtyChunks.insert({ aChunkCoord.mX + x, aChunkCoord.mY + y, aChunkCoord.mZ + z });
+				}
+			}
+		}
+	}
+
+	void CubeWorld::PrivGrowBounds(const int32_t aX, const int32_t aY, const int32_t aZ)
+	{
+		mMinCell.mX = std::min(mMinCell.mX, aX);
+		mMinCell.mY = std::min(mMinCell.mY, aY);
+		mMinCell.mZ = std::min(mMinCell.mZ, aZ);
+		mMaxCell.mX = std::max(mMaxCell.mX, aX + 1);
+		mMaxCell.mY = std::max(mMaxCell.mY, aY + 1);
+		mMaxCell.mZ = std::max(mMaxCell.mZ, aZ + 1);
+	}
+
+	std::shared_ptr<CubeWorld> createCubeWorldFromBinaryFile(LPCSTR aFilename, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ)
+	{
+		std::ifstream cubeFile(aFilename, std::ios::binary);
+		if (!cubeFile.is_open())
+		{
+			return nullptr;
+		}
+
+		std::vector<char> data(aSizeX * aSizeY * aSizeZ);
+		if (!data.empty())
+		{
+			cubeFile.read(data.data(), data.size());
+		}
+		return createCubeWorldFromMemory(data.data(), data.size(), aSizeX, aSizeY, aSizeZ);
+	}
+
+	std::shared_ptr<CubeWorld> createCubeWorldFromMemory(const char* apData, const size_t aDataSize, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ)
+	{
+		constexpr size_t MAX_AXIS_SIZE = static_cast<size_t>(std::numeric_limits<int32_t>::max());
+		if (aSizeX > MAX_AXIS_SIZE ||
+			aSizeY > MAX_AXIS_SIZE ||
+			aSizeZ > MAX_AXIS_SIZE ||
+			aDataSize < aSizeX * aSizeY * aSizeZ)
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<CubeWorld> pCubeWorld = std::make_shared<CubeWorld>(aSizeX, aSizeY, aSizeZ);
+
+		//	the cube world is stored left to right (x++), back to front (z++), bottom to top (y++),
+		//	only chunks with cubes in them are created
+		const char* pCell = apData;
+		for (int32_t y = 0; y < static_cast<int32_t>(aSizeY); y++)
+		{
+			for (int32_t z = 0; z < static_cast<int32_t>(aSizeZ); z++)
+			{
+				for (int32_t x = 0; x < static_cast<int32_t>(aSizeX); x++, pCell++)
+				{
+					if (*pCell != 0)
+					{
+						pCubeWorld->Set(x, y, z, *pCell);
+					}
+				}
+			}
+		}
+
+		//	loading writes every cell once, so the chunks are only compressed at the end
+		pCubeWorld->CompressChunks();
+		return pCubeWorld;
+	}
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tde
+{
+	class MappedFile;
+
+	using CubeCell = char;
+
+	constexpr static CubeCell HAS_CUBE = 0X01;
+
+	//	the other 7 bits of a cell with a cube are its material, an index into the material table of the renderer
+	constexpr static int32_t CUBE_MATERIAL_SHIFT = 1;
+	constexpr static uint32_t CUBE_MATERIAL_COUNT = 1 << (8 - CUBE_MATERIAL_SHIFT);
+
+	inline constexpr CubeCell makeCubeCell(const uint32_t aMaterial)
+	{
+		return static_cast<CubeCell>((aMaterial << CUBE_MATERIAL_SHIFT) | HAS_CUBE);
+	}
+
+	inline constexpr uint32_t getCubeMaterial(const CubeCell aCell)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(aCell)) >> CUBE_MATERIAL_SHIFT;
+	}
+
+	//	the world is made of cubic chunks of 32 x 32 x 32 cells
+	constexpr static int32_t CUBE_CHUNK_SIZE_LOG2 = 5;
+	constexpr static int32_t CUBE_CHUNK_SIZE = 1 << CUBE_CHUNK_SIZE_LOG2;
+	constexpr static int32_t CUBE_CHUNK_MASK = CUBE_CHUNK_SIZE - 1;
+	constexpr static size_t CUBE_CHUNK_CELL_COUNT = CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE;
+
+	//	a cell or a chunk position, cells can have negative coordinates
+	struct CubeCoord
+	{
+		int32_t mX = 0;
+		int32_t mY = 0;
+		int32_t mZ = 0;
+
+		inline bool operator==(const CubeCoord& aOther) const { return mX == aOther.mX && mY == aOther.mY && mZ == aOther.mZ; }
+		inline bool operator!=(const CubeCoord& aOther) const { return !(*this == aOther); }
+	};
+
+	struct CubeCoordHash
+	{
+		inline size_t operator()(const CubeCoord& aCoord) const
+		{
+			//	neighbouring chunks should land in different buckets
+			uint64_t hash = static_cast<uint32_t>(aCoord.mX) * 0x9E3779B97F4A7C15ull;
+			hash ^= static_cast<uint32_t>(aCoord.mY) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+			hash ^= static_cast<uint32_t>(aCoord.mZ) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	//	arithmetic shift and mask, so negative cells go to the chunk below them
+	inline CubeCoord toChunkCoord(const int32_t aX, const int32_t aY, const int32_t aZ)
+	{
+		return { aX >> CUBE_CHUNK_SIZE_LOG2, aY >> CUBE_CHUNK_SIZE_LOG2, aZ >> CUBE_CHUNK_SIZE_LOG2 };
+	}
+
+	//	how the cells of a chunk are kept in memory, Compress picks the smallest one
+	enum class CubeChunkStorage : uint8_t
+	{
+		UNIFORM,	//	every cell has the same value, nothing is allocated
+		PALETTE,	//	1, 2 or 4 bit indices into up to 16 distinct cells
+		RUN_LENGTH,	//	runs of equal cells along y for every column
+		RAW,		//	one byte per cell
+	};
+
+	//	what is needed besides the data to read a compressed chunk, e.g. from a cube world file
+	struct CubeChunkEncoding
+	{
+		CubeChunkStorage mStorage;
+		CubeCell mUniformCell;
+		uint8_t mPaletteIndexBits;
+		uint8_t mPaletteSize;
+	};
+
+	class CubeChunk
+	{
+	public:
+		constexpr static size_t MAX_PALETTE_SIZE = 16;
+
+		//	the cells are laid out like the binary file, x++ first, then z++, then y++
+		static inline size_t CellIndex(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ)
+		{
+			return (static_cast<size_t>(aLocalY) << (CUBE_CHUNK_SIZE_LOG2 * 2)) | (static_cast<size_t>(aLocalZ) << CUBE_CHUNK_SIZE_LOG2) | static_cast<size_t>(aLocalX);
+		}
+
+		//	starts uniformly empty
+		CubeChunk();
+
+		//	unchecked, the coordinates must be within [0, CUBE_CHUNK_SIZE)
+		inline CubeCell Get(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ) const
+		{
+			switch (mStorage)
+			{
+			case CubeChunkStorage::UNIFORM:
+				return mUniformCell;
+			case CubeChunkStorage::RAW:
+				return mpRawCells[CellIndex(aLocalX, aLocalY, aLocalZ)];
+			default:
+				return PrivGetCompressed(aLocalX, aLocalY, aLocalZ);
+			}
+		}
+		//	palette chunks are written in place as long as the palette has room, otherwise the chunk is expanded to raw cells
+		inline void Set(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ, const CubeCell aCell)
+		{
+			if (mStorage == CubeChunkStorage::RAW && !mIsMapped)
+			{
+				mpCells[CellIndex(aLocalX, aLocalY, aLocalZ)] = aCell;
+				mIsCompressionPending = true;
+				return;
+			}
+			PrivSetCompressed(aLocalX, aLocalY, aLocalZ, aCell);
+		}
+
+		bool IsEmpty() const;
+		//	true if every cell is aOutCell
+		bool IsUniform(CubeCell& aOutCell) const;
+
+		//	the cells in CellIndex order, nullptr if the chunk is compressed
+		inline const CubeCell* GetRawCells() const { return mpRawCells; }
+		//	expands the chunk to raw cells, it stays expanded until the next Compress
+		CubeCell* GetMutableCells();
+		//	decompresses CUBE_CHUNK_SIZE cells, x++
+		void CopyRow(const int32_t aLocalY, const int32_t aLocalZ, CubeCell* apOutCells) const;
+		//	decompresses all cells in CellIndex order
+		void CopyCells(CubeCell* apOutCells) const;
+
+		//	switches to the smallest storage for the current cells
+		void Compress();
+		//	the chunk has been written since it was last compressed
+		inline bool IsCompressionPending() const { return mIsCompressionPending; }
+		inline CubeChunkStorage GetStorage() const { return mStorage; }
+		//	bytes of this chunk and its allocations, mapped data isn't counted
+		size_t GetMemoryUsage() const;
+
+		CubeChunkEncoding GetEncoding() const;
+		//	appends the data which MapEncodedData reads back
+		void AppendEncodedData(std::vector<uint8_t>& aOutData) const;
+		//	reads the cells straight from apData instead of copying them, the data is copied before the first write,
+		//	so it only has to outlive the chunk, returns false if the size doesn't match the encoding or the data could be read out of bounds
+		bool MapEncodedData(const CubeChunkEncoding& aEncoding, const uint8_t* apData, const size_t aDataSize);
+		//	copies mapped data into the chunk's own storage, so the data doesn't have to outlive it anymore
+		inline void Unmap()
+		{
+			if (mIsMapped)
+			{
+				PrivCopyMappedData();
+			}
+		}
+
+	private:
+		CubeCell PrivGetCompressed(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ) const;
+		void PrivSetCompressed(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ, const CubeCell aCell);
+
+		inline uint8_t PrivGetPaletteIndex(const size_t aCellIndex) const
+		{
+			const size_t bit = aCellIndex * mPaletteIndexBits;
+			return (mpData[bit >> 3] >> (bit & 7)) & ((1 << mPaletteIndexBits) - 1);
+		}
+		void PrivSetPaletteIndex(const size_t aCellIndex, const uint8_t aPaletteIndex);
+		//	repacks the indices with more bits per index
+		void PrivWidenPalette(const uint8_t aPaletteIndexBits);
+		void PrivExpand();
+		//	copies mapped data into the chunk's own storage
+		void PrivCopyMappedData();
+		//	points the views to the chunk's own storage
+		void PrivUpdateViews();
+		void PrivEncodePalette(const CubeCell* apCells, const std::vector<CubeCell>& aPalette);
+		void PrivEncodeRunLength(const CubeCell* apCells);
+
+		CubeChunkStorage mStorage = CubeChunkStorage::UNIFORM;
+		CubeCell mUniformCell = 0;
+		uint8_t mPaletteIndexBits = 0;
+		uint8_t mPaletteSize = 0;
+		bool mIsCompressionPending = false;
+		bool mIsMapped = false;
+
+		//	what reads go through, they point to the storage below or into mapped data
+		const CubeCell* mpPalette = nullptr;
+		const uint8_t* mpData = nullptr;
+		const uint16_t* mpColumnRuns = nullptr;
+		const CubeCell* mpRawCells = nullptr;
+
+		std::vector<CubeCell> mPalette;
+		//	packed palette indices, or (cell, length) pairs of the runs
+		std::vector<uint8_t> mData;
+		//	the first run of every column (z, x) in mData, plus one past the last run
+		std::vector<uint16_t> mColumnRuns;
+		std::unique_ptr<CubeCell[]> mpCells;
+	};
+
+	//	sparse world of chunks, only chunks which have been written to take memory, and those are compressed
+	//	the bounds cover every cell which has been set, plus the size the world was created with,
+	//	they are what the renderer centers on and what the checked At is tested against
+	//	writes mark the chunk dirty, and the neighbours whose faces or occlusion it may change, so renderers only remesh what changed
+	//	reading from several threads is fine as long as nobody writes
+	class CubeWorld
+	{
+	public:
+		using ChunkMap = std::unordered_map<CubeCoord, std::unique_ptr<CubeChunk>, CubeCoordHash>;
+
+		CubeWorld() = default;
+		//	starts with the bounds [0, size) on every axis
+		CubeWorld(const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ);
+		//	starts with the bounds [aMinCell, aMaxCell)
+		CubeWorld(const CubeCoord& aMinCell, const CubeCoord& aMaxCell);
+
+		//	checked, for tools, throws if the cell is out of the bounds, creates the chunk if it doesn't exist,
+		//	the cell is marked dirty as it's about to be written and its chunk is expanded to raw cells
+		CubeCell& At(const int32_t aX, const int32_t aY, const int32_t aZ);
+
+		//	unchecked, cells in chunks which don't exist are empty
+		//	inner loops should look up the chunk once and read its cells instead
+		inline CubeCell Get(const int32_t aX, const int32_t aY, const int32_t aZ) const
+		{
+			const CubeChunk* pChunk = FindChunk(toChunkCoord(aX, aY, aZ));
+			return pChunk ? pChunk->Get(aX & CUBE_CHUNK_MASK, aY & CUBE_CHUNK_MASK, aZ & CUBE_CHUNK_MASK) : 0;
+		}
+		//	grows the bounds, setting an empty cell doesn't create a chunk
+		void Set(const int32_t aX, const int32_t aY, const int32_t aZ, const CubeCell aCell);
+
+		const CubeChunk* FindChunk(const CubeCoord& aChunkCoord) const;
+		CubeChunk* FindChunk(const CubeCoord& aChunkCoord);
+		CubeChunk& GetOrCreateChunk(const CubeCoord& aChunkCoord);
+		//	replaces the chunk, it's marked dirty with its neighbours as their borders may have changed
+		void AddChunk(const CubeCoord& aChunkCoord, std::unique_ptr<CubeChunk> apChunk);
+		//	the chunk and its neighbours are marked dirty like in AddChunk
+		void RemoveChunk(const CubeCoord& aChunkCoord);
+		//	frees the chunks which have been cleared, they are marked dirty so their meshes are dropped
+		void RemoveEmptyChunks();
+		//	compresses the chunks which have been written since, call it after a batch of edits
+		void CompressChunks();
+		//	bytes held by the chunks
+		size_t GetChunkMemoryUsage() const;
+
+		//	chunks which have been written since the last call, some of them may not exist anymore
+		std::vector<CubeCoord> TakeDirtyChunks();
+		void MarkChunkDirty(const CubeCoord& aChunkCoord);
+		void MarkAllChunksDirty();
+		inline bool HasDirtyChunks() const { return !mDirtyChunks.empty(); }
+		//	chunks whose cells changed since the last call, without the neighbours the dirty chunks include,
+		//	for indices over the cells like CubeWorldOctree
+		std::vector<CubeCoord> TakeEditedChunks();
+
+		inline const ChunkMap& GetChunks() const { return mChunks; }
+		inline size_t GetChunkCount() const { return mChunks.size(); }
+
+		inline bool IsInBounds(const int32_t aX, const int32_t aY, const int32_t aZ) const
+		{
+			return aX >= mMinCell.mX && aX < mMaxCell.mX && aY >= mMinCell.mY && aY < mMaxCell.mY && aZ >= mMinCell.mZ && aZ < mMaxCell.mZ;
+		}
+		//	inclusive
+		inline const CubeCoord& GetMinCell() const { return mMinCell; }
+		//	exclusive
+		inline const CubeCoord& GetMaxCell() const { return mMaxCell; }
+		inline size_t GetSizeX() const { return static_cast<size_t>(mMaxCell.mX - mMinCell.mX); }
+		inline size_t GetSizeY() const { return static_cast<size_t>(mMaxCell.mY - mMinCell.mY); }
+		inline size_t GetSizeZ() const { return static_cast<size_t>(mMaxCell.mZ - mMinCell.mZ); }
+
+		//	keeps the file alive which mapped chunks read from
+		inline void SetMappedFile(std::shared_ptr<MappedFile> apMappedFile) { mpMappedFile = std::move(apMappedFile); }
+		inline const std::shared_ptr<MappedFile>& GetMappedFile() const { return mpMappedFile; }
+		//	copies the cells of the mapped chunks and lets go of the file, e.g. before it's overwritten
+		void UnmapChunks();
+
+	private:
+		void PrivGrowBounds(const int32_t aX, const int32_t aY, const int32_t aZ);
+		//	the faces of the neighbouring chunks depend on cells on the border
+		void PrivMarkCellDirty(const int32_t aX, const int32_t aY, const int32_t aZ);
+		void PrivMarkChunkAndNeighboursDirty(const CubeCoord& aChunkCoord);
+
+		//	destroyed after the chunks which point into it
+		std::shared_ptr<MappedFile> mpMappedFile;
+		ChunkMap mChunks;
+		std::unordered_set<CubeCoord, CubeCoordHash> mDirtyChunks;
+		std::unordered_set<CubeCoord, CubeCoordHash> mEditedChunks;
+		CubeCoord mMinCell;
+		CubeCoord mMaxCell;
+	};
+
+	std::shared_ptr<CubeWorld> createCubeWorldFromBinaryFile(LPCSTR aFilename, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ);
+	//	same layout as the binary file, for data which has already been read, e.g. by readFileAsync
+	std::shared_ptr<CubeWorld> createCubeWorldFromMemory(const char* apData, const size_t aDataSize, const size_t aSizeX, const size_t aSizeY, const size_t aSizeZ);
+}
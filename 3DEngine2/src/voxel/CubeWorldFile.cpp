@@ -0,0 +1,218 @@
+#include "pch.h"
+#include "voxel/CubeWorldFile.h"
+#include "common/MappedFile.h"
+
+#include <fstream>
+#include <filesystem>
+
+namespace tde
+{
+	namespace
+	{
+		inline size_t alignDataOffset(const size_t aOffset)
+		{
+			return (aOffset + CUBE_WORLD_FILE_DATA_ALIGNMENT - 1) & ~(CUBE_WORLD_FILE_DATA_ALIGNMENT - 1);
+		}
+
+		inline bool isChunkInRange(const CubeCoord& aChunkCoord, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk)
+		{
+			return aChunkCoord.mX >= aMinChunk.mX && aChunkCoord.mX <= aMaxChunk.mX &&
+				aChunkCoord.mY >= aMinChunk.mY && aChunkCoord.mY <= aMaxChunk.mY &&
+				aChunkCoord.mZ >= aMinChunk.mZ && aChunkCoord.mZ <= aMaxChunk.mZ;
+		}
+	}
+
+	uint32_t computeCubeWorldFileChecksum(const uint8_t* apData, const size_t aSize)
+	{
+		uint32_t checksum = 0x811C9DC5;
+		for (size_t i = 0; i < aSize; i++)
+		{
+			checksum = (checksum ^ apData[i]) * 0x01000193;
+		}
+		return checksum;
+	}
+
+	bool saveCubeWorldFile(CubeWorld& aCubeWorld, const std::wstring& aPath)
+	{
+		//	bottom to top, back to front, left to right, so neighbouring chunks are close in the file
+		std::vector<std::pair<CubeCoord, const CubeChunk*>> chunks;
+		chunks.reserve(aCubeWorld.GetChunkCount());
+		for (const auto& chunk : aCubeWorld.GetChunks())
+		{
+			chunks.emplace_back(chunk.first, chunk.second.get());
+		}
+		std::sort(chunks.begin(), chunks.end(), [](const auto& aLeft, const auto& aRight)
+		{
+			return std::tie(aLeft.first.mY, aLeft.first.mZ, aLeft.first.mX) < std::tie(aRight.first.mY, aRight.first.mZ, aRight.first.mX);
+		});
+
+		std::vector<CubeWorldFileChunk> chunkTable(chunks.size());
+		std::vector<uint8_t> chunkData;
+		const size_t dataOffset = alignDataOffset(sizeof(CubeWorldFileHeader) + chunkTable.size() * sizeof(CubeWorldFileChunk));
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			chunkData.resize(alignDataOffset(chunkData.size()), 0);
+			const size_t chunkDataOffset = chunkData.size();
+			chunks[i].second->AppendEncodedData(chunkData);
+
+			CubeWorldFileChunk& entry = chunkTable[i];
+			entry.mCoord = chunks[i].first;
+			entry.mEncoding = chunks[i].second->GetEncoding();
+			entry.mDataOffset = dataOffset + chunkDataOffset;
+			entry.mDataSize = static_cast<uint32_t>(chunkData.size() - chunkDataOffset);
+			entry.mChecksum = computeCubeWorldFileChecksum(chunkData.data() + chunkDataOffset, entry.mDataSize);
+		}
+
+		CubeWorldFileHeader header = {};
+		header.mMagic = CUBE_WORLD_FILE_MAGIC;
+		header.mVersion = CUBE_WORLD_FILE_VERSION;
+		header.mMinCell = aCubeWorld.GetMinCell();
+		header.mMaxCell = aCubeWorld.GetMaxCell();
+		header.mChunkSizeLog2 = CUBE_CHUNK_SIZE_LOG2;
+		header.mChunkCount = static_cast<uint32_t>(chunkTable.size());
+		header.mChunkTableOffset = sizeof(CubeWorldFileHeader);
+		header.mChunkTableChecksum = computeCubeWorldFileChecksum(reinterpret_cast<const uint8_t*>(chunkTable.data()), chunkTable.size() * sizeof(CubeWorldFileChunk));
+
+		//	written next to the file first, so a failed save never leaves a broken file behind
+		const std::filesystem::path path(aPath);
+		std::filesystem::path tempPath = path;
+		tempPath += L".tmp";
+		{
+			std::ofstream cubeFile(tempPath, std::ios::binary | std::ios::trunc);
+			if (!cubeFile.is_open())
+			{
+				return false;
+			}
+			const char padding[CUBE_WORLD_FILE_DATA_ALIGNMENT] = {};
+			cubeFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			cubeFile.write(reinterpret_cast<const char*>(chunkTable.data()), chunkTable.size() * sizeof(CubeWorldFileChunk));
+			cubeFile.write(padding, dataOffset - sizeof(CubeWorldFileHeader) - chunkTable.size() * sizeof(CubeWorldFileChunk));
+			cubeFile.write(reinterpret_cast<const char*>(chunkData.data()), chunkData.size());
+			cubeFile.close();
+			if (cubeFile.fail())
+			{
+				std::error_code error;
+				std::filesystem::remove(tempPath, error);
+				return false;
+			}
+		}
+
+		//	a world loaded from this file still reads its chunks from it, the file can't be replaced while it's mapped
+		//	and the chunks mustn't see the new data
+		std::error_code error;
+		if (aCubeWorld.GetMappedFile() && std::filesystem::equivalent(aCubeWorld.GetMappedFile()->GetPath(), path, error))
+		{
+			aCubeWorld.UnmapChunks();
+		}
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+		{
+			//	someone else still has the file open, e.g. a CubeWorldStreamer
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	std::shared_ptr<CubeWorld> loadCubeWorldFile(const std::wstring& aPath, const bool aVerifyChecksums)
+	{
+		constexpr int32_t MIN_CHUNK = std::numeric_limits<int32_t>::min();
+		constexpr int32_t MAX_CHUNK = std::numeric_limits<int32_t>::max();
+		return loadCubeWorldFile(aPath, { MIN_CHUNK, MIN_CHUNK, MIN_CHUNK }, { MAX_CHUNK, MAX_CHUNK, MAX_CHUNK }, aVerifyChecksums);
+	}
+
+	std::shared_ptr<CubeWorld> loadCubeWorldFile(const std::wstring& aPath, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk,
+		const bool aVerifyChecksums)
+	{
+		CubeWorldFileReader reader(aPath);
+		if (!reader.IsOpen())
+		{
+			return nullptr;
+		}
+
+		std::shared_ptr<CubeWorld> pCubeWorld = std::make_shared<CubeWorld>(reader.GetHeader().mMinCell, reader.GetHeader().mMaxCell);
+		for (size_t i = 0; i < reader.GetChunkCount(); i++)
+		{
+			const CubeWorldFileChunk& entry = reader.GetChunks()[i];
+			if (!isChunkInRange(entry.mCoord, aMinChunk, aMaxChunk))
+			{
+				continue;
+			}
+			if (std::unique_ptr<CubeChunk> pChunk = reader.LoadChunk(entry, aVerifyChecksums))
+			{
+				pCubeWorld->AddChunk(entry.mCoord, std::move(pChunk));
+			}
+		}
+
+		pCubeWorld->SetMappedFile(reader.GetMappedFile());
+		return pCubeWorld;
+	}
+
+	CubeWorldFileReader::CubeWorldFileReader(const std::wstring& aPath)
+		: mpFile(std::make_shared<MappedFile>(aPath))
+		, mHeader{}
+		, mpChunkTable(nullptr)
+	{
+		if (!mpFile->IsOpen() || mpFile->GetSize() < sizeof(CubeWorldFileHeader))
+		{
+			return;
+		}
+
+		const uint8_t* pFileData = mpFile->GetData();
+		const size_t fileSize = mpFile->GetSize();
+		std::memcpy(&mHeader, pFileData, sizeof(mHeader));
+		if (mHeader.mMagic != CUBE_WORLD_FILE_MAGIC ||
+			mHeader.mVersion != CUBE_WORLD_FILE_VERSION ||
+			mHeader.mChunkSizeLog2 != CUBE_CHUNK_SIZE_LOG2 ||
+			mHeader.mChunkTableOffset > fileSize ||
+			mHeader.mChunkTableOffset % alignof(CubeWorldFileChunk) != 0 ||
+			mHeader.mChunkCount > (fileSize - mHeader.mChunkTableOffset) / sizeof(CubeWorldFileChunk))
+		{
+			return;
+		}
+
+		//	the table is small and every load reads it, so it's always verified
+		const CubeWorldFileChunk* pChunkTable = reinterpret_cast<const CubeWorldFileChunk*>(pFileData + mHeader.mChunkTableOffset);
+		if (computeCubeWorldFileChecksum(reinterpret_cast<const uint8_t*>(pChunkTable), mHeader.mChunkCount * sizeof(CubeWorldFileChunk)) != mHeader.mChunkTableChecksum)
+		{
+			return;
+		}
+
+		mChunkIndices.reserve(mHeader.mChunkCount);
+		for (uint32_t i = 0; i < mHeader.mChunkCount; i++)
+		{
+			mChunkIndices[pChunkTable[i].mCoord] = i;
+		}
+		mpChunkTable = pChunkTable;
+	}
+
+	const CubeWorldFileChunk* CubeWorldFileReader::FindChunk(const CubeCoord& aChunkCoord) const
+	{
+		auto indexIt = mChunkIndices.find(aChunkCoord);
+		return indexIt != mChunkIndices.end() ? mpChunkTable + indexIt->second : nullptr;
+	}
+
+	std::unique_ptr<CubeChunk> CubeWorldFileReader::LoadChunk(const CubeWorldFileChunk& aEntry, const bool aVerifyChecksum) const
+	{
+		const size_t fileSize = mpFile->GetSize();
+		if (aEntry.mDataOffset > fileSize ||
+			aEntry.mDataSize > fileSize - aEntry.mDataOffset ||
+			aEntry.mDataOffset % CUBE_WORLD_FILE_DATA_ALIGNMENT != 0)
+		{
+			return nullptr;
+		}
+
+		const uint8_t* pChunkData = mpFile->GetData() + aEntry.mDataOffset;
+		if (aVerifyChecksum && computeCubeWorldFileChecksum(pChunkData, aEntry.mDataSize) != aEntry.mChecksum)
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<CubeChunk> pChunk = std::make_unique<CubeChunk>();
+		if (!pChunk->MapEncodedData(aEntry.mEncoding, pChunkData, aEntry.mDataSize))
+		{
+			return nullptr;
+		}
+		return pChunk;
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	constexpr static uint32_t CUBE_WORLD_FILE_MAGIC = 0x57434454;	//	"TDCW"
+	constexpr static uint32_t CUBE_WORLD_FILE_VERSION = 1;
+	//	the encoded data of every chunk starts on this alignment, so it can be read in place
+	constexpr static size_t CUBE_WORLD_FILE_DATA_ALIGNMENT = 8;
+
+	//	a cube world file is the header, the chunk table and the encoded data of the chunks, all little endian
+	struct CubeWorldFileHeader
+	{
+		uint32_t mMagic;
+		uint32_t mVersion;
+		CubeCoord mMinCell;
+		CubeCoord mMaxCell;
+		uint32_t mChunkSizeLog2;	//	files written with another chunk size are rejected
+		uint32_t mChunkCount;
+		uint64_t mChunkTableOffset;
+		uint32_t mChunkTableChecksum;
+		uint32_t mPadding;
+	};
+
+	struct CubeWorldFileChunk
+	{
+		CubeCoord mCoord;
+		CubeChunkEncoding mEncoding;
+		uint64_t mDataOffset;
+		uint32_t mDataSize;
+		uint32_t mChecksum;	//	of the encoded data
+	};
+
+	static_assert(sizeof(CubeWorldFileHeader) == 56, "the cube world file header must not change its layout");
+	static_assert(sizeof(CubeWorldFileChunk) == 32, "the cube world file chunk must not change its layout");
+
+	class MappedFile;
+
+	//	an open cube world file whose chunks can be loaded one at a time, e.g. by CubeWorldStreamer,
+	//	loading chunks from several threads at once is fine
+	class CubeWorldFileReader
+	{
+	public:
+		//	only reads the header and the chunk table
+		explicit CubeWorldFileReader(const std::wstring& aPath);
+		CubeWorldFileReader(const CubeWorldFileReader& aOther) = delete;
+		CubeWorldFileReader& operator=(const CubeWorldFileReader& aOther) = delete;
+
+		//	false if the file can't be mapped or its header or chunk table is damaged
+		inline bool IsOpen() const { return mpChunkTable != nullptr; }
+		inline const CubeWorldFileHeader& GetHeader() const { return mHeader; }
+		inline const CubeWorldFileChunk* GetChunks() const { return mpChunkTable; }
+		inline size_t GetChunkCount() const { return mpChunkTable ? mHeader.mChunkCount : 0; }
+		//	nullptr if the file has no such chunk
+		const CubeWorldFileChunk* FindChunk(const CubeCoord& aChunkCoord) const;
+
+		//	the chunk reads from the mapping, so the mapped file must outlive it,
+		//	nullptr if the entry doesn't fit the file, the checksum doesn't match or the data doesn't fit the encoding
+		std::unique_ptr<CubeChunk> LoadChunk(const CubeWorldFileChunk& aEntry, const bool aVerifyChecksum) const;
+		inline const std::shared_ptr<MappedFile>& GetMappedFile() const { return mpFile; }
+
+	private:
+		std::shared_ptr<MappedFile> mpFile;
+		CubeWorldFileHeader mHeader;
+		const CubeWorldFileChunk* mpChunkTable;
+		std::unordered_map<CubeCoord, uint32_t, CubeCoordHash> mChunkIndices;
+	};
+
+	//	32 bit fnv-1a
+	uint32_t computeCubeWorldFileChecksum(const uint8_t* apData, const size_t aSize);
+
+	//	the chunks are written as they are, CubeWorld::CompressChunks first to keep the file small,
+	//	saving over the file the world was loaded from unmaps its chunks first,
+	//	returns false and leaves the old file as it was if it can't be written or replaced
+	bool saveCubeWorldFile(CubeWorld& aCubeWorld, const std::wstring& aPath);
+	//	maps the file and points the chunks into it, so loading only reads the header and the chunk table,
+	//	cells are paged in when they are first touched and copied when they are first written,
+	//	checksums are only verified on request since that reads the whole file, chunks which fail it are left out
+	std::shared_ptr<CubeWorld> loadCubeWorldFile(const std::wstring& aPath, const bool aVerifyChecksums = false);
+	//	only loads the chunks within [aMinChunk, aMaxChunk], the world keeps the bounds of the file
+	std::shared_ptr<CubeWorld> loadCubeWorldFile(const std::wstring& aPath, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk,
+		const bool aVerifyChecksums = false);
+}
@@ -0,0 +1,452 @@
+#include "pch.h"
+#include "voxel/CubeWorldGenerator.h"
+
+#include "common/CpuFeatures.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+
+#include <immintrin.h>
+
+namespace tde
+{
+	namespace
+	{
+		//	the scalar and the avx2 noise do the same float operations in the same order without fused multiply adds,
+		//	so the world doesn't depend on the cpu it was generated on
+
+		constexpr uint32_t HASH_X = 0x8DA6B343u;
+		constexpr uint32_t HASH_Y = 0xD8163841u;
+		constexpr uint32_t HASH_Z = 0xCB1AB31Fu;
+		constexpr uint32_t HASH_MIX = 0x27D4EB2Du;
+
+		constexpr uint32_t TERRAIN_SEED_SALT = 0x68E31DA4u;
+		constexpr uint32_t CAVE_SEED_SALT = 0xB5297A4Du;
+
+		//	the gradients are picked by the top bits of the hash, the low bits of a product are poorly mixed
+		inline uint32_t hashLattice(const uint32_t aSeed, const uint32_t aHashX, const uint32_t aHashY, const uint32_t aHashZ)
+		{
+			return (aSeed ^ aHashX ^ aHashY ^ aHashZ) * HASH_MIX;
+		}
+
+		inline float fade(const float aT)
+		{
+			return aT * aT * aT * (aT * (aT * 6.0f - 15.0f) + 10.0f);
+		}
+
+		inline float lerp(const float aA, const float aB, const float aT)
+		{
+			return aA + aT * (aB - aA);
+		}
+
+		//	8 gradients of the form (+-1, +-2) and (+-2, +-1)
+		inline float gradient2(const uint32_t aHash, const float aX, const float aY)
+		{
+			const uint32_t gradient = aHash >> 29;
+			const float u = gradient < 4 ? aX : aY;
+			const float v = gradient < 4 ? aY : aX;
+			return ((gradient & 1) ? -u : u) + ((gradient & 2) ? -(v + v) : (v + v));
+		}
+
+		//	the 12 edges of a cube, padded to 16 like in improved perlin noise
+		inline float gradient3(const uint32_t aHash, const float aX, const float aY, const float aZ)
+		{
+			const uint32_t gradient = aHash >> 28;
+			const float u = gradient < 8 ? aX : aY;
+			const float v = gradient < 4 ? aY : ((gradient | 2) == 14 ? aX : aZ);
+			return ((gradient & 1) ? -u : u) + ((gradient & 2) ? -v : v);
+		}
+
+		float gradientNoise2(const float aX, const float aY, const uint32_t aSeed)
+		{
+			const float floorX = std::floor(aX);
+			const float floorY = std::floor(aY);
+			const int32_t cellX = static_cast<int32_t>(floorX);
+			const int32_t cellY = static_cast<int32_t>(floorY);
+			const float x = aX - floorX;
+			const float y = aY - floorY;
+			const uint32_t hashX0 = static_cast<uint32_t>(cellX) * HASH_X;
+			const uint32_t hashX1 = static_cast<uint32_t>(cellX + 1) * HASH_X;
+			const uint32_t hashY0 = static_cast<uint32_t>(cellY) * HASH_Y;
+			const uint32_t hashY1 = static_cast<uint32_t>(cellY + 1) * HASH_Y;
+
+			const float n00 = gradient2(hashLattice(aSeed, hashX0, hashY0, 0), x, y);
+			const float n10 = gradient2(hashLattice(aSeed, hashX1, hashY0, 0), x - 1.0f, y);
+			const float n01 = gradient2(hashLattice(aSeed, hashX0, hashY1, 0), x, y - 1.0f);
+			const float n11 = gradient2(hashLattice(aSeed, hashX1, hashY1, 0), x - 1.0f, y - 1.0f);
+			const float u = fade(x);
+			return lerp(lerp(n00, n10, u), lerp(n01, n11, u), fade(y));
+		}
+
+		float gradientNoise3(const float aX, const float aY, const float aZ, const uint32_t aSeed)
+		{
+			const float floorX = std::floor(aX);
+			const float floorY = std::floor(aY);
+			const float floorZ = std::floor(aZ);
+			const int32_t cellX = static_cast<int32_t>(floorX);
+			const int32_t cellY = static_cast<int32_t>(floorY);
+			const int32_t cellZ = static_cast<int32_t>(floorZ);
+			const float x = aX - floorX;
+			const float y = aY - floorY;
+			const float z = aZ - floorZ;
+			const uint32_t hashX0 = static_cast<uint32_t>(cellX) * HASH_X;
+			const uint32_t hashX1 = static_cast<uint32_t>(cellX + 1) * HASH_X;
+			const uint32_t hashY0 = static_cast<uint32_t>(cellY) * HASH_Y;
+			const uint32_t hashY1 = static_cast<uint32_t>(cellY + 1) * HASH_Y;
+			const uint32_t hashZ0 = static_cast<uint32_t>(cellZ) * HASH_Z;
+			const uint32_t hashZ1 = static_cast<uint32_t>(cellZ + 1) * HASH_Z;
+
+			const float n000 = gradient3(hashLattice(aSeed, hashX0, hashY0, hashZ0), x, y, z);
+			const float n100 = gradient3(hashLattice(aSeed, hashX1, hashY0, hashZ0), x - 1.0f, y, z);
+			const float n010 = gradient3(hashLattice(aSeed, hashX0, hashY1, hashZ0), x, y - 1.0f, z);
+			const float n110 = gradient3(hashLattice(aSeed, hashX1, hashY1, hashZ0), x - 1.0f, y - 1.0f, z);
+			const float n001 = gradient3(hashLattice(aSeed, hashX0, hashY0, hashZ1), x, y, z - 1.0f);
+			const float n101 = gradient3(hashLattice(aSeed, hashX1, hashY0, hashZ1), x - 1.0f, y, z - 1.0f);
+			const float n011 = gradient3(hashLattice(aSeed, hashX0, hashY1, hashZ1), x, y - 1.0f, z - 1.0f);
+			const float n111 = gradient3(hashLattice(aSeed, hashX1, hashY1, hashZ1), x - 1.0f, y - 1.0f, z - 1.0f);
+			const float u = fade(x);
+			const float v = fade(y);
+			const float nearNoise = lerp(lerp(n000, n100, u), lerp(n010, n110, u), v);
+			const float farNoise = lerp(lerp(n001, n101, u), lerp(n011, n111, u), v);
+			return lerp(nearNoise, farNoise, fade(z));
+		}
+
+		inline __m256i hashLatticeAvx2(const __m256i aSeed, const __m256i aHashX, const __m256i aHashY, const __m256i aHashZ)
+		{
+			return _mm256_mullo_epi32(_mm256_xor_si256(_mm256_xor_si256(aSeed, aHashX), _mm256_xor_si256(aHashY, aHashZ)), _mm256_set1_epi32(static_cast<int32_t>(HASH_MIX)));
+		}
+
+		inline __m256 fadeAvx2(const __m256 aT)
+		{
+			const __m256 inner = _mm256_add_ps(_mm256_mul_ps(aT, _mm256_sub_ps(_mm256_mul_ps(aT, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+			return _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(aT, aT), aT), inner);
+		}
+
+		inline __m256 lerpAvx2(const __m256 aA, const __m256 aB, const __m256 aT)
+		{
+			return _mm256_add_ps(aA, _mm256_mul_ps(aT, _mm256_sub_ps(aB, aA)));
+		}
+
+		//	flips the sign where the bit of the gradient is set, like the negations of the scalar version
+		inline __m256 flipSignAvx2(const __m256 aValue, const __m256i aGradient, const int32_t aBit)
+		{
+			const __m256i sign = _mm256_slli_epi32(_mm256_and_si256(aGradient, _mm256_set1_epi32(1 << aBit)), 31 - aBit);
+			return _mm256_xor_ps(aValue, _mm256_castsi256_ps(sign));
+		}
+
+		inline __m256 gradient2Avx2(const __m256i aHash, const __m256 aX, const __m256 aY)
+		{
+			const __m256i gradient = _mm256_srli_epi32(aHash, 29);
+			const __m256 isBelow4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), gradient));
+			const __m256 u = _mm256_blendv_ps(aY, aX, isBelow4);
+			const __m256 v = _mm256_blendv_ps(aX, aY, isBelow4);
+			return _mm256_add_ps(flipSignAvx2(u, gradient, 0), flipSignAvx2(_mm256_add_ps(v, v), gradient, 1));
+		}
+
+		inline __m256 gradient3Avx2(const __m256i aHash, const __m256 aX, const __m256 aY, const __m256 aZ)
+		{
+			const __m256i gradient = _mm256_srli_epi32(aHash, 28);
+			const __m256 isBelow8 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(8), gradient));
+			const __m256 isBelow4 = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(4), gradient));
+			const __m256 is12Or14 = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_or_si256(gradient, _mm256_set1_epi32(2)), _mm256_set1_epi32(14)));
+			const __m256 u = _mm256_blendv_ps(aY, aX, isBelow8);
+			const __m256 v = _mm256_blendv_ps(_mm256_blendv_ps(aZ, aX, is12Or14), aY, isBelow4);
+			return _mm256_add_ps(flipSignAvx2(u, gradient, 0), flipSignAvx2(v, gradient, 1));
+		}
+
+		inline void splitLatticeAvx2(const __m256 aValue, __m256i& aOutCell, __m256& aOutFraction)
+		{
+			const __m256 floorValue = _mm256_floor_ps(aValue);
+			aOutCell = _mm256_cvttps_epi32(floorValue);
+			aOutFraction = _mm256_sub_ps(aValue, floorValue);
+		}
+
+		__m256 gradientNoise2Avx2(const __m256 aX, const __m256 aY, const uint32_t aSeed)
+		{
+			__m256i cellX, cellY;
+			__m256 x, y;
+			splitLatticeAvx2(aX, cellX, x);
+			splitLatticeAvx2(aY, cellY, y);
+			const __m256i one = _mm256_set1_epi32(1);
+			const __m256i hashX0 = _mm256_mullo_epi32(cellX, _mm256_set1_epi32(static_cast<int32_t>(HASH_X)));
+			const __m256i hashX1 = _mm256_mullo_epi32(_mm256_add_epi32(cellX, one), _mm256_set1_epi32(static_cast<int32_t>(HASH_X)));
+			const __m256i hashY0 = _mm256_mullo_epi32(cellY, _mm256_set1_epi32(static_cast<int32_t>(HASH_Y)));
+			const __m256i hashY1 = _mm256_mullo_epi32(_mm256_add_epi32(cellY, one), _mm256_set1_epi32(static_cast<int32_t>(HASH_Y)));
+			const __m256i seed = _mm256_set1_epi32(static_cast<int32_t>(aSeed));
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f));
+			const __m256 y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f));
+
+			const __m256 n00 = gradient2Avx2(hashLatticeAvx2(seed, hashX0, hashY0, zero), x, y);
+			const __m256 n10 = gradient2Avx2(hashLatticeAvx2(seed, hashX1, hashY0, zero), x1, y);
+			const __m256 n01 = gradient2Avx2(hashLatticeAvx2(seed, hashX0, hashY1, zero), x, y1);
+			const __m256 n11 = gradient2Avx2(hashLatticeAvx2(seed, hashX1, hashY1, zero), x1, y1);
+			const __m256 u = fadeAvx2(x);
+			return lerpAvx2(lerpAvx2(n00, n10, u), lerpAvx2(n01, n11, u), fadeAvx2(y));
+		}
+
+		__m256 gradientNoise3Avx2(const __m256 aX, const __m256 aY, const __m256 aZ, const uint32_t aSeed)
+		{
+			__m256i cellX, cellY, cellZ;
+			__m256 x, y, z;
+			splitLatticeAvx2(aX, cellX, x);
+			splitLatticeAvx2(aY, cellY, y);
+			splitLatticeAvx2(aZ, cellZ, z);
+			const __m256i one = _mm256_set1_epi32(1);
+			const __m256i hashX0 = _mm256_mullo_epi32(cellX, _mm256_set1_epi32(static_cast<int32_t>(HASH_X)));
+			const __m256i hashX1 = _mm256_mullo_epi32(_mm256_add_epi32(cellX, one), _mm256_set1_epi32(static_cast<int32_t>(HASH_X)));
+			const __m256i hashY0 = _mm256_mullo_epi32(cellY, _mm256_set1_epi32(static_cast<int32_t>(HASH_Y)));
+			const __m256i hashY1 = _mm256_mullo_epi32(_mm256_add_epi32(cellY, one), _mm256_set1_epi32(static_cast<int32_t>(HASH_Y)));
+			const __m256i hashZ0 = _mm256_mullo_epi32(cellZ, _mm256_set1_epi32(static_cast<int32_t>(HASH_Z)));
+			const __m256i hashZ1 = _mm256_mullo_epi32(_mm256_add_epi32(cellZ, one), _mm256_set1_epi32(static_cast<int32_t>(HASH_Z)));
+			const __m256i seed = _mm256_set1_epi32(static_cast<int32_t>(aSeed));
+			const __m256 x1 = _mm256_sub_ps(x, _mm256_set1_ps(1.0f));
+			const __m256 y1 = _mm256_sub_ps(y, _mm256_set1_ps(1.0f));
+			const __m256 z1 = _mm256_sub_ps(z, _mm256_set1_ps(1.0f));
+
+			const __m256 n000 = gradient3Avx2(hashLatticeAvx2(seed, hashX0, hashY0, hashZ0), x, y, z);
+			const __m256 n100 = gradient3Avx2(hashLatticeAvx2(seed, hashX1, hashY0, hashZ0), x1, y, z);
+			const __m256 n010 = gradient3Avx2(hashLatticeAvx2(seed, hashX0, hashY1, hashZ0), x, y1, z);
+			const __m256 n110 = gradient3Avx2(hashLatticeAvx2(seed, hashX1, hashY1, hashZ0), x1, y1, z);
+			const __m256 n001 = gradient3Avx2(hashLatticeAvx2(seed, hashX0, hashY0, hashZ1), x, y, z1);
+			const __m256 n101 = gradient3Avx2(hashLatticeAvx2(seed, hashX1, hashY0, hashZ1), x1, y, z1);
+			const __m256 n011 = gradient3Avx2(hashLatticeAvx2(seed, hashX0, hashY1, hashZ1), x, y1, z1);
+			const __m256 n111 = gradient3Avx2(hashLatticeAvx2(seed, hashX1, hashY1, hashZ1), x1, y1, z1);
+			const __m256 u = fadeAvx2(x);
+			const __m256 v = fadeAvx2(y);
+			const __m256 nearNoise = lerpAvx2(lerpAvx2(n000, n100, u), lerpAvx2(n010, n110, u), v);
+			const __m256 farNoise = lerpAvx2(lerpAvx2(n001, n101, u), lerpAvx2(n011, n111, u), v);
+			return lerpAvx2(nearNoise, farNoise, fadeAvx2(z));
+		}
+
+		std::vector<CubeNoiseOctave> makeOctaves(const uint32_t aSeed, const float aScale, const int32_t aOctaveCount)
+		{
+			std::vector<CubeNoiseOctave> octaves(static_cast<size_t>(std::max(aOctaveCount, 0)));
+			float frequency = 1.0f / aScale;
+			float amplitude = 1.0f;
+			float amplitudeSum = 0.0f;
+			for (size_t octave = 0; octave < octaves.size(); octave++)
+			{
+				octaves[octave].mFrequency = frequency;
+				octaves[octave].mAmplitude = amplitude;
+				octaves[octave].mSeed = (aSeed + static_cast<uint32_t>(octave) * 0x9E3779B9u) * HASH_MIX;
+				amplitudeSum += amplitude;
+				frequency *= 2.0f;
+				amplitude *= 0.5f;
+			}
+			for (CubeNoiseOctave& octave : octaves)
+			{
+				octave.mAmplitude /= amplitudeSum;
+			}
+			return octaves;
+		}
+
+		int32_t computeHeight(const std::vector<CubeNoiseOctave>& aOctaves, const CubeWorldGeneratorSettings& aSettings, const int32_t aCellX, const int32_t aCellZ)
+		{
+			float noise = 0.0f;
+			for (const CubeNoiseOctave& octave : aOctaves)
+			{
+				noise = noise + octave.mAmplitude * gradientNoise2(static_cast<float>(aCellX) * octave.mFrequency, static_cast<float>(aCellZ) * octave.mFrequency, octave.mSeed);
+			}
+			return static_cast<int32_t>(std::floor(aSettings.mBaseHeight + aSettings.mHeightAmplitude * noise));
+		}
+
+		//	8 columns along x
+		void computeHeightsAvx2(const std::vector<CubeNoiseOctave>& aOctaves, const CubeWorldGeneratorSettings& aSettings, const int32_t aCellX, const int32_t aCellZ, int32_t* apOutHeights)
+		{
+			const __m256 cellX = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(aCellX), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+			const __m256 cellZ = _mm256_set1_ps(static_cast<float>(aCellZ));
+			__m256 noise = _mm256_setzero_ps();
+			for (const CubeNoiseOctave& octave : aOctaves)
+			{
+				const __m256 frequency = _mm256_set1_ps(octave.mFrequency);
+				const __m256 octaveNoise = gradientNoise2Avx2(_mm256_mul_ps(cellX, frequency), _mm256_mul_ps(cellZ, frequency), octave.mSeed);
+				noise = _mm256_add_ps(noise, _mm256_mul_ps(_mm256_set1_ps(octave.mAmplitude), octaveNoise));
+			}
+			const __m256 height = _mm256_add_ps(_mm256_set1_ps(aSettings.mBaseHeight), _mm256_mul_ps(_mm256_set1_ps(aSettings.mHeightAmplitude), noise));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(apOutHeights), _mm256_cvttps_epi32(_mm256_floor_ps(height)));
+		}
+
+		bool isCaveCell(const std::vector<CubeNoiseOctave>& aOctaves, const float aThreshold, const int32_t aCellX, const int32_t aCellY, const int32_t aCellZ)
+		{
+			float noise = 0.0f;
+			for (const CubeNoiseOctave& octave : aOctaves)
+			{
+				noise = noise + octave.mAmplitude * gradientNoise3(static_cast<float>(aCellX) * octave.mFrequency, static_cast<float>(aCellY) * octave.mFrequency,
+					static_cast<float>(aCellZ) * octave.mFrequency, octave.mSeed);
+			}
+			return noise > aThreshold;
+		}
+
+		//	bit i is set if the cell i along x is carved out
+		uint32_t computeCaveMaskAvx2(const std::vector<CubeNoiseOctave>& aOctaves, const float aThreshold, const int32_t aCellX, const int32_t aCellY, const int32_t aCellZ)
+		{
+			const __m256 cellX = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(aCellX), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+			const __m256 cellY = _mm256_set1_ps(static_cast<float>(aCellY));
+			const __m256 cellZ = _mm256_set1_ps(static_cast<float>(aCellZ));
+			__m256 noise = _mm256_setzero_ps();
+			for (const CubeNoiseOctave& octave : aOctaves)
+			{
+				const __m256 frequency = _mm256_set1_ps(octave.mFrequency);
+				const __m256 octaveNoise = gradientNoise3Avx2(_mm256_mul_ps(cellX, frequency), _mm256_mul_ps(cellY, frequency), _mm256_mul_ps(cellZ, frequency), octave.mSeed);
+				noise = _mm256_add_ps(noise, _mm256_mul_ps(_mm256_set1_ps(octave.mAmplitude), octaveNoise));
+			}
+			return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(noise, _mm256_set1_ps(aThreshold), _CMP_GT_OQ)));
+		}
+	}
+
+	CubeWorldGenerator::CubeWorldGenerator(const CubeWorldGeneratorSettings& aSettings)
+		: mSettings(aSettings)
+		, mTerrainOctaves(makeOctaves(aSettings.mSeed ^ TERRAIN_SEED_SALT, aSettings.mTerrainScale, aSettings.mTerrainOctaves))
+		, mCaveOctaves(makeOctaves(aSettings.mSeed ^ CAVE_SEED_SALT, aSettings.mCaveScale, aSettings.mCaveOctaves))
+	{
+	}
+
+	std::unique_ptr<CubeChunk> CubeWorldGenerator::GenerateChunk(const CubeCoord& aChunkCoord) const
+	{
+		int32_t heights[CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE];
+		PrivComputeHeights(aChunkCoord, heights);
+		const int32_t minCellY = aChunkCoord.mY << CUBE_CHUNK_SIZE_LOG2;
+		if (*std::max_element(std::begin(heights), std::end(heights)) < minCellY)
+		{
+			return nullptr;
+		}
+
+		uint32_t caveMasks[CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE];
+		PrivComputeCaveMasks(aChunkCoord, heights, caveMasks);
+
+		std::unique_ptr<CubeChunk> pChunk = std::make_unique<CubeChunk>();
+		CubeCell* pCells = pChunk->GetMutableCells();
+		for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+		{
+			for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+			{
+				const uint32_t caveMask = caveMasks[y * CUBE_CHUNK_SIZE + z];
+				CubeCell* pRow = &pCells[CubeChunk::CellIndex(0, y, z)];
+				for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+				{
+					const int32_t depth = heights[z * CUBE_CHUNK_SIZE + x] - (minCellY + y);
+					if (depth < 0 || (caveMask >> x) & 1)
+					{
+						pRow[x] = 0;
+					}
+					else
+					{
+						pRow[x] = depth == 0 ? mSettings.mSurfaceCell : (depth <= mSettings.mSoilDepth ? mSettings.mSoilCell : mSettings.mStoneCell);
+					}
+				}
+			}
+		}
+
+		pChunk->Compress();
+		if (pChunk->IsEmpty())
+		{
+			return nullptr;
+		}
+		return pChunk;
+	}
+
+	void CubeWorldGenerator::GenerateChunks(CubeWorld& aCubeWorld, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk) const
+	{
+		if (aMaxChunk.mX < aMinChunk.mX || aMaxChunk.mY < aMinChunk.mY || aMaxChunk.mZ < aMinChunk.mZ)
+		{
+			return;
+		}
+
+		const size_t sizeX = static_cast<size_t>(aMaxChunk.mX - aMinChunk.mX) + 1;
+		const size_t sizeZ = static_cast<size_t>(aMaxChunk.mZ - aMinChunk.mZ) + 1;
+		const size_t sizeY = static_cast<size_t>(aMaxChunk.mY - aMinChunk.mY) + 1;
+		auto getChunkCoord = [&](const size_t aIndex) -> CubeCoord
+		{
+			return { aMinChunk.mX + static_cast<int32_t>(aIndex % sizeX),
+				aMinChunk.mY + static_cast<int32_t>(aIndex / (sizeX * sizeZ)),
+				aMinChunk.mZ + static_cast<int32_t>(aIndex / sizeX % sizeZ) };
+		};
+
+		//	the chunks are only added once all are done, the world isn't safe to write from several threads
+		std::vector<std::unique_ptr<CubeChunk>> chunks(sizeX * sizeY * sizeZ);
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, chunks.size(), [&](const size_t aIndex)
+		{
+			chunks[aIndex] = GenerateChunk(getChunkCoord(aIndex));
+		}, 1);
+
+		for (size_t index = 0; index < chunks.size(); index++)
+		{
+			if (chunks[index])
+			{
+				aCubeWorld.AddChunk(getChunkCoord(index), std::move(chunks[index]));
+			}
+		}
+	}
+
+	void CubeWorldGenerator::PrivComputeHeights(const CubeCoord& aChunkCoord, int32_t* apOutHeights) const
+	{
+		const int32_t minCellX = aChunkCoord.mX << CUBE_CHUNK_SIZE_LOG2;
+		const int32_t minCellZ = aChunkCoord.mZ << CUBE_CHUNK_SIZE_LOG2;
+		const bool isAvx2 = isAvx2Supported();
+		for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+		{
+			int32_t* pRow = &apOutHeights[z * CUBE_CHUNK_SIZE];
+			if (isAvx2)
+			{
+				for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x += 8)
+				{
+					computeHeightsAvx2(mTerrainOctaves, mSettings, minCellX + x, minCellZ + z, pRow + x);
+				}
+			}
+			else
+			{
+				for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+				{
+					pRow[x] = computeHeight(mTerrainOctaves, mSettings, minCellX + x, minCellZ + z);
+				}
+			}
+		}
+	}
+
+	void CubeWorldGenerator::PrivComputeCaveMasks(const CubeCoord& aChunkCoord, const int32_t* apHeights, uint32_t* apOutMasks) const
+	{
+		std::fill_n(apOutMasks, CUBE_CHUNK_SIZE * CUBE_CHUNK_SIZE, 0u);
+		if (mCaveOctaves.empty())
+		{
+			return;
+		}
+
+		const int32_t minCellX = aChunkCoord.mX << CUBE_CHUNK_SIZE_LOG2;
+		const int32_t minCellY = aChunkCoord.mY << CUBE_CHUNK_SIZE_LOG2;
+		const int32_t minCellZ = aChunkCoord.mZ << CUBE_CHUNK_SIZE_LOG2;
+		const bool isAvx2 = isAvx2Supported();
+		for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+		{
+			//	rows above the terrain have nothing to carve
+			const int32_t* pHeights = &apHeights[z * CUBE_CHUNK_SIZE];
+			const int32_t rowHeight = *std::max_element(pHeights, pHeights + CUBE_CHUNK_SIZE);
+			for (int32_t y = 0; y < CUBE_CHUNK_SIZE && minCellY + y <= rowHeight; y++)
+			{
+				uint32_t& mask = apOutMasks[y * CUBE_CHUNK_SIZE + z];
+				if (isAvx2)
+				{
+					for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x += 8)
+					{
+						mask |= computeCaveMaskAvx2(mCaveOctaves, mSettings.mCaveThreshold, minCellX + x, minCellY + y, minCellZ + z) << x;
+					}
+				}
+				else
+				{
+					for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+					{
+						mask |= static_cast<uint32_t>(isCaveCell(mCaveOctaves, mSettings.mCaveThreshold, minCellX + x, minCellY + y, minCellZ + z)) << x;
+					}
+				}
+			}
+		}
+	}
+
+	std::shared_ptr<CubeWorld> generateCubeWorld(const CubeWorldGeneratorSettings& aSettings, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk)
+	{
+		const CubeCoord minCell{ aMinChunk.mX << CUBE_CHUNK_SIZE_LOG2, aMinChunk.mY << CUBE_CHUNK_SIZE_LOG2, aMinChunk.mZ << CUBE_CHUNK_SIZE_LOG2 };
+		const CubeCoord maxCell{ (aMaxChunk.mX + 1) << CUBE_CHUNK_SIZE_LOG2, (aMaxChunk.mY + 1) << CUBE_CHUNK_SIZE_LOG2, (aMaxChunk.mZ + 1) << CUBE_CHUNK_SIZE_LOG2 };
+		std::shared_ptr<CubeWorld> pCubeWorld = std::make_shared<CubeWorld>(minCell, maxCell);
+		CubeWorldGenerator(aSettings).GenerateChunks(*pCubeWorld, aMinChunk, aMaxChunk);
+		return pCubeWorld;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	struct CubeWorldGeneratorSettings
+	{
+		uint32_t mSeed = 1;
+
+		//	the terrain is a heightmap of fractal gradient noise, heights are in cells
+		float mBaseHeight = 40.0f;
+		float mHeightAmplitude = 24.0f;
+		//	cells per period of the first octave
+		float mTerrainScale = 128.0f;
+		int32_t mTerrainOctaves = 5;
+		//	the cells below the surface which are soil, the rest is stone
+		int32_t mSoilDepth = 3;
+
+		//	caves are carved where 3d fractal noise is above the threshold, 0 octaves turn them off
+		float mCaveScale = 32.0f;
+		int32_t mCaveOctaves = 2;
+		float mCaveThreshold = 0.3f;
+
+		//	the cells have to have HAS_CUBE set
+		CubeCell mSurfaceCell = makeCubeCell(2);
+		CubeCell mSoilCell = makeCubeCell(1);
+		CubeCell mStoneCell = makeCubeCell(0);
+	};
+
+	//	one octave of fractal noise
+	struct CubeNoiseOctave
+	{
+		float mFrequency;
+		float mAmplitude;	//	the amplitudes of all octaves add up to 1
+		uint32_t mSeed;
+	};
+
+	//	generates the chunks of an endless world from a seed, every chunk only depends on the settings and its coordinates,
+	//	so chunks can be generated in any order and on any thread with the same result,
+	//	the noise is evaluated 8 cells at a time with avx2, the scalar fallback computes the same values
+	class CubeWorldGenerator
+	{
+	public:
+		explicit CubeWorldGenerator(const CubeWorldGeneratorSettings& aSettings);
+
+		//	nullptr if the chunk has no cubes, otherwise it's compressed, may be called from several threads at once
+		std::unique_ptr<CubeChunk> GenerateChunk(const CubeCoord& aChunkCoord) const;
+		//	generates the chunks in [aMinChunk, aMaxChunk] on the workers and adds them to the world in a fixed order
+		void GenerateChunks(CubeWorld& aCubeWorld, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk) const;
+
+		inline const CubeWorldGeneratorSettings& GetSettings() const { return mSettings; }
+
+	private:
+		//	the highest cell with a cube of every column (z, x) of a chunk
+		void PrivComputeHeights(const CubeCoord& aChunkCoord, int32_t* apOutHeights) const;
+		//	the cells of the rows of a chunk along x which are carved out, bit x of row (y, z)
+		void PrivComputeCaveMasks(const CubeCoord& aChunkCoord, const int32_t* apHeights, uint32_t* apOutMasks) const;
+
+		CubeWorldGeneratorSettings mSettings;
+		std::vector<CubeNoiseOctave> mTerrainOctaves;
+		std::vector<CubeNoiseOctave> mCaveOctaves;
+	};
+
+	//	the bounds of the world are the chunks in [aMinChunk, aMaxChunk]
+	std::shared_ptr<CubeWorld> generateCubeWorld(const CubeWorldGeneratorSettings& aSettings, const CubeCoord& aMinChunk, const CubeCoord& aMaxChunk);
+}
@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "voxel/CubeWorldLighting.h"
+
+#include "voxel/CubeFaceCulling.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+
+#include <unordered_set>
+
+namespace tde
+{
+	namespace
+	{
+		//	in CubeVertexFacing order
+		constexpr int32_t FACE_NEGATIVE_Y = 1;
+		constexpr int32_t FACE_POSITIVE_Y = 4;
+
+		//	the neighbouring chunks which sample the cell, including the chunk of the cell itself,
+		//	bit ((y + 1) * 3 + z + 1) * 3 + x + 1 stands for the chunk at the offset (x, y, z)
+		uint32_t getSamplingNeighbours(const int32_t aLocalX, const int32_t aLocalY, const int32_t aLocalZ)
+		{
+			const int32_t localCell[3] = { aLocalX, aLocalY, aLocalZ };
+			int32_t minOffset[3];
+			int32_t maxOffset[3];
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				minOffset[axis] = localCell[axis] == 0 ? -1 : 0;
+				maxOffset[axis] = localCell[axis] == CUBE_CHUNK_MASK ? 1 : 0;
+			}
+			uint32_t neighbours = 0;
+			for (int32_t y = minOffset[1]; y <= maxOffset[1]; y++)
+			{
+				for (int32_t z = minOffset[2]; z <= maxOffset[2]; z++)
+				{
+					for (int32_t x = minOffset[0]; x <= maxOffset[0]; x++)
+					{
+						neighbours |= 1u << (((y + 1) * 3 + z + 1) * 3 + x + 1);
+					}
+				}
+			}
+			return neighbours;
+		}
+	}
+
+	CubeWorldLighting::CubeWorldLighting(CubeWorld& aCubeWorld)
+	{
+		Build(aCubeWorld);
+	}
+
+	void CubeWorldLighting::Build(CubeWorld& aCubeWorld)
+	{
+		mChunkLights.clear();
+		std::vector<CubeCoord> chunkCoords;
+		chunkCoords.reserve(aCubeWorld.GetChunkCount());
+		for (const auto& chunk : aCubeWorld.GetChunks())
+		{
+			chunkCoords.push_back(chunk.first);
+		}
+		PrivRelight(aCubeWorld, std::move(chunkCoords));
+	}
+
+	void CubeWorldLighting::Update(CubeWorld& aCubeWorld, const std::vector<CubeCoord>& aEditedChunks)
+	{
+		if (!aEditedChunks.empty())
+		{
+			PrivRelight(aCubeWorld, aEditedChunks);
+		}
+	}
+
+	uint8_t CubeWorldLighting::GetLight(const int32_t aX, const int32_t aY, const int32_t aZ) const
+	{
+		const ChunkLight* pChunkLight = FindChunkLight(toChunkCoord(aX, aY, aZ));
+		return pChunkLight ? pChunkLight->Get(CubeChunk::CellIndex(aX & CUBE_CHUNK_MASK, aY & CUBE_CHUNK_MASK, aZ & CUBE_CHUNK_MASK)) : CUBE_MAX_LIGHT_LEVEL;
+	}
+
+	const CubeWorldLighting::ChunkLight* CubeWorldLighting::FindChunkLight(const CubeCoord& aChunkCoord) const
+	{
+		const auto lightIt = mChunkLights.find(aChunkCoord);
+		return lightIt != mChunkLights.end() ? &lightIt->second : nullptr;
+	}
+
+	size_t CubeWorldLighting::GetMemoryUsage() const
+	{
+		size_t memoryUsage = 0;
+		for (const auto& chunkLight : mChunkLights)
+		{
+			memoryUsage += sizeof(ChunkLight) + (chunkLight.second.mpLevels ? CUBE_CHUNK_CELL_COUNT : 0);
+		}
+		return memoryUsage;
+	}
+
+	void CubeWorldLighting::PrivRelight(CubeWorld& aCubeWorld, std::vector<CubeCoord> aChunkCoords)
+	{
+		std::vector<std::unique_ptr<uint8_t[]>> chunkLevels;
+		while (!aChunkCoords.empty())
+		{
+			//	every chunk of a wave reads the light from before the wave, so the result doesn't depend on the order
+			chunkLevels.resize(aChunkCoords.size());
+			parallelFor(WorkDispatcherLocator::Get().get(), 0, aChunkCoords.size(), [&](const size_t aChunk)
+			{
+				const CubeChunk* pChunk = aCubeWorld.FindChunk(aChunkCoords[aChunk]);
+				if (!pChunk)
+				{
+					return;
+				}
+				if (!chunkLevels[aChunk])
+				{
+					chunkLevels[aChunk] = std::make_unique<uint8_t[]>(CUBE_CHUNK_CELL_COUNT);
+				}
+				PrivLightChunk(aCubeWorld, aChunkCoords[aChunk], *pChunk, chunkLevels[aChunk].get());
+			}, 1);
+
+			std::unordered_set<CubeCoord, CubeCoordHash> nextChunks;
+			for (size_t chunk = 0; chunk < aChunkCoords.size(); chunk++)
+			{
+				const CubeCoord& chunkCoord = aChunkCoords[chunk];
+				const auto lightIt = mChunkLights.find(chunkCoord);
+				uint32_t changedNeighbours = 0;
+				if (!aCubeWorld.FindChunk(chunkCoord))
+				{
+					//	a removed chunk turns into open air
+					if (lightIt != mChunkLights.end())
+					{
+						mChunkLights.erase(lightIt);
+						changedNeighbours = ~0u;
+					}
+				}
+				else if (lightIt == mChunkLights.end())
+				{
+					changedNeighbours = ~0u;
+				}
+				else
+				{
+					const uint8_t* pLevels = chunkLevels[chunk].get();
+					for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+					{
+						for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+						{
+							for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+							{
+								const size_t cellIndex = CubeChunk::CellIndex(x, y, z);
+								if (pLevels[cellIndex] != lightIt->second.Get(cellIndex))
+								{
+									changedNeighbours |= getSamplingNeighbours(x, y, z);
+								}
+							}
+						}
+					}
+				}
+				if (changedNeighbours == 0)
+				{
+					continue;
+				}
+
+				if (chunkLevels[chunk])
+				{
+					ChunkLight& chunkLight = mChunkLights[chunkCoord];
+					const uint8_t* pLevels = chunkLevels[chunk].get();
+					if (std::all_of(pLevels, pLevels + CUBE_CHUNK_CELL_COUNT, [pLevels](const uint8_t aLevel) { return aLevel == pLevels[0]; }))
+					{
+						chunkLight.mpLevels.reset();
+						chunkLight.mUniformLevel = pLevels[0];
+					}
+					else
+					{
+						//	the buffer of the wave moves into the chunk, the next wave allocates a new one
+						chunkLight.mpLevels = std::move(chunkLevels[chunk]);
+					}
+				}
+
+				//	the renderer remeshes the chunks which sample the changed cells,
+				//	the light spreads on to the chunks across the faces
+				for (int32_t y = -1; y <= 1; y++)
+				{
+					for (int32_t z = -1; z <= 1; z++)
+					{
+						for (int32_t x = -1; x <= 1; x++)
+						{
+							if (!(changedNeighbours & (1u << (((y + 1) * 3 + z + 1) * 3 + x + 1))))
+							{
+								continue;
+							}
+							const CubeCoord neighbourCoord{ chunkCoord.mX + x, chunkCoord.mY + y, chunkCoord.mZ + z };
+							if (!aCubeWorld.FindChunk(neighbourCoord))
+							{
+								continue;
+							}
+							aCubeWorld.MarkChunkDirty(neighbourCoord);
+							if (std::abs(x) + std::abs(y) + std::abs(z) == 1)
+							{
+								nextChunks.insert(neighbourCoord);
+							}
+						}
+					}
+				}
+			}
+
+			aChunkCoords.assign(nextChunks.begin(), nextChunks.end());
+		}
+	}
+
+	void CubeWorldLighting::PrivLightChunk(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, uint8_t* apOutLevels) const
+	{
+		std::unique_ptr<CubeCell[]> pCopiedCells;
+		const CubeCell* pCells = aChunk.GetRawCells();
+		if (!pCells)
+		{
+			pCopiedCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+			aChunk.CopyCells(pCopiedCells.get());
+			pCells = pCopiedCells.get();
+		}
+
+		//	the cells are visited brightest first, so every cell is spread from once it has its final level
+		std::vector<uint16_t> levelQueues[CUBE_MAX_LIGHT_LEVEL + 1];
+		std::fill_n(apOutLevels, CUBE_CHUNK_CELL_COUNT, uint8_t(0));
+		auto raiseLevel = [&](const size_t aCellIndex, const uint8_t aLevel)
+		{
+			if (aLevel > apOutLevels[aCellIndex])
+			{
+				apOutLevels[aCellIndex] = aLevel;
+				levelQueues[aLevel].push_back(static_cast<uint16_t>(aCellIndex));
+			}
+		};
+
+		//	light comes in through the borders
+		for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+		{
+			const CubeCoord neighbourCoord = getCubeFaceNeighbour(aChunkCoord, face);
+			const bool isOpenAir = !aCubeWorld.FindChunk(neighbourCoord);
+			const ChunkLight* pNeighbourLight = FindChunkLight(neighbourCoord);
+
+			const int32_t normalAxis = face % 3;
+			const int32_t uAxis = (normalAxis + 1) % 3;
+			const int32_t vAxis = (normalAxis + 2) % 3;
+			int32_t cell[3];
+			int32_t neighbourCell[3];
+			cell[normalAxis] = face < 3 ? 0 : CUBE_CHUNK_MASK;
+			neighbourCell[normalAxis] = face < 3 ? CUBE_CHUNK_MASK : 0;
+			for (int32_t v = 0; v < CUBE_CHUNK_SIZE; v++)
+			{
+				cell[vAxis] = neighbourCell[vAxis] = v;
+				for (int32_t u = 0; u < CUBE_CHUNK_SIZE; u++)
+				{
+					cell[uAxis] = neighbourCell[uAxis] = u;
+					const size_t cellIndex = CubeChunk::CellIndex(cell[0], cell[1], cell[2]);
+					if (pCells[cellIndex] & HAS_CUBE)
+					{
+						continue;
+					}
+					const uint8_t level = isOpenAir ? CUBE_MAX_LIGHT_LEVEL :
+						(pNeighbourLight ? pNeighbourLight->Get(CubeChunk::CellIndex(neighbourCell[0], neighbourCell[1], neighbourCell[2])) : 0);
+					if (face == FACE_POSITIVE_Y && level == CUBE_MAX_LIGHT_LEVEL)
+					{
+						raiseLevel(cellIndex, level);
+					}
+					else if (level > 1)
+					{
+						raiseLevel(cellIndex, level - 1);
+					}
+				}
+			}
+		}
+
+		//	and spreads from the brightest cells
+		for (int32_t level = CUBE_MAX_LIGHT_LEVEL; level > 1; level--)
+		{
+			std::vector<uint16_t>& queue = levelQueues[level];
+			//	sky light falling down stays in this queue, so it grows while it's visited
+			for (size_t i = 0; i < queue.size(); i++)
+			{
+				const size_t cellIndex = queue[i];
+				if (apOutLevels[cellIndex] != level)
+				{
+					continue;
+				}
+				const int32_t x = static_cast<int32_t>(cellIndex & CUBE_CHUNK_MASK);
+				const int32_t z = static_cast<int32_t>((cellIndex >> CUBE_CHUNK_SIZE_LOG2) & CUBE_CHUNK_MASK);
+				const int32_t y = static_cast<int32_t>(cellIndex >> (CUBE_CHUNK_SIZE_LOG2 * 2));
+				for (int32_t face = 0; face < static_cast<int32_t>(CUBE_FACE_COUNT); face++)
+				{
+					int32_t neighbourCell[3] = { x, y, z };
+					neighbourCell[face % 3] += face < 3 ? -1 : 1;
+					if (neighbourCell[face % 3] < 0 || neighbourCell[face % 3] > CUBE_CHUNK_MASK)
+					{
+						continue;
+					}
+					const size_t neighbourIndex = CubeChunk::CellIndex(neighbourCell[0], neighbourCell[1], neighbourCell[2]);
+					if (pCells[neighbourIndex] & HAS_CUBE)
+					{
+						continue;
+					}
+					const bool isFalling = face == FACE_NEGATIVE_Y && level == CUBE_MAX_LIGHT_LEVEL;
+					raiseLevel(neighbourIndex, static_cast<uint8_t>(isFalling ? level : level - 1));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	//	light levels run from 0, dark, to this, open sky
+	constexpr static uint8_t CUBE_MAX_LIGHT_LEVEL = 15;
+
+	//	sky light flood filled through the cells without cubes, like in minecraft: light from the open sky reaches straight down
+	//	without getting weaker and loses a level for every cell it travels in any other direction, cells with cubes are dark
+	//	chunks which don't exist are open air, so they are fully lit
+	//	every chunk is lit on its own from the borders of its neighbours, a chunk whose border changes passes the change on
+	//	to its neighbours in the next wave, the chunks of a wave are lit on the workers,
+	//	light which is cut off fades a level per wave, so darkening a large area takes up to CUBE_MAX_LIGHT_LEVEL waves
+	//	reading from several threads is fine as long as nobody updates the lighting
+	class CubeWorldLighting
+	{
+	public:
+		//	the light of one chunk, in CubeChunk::CellIndex order
+		class ChunkLight
+		{
+		public:
+			inline uint8_t Get(const size_t aCellIndex) const { return mpLevels ? mpLevels[aCellIndex] : mUniformLevel; }
+
+		private:
+			friend class CubeWorldLighting;
+
+			//	nullptr if every cell has the uniform level
+			std::unique_ptr<uint8_t[]> mpLevels;
+			uint8_t mUniformLevel = 0;
+		};
+
+		CubeWorldLighting() = default;
+		//	lights every chunk on the workers
+		explicit CubeWorldLighting(CubeWorld& aCubeWorld);
+
+		void Build(CubeWorld& aCubeWorld);
+		//	relights the edited chunks and the chunks their light spreads to, e.g. with CubeWorld::TakeEditedChunks,
+		//	every chunk whose light changes is marked dirty in the world together with the neighbours which sample its border
+		void Update(CubeWorld& aCubeWorld, const std::vector<CubeCoord>& aEditedChunks);
+
+		//	the full level for chunks which don't exist
+		uint8_t GetLight(const int32_t aX, const int32_t aY, const int32_t aZ) const;
+		//	for many lookups in the same chunk, null if the chunk isn't lit
+		const ChunkLight* FindChunkLight(const CubeCoord& aChunkCoord) const;
+
+		size_t GetMemoryUsage() const;
+
+	private:
+		//	lights the chunks in waves until no border changes anymore
+		void PrivRelight(CubeWorld& aCubeWorld, std::vector<CubeCoord> aChunkCoords);
+		//	the levels of the chunk from the current light of its neighbours, neighbours which exist but aren't lit yet are dark
+		void PrivLightChunk(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord, const CubeChunk& aChunk, uint8_t* apOutLevels) const;
+
+		std::unordered_map<CubeCoord, ChunkLight, CubeCoordHash> mChunkLights;
+	};
+}
@@ -0,0 +1,625 @@
+#include "pch.h"
+#include "voxel/CubeWorldOctree.h"
+
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+
+#include <array>
+#include <bit>
+
+namespace tde
+{
+	using namespace DirectX;
+
+	namespace
+	{
+		constexpr uint32_t NO_NODE = 0xFFFFFFFF;
+		constexpr int32_t BRICKS_PER_CHUNK_AXIS = CUBE_CHUNK_SIZE >> 2;
+
+		//	a node as it's stored, the child mask and up to 8 children, the unused children are zero
+		using NodeKey = std::array<uint32_t, 9>;
+
+		struct NodeKeyHash
+		{
+			inline size_t operator()(const NodeKey& aKey) const
+			{
+				uint64_t hash = 0xCBF29CE484222325ull;
+				for (const uint32_t word : aKey)
+				{
+					hash = (hash ^ word) * 0x100000001B3ull;
+				}
+				return static_cast<size_t>(hash);
+			}
+		};
+
+		inline CubeCoord shiftCoordDown(const CubeCoord& aCoord, const int32_t aShift)
+		{
+			return { aCoord.mX >> aShift, aCoord.mY >> aShift, aCoord.mZ >> aShift };
+		}
+
+		inline CubeCoord shiftCoordUp(const CubeCoord& aCoord, const int32_t aShift)
+		{
+			return { aCoord.mX * (1 << aShift), aCoord.mY * (1 << aShift), aCoord.mZ * (1 << aShift) };
+		}
+
+		inline CubeCoord offsetCoord(const CubeCoord& aCoord, const int32_t aOffset)
+		{
+			return { aCoord.mX + aOffset, aCoord.mY + aOffset, aCoord.mZ + aOffset };
+		}
+
+		//	the child of an octree node, bit 0 of the index picks the upper half along x, bit 1 along y, bit 2 along z
+		inline CubeCoord getChildMin(const CubeCoord& aNodeMin, const int32_t aChildIndex, const int32_t aChildSizeLog2)
+		{
+			return {
+				aNodeMin.mX + ((aChildIndex & 1) << aChildSizeLog2),
+				aNodeMin.mY + (((aChildIndex >> 1) & 1) << aChildSizeLog2),
+				aNodeMin.mZ + (((aChildIndex >> 2) & 1) << aChildSizeLog2) };
+		}
+
+		inline bool isBoxOverlapping(const CubeCoord& aMinA, const CubeCoord& aMaxA, const CubeCoord& aMinB, const CubeCoord& aMaxB)
+		{
+			return aMinA.mX <= aMaxB.mX && aMinB.mX <= aMaxA.mX &&
+				aMinA.mY <= aMaxB.mY && aMinB.mY <= aMaxA.mY &&
+				aMinA.mZ <= aMaxB.mZ && aMinB.mZ <= aMaxA.mZ;
+		}
+
+		inline bool isBoxContaining(const CubeCoord& aOuterMin, const CubeCoord& aOuterMax, const CubeCoord& aInnerMin, const CubeCoord& aInnerMax)
+		{
+			return aOuterMin.mX <= aInnerMin.mX && aInnerMax.mX <= aOuterMax.mX &&
+				aOuterMin.mY <= aInnerMin.mY && aInnerMax.mY <= aOuterMax.mY &&
+				aOuterMin.mZ <= aInnerMin.mZ && aInnerMax.mZ <= aOuterMax.mZ;
+		}
+
+		//	builds the nodes bottom up and merges the ones which are already in the tree
+		class ChunkTreeBuilder
+		{
+		public:
+			ChunkTreeBuilder(std::vector<uint32_t>& aOutNodes, std::vector<uint64_t>& aOutBricks, uint32_t& aOutNodeCount, const uint64_t* apBrickMasks)
+				: mNodes(aOutNodes)
+				, mBricks(aOutBricks)
+				, mNodeCount(aOutNodeCount)
+				, mpBrickMasks(apBrickMasks)
+			{}
+
+			//	NO_NODE if the node has no cubes
+			uint32_t Build(const int32_t aSizeLog2, const CubeCoord& aNodeMin)
+			{
+				if (aSizeLog2 == CUBE_BRICK_SIZE_LOG2)
+				{
+					const uint64_t brickMask = mpBrickMasks[((aNodeMin.mY >> 2) * BRICKS_PER_CHUNK_AXIS + (aNodeMin.mZ >> 2)) * BRICKS_PER_CHUNK_AXIS + (aNodeMin.mX >> 2)];
+					if (brickMask == 0)
+					{
+						return NO_NODE;
+					}
+					const auto brickIt = mBrickIds.try_emplace(brickMask, static_cast<uint32_t>(mBricks.size()));
+					if (brickIt.second)
+					{
+						mBricks.emplace_back(brickMask);
+					}
+					return brickIt.first->second;
+				}
+
+				NodeKey key = {};
+				uint32_t childCount = 0;
+				for (int32_t child = 0; child < 8; child++)
+				{
+					const uint32_t childId = Build(aSizeLog2 - 1, getChildMin(aNodeMin, child, aSizeLog2 - 1));
+					if (childId != NO_NODE)
+					{
+						key[0] |= 1u << child;
+						key[++childCount] = childId;
+					}
+				}
+				if (key[0] == 0)
+				{
+					return NO_NODE;
+				}
+
+				const auto nodeIt = mNodeIds.try_emplace(key, static_cast<uint32_t>(mNodes.size()));
+				if (nodeIt.second)
+				{
+					mNodes.insert(mNodes.end(), key.begin(), key.begin() + childCount + 1);
+					mNodeCount++;
+				}
+				return nodeIt.first->second;
+			}
+
+		private:
+			std::vector<uint32_t>& mNodes;
+			std::vector<uint64_t>& mBricks;
+			uint32_t& mNodeCount;
+			const uint64_t* mpBrickMasks;
+			std::unordered_map<uint64_t, uint32_t> mBrickIds;
+			std::unordered_map<NodeKey, uint32_t, NodeKeyHash> mNodeIds;
+		};
+	}
+
+	CubeWorldOctree::CubeWorldOctree(CubeWorld& aCubeWorld)
+	{
+		Build(aCubeWorld);
+	}
+
+	void CubeWorldOctree::Build(CubeWorld& aCubeWorld)
+	{
+		mChunkTrees.clear();
+		for (auto& regionCounts : mRegionCounts)
+		{
+			regionCounts.clear();
+		}
+		aCubeWorld.TakeEditedChunks();
+
+		std::vector<std::pair<CubeCoord, const CubeChunk*>> chunks;
+		chunks.reserve(aCubeWorld.GetChunkCount());
+		for (const auto& chunk : aCubeWorld.GetChunks())
+		{
+			chunks.emplace_back(chunk.first, chunk.second.get());
+		}
+
+		//	the chunks are independent, only the regions above them are shared
+		std::vector<std::unique_ptr<ChunkTree>> trees(chunks.size());
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, chunks.size(), [&](const size_t aChunk)
+		{
+			trees[aChunk] = PrivBuildChunkTree(*chunks[aChunk].second);
+		});
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			PrivSetChunkTree(chunks[i].first, std::move(trees[i]));
+		}
+	}
+
+	void CubeWorldOctree::Update(CubeWorld& aCubeWorld)
+	{
+		Update(aCubeWorld, aCubeWorld.TakeEditedChunks());
+	}
+
+	void CubeWorldOctree::Update(const CubeWorld& aCubeWorld, const std::vector<CubeCoord>& aEditedChunks)
+	{
+		std::vector<std::unique_ptr<ChunkTree>> trees(aEditedChunks.size());
+		parallelFor(WorkDispatcherLocator::Get().get(), 0, aEditedChunks.size(), [&](const size_t aChunk)
+		{
+			if (const CubeChunk* pChunk = aCubeWorld.FindChunk(aEditedChunks[aChunk]))
+			{
+				trees[aChunk] = PrivBuildChunkTree(*pChunk);
+			}
+		}, 1);
+		for (size_t i = 0; i < aEditedChunks.size(); i++)
+		{
+			PrivSetChunkTree(aEditedChunks[i], std::move(trees[i]));
+		}
+	}
+
+	void CubeWorldOctree::UpdateChunk(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord)
+	{
+		const CubeChunk* pChunk = aCubeWorld.FindChunk(aChunkCoord);
+		PrivSetChunkTree(aChunkCoord, pChunk ? PrivBuildChunkTree(*pChunk) : nullptr);
+	}
+
+	bool CubeWorldOctree::IsBoxEmpty(const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const
+	{
+		if (mRegionCounts[REGION_LEVEL_COUNT - 1].empty())
+		{
+			return true;
+		}
+
+		//	only the top regions which have cubes need to be visited
+		const CubeCoord minRegion = shiftCoordDown(aMinCell, CUBE_CHUNK_SIZE_LOG2 + REGION_LEVEL_COUNT);
+		const CubeCoord maxRegion = shiftCoordDown(aMaxCell, CUBE_CHUNK_SIZE_LOG2 + REGION_LEVEL_COUNT);
+		for (int32_t y = std::max(minRegion.mY, mMinRegion.mY); y <= std::min(maxRegion.mY, mMaxRegion.mY); y++)
+		{
+			for (int32_t z = std::max(minRegion.mZ, mMinRegion.mZ); z <= std::min(maxRegion.mZ, mMaxRegion.mZ); z++)
+			{
+				for (int32_t x = std::max(minRegion.mX, mMinRegion.mX); x <= std::min(maxRegion.mX, mMaxRegion.mX); x++)
+				{
+					if (!PrivIsRegionBoxEmpty(REGION_LEVEL_COUNT - 1, { x, y, z }, aMinCell, aMaxCell))
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CubeWorldOctree::Raycast(const XMFLOAT3& aOrigin, const XMFLOAT3& aDirection, const float aMaxDistance, CubeRayHit& aOutHit) const
+	{
+		if (mRegionCounts[REGION_LEVEL_COUNT - 1].empty())
+		{
+			return false;
+		}
+
+		const float origin[3] = { aOrigin.x, aOrigin.y, aOrigin.z };
+		const float direction[3] = { aDirection.x, aDirection.y, aDirection.z };
+		float inverseDirection[3];
+
+		//	clip the ray to the top regions which have cubes
+		const int32_t regionSizeLog2 = CUBE_CHUNK_SIZE_LOG2 + REGION_LEVEL_COUNT;
+		const CubeCoord boundsMin = shiftCoordUp(mMinRegion, regionSizeLog2);
+		const CubeCoord boundsMax = shiftCoordUp(offsetCoord(mMaxRegion, 1), regionSizeLog2);
+		const int32_t lowerBound[3] = { boundsMin.mX, boundsMin.mY, boundsMin.mZ };
+		const int32_t upperBound[3] = { boundsMax.mX, boundsMax.mY, boundsMax.mZ };
+		float enterDistance = 0.0f;
+		float exitDistance = aMaxDistance;
+		int32_t enterAxis = -1;
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			if (direction[axis] == 0.0f)
+			{
+				if (origin[axis] < static_cast<float>(lowerBound[axis]) || origin[axis] >= static_cast<float>(upperBound[axis]))
+				{
+					return false;
+				}
+				inverseDirection[axis] = 0.0f;
+				continue;
+			}
+			inverseDirection[axis] = 1.0f / direction[axis];
+			float nearDistance = (static_cast<float>(lowerBound[axis]) - origin[axis]) * inverseDirection[axis];
+			float farDistance = (static_cast<float>(upperBound[axis]) - origin[axis]) * inverseDirection[axis];
+			if (nearDistance > farDistance)
+			{
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance > enterDistance)
+			{
+				enterDistance = nearDistance;
+				enterAxis = axis;
+			}
+			exitDistance = std::min(exitDistance, farDistance);
+		}
+		if (enterDistance > exitDistance)
+		{
+			return false;
+		}
+
+		int32_t cell[3];
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			cell[axis] = std::clamp(static_cast<int32_t>(std::floor(origin[axis] + direction[axis] * enterDistance)), lowerBound[axis], upperBound[axis] - 1);
+		}
+		if (enterAxis >= 0)
+		{
+			cell[enterAxis] = direction[enterAxis] > 0.0f ? lowerBound[enterAxis] : upperBound[enterAxis] - 1;
+		}
+
+		//	jump from empty box to empty box, the cell after a box is the one across the face the ray leaves through
+		float distance = enterDistance;
+		int32_t hitAxis = enterAxis;
+		int32_t boxMin[3];
+		int32_t boxSize = 0;
+		while (PrivFindEmptyBox(cell, boxMin, boxSize))
+		{
+			float nextDistance = std::numeric_limits<float>::infinity();
+			int32_t exitAxis = -1;
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				if (direction[axis] == 0.0f)
+				{
+					continue;
+				}
+				const int32_t boundary = direction[axis] > 0.0f ? boxMin[axis] + boxSize : boxMin[axis];
+				const float axisDistance = (static_cast<float>(boundary) - origin[axis]) * inverseDirection[axis];
+				if (axisDistance < nextDistance)
+				{
+					nextDistance = axisDistance;
+					exitAxis = axis;
+				}
+			}
+			if (exitAxis < 0 || nextDistance > exitDistance)
+			{
+				return false;
+			}
+
+			distance = std::max(distance, nextDistance);
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				if (axis == exitAxis)
+				{
+					cell[axis] = direction[axis] > 0.0f ? boxMin[axis] + boxSize : boxMin[axis] - 1;
+				}
+				else
+				{
+					//	the exit point is on the box, rounding mustn't move it off the face
+					cell[axis] = std::clamp(static_cast<int32_t>(std::floor(origin[axis] + direction[axis] * distance)), boxMin[axis], boxMin[axis] + boxSize - 1);
+				}
+			}
+			hitAxis = exitAxis;
+		}
+
+		aOutHit.mCell = { cell[0], cell[1], cell[2] };
+		aOutHit.mFace = hitAxis < 0 ? -1 : (direction[hitAxis] > 0.0f ? hitAxis : hitAxis + 3);
+		aOutHit.mDistance = distance;
+		return true;
+	}
+
+	uint64_t CubeWorldOctree::GetBrickMask(const CubeCoord& aBrickCoord) const
+	{
+		const ChunkTree* pTree = FindChunkTree(shiftCoordDown(aBrickCoord, CUBE_CHUNK_SIZE_LOG2 - CUBE_BRICK_SIZE_LOG2));
+		return pTree ? GetBrickMask(*pTree, aBrickCoord) : 0;
+	}
+
+	const CubeWorldOctree::ChunkTree* CubeWorldOctree::FindChunkTree(const CubeCoord& aChunkCoord) const
+	{
+		const auto treeIt = mChunkTrees.find(aChunkCoord);
+		return treeIt != mChunkTrees.end() ? treeIt->second.get() : nullptr;
+	}
+
+	uint64_t CubeWorldOctree::GetBrickMask(const ChunkTree& aTree, const CubeCoord& aBrickCoord)
+	{
+		uint32_t node = aTree.mRoot;
+		for (int32_t childShift = CUBE_CHUNK_SIZE_LOG2 - CUBE_BRICK_SIZE_LOG2 - 1; childShift >= 0; childShift--)
+		{
+			const uint32_t childMask = aTree.mNodes[node];
+			const uint32_t child =
+				((aBrickCoord.mX >> childShift) & 1) |
+				(((aBrickCoord.mY >> childShift) & 1) << 1) |
+				(((aBrickCoord.mZ >> childShift) & 1) << 2);
+			if (!(childMask & (1u << child)))
+			{
+				return 0;
+			}
+			node = aTree.mNodes[node + 1 + std::popcount(childMask & ((1u << child) - 1))];
+		}
+		return aTree.mBricks[node];
+	}
+
+	size_t CubeWorldOctree::GetNodeCount() const
+	{
+		size_t nodeCount = 0;
+		for (const auto& chunkTree : mChunkTrees)
+		{
+			nodeCount += chunkTree.second->mNodeCount + chunkTree.second->mBricks.size();
+		}
+		return nodeCount;
+	}
+
+	size_t CubeWorldOctree::GetMemoryUsage() const
+	{
+		size_t memoryUsage = 0;
+		for (const auto& chunkTree : mChunkTrees)
+		{
+			memoryUsage += sizeof(ChunkTree) +
+				chunkTree.second->mNodes.capacity() * sizeof(uint32_t) +
+				chunkTree.second->mBricks.capacity() * sizeof(uint64_t);
+		}
+		for (const auto& regionCounts : mRegionCounts)
+		{
+			memoryUsage += regionCounts.size() * (sizeof(CubeCoord) + sizeof(uint32_t));
+		}
+		return memoryUsage;
+	}
+
+	std::unique_ptr<CubeWorldOctree::ChunkTree> CubeWorldOctree::PrivBuildChunkTree(const CubeChunk& aChunk)
+	{
+		if (aChunk.IsEmpty())
+		{
+			return nullptr;
+		}
+
+		//	compressed chunks are decompressed once instead of cell by cell
+		std::unique_ptr<CubeCell[]> pDecompressedCells;
+		const CubeCell* pCells = aChunk.GetRawCells();
+		if (!pCells)
+		{
+			pDecompressedCells = std::make_unique<CubeCell[]>(CUBE_CHUNK_CELL_COUNT);
+			aChunk.CopyCells(pDecompressedCells.get());
+			pCells = pDecompressedCells.get();
+		}
+
+		uint64_t brickMasks[BRICKS_PER_CHUNK_AXIS * BRICKS_PER_CHUNK_AXIS * BRICKS_PER_CHUNK_AXIS] = {};
+		for (int32_t y = 0; y < CUBE_CHUNK_SIZE; y++)
+		{
+			for (int32_t z = 0; z < CUBE_CHUNK_SIZE; z++)
+			{
+				const CubeCell* pRow = pCells + CubeChunk::CellIndex(0, y, z);
+				uint64_t* pBrickRow = &brickMasks[((y >> 2) * BRICKS_PER_CHUNK_AXIS + (z >> 2)) * BRICKS_PER_CHUNK_AXIS];
+				const int32_t rowShift = (y & 3) * 16 + (z & 3) * 4;
+				for (int32_t x = 0; x < CUBE_CHUNK_SIZE; x++)
+				{
+					pBrickRow[x >> 2] |= static_cast<uint64_t>(pRow[x] & HAS_CUBE) << (rowShift + (x & 3));
+				}
+			}
+		}
+
+		std::unique_ptr<ChunkTree> pTree = std::make_unique<ChunkTree>();
+		ChunkTreeBuilder builder(pTree->mNodes, pTree->mBricks, pTree->mNodeCount, brickMasks);
+		pTree->mRoot = builder.Build(CUBE_CHUNK_SIZE_LOG2, { 0, 0, 0 });
+		if (pTree->mRoot == NO_NODE)
+		{
+			return nullptr;
+		}
+		pTree->mNodes.shrink_to_fit();
+		pTree->mBricks.shrink_to_fit();
+		return pTree;
+	}
+
+	void CubeWorldOctree::PrivSetChunkTree(const CubeCoord& aChunkCoord, std::unique_ptr<ChunkTree> apTree)
+	{
+		auto treeIt = mChunkTrees.find(aChunkCoord);
+		if (apTree)
+		{
+			if (treeIt != mChunkTrees.end())
+			{
+				treeIt->second = std::move(apTree);
+				return;
+			}
+			mChunkTrees.emplace(aChunkCoord, std::move(apTree));
+			for (int32_t level = 0; level < REGION_LEVEL_COUNT; level++)
+			{
+				mRegionCounts[level][shiftCoordDown(aChunkCoord, level + 1)]++;
+			}
+			PrivUpdateBounds();
+		}
+		else if (treeIt != mChunkTrees.end())
+		{
+			mChunkTrees.erase(treeIt);
+			for (int32_t level = 0; level < REGION_LEVEL_COUNT; level++)
+			{
+				auto countIt = mRegionCounts[level].find(shiftCoordDown(aChunkCoord, level + 1));
+				if (--countIt->second == 0)
+				{
+					mRegionCounts[level].erase(countIt);
+				}
+			}
+			PrivUpdateBounds();
+		}
+	}
+
+	void CubeWorldOctree::PrivUpdateBounds()
+	{
+		const auto& topRegions = mRegionCounts[REGION_LEVEL_COUNT - 1];
+		if (topRegions.empty())
+		{
+			return;
+		}
+		mMinRegion = topRegions.begin()->first;
+		mMaxRegion = topRegions.begin()->first;
+		for (const auto& region : topRegions)
+		{
+			mMinRegion = { std::min(mMinRegion.mX, region.first.mX), std::min(mMinRegion.mY, region.first.mY), std::min(mMinRegion.mZ, region.first.mZ) };
+			mMaxRegion = { std::max(mMaxRegion.mX, region.first.mX), std::max(mMaxRegion.mY, region.first.mY), std::max(mMaxRegion.mZ, region.first.mZ) };
+		}
+	}
+
+	uint32_t CubeWorldOctree::PrivGetRegionCount(const int32_t aLevel, const CubeCoord& aRegionCoord) const
+	{
+		const auto countIt = mRegionCounts[aLevel].find(aRegionCoord);
+		return countIt != mRegionCounts[aLevel].end() ? countIt->second : 0;
+	}
+
+	bool CubeWorldOctree::PrivFindEmptyBox(const int32_t aCell[3], int32_t aOutBoxMin[3], int32_t& aOutBoxSize) const
+	{
+		const CubeCoord chunkCoord = toChunkCoord(aCell[0], aCell[1], aCell[2]);
+		const auto treeIt = mChunkTrees.find(chunkCoord);
+		if (treeIt == mChunkTrees.end())
+		{
+			//	the largest region without cubes, or the chunk itself
+			int32_t boxSizeLog2 = CUBE_CHUNK_SIZE_LOG2;
+			for (int32_t level = REGION_LEVEL_COUNT - 1; level >= 0; level--)
+			{
+				if (PrivGetRegionCount(level, shiftCoordDown(chunkCoord, level + 1)) == 0)
+				{
+					boxSizeLog2 = CUBE_CHUNK_SIZE_LOG2 + level + 1;
+					break;
+				}
+			}
+			aOutBoxSize = 1 << boxSizeLog2;
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				aOutBoxMin[axis] = aCell[axis] & ~(aOutBoxSize - 1);
+			}
+			return true;
+		}
+
+		const ChunkTree& tree = *treeIt->second;
+		uint32_t node = tree.mRoot;
+		for (int32_t childSizeLog2 = CUBE_CHUNK_SIZE_LOG2 - 1; childSizeLog2 >= CUBE_BRICK_SIZE_LOG2; childSizeLog2--)
+		{
+			const uint32_t childMask = tree.mNodes[node];
+			const uint32_t child =
+				((aCell[0] >> childSizeLog2) & 1) |
+				(((aCell[1] >> childSizeLog2) & 1) << 1) |
+				(((aCell[2] >> childSizeLog2) & 1) << 2);
+			if (!(childMask & (1u << child)))
+			{
+				aOutBoxSize = 1 << childSizeLog2;
+				for (int32_t axis = 0; axis < 3; axis++)
+				{
+					aOutBoxMin[axis] = aCell[axis] & ~(aOutBoxSize - 1);
+				}
+				return true;
+			}
+			node = tree.mNodes[node + 1 + std::popcount(childMask & ((1u << child) - 1))];
+		}
+
+		const uint64_t brick = tree.mBricks[node];
+		if ((brick >> getCubeBrickBit(aCell[0], aCell[1], aCell[2])) & 1)
+		{
+			return false;
+		}
+		aOutBoxSize = 1;
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			aOutBoxMin[axis] = aCell[axis];
+		}
+		return true;
+	}
+
+	bool CubeWorldOctree::PrivIsRegionBoxEmpty(const int32_t aLevel, const CubeCoord& aRegionCoord, const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const
+	{
+		if (aLevel < 0)
+		{
+			const auto treeIt = mChunkTrees.find(aRegionCoord);
+			return treeIt == mChunkTrees.end() ||
+				PrivIsNodeBoxEmpty(*treeIt->second, treeIt->second->mRoot, CUBE_CHUNK_SIZE_LOG2, shiftCoordUp(aRegionCoord, CUBE_CHUNK_SIZE_LOG2), aMinCell, aMaxCell);
+		}
+		if (PrivGetRegionCount(aLevel, aRegionCoord) == 0)
+		{
+			return true;
+		}
+
+		//	a region with chunks which is inside the box always has a cube in the box
+		const int32_t regionSizeLog2 = CUBE_CHUNK_SIZE_LOG2 + aLevel + 1;
+		const CubeCoord regionMin = shiftCoordUp(aRegionCoord, regionSizeLog2);
+		if (isBoxContaining(aMinCell, aMaxCell, regionMin, offsetCoord(regionMin, (1 << regionSizeLog2) - 1)))
+		{
+			return false;
+		}
+		for (int32_t child = 0; child < 8; child++)
+		{
+			const CubeCoord childMin = getChildMin(regionMin, child, regionSizeLog2 - 1);
+			if (isBoxOverlapping(aMinCell, aMaxCell, childMin, offsetCoord(childMin, (1 << (regionSizeLog2 - 1)) - 1)) &&
+				!PrivIsRegionBoxEmpty(aLevel - 1, shiftCoordDown(childMin, regionSizeLog2 - 1), aMinCell, aMaxCell))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool CubeWorldOctree::PrivIsNodeBoxEmpty(const ChunkTree& aTree, const uint32_t aNode, const int32_t aNodeSizeLog2, const CubeCoord& aNodeMin,
+		const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const
+	{
+		//	nodes only exist where there are cubes
+		const CubeCoord nodeMax = offsetCoord(aNodeMin, (1 << aNodeSizeLog2) - 1);
+		if (isBoxContaining(aMinCell, aMaxCell, aNodeMin, nodeMax))
+		{
+			return false;
+		}
+
+		if (aNodeSizeLog2 == CUBE_BRICK_SIZE_LOG2)
+		{
+			const uint64_t brick = aTree.mBricks[aNode];
+			for (int32_t y = std::max(aMinCell.mY, aNodeMin.mY); y <= std::min(aMaxCell.mY, nodeMax.mY); y++)
+			{
+				for (int32_t z = std::max(aMinCell.mZ, aNodeMin.mZ); z <= std::min(aMaxCell.mZ, nodeMax.mZ); z++)
+				{
+					for (int32_t x = std::max(aMinCell.mX, aNodeMin.mX); x <= std::min(aMaxCell.mX, nodeMax.mX); x++)
+					{
+						if ((brick >> getCubeBrickBit(x, y, z)) & 1)
+						{
+							return false;
+						}
+					}
+				}
+			}
+			return true;
+		}
+
+		const uint32_t childMask = aTree.mNodes[aNode];
+		uint32_t childSlot = aNode + 1;
+		for (int32_t child = 0; child < 8; child++)
+		{
+			if (!(childMask & (1u << child)))
+			{
+				continue;
+			}
+			const uint32_t childNode = aTree.mNodes[childSlot++];
+			const CubeCoord childMin = getChildMin(aNodeMin, child, aNodeSizeLog2 - 1);
+			if (isBoxOverlapping(aMinCell, aMaxCell, childMin, offsetCoord(childMin, (1 << (aNodeSizeLog2 - 1)) - 1)) &&
+				!PrivIsNodeBoxEmpty(aTree, childNode, aNodeSizeLog2 - 1, childMin, aMinCell, aMaxCell))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
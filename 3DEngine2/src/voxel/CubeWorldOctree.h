@@ -0,0 +1,96 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+
+namespace tde
+{
+	//	the leaves of the octree, bricks of 4 x 4 x 4 cells
+	constexpr static int32_t CUBE_BRICK_SIZE_LOG2 = 2;
+
+	//	bit (y * 16 + z * 4 + x) of a brick mask is set if the cell (x, y, z) of the brick has a cube
+	inline uint32_t getCubeBrickBit(const int32_t aX, const int32_t aY, const int32_t aZ)
+	{
+		return static_cast<uint32_t>((aY & 3) * 16 + (aZ & 3) * 4 + (aX & 3));
+	}
+
+	//	the first cube a ray runs into
+	struct CubeRayHit
+	{
+		CubeCoord mCell;
+		int32_t mFace = -1;		//	the face of the cell the ray entered through, in CubeVertexFacing order, -1 if the ray starts inside it
+		float mDistance = 0.0f;	//	along the ray to where it enters the cell
+	};
+
+	//	occupancy index over a cube world for queries which skip empty space
+	//	inside a chunk it's an octree of 32, 16 and 8 cells wide nodes down to 4 x 4 x 4 bricks of occupancy bits,
+	//	identical subtrees are stored once, so solid and repeating parts of a chunk collapse into a few nodes,
+	//	every chunk keeps its own nodes so an edit only rebuilds the tree of one chunk
+	//	above the chunks, regions of 2, 4, .. 64 chunks count the chunks with cubes in them,
+	//	which lets a ray jump over up to 2048 empty cells at once
+	//	queries may run on several threads as long as nobody updates the index
+	class CubeWorldOctree
+	{
+	public:
+		//	the octree of one chunk
+		struct ChunkTree
+		{
+			//	a node is its child mask followed by the indices of the children which exist,
+			//	those are nodes except for the 8 cells wide nodes whose children are bricks
+			std::vector<uint32_t> mNodes;
+			//	see getCubeBrickBit
+			std::vector<uint64_t> mBricks;
+			uint32_t mRoot = 0;
+			uint32_t mNodeCount = 0;
+		};
+
+		CubeWorldOctree() = default;
+		//	builds the trees of the chunks on the workers
+		explicit CubeWorldOctree(CubeWorld& aCubeWorld);
+
+		//	the edits the world recorded so far are covered by the new index
+		void Build(CubeWorld& aCubeWorld);
+		//	rebuilds the chunks which were edited since the last call, see CubeWorld::TakeEditedChunks
+		void Update(CubeWorld& aCubeWorld);
+		//	for when the edited chunks are shared with other indices, e.g. CubeWorldLighting
+		void Update(const CubeWorld& aCubeWorld, const std::vector<CubeCoord>& aEditedChunks);
+		//	rebuilds one chunk, a chunk which doesn't exist anymore is dropped
+		void UpdateChunk(const CubeWorld& aCubeWorld, const CubeCoord& aChunkCoord);
+
+		//	whether no cell in [aMinCell, aMaxCell] has a cube, both corners are inclusive
+		bool IsBoxEmpty(const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const;
+		//	the first cube along the ray within aMaxDistance, the distance is measured in lengths of aDirection
+		bool Raycast(const DirectX::XMFLOAT3& aOrigin, const DirectX::XMFLOAT3& aDirection, const float aMaxDistance, CubeRayHit& aOutHit) const;
+
+		//	the occupancy of the brick with the cell coordinates >> CUBE_BRICK_SIZE_LOG2, 0 where there are no cubes
+		uint64_t GetBrickMask(const CubeCoord& aBrickCoord) const;
+		//	for many lookups in the same chunk, null if the chunk has no cubes
+		const ChunkTree* FindChunkTree(const CubeCoord& aChunkCoord) const;
+		//	the brick coordinates are taken within the chunk, only their lowest bits are used
+		static uint64_t GetBrickMask(const ChunkTree& aTree, const CubeCoord& aBrickCoord);
+
+		//	nodes and bricks after the merging of identical subtrees
+		size_t GetNodeCount() const;
+		size_t GetMemoryUsage() const;
+
+	private:
+		//	region levels above the chunk level, the top regions are 2^REGION_LEVEL_COUNT chunks wide
+		constexpr static int32_t REGION_LEVEL_COUNT = 6;
+
+		//	null if the chunk has no cubes
+		static std::unique_ptr<ChunkTree> PrivBuildChunkTree(const CubeChunk& aChunk);
+		void PrivSetChunkTree(const CubeCoord& aChunkCoord, std::unique_ptr<ChunkTree> apTree);
+		void PrivUpdateBounds();
+		uint32_t PrivGetRegionCount(const int32_t aLevel, const CubeCoord& aRegionCoord) const;
+		//	false if the cell has a cube, otherwise the largest empty node or region around the cell
+		bool PrivFindEmptyBox(const int32_t aCell[3], int32_t aOutBoxMin[3], int32_t& aOutBoxSize) const;
+		bool PrivIsRegionBoxEmpty(const int32_t aLevel, const CubeCoord& aRegionCoord, const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const;
+		bool PrivIsNodeBoxEmpty(const ChunkTree& aTree, const uint32_t aNode, const int32_t aNodeSizeLog2, const CubeCoord& aNodeMin,
+			const CubeCoord& aMinCell, const CubeCoord& aMaxCell) const;
+
+		std::unordered_map<CubeCoord, std::unique_ptr<ChunkTree>, CubeCoordHash> mChunkTrees;
+		//	the chunks with cubes in every region, level l is indexed by the chunk coordinates >> (l + 1)
+		std::unordered_map<CubeCoord, uint32_t, CubeCoordHash> mRegionCounts[REGION_LEVEL_COUNT];
+		//	the top regions which have cubes, inclusive
+		CubeCoord mMinRegion;
+		CubeCoord mMaxRegion;
+	};
+}
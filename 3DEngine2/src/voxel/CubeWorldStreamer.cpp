@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "voxel/CubeWorldStreamer.h"
+#include "voxel/CubeWorldFile.h"
+#include "common/WorkDispatcher.h"
+
+namespace tde
+{
+	CubeWorldStreamer::CubeWorldStreamer(std::shared_ptr<CubeWorldFileReader> apReader, const float aLoadRadius, const float aUnloadRadius, const size_t aMemoryBudget)
+		: mpReader(apReader)
+		, mpCubeWorld(std::make_shared<CubeWorld>(apReader->GetHeader().mMinCell, apReader->GetHeader().mMaxCell))
+		, mLoadRadius(aLoadRadius)
+		, mUnloadRadius(std::max(aLoadRadius, aUnloadRadius))
+		, mMemoryBudget(aMemoryBudget)
+		, mPendingBytes(0)
+	{
+		//	the streamed chunks point into the mapping
+		mpCubeWorld->SetMappedFile(mpReader->GetMappedFile());
+	}
+
+	CubeWorldStreamer::~CubeWorldStreamer()
+	{
+		WorkDispatcherLocator::Get()->WaitFor(mLoadCounter);
+		while (ChunkLoad* pLoad = mFinishedLoads.Pop())
+		{
+			delete pLoad;
+		}
+	}
+
+	void CubeWorldStreamer::Update(const DirectX::XMFLOAT3& aFocusCell)
+	{
+		const DirectX::XMFLOAT3 focusChunk{
+			aFocusCell.x / static_cast<float>(CUBE_CHUNK_SIZE),
+			aFocusCell.y / static_cast<float>(CUBE_CHUNK_SIZE),
+			aFocusCell.z / static_cast<float>(CUBE_CHUNK_SIZE) };
+
+		PrivCommitLoads(focusChunk);
+		PrivEvictChunks(focusChunk);
+		PrivRequestLoads(focusChunk);
+	}
+
+	size_t CubeWorldStreamer::GetResidentBytes() const
+	{
+		//	edited chunks own their cells, so they are asked every time
+		size_t residentBytes = 0;
+		for (const auto& residentChunk : mResidentChunks)
+		{
+			const CubeChunk* pChunk = mpCubeWorld->FindChunk(residentChunk.first);
+			residentBytes += residentChunk.second + (pChunk ? pChunk->GetMemoryUsage() : 0);
+		}
+		return residentBytes;
+	}
+
+	void CubeWorldStreamer::PrivLoadChunk(ChunkLoad* apLoad)
+	{
+		//	verifying the checksum touches every page of the chunk, so it's read from disk here and not while meshing
+		apLoad->mpChunk = apLoad->mpStreamer->mpReader->LoadChunk(*apLoad->mpEntry, true);
+		apLoad->mpStreamer->mFinishedLoads.Push(apLoad);
+	}
+
+	void CubeWorldStreamer::PrivCommitLoads(const DirectX::XMFLOAT3& aFocusChunk)
+	{
+		//	a push which is still in progress is picked up next frame
+		while (ChunkLoad* pLoad = mFinishedLoads.Pop())
+		{
+			const CubeCoord chunkCoord = pLoad->mpEntry->mCoord;
+			auto pendingIt = mPendingLoads.find(chunkCoord);
+			mPendingBytes -= pendingIt->second + sizeof(CubeChunk);
+
+			//	the focus may have moved away while the chunk was loading
+			if (pLoad->mpChunk && PrivGetDistance(chunkCoord, aFocusChunk) <= mUnloadRadius)
+			{
+				mResidentChunks[chunkCoord] = pendingIt->second;
+				mpCubeWorld->AddChunk(chunkCoord, std::move(pLoad->mpChunk));
+			}
+			mPendingLoads.erase(pendingIt);
+			delete pLoad;
+		}
+	}
+
+	void CubeWorldStreamer::PrivEvictChunks(const DirectX::XMFLOAT3& aFocusChunk)
+	{
+		for (auto residentIt = mResidentChunks.begin(); residentIt != mResidentChunks.end();)
+		{
+			if (PrivGetDistance(residentIt->first, aFocusChunk) > mUnloadRadius)
+			{
+				mpCubeWorld->RemoveChunk(residentIt->first);
+				residentIt = mResidentChunks.erase(residentIt);
+			}
+			else
+			{
+				++residentIt;
+			}
+		}
+
+		//	over budget, e.g. after edits expanded some chunks, the farthest chunks go first
+		size_t residentBytes = GetResidentBytes();
+		if (residentBytes <= mMemoryBudget)
+		{
+			return;
+		}
+
+		std::vector<std::pair<float, CubeCoord>> residentChunks;
+		residentChunks.reserve(mResidentChunks.size());
+		for (const auto& residentChunk : mResidentChunks)
+		{
+			residentChunks.emplace_back(PrivGetDistance(residentChunk.first, aFocusChunk), residentChunk.first);
+		}
+		std::sort(residentChunks.begin(), residentChunks.end(), [](const auto& aLeft, const auto& aRight) { return aLeft.first > aRight.first; });
+		for (const auto& residentChunk : residentChunks)
+		{
+			if (residentBytes <= mMemoryBudget)
+			{
+				break;
+			}
+			const CubeChunk* pChunk = mpCubeWorld->FindChunk(residentChunk.second);
+			residentBytes -= mResidentChunks[residentChunk.second] + (pChunk ? pChunk->GetMemoryUsage() : 0);
+			mpCubeWorld->RemoveChunk(residentChunk.second);
+			mResidentChunks.erase(residentChunk.second);
+		}
+	}
+
+	void CubeWorldStreamer::PrivRequestLoads(const DirectX::XMFLOAT3& aFocusChunk)
+	{
+		if (mPendingLoads.size() >= MAX_LOADS_IN_FLIGHT)
+		{
+			return;
+		}
+
+		//	the chunks of the file within the load radius which aren't there yet, nearest first
+		const int32_t radius = static_cast<int32_t>(std::ceil(mLoadRadius));
+		const CubeCoord focusChunk{
+			static_cast<int32_t>(std::floor(aFocusChunk.x)),
+			static_cast<int32_t>(std::floor(aFocusChunk.y)),
+			static_cast<int32_t>(std::floor(aFocusChunk.z)) };
+		std::vector<std::pair<float, const CubeWorldFileChunk*>> candidates;
+		for (int32_t y = focusChunk.mY - radius; y <= focusChunk.mY + radius; y++)
+		{
+			for (int32_t z = focusChunk.mZ - radius; z <= focusChunk.mZ + radius; z++)
+			{
+				for (int32_t x = focusChunk.mX - radius; x <= focusChunk.mX + radius; x++)
+				{
+					const CubeCoord chunkCoord{ x, y, z };
+					const float distance = PrivGetDistance(chunkCoord, aFocusChunk);
+					if (distance > mLoadRadius || mResidentChunks.count(chunkCoord) > 0 || mPendingLoads.count(chunkCoord) > 0)
+					{
+						continue;
+					}
+					if (const CubeWorldFileChunk* pEntry = mpReader->FindChunk(chunkCoord))
+					{
+						candidates.emplace_back(distance, pEntry);
+					}
+				}
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const auto& aLeft, const auto& aRight) { return aLeft.first < aRight.first; });
+
+		WorkDispatcher* pDispatcher = WorkDispatcherLocator::Get().get();
+		size_t residentBytes = GetResidentBytes();
+		for (const auto& candidate : candidates)
+		{
+			const size_t chunkBytes = candidate.second->mDataSize + sizeof(CubeChunk);
+			if (mPendingLoads.size() >= MAX_LOADS_IN_FLIGHT || residentBytes + mPendingBytes + chunkBytes > mMemoryBudget)
+			{
+				break;
+			}
+
+			ChunkLoad* pLoad = new ChunkLoad();
+			pLoad->mpStreamer = this;
+			pLoad->mpEntry = candidate.second;
+			mPendingLoads[candidate.second->mCoord] = candidate.second->mDataSize;
+			mPendingBytes += chunkBytes;
+			pDispatcher->Dispatch(Job([pLoad]() { PrivLoadChunk(pLoad); }, JobPriority::BACKGROUND), &mLoadCounter);
+		}
+	}
+
+	float CubeWorldStreamer::PrivGetDistance(const CubeCoord& aChunkCoord, const DirectX::XMFLOAT3& aFocusChunk) const
+	{
+		//	to the center of the chunk
+		const float dx = static_cast<float>(aChunkCoord.mX) + 0.5f - aFocusChunk.x;
+		const float dy = static_cast<float>(aChunkCoord.mY) + 0.5f - aFocusChunk.y;
+		const float dz = static_cast<float>(aChunkCoord.mZ) + 0.5f - aFocusChunk.z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "voxel/CubeWorld.h"
+#include "common/Job.h"
+#include "common/MpscIntrusiveList.h"
+
+namespace tde
+{
+	class CubeWorldFileReader;
+	struct CubeWorldFileChunk;
+
+	//	keeps the chunks of a cube world file which are within a radius of a focus point in the world,
+	//	chunks are paged in and checked on background jobs and added to the world in Update, so the renderer meshes them as dirty chunks,
+	//	chunks beyond the unload radius are evicted, and the farthest ones once the memory budget is exceeded
+	//	edits to a streamed chunk are lost when it's evicted
+	class CubeWorldStreamer
+	{
+	public:
+		//	bounds the work queued per frame, so a fast moving focus can't flood the workers
+		static constexpr size_t MAX_LOADS_IN_FLIGHT = 16;
+
+		//	the radii are in chunks, the unload radius is at least the load radius so chunks on the edge don't flicker,
+		//	the budget covers the chunks and their data in the file
+		CubeWorldStreamer(std::shared_ptr<CubeWorldFileReader> apReader, const float aLoadRadius, const float aUnloadRadius, const size_t aMemoryBudget);
+		CubeWorldStreamer(const CubeWorldStreamer& aOther) = delete;
+		CubeWorldStreamer& operator=(const CubeWorldStreamer& aOther) = delete;
+		//	waits for the loads in flight
+		~CubeWorldStreamer();
+
+		//	on the thread which owns the world, aFocusCell is in cells
+		void Update(const DirectX::XMFLOAT3& aFocusCell);
+
+		//	starts empty with the bounds of the file
+		inline const std::shared_ptr<CubeWorld>& GetCubeWorld() const { return mpCubeWorld; }
+		size_t GetResidentBytes() const;
+		inline size_t GetPendingLoadCount() const { return mPendingLoads.size(); }
+
+	private:
+		struct ChunkLoad : public MpscNode
+		{
+			CubeWorldStreamer* mpStreamer;
+			const CubeWorldFileChunk* mpEntry;
+			std::unique_ptr<CubeChunk> mpChunk;	//	nullptr if the chunk is damaged
+		};
+
+		static void PrivLoadChunk(ChunkLoad* apLoad);
+		void PrivCommitLoads(const DirectX::XMFLOAT3& aFocusChunk);
+		void PrivEvictChunks(const DirectX::XMFLOAT3& aFocusChunk);
+		void PrivRequestLoads(const DirectX::XMFLOAT3& aFocusChunk);
+		float PrivGetDistance(const CubeCoord& aChunkCoord, const DirectX::XMFLOAT3& aFocusChunk) const;
+
+		std::shared_ptr<CubeWorldFileReader> mpReader;
+		std::shared_ptr<CubeWorld> mpCubeWorld;
+		float mLoadRadius;
+		float mUnloadRadius;
+		size_t mMemoryBudget;
+
+		//	resident and loading chunks with the size of their data in the file
+		std::unordered_map<CubeCoord, size_t, CubeCoordHash> mResidentChunks;
+		std::unordered_map<CubeCoord, size_t, CubeCoordHash> mPendingLoads;
+		//	what the loading chunks will take once they are resident
+		size_t mPendingBytes;
+		MpscIntrusiveList<ChunkLoad> mFinishedLoads;
+		JobCounter mLoadCounter;
+	};
+}
@@ -0,0 +1,32 @@
+#include "pch.h"
+#include "TestFramework.h"
+#include "common/WorkDispatcher.h"
+
+#include <cstring>
+
+using namespace tde;
+
+//	3DEngine2Tests [-bench] [name filter]
+//	runs the tests, or the benchmarks with -bench, the exit code is the number of failed tests
+int main(int argc, char* argv[])
+{
+	TestKind kind = TestKind::TEST;
+	const char* pFilter = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "-bench") == 0)
+		{
+			kind = TestKind::BENCHMARK;
+		}
+		else
+		{
+			pFilter = argv[i];
+		}
+	}
+
+	//	one worker per core like the game, for the parts which spread over the workers
+	WorkDispatcherLocator::Provide(std::make_shared<WorkDispatcher>("Tests"));
+	const int failedCount = TestRegistry::Get().Run(kind, pFilter);
+	WorkDispatcherLocator::Provide(nullptr);
+	return failedCount;
+}
@@ -0,0 +1,52 @@
+#include "pch.h"
+#include "TestFramework.h"
+
+#include <chrono>
+#include <cstring>
+
+namespace tde
+{
+	TestRegistry& TestRegistry::Get()
+	{
+		//	a function static, the registrations run before main in any order
+		static TestRegistry registry;
+		return registry;
+	}
+
+	void TestRegistry::Add(const char* apName, const TestKind aKind, TestFunction apFunction)
+	{
+		mEntries.push_back({ apName, aKind, apFunction });
+	}
+
+	void TestRegistry::ReportFailure(const char* apExpression, const char* apFile, const int aLine)
+	{
+		mFailureCount.fetch_add(1, std::memory_order_relaxed);
+		std::printf("    %s(%d): check failed: %s\n", apFile, aLine, apExpression);
+	}
+
+	int TestRegistry::Run(const TestKind aKind, const char* apFilter)
+	{
+		int failedCount = 0;
+		int runCount = 0;
+		for (const Entry& entry : mEntries)
+		{
+			if (entry.mKind != aKind || (apFilter && !std::strstr(entry.mpName, apFilter)))
+			{
+				continue;
+			}
+
+			std::printf("%s\n", entry.mpName);
+			std::fflush(stdout);
+			const uint32_t failuresBefore = mFailureCount.load(std::memory_order_relaxed);
+			const auto start = std::chrono::steady_clock::now();
+			entry.mpFunction();
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			const bool isFailed = mFailureCount.load(std::memory_order_relaxed) != failuresBefore;
+			std::printf("    %s in %.1f ms\n", isFailed ? "FAILED" : "passed", milliseconds);
+			failedCount += isFailed;
+			runCount++;
+		}
+		std::printf("%d of %d failed\n", failedCount, runCount);
+		return failedCount;
+	}
+}
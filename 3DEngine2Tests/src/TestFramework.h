@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+
+namespace tde
+{
+	enum class TestKind : uint8_t
+	{
+		TEST,		//	checks something and fails the run if a TDE_CHECK doesn't hold
+		BENCHMARK,	//	prints its own numbers, only runs when asked for
+	};
+
+	//	every TDE_TEST and TDE_BENCHMARK adds itself before main, the runner picks them by kind and name
+	class TestRegistry
+	{
+	public:
+		using TestFunction = void(*)();
+
+		static TestRegistry& Get();
+
+		void Add(const char* apName, const TestKind aKind, TestFunction apFunction);
+		//	checks may fail on any thread, a failing check doesn't stop the test so one run shows every broken check
+		void ReportFailure(const char* apExpression, const char* apFile, const int aLine);
+		//	runs the tests of aKind whose name contains apFilter, nullptr runs all of them, returns the number of failed tests
+		int Run(const TestKind aKind, const char* apFilter);
+
+	private:
+		struct Entry
+		{
+			const char* mpName;
+			TestKind mKind;
+			TestFunction mpFunction;
+		};
+
+		std::vector<Entry> mEntries;
+		std::atomic<uint32_t> mFailureCount = 0;
+	};
+
+	struct TestRegistration
+	{
+		inline TestRegistration(const char* apName, const TestKind aKind, TestRegistry::TestFunction apFunction)
+		{
+			TestRegistry::Get().Add(apName, aKind, apFunction);
+		}
+	};
+}
+
+#define TDE_TEST(aName) \
+	static void aName(); \
+	static const tde::TestRegistration aName##Registration(#aName, tde::TestKind::TEST, &aName); \
+	static void aName()
+
+#define TDE_BENCHMARK(aName) \
+	static void aName(); \
+	static const tde::TestRegistration aName##Registration(#aName, tde::TestKind::BENCHMARK, &aName); \
+	static void aName()
+
+#define TDE_CHECK(aExpression) \
+	do \
+	{ \
+		if (!(aExpression)) \
+		{ \
+			tde::TestRegistry::Get().ReportFailure(#aExpression, __FILE__, __LINE__); \
+		} \
+	} while (false)
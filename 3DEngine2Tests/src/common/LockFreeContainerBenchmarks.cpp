@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "TestFramework.h"
+#include "common/MpmcQueue.h"
+#include "common/MpscIntrusiveList.h"
+#include "common/SpscRingBuffer.h"
+
+#include <chrono>
+
+namespace tde
+{
+	namespace
+	{
+		constexpr uint32_t ITEMS_PER_PRODUCER = 1000000;
+		constexpr size_t QUEUE_CAPACITY = 1024;
+
+		//	what the lock free containers replace
+		template<typename T>
+		class MutexQueue
+		{
+		public:
+			inline bool TryPush(const T& aItem)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (mItems.size() >= QUEUE_CAPACITY)
+				{
+					return false;
+				}
+				mItems.push_back(aItem);
+				return true;
+			}
+
+			inline bool TryPop(T& aOutItem)
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				if (mItems.empty())
+				{
+					return false;
+				}
+				aOutItem = mItems.front();
+				mItems.pop_front();
+				return true;
+			}
+
+		private:
+			std::mutex mMutex;
+			std::deque<T> mItems;
+		};
+
+		struct ListItem : public MpscNode
+		{
+			uint32_t mNumber = 0;
+		};
+
+		//	every producer pushes ITEMS_PER_PRODUCER items, the consumers pop until all of them are through,
+		//	prints millions of items per second from the first push to the last pop
+		template<typename PushFunction, typename PopFunction>
+		void runQueueBenchmark(const char* apName, const uint32_t aProducerCount, const uint32_t aConsumerCount,
+			PushFunction&& aPush, PopFunction&& aPop)
+		{
+			const uint64_t totalCount = static_cast<uint64_t>(aProducerCount) * ITEMS_PER_PRODUCER;
+			std::atomic<uint64_t> poppedCount = 0;
+			std::atomic<bool> isStarted = false;
+			std::vector<std::thread> threads;
+			for (uint32_t producer = 0; producer < aProducerCount; producer++)
+			{
+				threads.emplace_back([&, producer]()
+				{
+					while (!isStarted.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+					for (uint32_t number = 0; number < ITEMS_PER_PRODUCER; number++)
+					{
+						while (!aPush(producer, number))
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+			}
+			for (uint32_t consumer = 0; consumer < aConsumerCount; consumer++)
+			{
+				threads.emplace_back([&]()
+				{
+					while (!isStarted.load(std::memory_order_acquire))
+					{
+						std::this_thread::yield();
+					}
+					while (poppedCount.load(std::memory_order_relaxed) < totalCount)
+					{
+						if (aPop())
+						{
+							poppedCount.fetch_add(1, std::memory_order_relaxed);
+						}
+						else
+						{
+							std::this_thread::yield();
+						}
+					}
+				});
+			}
+
+			const auto start = std::chrono::steady_clock::now();
+			isStarted.store(true, std::memory_order_release);
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::printf("    %-28s %2u producers %2u consumers %8.2f M items/s\n", apName, aProducerCount, aConsumerCount,
+				static_cast<double>(totalCount) / seconds / 1000000.0);
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> getThreadSplits()
+		{
+			const uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+			return { { 1, 1 }, { threadCount / 2, threadCount - threadCount / 2 }, { threadCount - 1, 1 } };
+		}
+	}
+
+	TDE_BENCHMARK(MpmcQueueThroughput)
+	{
+		for (const auto& [producerCount, consumerCount] : getThreadSplits())
+		{
+			MpmcQueue<uint64_t> queue(QUEUE_CAPACITY);
+			runQueueBenchmark("MpmcQueue", producerCount, consumerCount,
+				[&](const uint32_t aProducer, const uint32_t aNumber) { return queue.TryPush((static_cast<uint64_t>(aProducer) << 32) | aNumber); },
+				[&]() { uint64_t item; return queue.TryPop(item); });
+
+			MutexQueue<uint64_t> mutexQueue;
+			runQueueBenchmark("std::mutex + std::deque", producerCount, consumerCount,
+				[&](const uint32_t aProducer, const uint32_t aNumber) { return mutexQueue.TryPush((static_cast<uint64_t>(aProducer) << 32) | aNumber); },
+				[&]() { uint64_t item; return mutexQueue.TryPop(item); });
+		}
+	}
+
+	TDE_BENCHMARK(SpscRingBufferThroughput)
+	{
+		SpscRingBuffer<uint64_t, QUEUE_CAPACITY> buffer;
+		runQueueBenchmark("SpscRingBuffer", 1, 1,
+			[&](const uint32_t aProducer, const uint32_t aNumber) { return buffer.TryPush((static_cast<uint64_t>(aProducer) << 32) | aNumber); },
+			[&]() { uint64_t item; return buffer.TryPop(item); });
+
+		MpmcQueue<uint64_t> queue(QUEUE_CAPACITY);
+		runQueueBenchmark("MpmcQueue", 1, 1,
+			[&](const uint32_t aProducer, const uint32_t aNumber) { return queue.TryPush((static_cast<uint64_t>(aProducer) << 32) | aNumber); },
+			[&]() { uint64_t item; return queue.TryPop(item); });
+
+		MutexQueue<uint64_t> mutexQueue;
+		runQueueBenchmark("std::mutex + std::deque", 1, 1,
+			[&](const uint32_t aProducer, const uint32_t aNumber) { return mutexQueue.TryPush((static_cast<uint64_t>(aProducer) << 32) | aNumber); },
+			[&]() { uint64_t item; return mutexQueue.TryPop(item); });
+	}
+
+	TDE_BENCHMARK(MpscIntrusiveListThroughput)
+	{
+		const uint32_t threadCount = std::max(2u, std::thread::hardware_concurrency());
+		for (const uint32_t producerCount : { 1u, threadCount - 1 })
+		{
+			//	the list never allocates, the items are made up front
+			std::vector<ListItem> items(producerCount * static_cast<size_t>(ITEMS_PER_PRODUCER));
+			MpscIntrusiveList<ListItem> list;
+			runQueueBenchmark("MpscIntrusiveList", producerCount, 1,
+				[&](const uint32_t aProducer, const uint32_t aNumber)
+				{
+					list.Push(&items[static_cast<size_t>(aProducer) * ITEMS_PER_PRODUCER + aNumber]);
+					return true;
+				},
+				[&]() { return list.Pop() != nullptr; });
+
+			MutexQueue<ListItem*> mutexQueue;
+			runQueueBenchmark("std::mutex + std::deque", producerCount, 1,
+				[&](const uint32_t aProducer, const uint32_t aNumber) { return mutexQueue.TryPush(&items[static_cast<size_t>(aProducer) * ITEMS_PER_PRODUCER + aNumber]); },
+				[&]() { ListItem* pItem; return mutexQueue.TryPop(pItem); });
+		}
+	}
+}
@@ -0,0 +1,272 @@
+#include "pch.h"
+#include "TestFramework.h"
+#include "common/MpmcQueue.h"
+#include "common/MpscIntrusiveList.h"
+#include "common/SpscRingBuffer.h"
+
+namespace tde
+{
+	namespace
+	{
+		//	more threads than cores on purpose, so threads get preempted in the middle of a push or pop
+		uint32_t getStressThreadCount()
+		{
+			return std::max(4u, std::thread::hardware_concurrency());
+		}
+
+		//	the producer in the upper half, its running number in the lower one
+		inline uint64_t makeItem(const uint32_t aProducer, const uint32_t aNumber)
+		{
+			return (static_cast<uint64_t>(aProducer) << 32) | aNumber;
+		}
+
+		struct ListItem : public MpscNode
+		{
+			uint32_t mProducer = 0;
+			uint32_t mNumber = 0;
+		};
+	}
+
+	TDE_TEST(MpmcQueueFullAndEmpty)
+	{
+		MpmcQueue<int> queue(5);
+		TDE_CHECK(queue.GetCapacity() == 8);
+
+		int item = 0;
+		TDE_CHECK(!queue.TryPop(item));
+		for (int i = 0; i < 8; i++)
+		{
+			TDE_CHECK(queue.TryPush(i));
+		}
+		TDE_CHECK(!queue.TryPush(8));
+		TDE_CHECK(queue.GetSize() == 8);
+
+		//	a few laps around the ring
+		for (int i = 0; i < 100; i++)
+		{
+			TDE_CHECK(queue.TryPop(item) && item == i);
+			TDE_CHECK(queue.TryPush(i + 8));
+		}
+		for (int i = 100; i < 108; i++)
+		{
+			TDE_CHECK(queue.TryPop(item) && item == i);
+		}
+		TDE_CHECK(!queue.TryPop(item));
+		TDE_CHECK(queue.GetSize() == 0);
+	}
+
+	TDE_TEST(MpmcQueueStress)
+	{
+		//	a small queue, so producers keep running into a full queue and consumers into an empty one
+		constexpr uint32_t ITEMS_PER_PRODUCER = 200000;
+		MpmcQueue<uint64_t> queue(64);
+		const uint32_t producerCount = getStressThreadCount() / 2;
+		const uint32_t consumerCount = getStressThreadCount() - producerCount;
+
+		std::vector<std::vector<uint64_t>> consumed(consumerCount);
+		std::atomic<uint32_t> finishedProducerCount = 0;
+		std::vector<std::thread> threads;
+		for (uint32_t producer = 0; producer < producerCount; producer++)
+		{
+			threads.emplace_back([&, producer]()
+			{
+				for (uint32_t number = 0; number < ITEMS_PER_PRODUCER; number++)
+				{
+					while (!queue.TryPush(makeItem(producer, number)))
+					{
+						std::this_thread::yield();
+					}
+				}
+				finishedProducerCount.fetch_add(1, std::memory_order_release);
+			});
+		}
+		for (uint32_t consumer = 0; consumer < consumerCount; consumer++)
+		{
+			threads.emplace_back([&, consumer]()
+			{
+				//	once every push is done an empty queue stays empty, so lost items fail the test instead of hanging it
+				for (;;)
+				{
+					const bool isPushingDone = finishedProducerCount.load(std::memory_order_acquire) == producerCount;
+					uint64_t item;
+					if (queue.TryPop(item))
+					{
+						consumed[consumer].push_back(item);
+					}
+					else if (isPushingDone)
+					{
+						break;
+					}
+					else
+					{
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		//	every item exactly once, and every consumer sees the items of a producer in the order they were pushed
+		std::vector<uint32_t> seenCounts(producerCount * static_cast<size_t>(ITEMS_PER_PRODUCER), 0);
+		for (const std::vector<uint64_t>& items : consumed)
+		{
+			std::vector<int64_t> lastNumbers(producerCount, -1);
+			for (const uint64_t item : items)
+			{
+				const uint32_t producer = static_cast<uint32_t>(item >> 32);
+				const uint32_t number = static_cast<uint32_t>(item);
+				TDE_CHECK(producer < producerCount && number < ITEMS_PER_PRODUCER);
+				if (producer >= producerCount || number >= ITEMS_PER_PRODUCER)
+				{
+					continue;
+				}
+				TDE_CHECK(static_cast<int64_t>(number) > lastNumbers[producer]);
+				lastNumbers[producer] = number;
+				seenCounts[static_cast<size_t>(producer) * ITEMS_PER_PRODUCER + number]++;
+			}
+		}
+		TDE_CHECK(std::all_of(seenCounts.begin(), seenCounts.end(), [](const uint32_t aCount) { return aCount == 1; }));
+		uint64_t item;
+		TDE_CHECK(!queue.TryPop(item));
+	}
+
+	TDE_TEST(SpscRingBufferFullAndEmpty)
+	{
+		SpscRingBuffer<int, 8> buffer;
+		int item = 0;
+		TDE_CHECK(!buffer.TryPop(item));
+		for (int i = 0; i < 8; i++)
+		{
+			TDE_CHECK(buffer.TryPush(i));
+		}
+		TDE_CHECK(!buffer.TryPush(8));
+		TDE_CHECK(buffer.GetSize() == 8);
+
+		for (int i = 0; i < 100; i++)
+		{
+			TDE_CHECK(buffer.TryPop(item) && item == i);
+			TDE_CHECK(buffer.TryPush(i + 8));
+		}
+		for (int i = 100; i < 108; i++)
+		{
+			TDE_CHECK(buffer.TryPop(item) && item == i);
+		}
+		TDE_CHECK(!buffer.TryPop(item));
+		TDE_CHECK(buffer.GetSize() == 0);
+	}
+
+	TDE_TEST(SpscRingBufferStress)
+	{
+		//	small enough that the producer keeps catching up with the consumer and its cached head goes stale
+		constexpr uint32_t ITEM_COUNT = 2000000;
+		SpscRingBuffer<uint64_t, 64> buffer;
+
+		std::atomic<bool> isPushingDone = false;
+		std::thread producer([&]()
+		{
+			for (uint32_t number = 0; number < ITEM_COUNT; number++)
+			{
+				while (!buffer.TryPush(makeItem(number & 0xFF, number)))
+				{
+					std::this_thread::yield();
+				}
+			}
+			isPushingDone.store(true, std::memory_order_release);
+		});
+
+		//	the consumer runs on this thread, every item has to come out once and in the order it was pushed
+		uint32_t nextNumber = 0;
+		uint32_t wrongItemCount = 0;
+		for (;;)
+		{
+			const bool isDone = isPushingDone.load(std::memory_order_acquire);
+			uint64_t item;
+			if (buffer.TryPop(item))
+			{
+				wrongItemCount += item != makeItem(nextNumber & 0xFF, nextNumber) ? 1 : 0;
+				nextNumber++;
+			}
+			else if (isDone)
+			{
+				break;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+		producer.join();
+
+		TDE_CHECK(wrongItemCount == 0);
+		TDE_CHECK(nextNumber == ITEM_COUNT);
+		TDE_CHECK(buffer.GetSize() == 0);
+	}
+
+	TDE_TEST(MpscIntrusiveListStress)
+	{
+		constexpr uint32_t ITEMS_PER_PRODUCER = 200000;
+		const uint32_t producerCount = getStressThreadCount() - 1;
+		std::vector<ListItem> items(producerCount * static_cast<size_t>(ITEMS_PER_PRODUCER));
+		MpscIntrusiveList<ListItem> list;
+
+		std::atomic<uint32_t> finishedProducerCount = 0;
+		std::vector<std::thread> producers;
+		for (uint32_t producer = 0; producer < producerCount; producer++)
+		{
+			producers.emplace_back([&, producer]()
+			{
+				for (uint32_t number = 0; number < ITEMS_PER_PRODUCER; number++)
+				{
+					ListItem& item = items[static_cast<size_t>(producer) * ITEMS_PER_PRODUCER + number];
+					item.mProducer = producer;
+					item.mNumber = number;
+					list.Push(&item);
+				}
+				finishedProducerCount.fetch_add(1, std::memory_order_release);
+			});
+		}
+
+		//	the consumer runs on this thread, nullptr only means nothing can be popped right now,
+		//	unless every push is done before
+		std::vector<int64_t> lastNumbers(producerCount, -1);
+		std::vector<uint8_t> seenCounts(items.size(), 0);
+		size_t poppedCount = 0;
+		for (;;)
+		{
+			const bool isPushingDone = finishedProducerCount.load(std::memory_order_acquire) == producerCount;
+			ListItem* pItem = list.Pop();
+			if (!pItem)
+			{
+				if (isPushingDone)
+				{
+					break;
+				}
+				std::this_thread::yield();
+				continue;
+			}
+			const size_t index = static_cast<size_t>(pItem - items.data());
+			TDE_CHECK(index < items.size());
+			if (index >= items.size() || poppedCount++ > items.size())
+			{
+				break;
+			}
+			TDE_CHECK(static_cast<int64_t>(pItem->mNumber) > lastNumbers[pItem->mProducer]);
+			lastNumbers[pItem->mProducer] = pItem->mNumber;
+			seenCounts[index]++;
+		}
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		TDE_CHECK(std::all_of(seenCounts.begin(), seenCounts.end(), [](const uint8_t aCount) { return aCount == 1; }));
+		TDE_CHECK(list.Pop() == nullptr);
+		//	the list still works once it has been drained
+		list.Push(&items[0]);
+		TDE_CHECK(list.Pop() == &items[0]);
+		TDE_CHECK(list.Pop() == nullptr);
+	}
+}
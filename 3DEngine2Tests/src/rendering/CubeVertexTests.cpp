@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "TestFramework.h"
+#include "rendering/CubeWorldRenderer.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace tde
+{
+	namespace
+	{
+		bool areCornersEqual(const CubeVertexCorner& aLeft, const CubeVertexCorner& aRight)
+		{
+			return aLeft.mX == aRight.mX && aLeft.mY == aRight.mY && aLeft.mZ == aRight.mZ &&
+				aLeft.mFacing == aRight.mFacing && aLeft.mTexCoord == aRight.mTexCoord && aLeft.mMaterial == aRight.mMaterial &&
+				aLeft.mOcclusion == aRight.mOcclusion && aLeft.mLight == aRight.mLight;
+		}
+
+		//	a different occlusion and light in every corner, so a face which reads the wrong corner shows
+		inline UINT32 getTestCornerShading(const int32_t aCorner)
+		{
+			return static_cast<UINT32>(aCorner) | ((static_cast<UINT32>(aCorner) * 4 + 3) << 2);
+		}
+
+		//	where BoxVS puts a full vertex, the box center plus half the box size towards the corner of the vertex index
+		void getFullVertexPosition(const CubeWorldRenderer::CubeVertex& aVertex, float aOutPosition[3])
+		{
+			const float center[3] = { aVertex.mCenterPosition.x, aVertex.mCenterPosition.y, aVertex.mCenterPosition.z };
+			for (int32_t axis = 0; axis < 3; axis++)
+			{
+				const float boxSize = static_cast<float>(((aVertex.mVertex >> (CUBE_VERTEX_EXTENT_SHIFT + CUBE_VERTEX_EXTENT_BITS * axis)) & 0x1F) + 1);
+				const float direction = ((aVertex.mVertex >> (2 - axis)) & 1) ? 0.5f : -0.5f;
+				aOutPosition[axis] = center[axis] + direction * boxSize;
+			}
+		}
+	}
+
+	TDE_TEST(CubeCompactVertexRoundTrip)
+	{
+		//	the first and the far corner of a chunk and a few in between, every facing, tex coord, occlusion and light,
+		//	and the smallest and largest materials
+		const int32_t coords[] = { 0, 1, 17, CUBE_CHUNK_SIZE - 1, CUBE_CHUNK_SIZE };
+		const UINT32 materials[] = { 0, 1, 64, CUBE_MATERIAL_COUNT - 1 };
+		uint32_t mismatchCount = 0;
+		for (const int32_t x : coords)
+		{
+			for (const int32_t y : coords)
+			{
+				for (const int32_t z : coords)
+				{
+					for (UINT32 facing = 0; facing < 6; facing++)
+					{
+						for (UINT32 texCoord = 0; texCoord < 4; texCoord++)
+						{
+							for (const UINT32 material : materials)
+							{
+								for (UINT32 occlusion = 0; occlusion <= CUBE_VERTEX_MAX_OCCLUSION; occlusion++)
+								{
+									for (UINT32 light = 0; light < 16; light++)
+									{
+										CubeVertexCorner corner;
+										corner.mX = x;
+										corner.mY = y;
+										corner.mZ = z;
+										corner.mFacing = facing;
+										corner.mTexCoord = texCoord;
+										corner.mMaterial = material;
+										corner.mOcclusion = occlusion;
+										corner.mLight = light;
+										mismatchCount += !areCornersEqual(unpackCubeCompactVertex(packCubeCompactVertex(corner)), corner);
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+		TDE_CHECK(mismatchCount == 0);
+	}
+
+	TDE_TEST(CubeCompactVertexLayout)
+	{
+		//	BoxCompactVS reads the bits straight from the vertex, so every field has to end up where the layout says
+		CubeVertexCorner corner;
+		corner.mX = CUBE_CHUNK_SIZE;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == static_cast<UINT32>(CUBE_CHUNK_SIZE));
+		corner = {};
+		corner.mY = CUBE_CHUNK_SIZE;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == static_cast<UINT32>(CUBE_CHUNK_SIZE) << 6);
+		corner = {};
+		corner.mZ = CUBE_CHUNK_SIZE;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == static_cast<UINT32>(CUBE_CHUNK_SIZE) << 12);
+		corner = {};
+		corner.mFacing = CubeVertexFacing::PZ >> 3;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == 5u << 18);
+		corner = {};
+		corner.mTexCoord = CubeTexCoord::BOTTOM_RIGHT >> 6;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == 3u << 21);
+		corner = {};
+		corner.mMaterial = CUBE_MATERIAL_COUNT - 1;
+		TDE_CHECK(packCubeCompactVertex(corner).mCorner == 0x7Fu << 23);
+
+		//	the shading is laid out like packCubeVertexShading without the shift
+		corner = {};
+		corner.mOcclusion = CUBE_VERTEX_MAX_OCCLUSION;
+		corner.mLight = 15;
+		const CubeCompactVertex vertex = packCubeCompactVertex(corner);
+		TDE_CHECK(vertex.mCorner == 0);
+		TDE_CHECK(vertex.mShading == packCubeVertexShading(CUBE_VERTEX_MAX_OCCLUSION, 15) >> CUBE_VERTEX_SHADING_SHIFT);
+		TDE_CHECK(vertex.mShading == 0x3F);
+	}
+
+	TDE_TEST(CubeFaceExpansion)
+	{
+		//	every facing and size, at the first cell of a chunk and at one inside it
+		const int32_t corners[][3] = { { 0, 0, 0 }, { 3, 17, 31 } };
+		const UINT32 materials[] = { 0, CUBE_MATERIAL_COUNT - 1 };
+		UINT32 faceShading = 0;
+		for (int32_t corner = 0; corner < 4; corner++)
+		{
+			faceShading |= getTestCornerShading(corner) << (corner * 6);
+		}
+
+		uint32_t cornerMismatchCount = 0;
+		uint32_t fullVertexMismatchCount = 0;
+		uint32_t windingMismatchCount = 0;
+		float firstWinding = 0.0f;
+		for (const auto& corner : corners)
+		{
+			for (UINT32 facing = 0; facing < 6; facing++)
+			{
+				const int32_t normalAxis = static_cast<int32_t>(facing % 3);
+				const int32_t uAxis = (normalAxis + 1) % 3;
+				const int32_t vAxis = (normalAxis + 2) % 3;
+				for (UINT32 uSize = 1; uSize <= CUBE_FACE_MAX_SIZE; uSize++)
+				{
+					for (UINT32 vSize = 1; vSize <= CUBE_FACE_MAX_SIZE; vSize++)
+					{
+						const UINT32 material = materials[(uSize + vSize) % 2];
+						const CubeFace face = packCubeFace(corner, facing, uSize, vSize, faceShading, material);
+						CubeVertexCorner faceCorners[6];
+						expandCubeFace(face, faceCorners);
+						CubeWorldRenderer::CubeVertex fullVertices[6];
+						expandCubeFaceVertices(face, CubeCoord{ 0, 0, 0 }, DirectX::XMFLOAT3{ 0.0f, 0.0f, 0.0f }, fullVertices);
+
+						float positions[6][3];
+						for (size_t i = 0; i < 6; i++)
+						{
+							//	the corner straight from the vertex index in the table, the face lies in the plane of its corner
+							const UINT32 vertex = CUBE_FACE_VERTICES[facing][i];
+							int32_t expected[3] = { corner[0], corner[1], corner[2] };
+							expected[uAxis] += ((vertex >> (2 - uAxis)) & 1) ? static_cast<int32_t>(uSize) : 0;
+							expected[vAxis] += ((vertex >> (2 - vAxis)) & 1) ? static_cast<int32_t>(vSize) : 0;
+							const int32_t faceCorner = static_cast<int32_t>(((vertex >> (2 - uAxis)) & 1) | (((vertex >> (2 - vAxis)) & 1) << 1));
+							const UINT32 cornerShading = getTestCornerShading(faceCorner);
+
+							const CubeVertexCorner& faceVertex = faceCorners[i];
+							cornerMismatchCount += faceVertex.mX != expected[0] || faceVertex.mY != expected[1] || faceVertex.mZ != expected[2] ||
+								faceVertex.mFacing != facing || faceVertex.mTexCoord != ((vertex >> 6) & 0x3) || faceVertex.mMaterial != material ||
+								faceVertex.mOcclusion != (cornerShading & 0x3) || faceVertex.mLight != (cornerShading >> 2) ||
+								((vertex >> 3) & 0x7) != facing;
+
+							//	the full vertex has to end up on the same corner with the same bits
+							const CubeWorldRenderer::CubeVertex& fullVertex = fullVertices[i];
+							getFullVertexPosition(fullVertex, positions[i]);
+							fullVertexMismatchCount += positions[i][0] != static_cast<float>(expected[0]) ||
+								positions[i][1] != static_cast<float>(expected[1]) ||
+								positions[i][2] != static_cast<float>(expected[2]) ||
+								(fullVertex.mVertex & 0xFF) != vertex ||
+								fullVertex.mVertex >> CUBE_VERTEX_SHADING_SHIFT != cornerShading ||
+								fullVertex.mMaterial != material;
+						}
+
+						//	both triangles wind the same way seen from in front of the face, for every facing
+						const float normalSign = facing < 3 ? -1.0f : 1.0f;
+						for (size_t triangle = 0; triangle < 6; triangle += 3)
+						{
+							const float* p0 = positions[triangle];
+							const float* p1 = positions[triangle + 1];
+							const float* p2 = positions[triangle + 2];
+							const int32_t a = uAxis;
+							const int32_t b = vAxis;
+							const float winding = normalSign *
+								((p1[a] - p0[a]) * (p2[b] - p0[b]) - (p1[b] - p0[b]) * (p2[a] - p0[a]));
+							firstWinding = firstWinding == 0.0f ? winding : firstWinding;
+							windingMismatchCount += winding == 0.0f || (winding > 0.0f) != (firstWinding > 0.0f);
+						}
+					}
+				}
+			}
+		}
+		TDE_CHECK(cornerMismatchCount == 0);
+		TDE_CHECK(fullVertexMismatchCount == 0);
+		TDE_CHECK(windingMismatchCount == 0);
+	}
+
+	TDE_TEST(CubeFaceVerticesMatchBoxFacesVS)
+	{
+		//	the shader can't include the table, so it has its own copy as numbers, read it from the source next to this one
+		const std::filesystem::path shaderPath = std::filesystem::path(__FILE__).parent_path() / "../../../3DEngine2/src/shaders/BoxFacesVS.hlsl";
+		std::ifstream file(shaderPath);
+		TDE_CHECK(file.is_open());
+		std::stringstream source;
+		source << file.rdbuf();
+		const std::string text = source.str();
+
+		const size_t tableBegin = text.find("faceVertices[6][6]");
+		TDE_CHECK(tableBegin != std::string::npos);
+		if (tableBegin == std::string::npos)
+		{
+			return;
+		}
+		const size_t tableEnd = text.find("};", tableBegin);
+		std::stringstream table(text.substr(text.find('{', tableBegin), tableEnd - tableBegin));
+		std::vector<UINT32> numbers;
+		while (table)
+		{
+			const int next = table.peek();
+			if (next >= '0' && next <= '9')
+			{
+				UINT32 number;
+				table >> number;
+				numbers.push_back(number);
+			}
+			else
+			{
+				table.get();
+			}
+		}
+
+		TDE_CHECK(numbers.size() == 36);
+		if (numbers.size() != 36)
+		{
+			return;
+		}
+		for (size_t facing = 0; facing < 6; facing++)
+		{
+			for (size_t i = 0; i < 6; i++)
+			{
+				TDE_CHECK(numbers[facing * 6 + i] == CUBE_FACE_VERTICES[facing][i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "TestFramework.h"
+#include "common/CpuFeatures.h"
+#include "common/WorkDispatcher.h"
+#include "common/ParallelAlgorithms.h"
+#include "voxel/CubeRaycaster.h"
+#include "voxel/CubeWorldGenerator.h"
+
+#include <chrono>
+#include <random>
+
+namespace tde
+{
+	namespace
+	{
+		constexpr size_t RAY_COUNT = 1 << 18;
+		constexpr int32_t RUN_COUNT = 3;
+		//	the world is 8 x 3 x 8 chunks around the origin, high enough for the default terrain and its caves
+		constexpr int32_t WORLD_CHUNKS = 4;
+		constexpr float RAY_MAX_DISTANCE = 256.0f;
+
+		//	rays from above the terrain looking down at it at a shallow angle, like picking and line of sight do,
+		//	most of them walk a long way through the air before they hit
+		std::vector<CubeRay> makeRays()
+		{
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-WORLD_CHUNKS * CUBE_CHUNK_SIZE * 0.75f, WORLD_CHUNKS * CUBE_CHUNK_SIZE * 0.75f);
+			std::uniform_real_distribution<float> horizontal(-1.0f, 1.0f);
+			std::uniform_real_distribution<float> down(-0.5f, -0.05f);
+			std::vector<CubeRay> rays(RAY_COUNT);
+			for (CubeRay& ray : rays)
+			{
+				const float x = horizontal(random);
+				const float y = down(random);
+				const float z = horizontal(random);
+				const float length = std::sqrt(x * x + y * y + z * z);
+				ray.mDirection = { x / length, y / length, z / length };
+				ray.mOrigin = { position(random), 80.0f, position(random) };
+				ray.mMaxDistance = RAY_MAX_DISTANCE;
+			}
+			return rays;
+		}
+
+		//	prints the best of RUN_COUNT runs in millions of rays per second, returns the number of rays which hit
+		template<typename RaycastFunction>
+		size_t runRaycastBenchmark(const char* apName, const std::vector<CubeRay>& aRays, RaycastFunction&& aRaycast)
+		{
+			std::vector<CubeRayHit> hits(aRays.size());
+			std::unique_ptr<bool[]> pIsHit = std::make_unique<bool[]>(aRays.size());
+			double bestSeconds = std::numeric_limits<double>::infinity();
+			for (int32_t run = 0; run < RUN_COUNT; run++)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				aRaycast(aRays.data(), aRays.size(), hits.data(), pIsHit.get());
+				bestSeconds = std::min(bestSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+			}
+			const size_t hitCount = std::count(pIsHit.get(), pIsHit.get() + aRays.size(), true);
+			std::printf("    %-36s %8.2f M rays/s\n", apName, static_cast<double>(aRays.size()) / bestSeconds / 1000000.0);
+			return hitCount;
+		}
+	}
+
+	TDE_BENCHMARK(CubeRaycasterThroughput)
+	{
+		const std::shared_ptr<CubeWorld> pCubeWorld = generateCubeWorld(CubeWorldGeneratorSettings{},
+			CubeCoord{ -WORLD_CHUNKS, 0, -WORLD_CHUNKS }, CubeCoord{ WORLD_CHUNKS - 1, 2, WORLD_CHUNKS - 1 });
+		const CubeWorldOctree octree(*pCubeWorld);
+		const std::vector<CubeRay> rays = makeRays();
+		std::printf("    %zu rays, avx2 %s, %u threads\n", rays.size(), isAvx2Supported() ? "supported" : "not supported",
+			std::thread::hardware_concurrency());
+
+		const size_t scalarHitCount = runRaycastBenchmark("scalar", rays,
+			[&](const CubeRay* apRays, const size_t aCount, CubeRayHit* apHits, bool* apIsHit) { raycastCubesScalar(octree, apRays, aCount, apHits, apIsHit); });
+		//	the same batches as raycastCubesParallel, only without avx2
+		const size_t scalarParallelHitCount = runRaycastBenchmark("scalar parallel", rays,
+			[&](const CubeRay* apRays, const size_t aCount, CubeRayHit* apHits, bool* apIsHit)
+			{
+				const size_t batchCount = (aCount + CUBE_RAY_BATCH_SIZE - 1) / CUBE_RAY_BATCH_SIZE;
+				parallelFor(WorkDispatcherLocator::Get().get(), 0, batchCount, [&](const size_t aBatch)
+				{
+					const size_t first = aBatch * CUBE_RAY_BATCH_SIZE;
+					raycastCubesScalar(octree, apRays + first, std::min(CUBE_RAY_BATCH_SIZE, aCount - first), apHits + first, apIsHit + first);
+				});
+			});
+		const size_t hitCount = runRaycastBenchmark("raycastCubes", rays,
+			[&](const CubeRay* apRays, const size_t aCount, CubeRayHit* apHits, bool* apIsHit) { raycastCubes(octree, apRays, aCount, apHits, apIsHit); });
+		const size_t parallelHitCount = runRaycastBenchmark("raycastCubesParallel", rays,
+			[&](const CubeRay* apRays, const size_t aCount, CubeRayHit* apHits, bool* apIsHit) { raycastCubesParallel(octree, apRays, aCount, apHits, apIsHit); });
+
+		//	a faster path which misses cubes isn't faster
+		TDE_CHECK(scalarHitCount > 0 && scalarHitCount < rays.size());
+		TDE_CHECK(scalarParallelHitCount == scalarHitCount);
+		TDE_CHECK(hitCount == scalarHitCount);
+		TDE_CHECK(parallelHitCount == scalarHitCount);
+	}
+}